@@ -0,0 +1,493 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include "card_domain.h"
+#include "card_service.h"
+#include "card_simulator.h"
+#include "card_metrics.h"
+#include "reader_pool.h"
+
+/**
+ * Измерения сервиса карт на эмуляторе карты памяти (card_simulator).
+ * Каждый тест выводит одну строку JSON: пропускная способность, задержки
+ * (с учётом двух вызовов card_metrics_now на операцию), количество выделений
+ * памяти на операцию и число ошибок. Чтение и запись в буферы вызывающего
+ * после прогрева не должны обращаться к куче: при подсчёте выделений такой
+ * тест считается проваленным и программа возвращает 1.
+ *
+ * Установка сессии измеряется с моделью стоимости подключения: новое
+ * подключение стоит connectLatency, сброс через повторное подключение —
+ * resetLatency. «Холодные» варианты каждый раз устанавливают подключение
+ * заново, «тёплые» сохраняют его между сессиями и сбрасывают карту без
+ * переподключения.
+ *
+ * Использование: card_bench [итераций] [задержка APDU, мкс] [задержка подключения, мкс]
+ */
+
+#define BENCH_MAX_THREADS 8
+#define BENCH_WARMUP 1000
+#define BENCH_POOL_LATENCY 100         /* Задержка APDU для пула, если она не задана, мкс */
+#define BENCH_CONNECT_LATENCY 1000     /* Задержка установки подключения по умолчанию, мкс */
+
+static volatile LONG allocationCount = 0;
+
+#ifdef CARD_BENCH_COUNT_ALLOCATIONS
+/* Подсчёт выделений: сборка с -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc */
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* memory, size_t size);
+
+void* __wrap_malloc(size_t size) {
+    InterlockedIncrement(&allocationCount);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    InterlockedIncrement(&allocationCount);
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* memory, size_t size) {
+    InterlockedIncrement(&allocationCount);
+    return __real_realloc(memory, size);
+}
+#endif
+
+typedef struct {
+    CardSimulatorContext simulator;
+    CardContext context;
+    CardRepository repository;
+    CardService service;
+    uint8_t buffer[4096];
+} BenchSession;
+
+typedef int (*BenchOperation)(BenchSession* session, size_t iteration);
+
+typedef struct {
+    BenchSession* session;
+    BenchOperation operation;
+    size_t iterations;
+    uint64_t* samples;
+    size_t errors;
+    HANDLE start;
+} BenchWorker;
+
+static int bench_open(BenchSession* session, const CardSimulatorConfig* config) {
+    memset(session, 0, sizeof(BenchSession));
+    session->context.context = &session->simulator;
+    session->repository = card_simulator_create_repository();
+    
+    int result = card_service_initialize(&session->service, &session->repository, &session->context);
+    if (result != CARD_SUCCESS) {
+        return result;
+    }
+    
+    result = card_simulator_configure(&session->context, config);
+    if (result == CARD_SUCCESS) {
+        result = card_service_connect(&session->service, CARD_SIMULATOR_READER);
+    }
+    
+    if (result != CARD_SUCCESS) {
+        card_service_release(&session->service);
+    }
+    return result;
+}
+
+static void bench_close(BenchSession* session) {
+    card_service_disconnect(&session->service);
+    card_service_release(&session->service);
+}
+
+static int op_read_data(BenchSession* session, size_t iteration) {
+    CardData data = { NULL, 0, NULL };
+    int result = card_service_read_data(&session->service, (uint8_t)(iteration * 16), 64, &data);
+    card_data_release(&data);
+    return result;
+}
+
+static int op_read_into(BenchSession* session, size_t iteration) {
+    return card_service_read_into(&session->service, (uint16_t)((iteration * 64) % 0x7000),
+                                  session->buffer, 64);
+}
+
+static int op_read_range_4k(BenchSession* session, size_t iteration) {
+    return card_service_read_into(&session->service, (uint16_t)((iteration % 4) * 4096),
+                                  session->buffer, sizeof(session->buffer));
+}
+
+static int op_rewrite_data(BenchSession* session, size_t iteration) {
+    CardData data = { session->buffer, 16, NULL };
+    session->buffer[0] = (uint8_t)iteration;
+    return card_service_rewrite_data(&session->service, (uint8_t)(iteration * 16), &data);
+}
+
+static const uint8_t uidCommand[] = { 0xFF, 0xCA, 0x00, 0x00, 0x00 };
+
+static int op_execute_command(BenchSession* session, size_t iteration) {
+    (void)iteration;
+    CardData command = { (uint8_t*)uidCommand, sizeof(uidCommand), NULL };
+    CardData response = { session->buffer, 258, NULL };
+    return card_service_execute_command(&session->service, &command, &response);
+}
+
+static int op_execute_allocating(BenchSession* session, size_t iteration) {
+    (void)iteration;
+    CardData command = { (uint8_t*)uidCommand, sizeof(uidCommand), NULL };
+    CardData response = { NULL, 0, NULL };
+    int result = card_service_execute_command(&session->service, &command, &response);
+    card_data_release(&response);
+    return result;
+}
+
+/* Вызов репозитория напрямую: базовая линия для оценки накладных расходов сервиса */
+static int op_transmit_direct(BenchSession* session, size_t iteration) {
+    (void)iteration;
+    size_t responseLength = 258;
+    return session->repository.transmit(&session->context, uidCommand, sizeof(uidCommand),
+                                        session->buffer, &responseLength);
+}
+
+static int op_session_connect(BenchSession* session, size_t iteration) {
+    (void)iteration;
+    int result = card_service_disconnect(&session->service);
+    if (result == CARD_SUCCESS) {
+        result = card_service_connect(&session->service, CARD_SIMULATOR_READER);
+    }
+    return result;
+}
+
+/* Сброс без повторного подключения недоступен: карта сбрасывается при отключении */
+static int op_session_reset_cold(BenchSession* session, size_t iteration) {
+    (void)iteration;
+    int result = card_service_disconnect_with(&session->service, CARD_DISPOSITION_RESET);
+    if (result == CARD_SUCCESS) {
+        result = card_service_connect(&session->service, CARD_SIMULATOR_READER);
+    }
+    return result;
+}
+
+static int op_session_reset(BenchSession* session, size_t iteration) {
+    (void)iteration;
+    return card_service_reset(&session->service, CARD_DISPOSITION_RESET);
+}
+
+static DWORD WINAPI bench_thread(LPVOID parameter) {
+    BenchWorker* worker = (BenchWorker*)parameter;
+    
+    WaitForSingleObject(worker->start, INFINITE);
+    
+    for (size_t i = 0; i < worker->iterations; i++) {
+        uint64_t started = card_metrics_now();
+        int result = worker->operation(worker->session, i);
+        worker->samples[i] = card_metrics_now() - started;
+        if (result != CARD_SUCCESS) {
+            worker->errors++;
+        }
+    }
+    
+    return 0;
+}
+
+static int compare_samples(const void* left, const void* right) {
+    uint64_t a = *(const uint64_t*)left;
+    uint64_t b = *(const uint64_t*)right;
+    return (a > b) - (a < b);
+}
+
+/**
+ * Прогон одной операции
+ * @param allocationFree Операция горячего пути: при подсчёте выделений их не должно быть
+ * @return Код ошибки из CardError
+ */
+static int run_bench(const char* name, BenchOperation operation, const CardSimulatorConfig* config,
+                     size_t threads, size_t iterations, size_t bytes, int allocationFree) {
+    static BenchSession sessions[BENCH_MAX_THREADS];
+    BenchWorker workers[BENCH_MAX_THREADS];
+    HANDLE handles[BENCH_MAX_THREADS];
+    size_t total = threads * iterations;
+    
+    uint64_t* samples = (uint64_t*)malloc(total * sizeof(uint64_t));
+    HANDLE start = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (!samples || !start) {
+        printf("{\"bench\":\"%s\",\"error\":\"init\"}\n", name);
+        free(samples);
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    size_t opened = 0;
+    size_t started = 0;
+    int result = CARD_SUCCESS;
+    
+    // Сессии открываются и прогреваются до начала измерения
+    for (; opened < threads; opened++) {
+        result = bench_open(&sessions[opened], config);
+        if (result != CARD_SUCCESS) {
+            break;
+        }
+        for (size_t i = 0; i < BENCH_WARMUP; i++) {
+            operation(&sessions[opened], i);
+        }
+    }
+    
+    for (; result == CARD_SUCCESS && started < threads; started++) {
+        workers[started].session = &sessions[started];
+        workers[started].operation = operation;
+        workers[started].iterations = iterations;
+        workers[started].samples = samples + started * iterations;
+        workers[started].errors = 0;
+        workers[started].start = start;
+        
+        handles[started] = CreateThread(NULL, 0, bench_thread, &workers[started], 0, NULL);
+        if (!handles[started]) {
+            result = CARD_ERROR_INIT_FAILED;
+            break;
+        }
+    }
+    
+    uint64_t elapsed = 0;
+    LONG allocations = 0;
+    
+    if (result == CARD_SUCCESS) {
+        LONG allocationsBefore = allocationCount;
+        uint64_t begin = card_metrics_now();
+        SetEvent(start);
+        WaitForMultipleObjects((DWORD)threads, handles, TRUE, INFINITE);
+        elapsed = card_metrics_now() - begin;
+        allocations = allocationCount - allocationsBefore;
+    } else {
+        // Запущенные потоки завершаются, результат не выводится
+        SetEvent(start);
+        if (started > 0) {
+            WaitForMultipleObjects((DWORD)started, handles, TRUE, INFINITE);
+        }
+    }
+    
+    for (size_t i = 0; i < started; i++) {
+        CloseHandle(handles[i]);
+    }
+    for (size_t i = 0; i < opened; i++) {
+        bench_close(&sessions[i]);
+    }
+    CloseHandle(start);
+    
+    if (result != CARD_SUCCESS) {
+        printf("{\"bench\":\"%s\",\"threads\":%zu,\"error\":%d}\n", name, threads, result);
+        free(samples);
+        return result;
+    }
+    
+    size_t errors = 0;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < threads; i++) {
+        errors += workers[i].errors;
+    }
+    for (size_t i = 0; i < total; i++) {
+        sum += samples[i];
+    }
+    qsort(samples, total, sizeof(uint64_t), compare_samples);
+    
+    printf("{\"bench\":\"%s\",\"threads\":%zu,\"iterations\":%zu,\"bytes\":%zu,"
+           "\"apdu_latency_us\":%lu,\"connect_latency_us\":%lu,\"error_rate\":%lu,\"ops_per_sec\":%.0f,\"mean_ns\":%llu,"
+           "\"p50_ns\":%llu,\"p90_ns\":%llu,\"p99_ns\":%llu,\"max_ns\":%llu,",
+           name, threads, iterations, bytes,
+           (unsigned long)config->transmitLatency, (unsigned long)config->connectLatency,
+           (unsigned long)config->errorRate,
+           elapsed ? (double)total * 1e9 / (double)elapsed : 0.0,
+           (unsigned long long)(sum / total),
+           (unsigned long long)samples[(total - 1) * 50 / 100],
+           (unsigned long long)samples[(total - 1) * 90 / 100],
+           (unsigned long long)samples[(total - 1) * 99 / 100],
+           (unsigned long long)samples[total - 1]);
+
+#ifdef CARD_BENCH_COUNT_ALLOCATIONS
+    printf("\"allocs_per_op\":%.3f,", (double)allocations / (double)total);
+    // После прогрева горячий путь работает без кучи
+    if (allocationFree && allocations > 0) {
+        result = CARD_ERROR_MEMORY_ALLOCATION;
+        printf("\"allocation_free\":false,");
+    }
+#else
+    (void)allocations;
+    (void)allocationFree;
+    printf("\"allocs_per_op\":null,");
+#endif
+    printf("\"errors\":%zu}\n", errors);
+    fflush(stdout);
+    
+    free(samples);
+    return result;
+}
+
+/* ---- Пул считывателей ---- */
+
+static CardSimulatorConfig poolConfig;
+
+/* Потоки пула создают контексты сами; параметры эмулятора задаются при инициализации */
+static int pool_simulator_initialize(CardContext* context) {
+    int result = card_simulator_initialize(context);
+    if (result == CARD_SUCCESS) {
+        result = card_simulator_configure(context, &poolConfig);
+    }
+    return result;
+}
+
+/* Задания разной длины (от 1 до 4 APDU), чтобы очереди расходились и потоки забирали чужие задания */
+static int pool_job(CardService* service, void* argument) {
+    size_t index = (size_t)argument;
+    uint8_t buffer[64];
+    int result = CARD_SUCCESS;
+    
+    for (size_t i = 0; i <= index % 4 && result == CARD_SUCCESS; i++) {
+        result = card_service_read_into(service, (uint16_t)(((index + i) * 64) % 0x7000), buffer, sizeof(buffer));
+    }
+    return result;
+}
+
+/**
+ * Пакет заданий через reader_pool: две волны с ожиданием простоя между ними
+ * Проверяется, что каждое задание выполнено ровно один раз и без ошибок.
+ */
+static int run_pool_bench(size_t readers, size_t jobCount, double* baseline) {
+    char names[BENCH_MAX_THREADS][24];
+    const char* readerNames[BENCH_MAX_THREADS];
+    for (size_t i = 0; i < readers; i++) {
+        snprintf(names[i], sizeof(names[i]), "Simulator %zu", i + 1);
+        readerNames[i] = names[i];
+    }
+    
+    ReaderPoolJob* jobs = (ReaderPoolJob*)calloc(jobCount, sizeof(ReaderPoolJob));
+    if (!jobs) {
+        printf("{\"bench\":\"reader_pool\",\"readers\":%zu,\"error\":\"init\"}\n", readers);
+        return CARD_ERROR_MEMORY_ALLOCATION;
+    }
+    
+    CardRepository repository = card_simulator_create_repository();
+    repository.initialize = pool_simulator_initialize;
+    
+    ReaderPoolConfig config;
+    memset(&config, 0, sizeof(config));
+    config.repository = &repository;
+    config.contextSize = sizeof(CardSimulatorContext);
+    config.readerNames = readerNames;
+    config.readerCount = readers;
+    
+    ReaderPool pool;
+    int result = reader_pool_start(&pool, &config);
+    if (result != CARD_SUCCESS) {
+        printf("{\"bench\":\"reader_pool\",\"readers\":%zu,\"error\":%d}\n", readers, result);
+        free(jobs);
+        return result;
+    }
+    
+    uint64_t begin = card_metrics_now();
+    size_t half = jobCount / 2;
+    for (size_t i = 0; i < jobCount && result == CARD_SUCCESS; i++) {
+        jobs[i].run = pool_job;
+        jobs[i].argument = (void*)i;
+        result = reader_pool_submit(&pool, &jobs[i]);
+        
+        // Потоки засыпают и просыпаются снова: вторая волна после полного простоя
+        if (i + 1 == half) {
+            reader_pool_wait_idle(&pool);
+        }
+    }
+    reader_pool_wait_idle(&pool);
+    uint64_t elapsed = card_metrics_now() - begin;
+    
+    LONG completed = 0;
+    LONG stolen = 0;
+    for (size_t i = 0; i < pool.workerCount; i++) {
+        completed += pool.workers[i].completed;
+        stolen += pool.workers[i].stolen;
+    }
+    reader_pool_stop(&pool);
+    
+    size_t errors = 0;
+    for (size_t i = 0; i < jobCount; i++) {
+        if (jobs[i].result != CARD_SUCCESS || jobs[i].readerIndex >= readers) {
+            errors++;
+        }
+    }
+    free(jobs);
+    
+    double jobsPerSec = elapsed ? (double)jobCount * 1e9 / (double)elapsed : 0.0;
+    if (readers == 1) {
+        *baseline = jobsPerSec;
+    }
+    
+    printf("{\"bench\":\"reader_pool\",\"readers\":%zu,\"jobs\":%zu,\"apdu_latency_us\":%lu,"
+           "\"jobs_per_sec\":%.0f,\"speedup\":%.2f,\"completed\":%ld,\"stolen\":%ld,\"errors\":%zu}\n",
+           readers, jobCount, (unsigned long)poolConfig.transmitLatency, jobsPerSec,
+           *baseline > 0.0 ? jobsPerSec / *baseline : 0.0, (long)completed, (long)stolen, errors);
+    fflush(stdout);
+    
+    if (result != CARD_SUCCESS) {
+        return result;
+    }
+    return (errors == 0 && (size_t)completed == jobCount) ? CARD_SUCCESS : CARD_ERROR_TRANSMIT_FAILED;
+}
+
+int main(int argc, char** argv) {
+    size_t iterations = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 100000;
+    uint32_t latency = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 0;
+    uint32_t connectLatency = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 10) : BENCH_CONNECT_LATENCY;
+    
+    if (iterations == 0) {
+        printf("Использование: %s [итераций] [задержка APDU, мкс] [задержка подключения, мкс]\n", argv[0]);
+        return 1;
+    }
+    
+    CardSimulatorConfig config;
+    card_simulator_default_config(&config);
+    config.transmitLatency = latency;
+    
+    CardSimulatorConfig extended = config;
+    extended.extendedLength = 1;
+    
+    CardSimulatorConfig faulty = config;
+    faulty.errorRate = 100;
+    
+    // Сброс карты обходится дешевле установки подключения
+    CardSimulatorConfig cold = config;
+    cold.connectLatency = connectLatency;
+    cold.resetLatency = connectLatency / 5;
+    
+    CardSimulatorConfig warm = cold;
+    warm.persistent = 1;
+    
+    int failures = 0;
+    
+    // Операции сервиса и накладные расходы диспетчеризации
+    failures += run_bench("transmit_direct", op_transmit_direct, &config, 1, iterations, 4, 1) != CARD_SUCCESS;
+    failures += run_bench("execute_command", op_execute_command, &config, 1, iterations, 4, 1) != CARD_SUCCESS;
+    failures += run_bench("execute_command_alloc", op_execute_allocating, &config, 1, iterations, 4, 0) != CARD_SUCCESS;
+    failures += run_bench("read_data", op_read_data, &config, 1, iterations, 64, 0) != CARD_SUCCESS;
+    failures += run_bench("read_into", op_read_into, &config, 1, iterations, 64, 1) != CARD_SUCCESS;
+    failures += run_bench("rewrite_data", op_rewrite_data, &config, 1, iterations, 16, 1) != CARD_SUCCESS;
+    failures += run_bench("read_range_4k", op_read_range_4k, &config, 1, iterations / 10 + 1, 4096, 1) != CARD_SUCCESS;
+    failures += run_bench("read_range_4k_extended", op_read_range_4k, &extended, 1, iterations / 10 + 1, 4096, 1) != CARD_SUCCESS;
+    failures += run_bench("read_into_errors", op_read_into, &faulty, 1, iterations, 64, 0) != CARD_SUCCESS;
+    
+    // Установка сессии
+    size_t sessions = connectLatency ? iterations / 100 + 1 : iterations / 10 + 1;
+    failures += run_bench("session_connect_cold", op_session_connect, &cold, 1, sessions, 0, 0) != CARD_SUCCESS;
+    failures += run_bench("session_connect_warm", op_session_connect, &warm, 1, sessions, 0, 0) != CARD_SUCCESS;
+    failures += run_bench("session_reset_cold", op_session_reset_cold, &cold, 1, sessions, 0, 0) != CARD_SUCCESS;
+    failures += run_bench("session_reset_warm", op_session_reset, &warm, 1, sessions, 0, 0) != CARD_SUCCESS;
+    
+    // Масштабирование: у каждого потока своя эмулированная карта и сервис
+    for (size_t threads = 1; threads <= BENCH_MAX_THREADS; threads *= 2) {
+        failures += run_bench("read_into_scaling", op_read_into, &config, threads, iterations, 64, 0) != CARD_SUCCESS;
+    }
+    
+    // Пул считывателей: общая очередь заданий с перехватом между потоками
+    poolConfig = config;
+    poolConfig.transmitLatency = latency ? latency : BENCH_POOL_LATENCY;
+    double baseline = 0.0;
+    for (size_t readers = 1; readers <= BENCH_MAX_THREADS; readers *= 2) {
+        failures += run_pool_bench(readers, iterations / 100 + 2, &baseline) != CARD_SUCCESS;
+    }
+    
+    return failures ? 1 : 0;
+} 
\ No newline at end of file
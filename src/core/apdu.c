@@ -0,0 +1,159 @@
+#include "apdu.h"
+#include "card_domain.h"
+#include <string.h>
+
+int apdu_needs_extended(size_t dataLength, size_t expectedLength) {
+    return dataLength > APDU_SHORT_MAX_LC || expectedLength > APDU_SHORT_MAX_LE;
+}
+
+size_t apdu_encoded_length(size_t dataLength, size_t expectedLength, int extended) {
+    size_t length = APDU_HEADER_LENGTH;
+    
+    if (dataLength > 0) {
+        length += (extended ? 3 : 1) + dataLength;
+    }
+    
+    if (expectedLength > 0) {
+        // В расширенной форме Le занимает 3 байта, если поля Lc нет, иначе 2
+        length += extended ? (dataLength > 0 ? 2 : 3) : 1;
+    }
+    
+    return length;
+}
+
+int apdu_encode(uint8_t* buffer, size_t capacity, uint8_t cla, uint8_t ins, uint8_t p1, uint8_t p2,
+                const uint8_t* data, size_t dataLength, size_t expectedLength, int extended,
+                size_t* commandLength) {
+    if (!buffer || !commandLength || (dataLength > 0 && !data)) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    if (extended ? (dataLength > APDU_EXTENDED_MAX_LC || expectedLength > APDU_EXTENDED_MAX_LE)
+                 : apdu_needs_extended(dataLength, expectedLength)) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    size_t length = apdu_encoded_length(dataLength, expectedLength, extended);
+    if (length > capacity) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    buffer[0] = cla;
+    buffer[1] = ins;
+    buffer[2] = p1;
+    buffer[3] = p2;
+    
+    size_t position = APDU_HEADER_LENGTH;
+    
+    if (dataLength > 0) {
+        if (extended) {
+            buffer[position++] = 0x00;
+            buffer[position++] = (uint8_t)(dataLength >> 8);
+        }
+        buffer[position++] = (uint8_t)dataLength;
+        
+        // Данные, уже подготовленные на месте, не копируются
+        if (buffer + position != data) {
+            memmove(buffer + position, data, dataLength);
+        }
+        position += dataLength;
+    }
+    
+    if (expectedLength > 0) {
+        if (extended) {
+            if (dataLength == 0) {
+                buffer[position++] = 0x00;
+            }
+            // 65536 кодируется как 00 00
+            buffer[position++] = (uint8_t)((expectedLength >> 8) & 0xFF);
+        }
+        // 256 в короткой форме кодируется как 00
+        buffer[position++] = (uint8_t)(expectedLength & 0xFF);
+    }
+    
+    *commandLength = position;
+    return CARD_SUCCESS;
+}
+
+int apdu_parse(const uint8_t* command, size_t commandLength, ApduCommand* parsed) {
+    if (!command || !parsed || commandLength < APDU_HEADER_LENGTH) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    memset(parsed, 0, sizeof(ApduCommand));
+    parsed->cla = command[0];
+    parsed->ins = command[1];
+    parsed->p1 = command[2];
+    parsed->p2 = command[3];
+    
+    const uint8_t* body = command + APDU_HEADER_LENGTH;
+    size_t bodyLength = commandLength - APDU_HEADER_LENGTH;
+    
+    // Случай 1: только заголовок
+    if (bodyLength == 0) {
+        return CARD_SUCCESS;
+    }
+    
+    // Случай 2S: только Le
+    if (bodyLength == 1) {
+        parsed->expectedLength = body[0] ? body[0] : APDU_SHORT_MAX_LE;
+        return CARD_SUCCESS;
+    }
+    
+    // Случаи 3S и 4S: Lc в одном ненулевом байте
+    if (body[0] != 0x00) {
+        size_t dataLength = body[0];
+        if (bodyLength != 1 + dataLength && bodyLength != 2 + dataLength) {
+            return CARD_ERROR_INVALID_PARAMETER;
+        }
+        
+        parsed->data = body + 1;
+        parsed->dataLength = dataLength;
+        if (bodyLength == 2 + dataLength) {
+            uint8_t le = body[1 + dataLength];
+            parsed->expectedLength = le ? le : APDU_SHORT_MAX_LE;
+        }
+        return CARD_SUCCESS;
+    }
+    
+    // Расширенная форма: 00 и два байта длины
+    if (bodyLength < 3) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    parsed->extended = 1;
+    size_t value = ((size_t)body[1] << 8) | body[2];
+    
+    // Случай 2E: только Le
+    if (bodyLength == 3) {
+        parsed->expectedLength = value ? value : APDU_EXTENDED_MAX_LE;
+        return CARD_SUCCESS;
+    }
+    
+    // Случаи 3E и 4E
+    if (value == 0 || (bodyLength != 3 + value && bodyLength != 5 + value)) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    parsed->data = body + 3;
+    parsed->dataLength = value;
+    if (bodyLength == 5 + value) {
+        size_t le = ((size_t)body[3 + value] << 8) | body[4 + value];
+        parsed->expectedLength = le ? le : APDU_EXTENDED_MAX_LE;
+    }
+    
+    return CARD_SUCCESS;
+}
+
+uint8_t apdu_get_response_class(uint8_t cla) {
+    // Собственные классы (в том числе псевдо-APDU PC/SC) используют класс 00
+    if (cla & 0x80) {
+        return 0x00;
+    }
+    
+    // Дополнительный межотраслевой класс: канал в младших четырёх битах
+    if (cla & 0x40) {
+        return (uint8_t)(cla & 0x4F);
+    }
+    
+    return (uint8_t)(cla & 0x03);
+} 
\ No newline at end of file
@@ -0,0 +1,98 @@
+#ifndef APDU_H
+#define APDU_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * Слой ядра (Core Layer)
+ * Кодирование командных APDU по ISO 7816-4 (короткая и расширенная длина)
+ */
+
+#define APDU_HEADER_LENGTH 4            /* CLA INS P1 P2 */
+#define APDU_SHORT_MAX_LC 255           /* Максимальный Lc короткой команды */
+#define APDU_SHORT_MAX_LE 256           /* Короткий Le = 00 означает 256 байт */
+#define APDU_EXTENDED_MAX_LC 65535      /* Максимальный Lc расширенной команды */
+#define APDU_EXTENDED_MAX_LE 65536      /* Расширенный Le = 0000 означает 65536 байт */
+
+/* Максимальная длина закодированной команды: заголовок, 3 байта Lc, данные, 2 байта Le */
+#define APDU_MAX_COMMAND_LENGTH (APDU_HEADER_LENGTH + 3 + APDU_EXTENDED_MAX_LC + 2)
+
+/* Максимальная длина ответа: данные и статусное слово SW1 SW2 */
+#define APDU_MAX_RESPONSE_LENGTH (APDU_EXTENDED_MAX_LE + 2)
+
+#define APDU_CLA_CHAINING 0x10          /* Бит цепочки команд в CLA (ISO 7816-4) */
+#define APDU_INS_GET_RESPONSE 0xC0
+#define APDU_SW1_MORE_DATA 0x61         /* 61 XX — XX байт доступны через GET RESPONSE */
+#define APDU_SW1_WRONG_LENGTH 0x6C      /* 6C XX — команду нужно повторить с Le = XX */
+
+/**
+ * Разобранная командная APDU
+ */
+typedef struct {
+    uint8_t cla;
+    uint8_t ins;
+    uint8_t p1;
+    uint8_t p2;
+    const uint8_t* data;      /* Указывает внутрь исходной команды */
+    size_t dataLength;        /* Lc, 0 — поле отсутствует */
+    size_t expectedLength;    /* Le, 0 — поле отсутствует */
+    int extended;             /* Команда в расширенной форме */
+} ApduCommand;
+
+/**
+ * Проверка, требует ли команда расширенной длины
+ * @param dataLength Длина поля данных (Lc), 0 — поле отсутствует
+ * @param expectedLength Ожидаемая длина ответа (Le), 0 — поле отсутствует
+ * @return 1, если Lc или Le не помещаются в короткую форму, иначе 0
+ */
+int apdu_needs_extended(size_t dataLength, size_t expectedLength);
+
+/**
+ * Длина закодированной команды
+ * @param dataLength Длина поля данных (Lc), 0 — поле отсутствует
+ * @param expectedLength Ожидаемая длина ответа (Le), 0 — поле отсутствует
+ * @param extended Использовать расширенную форму Lc/Le
+ * @return Длина команды в байтах
+ */
+size_t apdu_encoded_length(size_t dataLength, size_t expectedLength, int extended);
+
+/**
+ * Кодирование команды в буфер
+ * Данные могут уже находиться в буфере на своём месте (смещение 5 или 7),
+ * тогда копирование не выполняется.
+ * @param buffer Буфер для команды
+ * @param capacity Размер буфера
+ * @param cla Байт класса
+ * @param ins Байт инструкции
+ * @param p1 Параметр P1
+ * @param p2 Параметр P2
+ * @param data Поле данных (может быть NULL, если dataLength == 0)
+ * @param dataLength Длина поля данных (Lc)
+ * @param expectedLength Ожидаемая длина ответа (Le), 0 — поле отсутствует
+ * @param extended Использовать расширенную форму Lc/Le
+ * @param commandLength Длина закодированной команды
+ * @return Код ошибки из CardError
+ */
+int apdu_encode(uint8_t* buffer, size_t capacity, uint8_t cla, uint8_t ins, uint8_t p1, uint8_t p2,
+                const uint8_t* data, size_t dataLength, size_t expectedLength, int extended,
+                size_t* commandLength);
+
+/**
+ * Разбор команды (случаи 1–4 в короткой и расширенной форме)
+ * @param command Команда
+ * @param commandLength Длина команды
+ * @param parsed Результат разбора
+ * @return Код ошибки из CardError
+ */
+int apdu_parse(const uint8_t* command, size_t commandLength, ApduCommand* parsed);
+
+/**
+ * Класс команды GET RESPONSE для ответа на команду с классом cla
+ * Сохраняется номер логического канала межотраслевого класса.
+ * @param cla Класс исходной команды
+ * @return Класс GET RESPONSE
+ */
+uint8_t apdu_get_response_class(uint8_t cla);
+
+#endif /* APDU_H */ 
\ No newline at end of file
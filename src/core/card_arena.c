@@ -0,0 +1,220 @@
+#include "card_arena.h"
+#include <string.h>
+
+/* Выравнивание выделяемой памяти (достаточно для любых скалярных типов) */
+#define CARD_ALLOC_ALIGNMENT 16
+#define CARD_ALIGN_UP(size) (((size) + CARD_ALLOC_ALIGNMENT - 1) & ~(size_t)(CARD_ALLOC_ALIGNMENT - 1))
+
+#define CARD_ARENA_CHUNK_HEADER CARD_ALIGN_UP(sizeof(CardArenaChunk))
+
+/**
+ * Заголовок блока пула; в свободном блоке хранит ссылку на следующий
+ */
+struct CardPoolBlock {
+    size_t sizeClass;          /* CARD_POOL_CLASS_COUNT — блок выделен мимо пула */
+    CardPoolBlock* next;
+};
+
+#define CARD_POOL_BLOCK_HEADER CARD_ALIGN_UP(sizeof(CardPoolBlock))
+
+static void* arena_allocate_callback(CardAllocator* allocator, size_t size) {
+    return card_arena_alloc((CardArena*)allocator, size);
+}
+
+static void arena_release_callback(CardAllocator* allocator, void* memory) {
+    // Память арены освобождается только сбросом
+    (void)allocator;
+    (void)memory;
+}
+
+static void* pool_allocate_callback(CardAllocator* allocator, size_t size) {
+    return card_pool_alloc((CardPool*)allocator, size);
+}
+
+static void pool_release_callback(CardAllocator* allocator, void* memory) {
+    card_pool_free((CardPool*)allocator, memory);
+}
+
+/**
+ * Выделение нового блока памяти арены
+ */
+static CardArenaChunk* arena_chunk_create(size_t capacity) {
+    CardArenaChunk* chunk = (CardArenaChunk*)malloc(CARD_ARENA_CHUNK_HEADER + capacity);
+    if (!chunk) {
+        return NULL;
+    }
+    
+    chunk->next = NULL;
+    chunk->capacity = capacity;
+    chunk->used = 0;
+    
+    return chunk;
+}
+
+int card_arena_initialize(CardArena* arena, size_t chunkSize) {
+    if (!arena) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    memset(arena, 0, sizeof(CardArena));
+    arena->allocator.allocate = arena_allocate_callback;
+    arena->allocator.release = arena_release_callback;
+    arena->chunkSize = chunkSize > 0 ? CARD_ALIGN_UP(chunkSize) : CARD_ARENA_DEFAULT_CHUNK_SIZE;
+    
+    // Первый блок выделяется при первом запросе
+    return CARD_SUCCESS;
+}
+
+void* card_arena_alloc(CardArena* arena, size_t size) {
+    if (!arena || size == 0 || size > SIZE_MAX - CARD_ARENA_CHUNK_HEADER - CARD_ALLOC_ALIGNMENT) {
+        return NULL;
+    }
+    
+    size = CARD_ALIGN_UP(size);
+    
+    // Переход к следующему сохранённому блоку после сброса
+    CardArenaChunk* chunk = arena->current;
+    while (chunk && chunk->capacity - chunk->used < size && chunk->next &&
+           chunk->next->capacity >= size) {
+        chunk = chunk->next;
+        chunk->used = 0;
+    }
+    
+    if (!chunk || chunk->capacity - chunk->used < size) {
+        CardArenaChunk* created = arena_chunk_create(size > arena->chunkSize ? size : arena->chunkSize);
+        if (!created) {
+            return NULL;
+        }
+        
+        // Новый блок встаёт за текущим, сохранённые блоки остаются в списке
+        if (chunk) {
+            created->next = chunk->next;
+            chunk->next = created;
+        } else {
+            arena->first = created;
+        }
+        chunk = created;
+    }
+    
+    arena->current = chunk;
+    void* memory = (uint8_t*)chunk + CARD_ARENA_CHUNK_HEADER + chunk->used;
+    chunk->used += size;
+    
+    return memory;
+}
+
+void card_arena_reset(CardArena* arena) {
+    if (!arena) {
+        return;
+    }
+    
+    // Занятость остальных блоков обнуляется при переходе к ним
+    arena->current = arena->first;
+    if (arena->first) {
+        arena->first->used = 0;
+    }
+}
+
+void card_arena_release(CardArena* arena) {
+    if (!arena) {
+        return;
+    }
+    
+    CardArenaChunk* chunk = arena->first;
+    while (chunk) {
+        CardArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    
+    arena->first = NULL;
+    arena->current = NULL;
+}
+
+/**
+ * Класс размера: наименьший блок CARD_POOL_MIN_BLOCK_SIZE << class, вмещающий size
+ */
+static size_t pool_size_class(size_t size) {
+    size_t sizeClass = 0;
+    size_t blockSize = CARD_POOL_MIN_BLOCK_SIZE;
+    
+    while (blockSize < size && sizeClass < CARD_POOL_CLASS_COUNT) {
+        blockSize <<= 1;
+        sizeClass++;
+    }
+    
+    return sizeClass;
+}
+
+int card_pool_initialize(CardPool* pool) {
+    if (!pool) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    memset(pool, 0, sizeof(CardPool));
+    pool->allocator.allocate = pool_allocate_callback;
+    pool->allocator.release = pool_release_callback;
+    
+    return CARD_SUCCESS;
+}
+
+void* card_pool_alloc(CardPool* pool, size_t size) {
+    if (!pool || size == 0 || size > SIZE_MAX - CARD_POOL_BLOCK_HEADER) {
+        return NULL;
+    }
+    
+    size_t sizeClass = pool_size_class(size);
+    CardPoolBlock* block = NULL;
+    
+    if (sizeClass < CARD_POOL_CLASS_COUNT && pool->freeLists[sizeClass]) {
+        block = pool->freeLists[sizeClass];
+        pool->freeLists[sizeClass] = block->next;
+        pool->cachedBlocks--;
+    } else {
+        size_t blockSize = sizeClass < CARD_POOL_CLASS_COUNT ?
+                           (size_t)CARD_POOL_MIN_BLOCK_SIZE << sizeClass : size;
+        block = (CardPoolBlock*)malloc(CARD_POOL_BLOCK_HEADER + blockSize);
+        if (!block) {
+            return NULL;
+        }
+        block->sizeClass = sizeClass;
+        pool->systemAllocations++;
+    }
+    
+    block->next = NULL;
+    return (uint8_t*)block + CARD_POOL_BLOCK_HEADER;
+}
+
+void card_pool_free(CardPool* pool, void* memory) {
+    if (!pool || !memory) {
+        return;
+    }
+    
+    CardPoolBlock* block = (CardPoolBlock*)((uint8_t*)memory - CARD_POOL_BLOCK_HEADER);
+    if (block->sizeClass >= CARD_POOL_CLASS_COUNT) {
+        free(block);
+        return;
+    }
+    
+    block->next = pool->freeLists[block->sizeClass];
+    pool->freeLists[block->sizeClass] = block;
+    pool->cachedBlocks++;
+}
+
+void card_pool_release(CardPool* pool) {
+    if (!pool) {
+        return;
+    }
+    
+    for (size_t i = 0; i < CARD_POOL_CLASS_COUNT; i++) {
+        CardPoolBlock* block = pool->freeLists[i];
+        while (block) {
+            CardPoolBlock* next = block->next;
+            free(block);
+            block = next;
+        }
+        pool->freeLists[i] = NULL;
+    }
+    
+    pool->cachedBlocks = 0;
+} 
\ No newline at end of file
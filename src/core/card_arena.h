@@ -0,0 +1,101 @@
+#ifndef CARD_ARENA_H
+#define CARD_ARENA_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "card_domain.h"
+
+/**
+ * Слой ядра (Core Layer)
+ * Распределители памяти для CardData:
+ *  - арена: выделение сдвигом указателя, освобождение всего сразу (на карту или задание);
+ *  - пул: списки свободных блоков по классам размеров для долгоживущих буферов.
+ * Распределители не потокобезопасны: каждый поток использует свой экземпляр.
+ */
+
+#define CARD_ARENA_DEFAULT_CHUNK_SIZE (64 * 1024)
+
+#define CARD_POOL_MIN_BLOCK_SIZE 32
+#define CARD_POOL_CLASS_COUNT 13   /* Классы 32 байта .. 128 КБ, покрывают ответ расширенной APDU */
+
+typedef struct CardArenaChunk {
+    struct CardArenaChunk* next;
+    size_t capacity;
+    size_t used;
+} CardArenaChunk;
+
+typedef struct {
+    CardAllocator allocator;   /* Интерфейс распределителя, первое поле */
+    CardArenaChunk* first;
+    CardArenaChunk* current;
+    size_t chunkSize;
+} CardArena;
+
+typedef struct CardPoolBlock CardPoolBlock;
+
+typedef struct {
+    CardAllocator allocator;   /* Интерфейс распределителя, первое поле */
+    CardPoolBlock* freeLists[CARD_POOL_CLASS_COUNT];
+    size_t cachedBlocks;       /* Блоков в списках свободных */
+    size_t systemAllocations;  /* Обращений к malloc */
+} CardPool;
+
+/**
+ * Инициализация арены
+ * @param arena Структура арены (память вызывающего)
+ * @param chunkSize Размер блока памяти арены, 0 — CARD_ARENA_DEFAULT_CHUNK_SIZE
+ * @return Код ошибки из CardError
+ */
+int card_arena_initialize(CardArena* arena, size_t chunkSize);
+
+/**
+ * Выделение памяти из арены
+ * @param arena Указатель на арену
+ * @param size Размер в байтах
+ * @return Указатель на память или NULL при ошибке
+ */
+void* card_arena_alloc(CardArena* arena, size_t size);
+
+/**
+ * Сброс арены: все выделенные объекты освобождаются, блоки памяти сохраняются
+ * @param arena Указатель на арену
+ */
+void card_arena_reset(CardArena* arena);
+
+/**
+ * Освобождение всей памяти арены
+ * @param arena Указатель на арену
+ */
+void card_arena_release(CardArena* arena);
+
+/**
+ * Инициализация пула
+ * @param pool Структура пула (память вызывающего)
+ * @return Код ошибки из CardError
+ */
+int card_pool_initialize(CardPool* pool);
+
+/**
+ * Выделение блока из пула
+ * Запросы больше старшего класса выделяются через malloc напрямую.
+ * @param pool Указатель на пул
+ * @param size Размер в байтах
+ * @return Указатель на память или NULL при ошибке
+ */
+void* card_pool_alloc(CardPool* pool, size_t size);
+
+/**
+ * Возврат блока в пул
+ * @param pool Указатель на пул
+ * @param memory Блок, выделенный card_pool_alloc
+ */
+void card_pool_free(CardPool* pool, void* memory);
+
+/**
+ * Освобождение свободных блоков пула
+ * Блоки, не возвращённые в пул, остаются за вызывающим.
+ * @param pool Указатель на пул
+ */
+void card_pool_release(CardPool* pool);
+
+#endif /* CARD_ARENA_H */ 
\ No newline at end of file
@@ -0,0 +1,162 @@
+#include "card_atr.h"
+#include "card_domain.h"
+#include <string.h>
+
+/* RID реестра PC/SC для карт памяти (PC/SC часть 3, раздел 3.1.3.2.3) */
+static const uint8_t storageCardRid[] = { 0xA0, 0x00, 0x00, 0x03, 0x06 };
+
+/**
+ * Разбор исторических байт: таблица возможностей карты (тег 7)
+ * и идентификатор приложения карты памяти (4F)
+ */
+static void card_atr_parse_historical(CardAtr* parsed) {
+    const uint8_t* historical = parsed->historical;
+    size_t end = parsed->historicalLength;
+    
+    if (end == 0) {
+        return;
+    }
+    
+    // Категория 00: последние три байта — индикатор состояния вне TLV
+    if (historical[0] == 0x00) {
+        if (end < 4) {
+            return;
+        }
+        end -= 3;
+    } else if (historical[0] != 0x80) {
+        return;
+    }
+    
+    // Объекты compact-TLV
+    size_t i = 1;
+    while (i < end) {
+        // PC/SC часть 3: 4F — идентификатор приложения с длиной в отдельном байте
+        if (historical[i] == 0x4F && i + 1 < end) {
+            size_t length = historical[i + 1];
+            const uint8_t* value = historical + i + 2;
+            if (i + 2 + length > end) {
+                break;
+            }
+            if (length >= 8 && memcmp(value, storageCardRid, sizeof(storageCardRid)) == 0) {
+                // RID, стандарт SS, имя карты NN NN
+                parsed->isStorageCard = 1;
+                parsed->storageStandard = value[5];
+                parsed->storageCardName = (uint16_t)((value[6] << 8) | value[7]);
+            }
+            i += 2 + length;
+            continue;
+        }
+        
+        uint8_t tag = historical[i] >> 4;
+        uint8_t length = historical[i] & 0x0F;
+        if (i + 1 + length > end) {
+            break;
+        }
+        
+        if (tag == 0x07 && length >= 3) {
+            parsed->extendedLength = (historical[i + 3] & 0x40) != 0;
+        }
+        i += 1 + length;
+    }
+}
+
+int card_atr_parse(const uint8_t* atr, size_t atrLength, CardAtr* parsed) {
+    if (!atr || !parsed || atrLength < 2 || (atr[0] != 0x3B && atr[0] != 0x3F)) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    memset(parsed, 0, sizeof(CardAtr));
+    parsed->ts = atr[0];
+    parsed->t0 = atr[1];
+    parsed->fi = 1;
+    parsed->di = 1;
+    parsed->ifsc = CARD_ATR_DEFAULT_IFSC;
+    
+    uint8_t indicator = atr[1] >> 4;
+    size_t position = 2;
+    int hasIfsc = 0;
+    
+    // Интерфейсные байты: набор i + 1 задаётся старшей тетрадой T0 или TDi
+    for (;;) {
+        size_t level = parsed->levels;
+        if (level >= CARD_ATR_MAX_LEVELS) {
+            return CARD_ERROR_INVALID_PARAMETER;
+        }
+        
+        size_t needed = (indicator & 0x01) + ((indicator >> 1) & 0x01) +
+                        ((indicator >> 2) & 0x01) + ((indicator >> 3) & 0x01);
+        if (position + needed > atrLength) {
+            return CARD_ERROR_INVALID_PARAMETER;
+        }
+        
+        parsed->present[level] = indicator;
+        if (indicator & CARD_ATR_TA) {
+            parsed->ta[level] = atr[position++];
+        }
+        if (indicator & CARD_ATR_TB) {
+            parsed->tb[level] = atr[position++];
+        }
+        if (indicator & CARD_ATR_TC) {
+            parsed->tc[level] = atr[position++];
+        }
+        if (indicator & CARD_ATR_TD) {
+            parsed->td[level] = atr[position++];
+        }
+        parsed->levels++;
+        
+        // Первый TAi (i >= 3) после TD(i-1) с T=1 задаёт IFSC
+        if (level >= 2 && !hasIfsc && (indicator & CARD_ATR_TA) && (parsed->td[level - 1] & 0x0F) == 1) {
+            parsed->ifsc = parsed->ta[level];
+            hasIfsc = 1;
+        }
+        
+        if (!(indicator & CARD_ATR_TD)) {
+            break;
+        }
+        
+        uint8_t protocol = parsed->td[level] & 0x0F;
+        if (parsed->protocols == 0) {
+            parsed->defaultProtocol = protocol;
+        }
+        parsed->protocols |= (uint16_t)(1u << protocol);
+        indicator = parsed->td[level] >> 4;
+    }
+    
+    // Без TD1 карта работает только в T=0
+    if (parsed->protocols == 0) {
+        parsed->protocols = CARD_ATR_PROTOCOL_T0;
+    }
+    
+    if (parsed->present[0] & CARD_ATR_TA) {
+        parsed->fi = parsed->ta[0] >> 4;
+        parsed->di = parsed->ta[0] & 0x0F;
+    }
+    if (parsed->present[0] & CARD_ATR_TC) {
+        parsed->extraGuardTime = parsed->tc[0];
+    }
+    if (parsed->levels > 1 && (parsed->present[1] & CARD_ATR_TA)) {
+        parsed->specificMode = 1;
+        parsed->specificProtocol = parsed->ta[1] & 0x0F;
+    }
+    
+    parsed->historicalLength = atr[1] & 0x0F;
+    if (position + parsed->historicalLength > atrLength) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    memcpy(parsed->historical, atr + position, parsed->historicalLength);
+    position += parsed->historicalLength;
+    
+    // TCK отсутствует, только если предложен один протокол T=0;
+    // ATR без обязательного TCK разбирается, но считается неподтверждённым
+    parsed->hasChecksum = parsed->protocols != CARD_ATR_PROTOCOL_T0 && position < atrLength;
+    if (parsed->hasChecksum) {
+        uint8_t checksum = 0;
+        for (size_t i = 1; i <= position; i++) {
+            checksum ^= atr[i];
+        }
+        parsed->checksumValid = checksum == 0;
+    }
+    
+    card_atr_parse_historical(parsed);
+    return CARD_SUCCESS;
+} 
\ No newline at end of file
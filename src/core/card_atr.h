@@ -0,0 +1,67 @@
+#ifndef CARD_ATR_H
+#define CARD_ATR_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * Слой ядра (Core Layer)
+ * Разбор ATR по ISO 7816-3: интерфейсные байты TA/TB/TC/TD, протоколы,
+ * исторические байты (ISO 7816-4) и идентификатор карты памяти PC/SC часть 3
+ */
+
+#define CARD_ATR_MAX_LEVELS 8          /* Наборов интерфейсных байт TAi..TDi */
+#define CARD_ATR_MAX_HISTORICAL 15
+
+#define CARD_ATR_TA 0x01               /* Признаки наличия байт в наборе (биты Y T0/TDi) */
+#define CARD_ATR_TB 0x02
+#define CARD_ATR_TC 0x04
+#define CARD_ATR_TD 0x08
+
+#define CARD_ATR_PROTOCOL_T0 0x0001    /* Бит n — протокол T=n */
+#define CARD_ATR_PROTOCOL_T1 0x0002
+#define CARD_ATR_PROTOCOL_T15 0x8000   /* T=15 — глобальные параметры, не протокол передачи */
+
+#define CARD_ATR_DEFAULT_IFSC 32       /* IFSC для T=1 без TAi (i >= 3) */
+
+/**
+ * Разобранный ATR
+ */
+typedef struct {
+    uint8_t ts;                              /* 3B — прямое, 3F — обратное соглашение */
+    uint8_t t0;
+    size_t levels;                           /* Наборов интерфейсных байт */
+    uint8_t present[CARD_ATR_MAX_LEVELS];    /* CARD_ATR_TA..CARD_ATR_TD для набора i + 1 */
+    uint8_t ta[CARD_ATR_MAX_LEVELS];
+    uint8_t tb[CARD_ATR_MAX_LEVELS];
+    uint8_t tc[CARD_ATR_MAX_LEVELS];
+    uint8_t td[CARD_ATR_MAX_LEVELS];
+    uint16_t protocols;                      /* Предложенные протоколы (CARD_ATR_PROTOCOL_*) */
+    uint8_t defaultProtocol;                 /* Первый указанный протокол, T=0 без TD1 */
+    uint8_t fi;                              /* Индексы Fi/Di из TA1 (1/1 без TA1) */
+    uint8_t di;
+    uint8_t extraGuardTime;                  /* TC1 */
+    int specificMode;                        /* TA2: карта работает только в указанном протоколе */
+    uint8_t specificProtocol;
+    size_t ifsc;                             /* Размер информационного поля карты для T=1 */
+    uint8_t historical[CARD_ATR_MAX_HISTORICAL];
+    size_t historicalLength;
+    int hasChecksum;                         /* TCK присутствует (обязателен, если предложен не только T=0) */
+    int checksumValid;
+    int extendedLength;                      /* Расширенные Lc/Le в таблице возможностей карты */
+    int isStorageCard;                       /* Идентификатор PC/SC часть 3 (RID A0 00 00 03 06) */
+    uint8_t storageStandard;                 /* SS: 03 — ISO 14443 A часть 3 и т. д. */
+    uint16_t storageCardName;                /* NN NN: 0001 — MIFARE Classic 1K и т. д. */
+} CardAtr;
+
+/**
+ * Разбор ATR
+ * Неверная контрольная сумма не считается ошибкой и отражается в checksumValid.
+ * @param atr Байты ATR
+ * @param atrLength Длина ATR
+ * @param parsed Структура для результата
+ * @return CARD_SUCCESS или CARD_ERROR_INVALID_PARAMETER для усечённого или неверного ATR
+ */
+int card_atr_parse(const uint8_t* atr, size_t atrLength, CardAtr* parsed);
+
+#endif /* CARD_ATR_H */ 
\ No newline at end of file
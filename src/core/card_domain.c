@@ -1,23 +1,45 @@
 #include "card_domain.h"
 #include <string.h>
 
+/**
+ * Выделение и освобождение памяти через распределитель или malloc/free
+ */
+static void* allocator_allocate(CardAllocator* allocator, size_t size) {
+    return allocator ? allocator->allocate(allocator, size) : malloc(size);
+}
+
+static void allocator_release(CardAllocator* allocator, void* memory) {
+    if (allocator) {
+        allocator->release(allocator, memory);
+    } else {
+        free(memory);
+    }
+}
+
 CardData* card_data_create(size_t length) {
+    return card_data_create_in(NULL, length);
+}
+
+CardData* card_data_create_in(CardAllocator* allocator, size_t length) {
     if (length == 0) {
         return NULL;
     }
     
-    CardData* data = (CardData*)malloc(sizeof(CardData));
+    // Буфер размещается отдельно от структуры: card_data_release и
+    // card_data_copy заменяют его, а вызывающий может освободить его сам
+    CardData* data = (CardData*)allocator_allocate(allocator, sizeof(CardData));
     if (!data) {
         return NULL;
     }
     
-    data->data = (uint8_t*)malloc(length);
+    data->data = (uint8_t*)allocator_allocate(allocator, length);
     if (!data->data) {
-        free(data);
+        allocator_release(allocator, data);
         return NULL;
     }
     
     data->length = length;
+    data->allocator = allocator;
     memset(data->data, 0, length);
     
     return data;
@@ -28,12 +50,38 @@ void card_data_free(CardData* data) {
         return;
     }
     
+    card_data_release(data);
+    allocator_release(data->allocator, data);
+}
+
+int card_data_reserve(CardData* data, size_t length) {
+    if (!data || length == 0) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    uint8_t* buffer = (uint8_t*)allocator_allocate(data->allocator, length);
+    if (!buffer) {
+        return CARD_ERROR_MEMORY_ALLOCATION;
+    }
+    
+    card_data_release(data);
+    data->data = buffer;
+    data->length = length;
+    
+    return CARD_SUCCESS;
+}
+
+void card_data_release(CardData* data) {
+    if (!data) {
+        return;
+    }
+    
     if (data->data) {
-        free(data->data);
-        data->data = NULL;
+        allocator_release(data->allocator, data->data);
     }
     
-    free(data);
+    data->data = NULL;
+    data->length = 0;
 }
 
 int card_data_copy(CardData* dest, const CardData* src) {
@@ -41,25 +89,85 @@ int card_data_copy(CardData* dest, const CardData* src) {
         return CARD_ERROR_INVALID_PARAMETER;
     }
     
-    // Если данные назначения не инициализированы или размер не соответствует
+    // Если данные назначения не инициализированы или размер не соответствует,
+    // новый буфер выделяется тем же распределителем
     if (!dest->data || dest->length < src->length) {
-        // Освобождаем старый буфер, если он есть
-        if (dest->data) {
-            free(dest->data);
-        }
-        
-        // Выделяем новый буфер
-        dest->data = (uint8_t*)malloc(src->length);
-        if (!dest->data) {
-            dest->length = 0;
-            return CARD_ERROR_MEMORY_ALLOCATION;
+        int result = card_data_reserve(dest, src->length);
+        if (result != CARD_SUCCESS) {
+            return result;
         }
-        
-        dest->length = src->length;
     }
     
     // Копируем данные
     memcpy(dest->data, src->data, src->length);
     
     return CARD_SUCCESS;
+}
+
+/**
+ * Проверка статусного слова элемента пакета по его маске
+ */
+static int batch_item_status(const CardBatchItem* item) {
+    if (item->responseLength < 2) {
+        return CARD_ERROR_TRANSMIT_FAILED;
+    }
+    
+    uint8_t sw1 = item->response[item->responseLength - 2];
+    uint8_t sw2 = item->response[item->responseLength - 1];
+    uint16_t status = (uint16_t)((sw1 << 8) | sw2);
+    
+    if (item->statusMask == 0) {
+        return (status == 0x9000 || sw1 == 0x61) ? CARD_SUCCESS : CARD_ERROR_BAD_STATUS;
+    }
+    
+    return (status & item->statusMask) == (item->expectedStatus & item->statusMask)
+        ? CARD_SUCCESS : CARD_ERROR_BAD_STATUS;
+}
+
+int card_batch_execute(CardContext* context, CardTransmitFunction transmit, CardBatchItem* items,
+                       size_t count, CardBatchPolicy policy, size_t* executed) {
+    if (executed) {
+        *executed = 0;
+    }
+    
+    if (!context || !transmit || (!items && count > 0)) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    int firstError = CARD_SUCCESS;
+    
+    for (size_t i = 0; i < count; i++) {
+        CardBatchItem* item = &items[i];
+        
+        if (!item->command || !item->response) {
+            item->result = CARD_ERROR_INVALID_PARAMETER;
+        } else {
+            item->result = transmit(context, item->command, item->commandLength,
+                                    item->response, &item->responseLength);
+            if (item->result == CARD_SUCCESS) {
+                item->result = batch_item_status(item);
+            } else {
+                item->responseLength = 0;
+            }
+        }
+        
+        if (executed) {
+            *executed = i + 1;
+        }
+        
+        if (item->result == CARD_SUCCESS) {
+            continue;
+        }
+        
+        if (firstError == CARD_SUCCESS) {
+            firstError = item->result;
+        }
+        
+        if (policy == CARD_BATCH_STOP_ON_ERROR ||
+            (policy == CARD_BATCH_STOP_ON_TRANSMIT && item->result != CARD_ERROR_BAD_STATUS)) {
+            break;
+        }
+    }
+    
+    return firstError;
 } 
\ No newline at end of file
@@ -9,27 +9,91 @@
  * Определяет основные сущности и интерфейсы для работы со смарт-картами
  */
 
+/**
+ * Интерфейс распределителя памяти для CardData
+ * Реализации (арена, пул) размещают структуру CardAllocator первым полем
+ */
+typedef struct CardAllocator {
+    void* (*allocate)(struct CardAllocator* allocator, size_t size);
+    void (*release)(struct CardAllocator* allocator, void* memory);
+} CardAllocator;
+
 typedef struct {
     uint8_t* data;
     size_t length;
+    CardAllocator* allocator;   /* Владелец буфера data, NULL — malloc/free */
 } CardData;
 
 typedef struct {
     void* context;
 } CardContext;
 
+#define CARD_ATR_MAX_LENGTH 33
+
+/**
+ * Сведения о подключённой карте и её возможностях
+ */
+typedef struct {
+    uint8_t atr[CARD_ATR_MAX_LENGTH];
+    size_t atrLength;
+    int extendedLength;       /* Поддержка Lc/Le расширенной длины */
+    size_t maxCommandData;    /* Максимум байт данных в одной команде */
+    size_t maxResponseData;   /* Максимум байт данных в одном ответе */
+    unsigned long resetCount; /* Сбросов карты, обработанных репозиторием (0 — не отслеживается) */
+} CardInfo;
+
+/**
+ * Действие с картой при отключении или повторном подключении
+ */
+typedef enum {
+    CARD_DISPOSITION_LEAVE = 0,     /* Карта остаётся в текущем состоянии */
+    CARD_DISPOSITION_RESET = 1,     /* Тёплый сброс */
+    CARD_DISPOSITION_UNPOWER = 2    /* Снятие питания (холодный сброс) */
+} CardDisposition;
+
+/**
+ * Команда пакетной передачи
+ * Буферы команды и ответа принадлежат вызывающему
+ */
+typedef struct {
+    const uint8_t* command;
+    size_t commandLength;
+    uint8_t* response;
+    size_t responseLength;    /* На входе — ёмкость буфера, на выходе — длина ответа */
+    uint16_t expectedStatus;  /* Ожидаемое SW1SW2 с учётом маски */
+    uint16_t statusMask;      /* 0 — успехом считаются 90 00 и 61 XX */
+    int result;               /* Код ошибки из CardError */
+} CardBatchItem;
+
+/**
+ * Правила остановки пакетной передачи
+ */
+typedef enum {
+    CARD_BATCH_STOP_ON_ERROR = 0,    /* Остановка при ошибке передачи или неожиданном статусе */
+    CARD_BATCH_STOP_ON_TRANSMIT = 1, /* Остановка только при ошибке передачи */
+    CARD_BATCH_CONTINUE = 2          /* Выполняются все команды */
+} CardBatchPolicy;
+
+typedef int (*CardTransmitFunction)(CardContext* context, const uint8_t* command, size_t commandLength,
+                                    uint8_t* response, size_t* responseLength);
+
 /**
  * Интерфейс репозитория карт (порт)
  * Определяет методы для взаимодействия с физической картой
  */
 typedef struct {
     int (*initialize)(CardContext* context);
-    int (*list_readers)(CardContext* context, char** readers, size_t* readersCount);
+    int (*list_readers)(CardContext* context, char*** readers, size_t* readersCount); /* Массив имён освобождается одним free */
     int (*connect)(CardContext* context, const char* reader);
     int (*disconnect)(CardContext* context);
     int (*release)(CardContext* context);
     int (*transmit)(CardContext* context, const uint8_t* command, size_t commandLength, 
                     uint8_t* response, size_t* responseLength);
+    int (*get_info)(CardContext* context, CardInfo* info);
+    int (*transmit_batch)(CardContext* context, CardBatchItem* items, size_t count,
+                          CardBatchPolicy policy, size_t* executed);
+    int (*reconnect)(CardContext* context, CardDisposition initialization);
+    int (*disconnect_with)(CardContext* context, CardDisposition disposition);
 } CardRepository;
 
 /**
@@ -41,14 +105,57 @@ typedef enum {
     CARD_ERROR_CONNECT_FAILED = -2,
     CARD_ERROR_TRANSMIT_FAILED = -3,
     CARD_ERROR_INVALID_PARAMETER = -4,
-    CARD_ERROR_MEMORY_ALLOCATION = -5
+    CARD_ERROR_MEMORY_ALLOCATION = -5,
+    CARD_ERROR_BAD_STATUS = -6
 } CardError;
 
 /**
  * Функции для создания и освобождения структуры CardData
+ * Копирование и освобождение выполняются через распределитель, создавший буфер.
+ * Буфер считается выделенным data->allocator: структуру с собственным массивом
+ * вызывающего в card_data_release, card_data_reserve и card_data_free не передают.
  */
 CardData* card_data_create(size_t length);
 void card_data_free(CardData* data);
 int card_data_copy(CardData* dest, const CardData* src);
 
+/**
+ * Создание CardData через распределитель
+ * Структура и буфер выделяются отдельно одним распределителем, поэтому буфер
+ * card_data_create (malloc) по-прежнему можно освободить через free.
+ * @param allocator Распределитель (NULL — malloc)
+ * @param length Размер буфера данных
+ * @return Указатель на CardData или NULL при ошибке
+ */
+CardData* card_data_create_in(CardAllocator* allocator, size_t length);
+
+/**
+ * Выделение буфера данных для структуры, размещённой вызывающим
+ * Используется распределитель data->allocator; прежний буфер освобождается.
+ * @param data Структура с заполненным полем allocator
+ * @param length Размер буфера
+ * @return Код ошибки из CardError
+ */
+int card_data_reserve(CardData* data, size_t length);
+
+/**
+ * Освобождение буфера данных без освобождения самой структуры
+ * @param data Структура с буфером
+ */
+void card_data_release(CardData* data);
+
+/**
+ * Последовательное выполнение пакета команд через функцию передачи
+ * Элементы после точки остановки не изменяются.
+ * @param context Контекст карты
+ * @param transmit Функция передачи одной команды
+ * @param items Массив команд, результаты записываются в него же
+ * @param count Количество команд
+ * @param policy Правила остановки из CardBatchPolicy
+ * @param executed Количество выполненных команд (может быть NULL)
+ * @return CARD_SUCCESS или код ошибки первой неуспешной команды
+ */
+int card_batch_execute(CardContext* context, CardTransmitFunction transmit, CardBatchItem* items,
+                       size_t count, CardBatchPolicy policy, size_t* executed);
+
 #endif /* CARD_DOMAIN_H */ 
\ No newline at end of file
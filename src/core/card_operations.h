@@ -41,6 +41,25 @@ typedef struct {
      */
     int (*rewrite_data)(void* service, uint8_t address, const CardData* data);
     
+    /**
+     * Чтение непрерывного диапазона памяти карты
+     * @param context Контекст карты
+     * @param offset Адрес начала чтения (до 0x7FFF)
+     * @param length Количество байт для чтения
+     * @param data Буфер для сохранения прочитанных данных
+     * @return Код ошибки из CardError
+     */
+    int (*read_range)(void* service, uint16_t offset, size_t length, CardData* data);
+    
+    /**
+     * Запись непрерывного диапазона памяти карты
+     * @param context Контекст карты
+     * @param offset Адрес начала записи (до 0x7FFF)
+     * @param data Данные для записи
+     * @return Код ошибки из CardError
+     */
+    int (*write_range)(void* service, uint16_t offset, const CardData* data);
+    
     /**
      * Отправка произвольной команды на карту
      * @param context Контекст карты
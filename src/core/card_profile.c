@@ -0,0 +1,74 @@
+#include "card_profile.h"
+#include "card_domain.h"
+#include <string.h>
+
+/* SLE 4442: синхронная карта, ATR не по ISO 7816-3 (протокол I2C-подобный) */
+static const uint8_t sle4442Atr[] = { 0xA2, 0x13, 0x10, 0x91 };
+
+/**
+ * Известные карты. MIFARE Classic читается и записывается блоками по 16 байт,
+ * Ultralight читается по 4 страницы и записывается по одной странице 4 байта.
+ */
+static const CardProfile cardProfiles[] = {
+    { "MIFARE Classic 1K", 0x0001, NULL, 0, 1024, 16, 16, 16, CARD_ATR_PROTOCOL_T1 },
+    { "MIFARE Classic 4K", 0x0002, NULL, 0, 4096, 16, 16, 16, CARD_ATR_PROTOCOL_T1 },
+    { "MIFARE Ultralight", 0x0003, NULL, 0, 64, 4, 16, 4, CARD_ATR_PROTOCOL_T1 },
+    { "MIFARE Mini", 0x0026, NULL, 0, 320, 16, 16, 16, CARD_ATR_PROTOCOL_T1 },
+    { "MIFARE Ultralight C", 0x003A, NULL, 0, 192, 4, 16, 4, CARD_ATR_PROTOCOL_T1 },
+    { "SLE 4442", 0, sle4442Atr, sizeof(sle4442Atr), 256, 1, 0, 0, 0 }
+};
+
+/**
+ * Поиск в таблице; parsed — NULL, если ATR не разобран по ISO 7816-3
+ */
+static const CardProfile* card_profile_lookup(const uint8_t* atr, size_t atrLength, const CardAtr* parsed) {
+    for (size_t i = 0; i < sizeof(cardProfiles) / sizeof(cardProfiles[0]); i++) {
+        const CardProfile* profile = &cardProfiles[i];
+        
+        if (profile->atrPrefix) {
+            if (atrLength >= profile->atrPrefixLength &&
+                memcmp(atr, profile->atrPrefix, profile->atrPrefixLength) == 0) {
+                return profile;
+            }
+        } else if (parsed && parsed->isStorageCard && parsed->storageCardName == profile->storageCardName) {
+            return profile;
+        }
+    }
+    
+    return NULL;
+}
+
+const CardProfile* card_profile_find(const uint8_t* atr, size_t atrLength, CardAtr* parsed) {
+    CardAtr local;
+    CardAtr* target = parsed ? parsed : &local;
+    
+    if (!atr || atrLength == 0) {
+        return NULL;
+    }
+    
+    int isParsed = card_atr_parse(atr, atrLength, target) == CARD_SUCCESS;
+    return card_profile_lookup(atr, atrLength, isParsed ? target : NULL);
+}
+
+uint16_t card_profile_select_protocols(const uint8_t* atr, size_t atrLength) {
+    const uint16_t transmission = CARD_ATR_PROTOCOL_T0 | CARD_ATR_PROTOCOL_T1;
+    CardAtr parsed;
+    
+    if (!atr || card_atr_parse(atr, atrLength, &parsed) != CARD_SUCCESS) {
+        return transmission;
+    }
+    
+    const CardProfile* profile = card_profile_lookup(atr, atrLength, &parsed);
+    
+    // В специфическом режиме карта не переключается на другой протокол
+    uint16_t offered = parsed.protocols & transmission;
+    if (parsed.specificMode && parsed.specificProtocol <= 1) {
+        offered = (uint16_t)(1u << parsed.specificProtocol);
+    }
+    
+    if (profile && (profile->protocols & offered)) {
+        return profile->protocols & offered;
+    }
+    
+    return offered ? offered : transmission;
+} 
\ No newline at end of file
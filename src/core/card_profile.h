@@ -0,0 +1,46 @@
+#ifndef CARD_PROFILE_H
+#define CARD_PROFILE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "card_atr.h"
+
+/**
+ * Слой ядра (Core Layer)
+ * Таблица известных карт: размер блоков чтения и записи, выравнивание
+ * записи по страницам памяти и предпочтительный протокол. Профиль
+ * выбирается по ATR при подключении и настраивает диапазонные операции
+ * сервиса без подбора параметров в приложении.
+ */
+
+typedef struct {
+    const char* name;
+    uint16_t storageCardName;    /* Имя карты PC/SC часть 3 (NN NN), 0 — сопоставление по ATR */
+    const uint8_t* atrPrefix;    /* Начало ATR для карт без идентификатора PC/SC */
+    size_t atrPrefixLength;
+    size_t memorySize;           /* Объём памяти данных, байт */
+    size_t pageSize;             /* Единица записи; блоки записи выравниваются по ней */
+    size_t readChunkSize;        /* Максимум байт в одной команде чтения, 0 — без ограничения */
+    size_t writeChunkSize;       /* Максимум байт в одной команде записи, 0 — без ограничения */
+    uint16_t protocols;          /* Предпочтительные протоколы (CARD_ATR_PROTOCOL_*), 0 — любые */
+} CardProfile;
+
+/**
+ * Поиск профиля карты по ATR
+ * @param atr Байты ATR
+ * @param atrLength Длина ATR
+ * @param parsed Структура для разобранного ATR (может быть NULL)
+ * @return Профиль из таблицы или NULL для неизвестной карты
+ */
+const CardProfile* card_profile_find(const uint8_t* atr, size_t atrLength, CardAtr* parsed);
+
+/**
+ * Выбор протоколов для подключения к карте
+ * Учитываются протоколы из ATR, специфический режим (TA2) и профиль карты.
+ * @param atr Байты ATR
+ * @param atrLength Длина ATR
+ * @return Маска CARD_ATR_PROTOCOL_T0 | CARD_ATR_PROTOCOL_T1; обе, если выбор не ограничен
+ */
+uint16_t card_profile_select_protocols(const uint8_t* atr, size_t atrLength);
+
+#endif /* CARD_PROFILE_H */ 
\ No newline at end of file
@@ -0,0 +1,388 @@
+#include "card_script.h"
+#include "card_domain.h"
+#include "apdu.h"
+#include <string.h>
+
+/* Значение шестнадцатеричной цифры + 1; 0 — не цифра */
+static const uint8_t hexDigits[256] = {
+    ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+    ['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+    ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16
+};
+
+typedef struct {
+    char name[CARD_SCRIPT_MAX_NAME];
+    size_t nameLength;
+    size_t offset;                  /* Значение в пуле программы */
+    size_t length;
+} ScriptVariable;
+
+typedef struct {
+    CardScript* script;
+    size_t instructionCapacity;
+    size_t poolCapacity;
+    ScriptVariable variables[CARD_SCRIPT_MAX_VARIABLES];
+    size_t variableCount;
+    size_t loops[CARD_SCRIPT_MAX_DEPTH];
+    size_t depth;
+} ScriptParser;
+
+static int is_space(char symbol) {
+    return symbol == ' ' || symbol == '\t';
+}
+
+static int is_name(char symbol) {
+    return (symbol >= 'A' && symbol <= 'Z') || (symbol >= 'a' && symbol <= 'z') ||
+           (symbol >= '0' && symbol <= '9') || symbol == '_';
+}
+
+static const char* skip_spaces(const char* position, const char* end) {
+    while (position < end && is_space(*position)) {
+        position++;
+    }
+    return position;
+}
+
+/**
+ * Проверка ключевого слова, за которым идёт пробел или конец строки
+ */
+static int keyword(const char* position, const char* end, const char* word) {
+    size_t length = strlen(word);
+    return (size_t)(end - position) >= length && memcmp(position, word, length) == 0 &&
+           ((size_t)(end - position) == length || is_space(position[length]));
+}
+
+static int pool_reserve(ScriptParser* parser, size_t extra) {
+    CardScript* script = parser->script;
+    if (script->poolLength + extra <= parser->poolCapacity) {
+        return CARD_SUCCESS;
+    }
+    
+    size_t capacity = parser->poolCapacity ? parser->poolCapacity : 256;
+    while (capacity < script->poolLength + extra) {
+        capacity *= 2;
+    }
+    
+    uint8_t* pool = (uint8_t*)realloc(script->pool, capacity);
+    if (!pool) {
+        return CARD_ERROR_MEMORY_ALLOCATION;
+    }
+    script->pool = pool;
+    parser->poolCapacity = capacity;
+    return CARD_SUCCESS;
+}
+
+static int emit(ScriptParser* parser, const CardScriptInstruction* instruction, uint32_t line) {
+    CardScript* script = parser->script;
+    if (script->count == parser->instructionCapacity) {
+        size_t capacity = parser->instructionCapacity ? parser->instructionCapacity * 2 : 64;
+        CardScriptInstruction* instructions = (CardScriptInstruction*)realloc(
+            script->instructions, capacity * sizeof(CardScriptInstruction));
+        if (!instructions) {
+            return CARD_ERROR_MEMORY_ALLOCATION;
+        }
+        script->instructions = instructions;
+        
+        uint32_t* lines = (uint32_t*)realloc(script->lines, capacity * sizeof(uint32_t));
+        if (!lines) {
+            return CARD_ERROR_MEMORY_ALLOCATION;
+        }
+        script->lines = lines;
+        parser->instructionCapacity = capacity;
+    }
+    
+    script->instructions[script->count] = *instruction;
+    script->lines[script->count] = line;
+    script->count++;
+    return CARD_SUCCESS;
+}
+
+static const ScriptVariable* find_variable(const ScriptParser* parser, const char* name, size_t length) {
+    // Поиск с конца: переопределённая переменная действует с места переопределения
+    for (size_t i = parser->variableCount; i > 0; i--) {
+        const ScriptVariable* variable = &parser->variables[i - 1];
+        if (variable->nameLength == length && memcmp(variable->name, name, length) == 0) {
+            return variable;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Разбор байт: пары шестнадцатеричных цифр и ссылки $ИМЯ, добавляются в конец пула
+ */
+static int parse_bytes(ScriptParser* parser, const char* position, const char* end) {
+    // Байт не больше половины символов; подстановки резервируют место отдельно
+    int result = pool_reserve(parser, (size_t)(end - position) / 2 + 1);
+    if (result != CARD_SUCCESS) {
+        return result;
+    }
+    
+    CardScript* script = parser->script;
+    while (position < end) {
+        if (is_space(*position)) {
+            position++;
+            continue;
+        }
+        
+        if (*position == '$') {
+            const char* name = ++position;
+            while (position < end && is_name(*position)) {
+                position++;
+            }
+            const ScriptVariable* variable = find_variable(parser, name, (size_t)(position - name));
+            if (!variable) {
+                return CARD_ERROR_INVALID_PARAMETER;
+            }
+            result = pool_reserve(parser, variable->length + (size_t)(end - position) / 2 + 1);
+            if (result != CARD_SUCCESS) {
+                return result;
+            }
+            // Пул мог переместиться: значение адресуется смещением
+            memmove(script->pool + script->poolLength, script->pool + variable->offset, variable->length);
+            script->poolLength += variable->length;
+            continue;
+        }
+        
+        if (end - position < 2) {
+            return CARD_ERROR_INVALID_PARAMETER;
+        }
+        uint8_t high = hexDigits[(uint8_t)position[0]];
+        uint8_t low = hexDigits[(uint8_t)position[1]];
+        if (!high || !low) {
+            return CARD_ERROR_INVALID_PARAMETER;
+        }
+        script->pool[script->poolLength++] = (uint8_t)(((high - 1) << 4) | (low - 1));
+        position += 2;
+    }
+    
+    return CARD_SUCCESS;
+}
+
+/**
+ * Ожидаемый статус: четыре тетрады (X — любая) или *
+ */
+static int parse_status(const char* position, const char* end, CardScriptInstruction* instruction) {
+    position = skip_spaces(position, end);
+    while (end > position && is_space(end[-1])) {
+        end--;
+    }
+    
+    if (end - position == 1 && *position == '*') {
+        instruction->swValue = 0;
+        instruction->swMask = 0;
+        return CARD_SUCCESS;
+    }
+    
+    uint16_t value = 0;
+    uint16_t mask = 0;
+    size_t nibbles = 0;
+    for (; position < end; position++) {
+        if (is_space(*position)) {
+            continue;
+        }
+        if (nibbles == 4) {
+            return CARD_ERROR_INVALID_PARAMETER;
+        }
+        value <<= 4;
+        mask <<= 4;
+        if (*position == 'X' || *position == 'x') {
+            nibbles++;
+            continue;
+        }
+        uint8_t digit = hexDigits[(uint8_t)*position];
+        if (!digit) {
+            return CARD_ERROR_INVALID_PARAMETER;
+        }
+        value |= (uint16_t)(digit - 1);
+        mask |= 0x0F;
+        nibbles++;
+    }
+    
+    if (nibbles != 4) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    instruction->swValue = value;
+    instruction->swMask = mask;
+    return CARD_SUCCESS;
+}
+
+static int parse_let(ScriptParser* parser, const char* position, const char* end) {
+    position = skip_spaces(position, end);
+    const char* name = position;
+    while (position < end && is_name(*position)) {
+        position++;
+    }
+    size_t nameLength = (size_t)(position - name);
+    
+    position = skip_spaces(position, end);
+    if (nameLength == 0 || nameLength >= CARD_SCRIPT_MAX_NAME || position == end || *position != '=' ||
+        parser->variableCount == CARD_SCRIPT_MAX_VARIABLES) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    // Значение хранится в пуле рядом с командами
+    size_t offset = parser->script->poolLength;
+    int result = parse_bytes(parser, position + 1, end);
+    if (result != CARD_SUCCESS) {
+        return result;
+    }
+    
+    ScriptVariable* variable = &parser->variables[parser->variableCount++];
+    memcpy(variable->name, name, nameLength);
+    variable->nameLength = nameLength;
+    variable->offset = offset;
+    variable->length = parser->script->poolLength - offset;
+    return CARD_SUCCESS;
+}
+
+static int parse_loop(ScriptParser* parser, const char* position, const char* end, uint32_t line) {
+    position = skip_spaces(position, end);
+    uint32_t count = 0;
+    const char* digits = position;
+    while (position < end && *position >= '0' && *position <= '9' && count <= 100000000U) {
+        count = count * 10 + (uint32_t)(*position - '0');
+        position++;
+    }
+    
+    if (position == digits || skip_spaces(position, end) != end || count == 0 || count > 100000000U ||
+        parser->depth == CARD_SCRIPT_MAX_DEPTH) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    CardScriptInstruction instruction;
+    memset(&instruction, 0, sizeof(instruction));
+    instruction.opcode = CARD_SCRIPT_LOOP;
+    instruction.operand = count;
+    
+    parser->loops[parser->depth++] = parser->script->count;
+    return emit(parser, &instruction, line);
+}
+
+static int parse_end(ScriptParser* parser, uint32_t line) {
+    if (parser->depth == 0) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    CardScriptInstruction instruction;
+    memset(&instruction, 0, sizeof(instruction));
+    instruction.opcode = CARD_SCRIPT_END;
+    instruction.operand = (uint32_t)parser->loops[--parser->depth];
+    return emit(parser, &instruction, line);
+}
+
+static int parse_send(ScriptParser* parser, const char* position, const char* end, uint32_t line) {
+    CardScriptInstruction instruction;
+    memset(&instruction, 0, sizeof(instruction));
+    instruction.opcode = CARD_SCRIPT_SEND;
+    instruction.swValue = 0x9000;
+    instruction.swMask = 0xFFFF;
+    
+    const char* slash = (const char*)memchr(position, '/', (size_t)(end - position));
+    if (slash) {
+        int result = parse_status(slash + 1, end, &instruction);
+        if (result != CARD_SUCCESS) {
+            return result;
+        }
+        end = slash;
+    }
+    
+    size_t offset = parser->script->poolLength;
+    int result = parse_bytes(parser, position, end);
+    if (result != CARD_SUCCESS) {
+        return result;
+    }
+    
+    // Команда проверяется при разборе, чтобы выполнение не встречало ошибок формата
+    size_t length = parser->script->poolLength - offset;
+    ApduCommand parsed;
+    if (apdu_parse(parser->script->pool + offset, length, &parsed) != CARD_SUCCESS) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    instruction.operand = (uint32_t)offset;
+    instruction.length = (uint32_t)length;
+    parser->script->sendCount++;
+    return emit(parser, &instruction, line);
+}
+
+static int parse_line(ScriptParser* parser, const char* position, const char* end, uint32_t line) {
+    const char* comment = (const char*)memchr(position, '#', (size_t)(end - position));
+    if (comment) {
+        end = comment;
+    }
+    position = skip_spaces(position, end);
+    while (end > position && (is_space(end[-1]) || end[-1] == '\r')) {
+        end--;
+    }
+    
+    if (position == end) {
+        return CARD_SUCCESS;
+    }
+    if (keyword(position, end, "let")) {
+        return parse_let(parser, position + 3, end);
+    }
+    if (keyword(position, end, "loop")) {
+        return parse_loop(parser, position + 4, end, line);
+    }
+    if (keyword(position, end, "end")) {
+        return skip_spaces(position + 3, end) == end ? parse_end(parser, line) : CARD_ERROR_INVALID_PARAMETER;
+    }
+    return parse_send(parser, position, end, line);
+}
+
+int card_script_parse(CardScript* script, const char* text, size_t length, size_t* errorLine) {
+    if (!script || (!text && length > 0)) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    memset(script, 0, sizeof(CardScript));
+    
+    ScriptParser parser;
+    memset(&parser, 0, sizeof(parser));
+    parser.script = script;
+    
+    // Байт команд не больше половины текста: пул обычно не перевыделяется
+    int result = pool_reserve(&parser, length / 2 + 1);
+    
+    const char* position = text;
+    const char* end = text + length;
+    uint32_t line = 0;
+    while (result == CARD_SUCCESS && position < end) {
+        const char* newline = (const char*)memchr(position, '\n', (size_t)(end - position));
+        const char* lineEnd = newline ? newline : end;
+        line++;
+        
+        result = parse_line(&parser, position, lineEnd, line);
+        position = newline ? newline + 1 : end;
+    }
+    
+    if (result == CARD_SUCCESS && parser.depth > 0) {
+        line = script->lines[parser.loops[parser.depth - 1]];
+        result = CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    if (result != CARD_SUCCESS) {
+        if (errorLine) {
+            *errorLine = line;
+        }
+        card_script_free(script);
+    }
+    return result;
+}
+
+int card_script_status_matches(const CardScriptInstruction* instruction, uint16_t sw) {
+    return (sw & instruction->swMask) == instruction->swValue;
+}
+
+void card_script_free(CardScript* script) {
+    if (!script) {
+        return;
+    }
+    
+    free(script->instructions);
+    free(script->lines);
+    free(script->pool);
+    memset(script, 0, sizeof(CardScript));
+} 
\ No newline at end of file
@@ -0,0 +1,81 @@
+#ifndef CARD_SCRIPT_H
+#define CARD_SCRIPT_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * Слой ядра (Core Layer)
+ * Сценарий APDU: текст разбирается один раз в компактную программу
+ * с готовыми байтами команд, которая затем выполняется без разбора.
+ *
+ * Синтаксис (строка — одна инструкция, # — комментарий):
+ *   let KEY = FF FF FF FF FF FF   переменная: байты, подставляемые через $KEY
+ *   loop 100                      повтор блока до end; блоки вкладываются
+ *   end
+ *   FF 82 00 00 06 $KEY / 9000    команда и ожидаемый статус
+ *   FF B0 00 04 10 / 90XX         X — любая тетрада; * — любой статус
+ * Без ожидаемого статуса шаг считается успешным только при 90 00.
+ */
+
+#define CARD_SCRIPT_MAX_DEPTH 16        /* Вложенность loop */
+#define CARD_SCRIPT_MAX_VARIABLES 64
+#define CARD_SCRIPT_MAX_NAME 32
+
+typedef enum {
+    CARD_SCRIPT_SEND = 0,
+    CARD_SCRIPT_LOOP = 1,           /* Начало блока: count повторов */
+    CARD_SCRIPT_END = 2             /* Конец блока: target — индекс инструкции LOOP */
+} CardScriptOpcode;
+
+/**
+ * Инструкция программы (16 байт)
+ */
+typedef struct {
+    uint8_t opcode;                 /* CardScriptOpcode */
+    uint8_t reserved;
+    uint16_t swValue;               /* Ожидаемый статус после наложения маски */
+    uint16_t swMask;                /* 0 — любой статус */
+    uint16_t reserved2;
+    uint32_t operand;               /* SEND — смещение команды в пуле, LOOP — повторы, END — индекс LOOP */
+    uint32_t length;                /* SEND — длина команды */
+} CardScriptInstruction;
+
+/**
+ * Разобранная программа: инструкции и пул байт всех команд
+ */
+typedef struct {
+    CardScriptInstruction* instructions;
+    size_t count;
+    uint32_t* lines;                /* Номер строки сценария для каждой инструкции */
+    uint8_t* pool;
+    size_t poolLength;
+    size_t sendCount;               /* Инструкций SEND */
+} CardScript;
+
+/**
+ * Разбор текста сценария
+ * @param script Структура программы (память вызывающего)
+ * @param text Текст сценария (не обязан заканчиваться нулём)
+ * @param length Длина текста
+ * @param errorLine Номер строки с ошибкой (может быть NULL)
+ * @return CARD_SUCCESS, CARD_ERROR_INVALID_PARAMETER для ошибки в сценарии
+ *         или CARD_ERROR_MEMORY_ALLOCATION
+ */
+int card_script_parse(CardScript* script, const char* text, size_t length, size_t* errorLine);
+
+/**
+ * Проверка статуса по ожиданию инструкции
+ * @param instruction Инструкция SEND
+ * @param sw Статус SW1 SW2
+ * @return 1, если статус ожидаемый
+ */
+int card_script_status_matches(const CardScriptInstruction* instruction, uint16_t sw);
+
+/**
+ * Освобождение программы
+ * @param script Указатель на программу
+ */
+void card_script_free(CardScript* script);
+
+#endif /* CARD_SCRIPT_H */ 
\ No newline at end of file
@@ -0,0 +1,299 @@
+#include "card_async.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+/**
+ * Проверка запроса до выполнения
+ * Буфер ответа обязателен: сервис выделил бы его сам, и память осталась бы без владельца
+ */
+static int card_async_is_valid(const CardAsyncRequest* request) {
+    switch (request->operation) {
+        case CARD_ASYNC_TRANSMIT:
+            return request->command && request->commandLength > 0 && request->buffer && request->length > 0;
+        case CARD_ASYNC_READ_RANGE:
+        case CARD_ASYNC_WRITE_RANGE:
+            return request->buffer && request->length > 0;
+        case CARD_ASYNC_CALL:
+            return request->function != NULL;
+        default:
+            return 0;
+    }
+}
+
+int card_async_execute(CardService* service, CardAsyncRequest* request) {
+    if (!card_async_is_valid(request)) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    switch (request->operation) {
+        case CARD_ASYNC_TRANSMIT: {
+            CardData command = { (uint8_t*)request->command, request->commandLength, NULL };
+            CardData response = { request->buffer, request->length, NULL };
+            int result = card_service_execute_command(service, &command, &response);
+            request->length = response.length;
+            return result;
+        }
+        case CARD_ASYNC_READ_RANGE:
+            return card_service_read_into(service, request->offset, request->buffer, request->length);
+        case CARD_ASYNC_WRITE_RANGE:
+            return card_service_write_from(service, request->offset, request->buffer, request->length);
+        case CARD_ASYNC_CALL:
+            return request->function(service, request->argument);
+        default:
+            return CARD_ERROR_INVALID_PARAMETER;
+    }
+}
+
+/**
+ * Доставка завершения: функция обратного вызова или очередь завершений
+ */
+static void card_async_complete(CardAsyncConnection* connection, CardAsyncRequest* request, int result) {
+    request->result = result;
+    
+    // После вызова вызывающий может освободить запрос, поэтому он больше не трогается
+    if (request->onComplete) {
+        InterlockedExchange(&request->isComplete, 1);
+        request->onComplete(request, request->userData);
+        return;
+    }
+    
+    EnterCriticalSection(&connection->lock);
+    request->next = NULL;
+    if (connection->completedTail) {
+        connection->completedTail->next = request;
+    } else {
+        connection->completedHead = request;
+    }
+    connection->completedTail = request;
+    InterlockedExchange(&request->isComplete, 1);
+    SetEvent(connection->completionEvent);
+    WakeAllConditionVariable(&connection->requestCompleted);
+    LeaveCriticalSection(&connection->lock);
+}
+
+static DWORD WINAPI card_async_thread(LPVOID parameter) {
+    CardAsyncConnection* connection = (CardAsyncConnection*)parameter;
+    
+    for (;;) {
+        EnterCriticalSection(&connection->lock);
+        while (!connection->head && !connection->isStopping) {
+            SleepConditionVariableCS(&connection->requestAvailable, &connection->lock, INFINITE);
+        }
+        
+        CardAsyncRequest* request = connection->head;
+        if (request) {
+            connection->head = request->next;
+            if (!connection->head) {
+                connection->tail = NULL;
+            }
+        }
+        LeaveCriticalSection(&connection->lock);
+        
+        // Остановка после выполнения всех принятых запросов
+        if (!request) {
+            break;
+        }
+        
+        card_async_complete(connection, request, card_async_execute(connection->service, request));
+    }
+    
+    return 0;
+}
+
+int card_async_start(CardAsyncConnection* connection, CardService* service) {
+    if (!connection || !service) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    memset(connection, 0, sizeof(CardAsyncConnection));
+    connection->service = service;
+    
+    // Событие с ручным сбросом: остаётся установленным, пока есть завершённые запросы
+    connection->completionEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (!connection->completionEvent) {
+        printf("Ошибка при создании события завершения\n");
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    InitializeCriticalSection(&connection->lock);
+    InitializeConditionVariable(&connection->requestAvailable);
+    InitializeConditionVariable(&connection->requestCompleted);
+    
+    connection->thread = CreateThread(NULL, 0, card_async_thread, connection, 0, NULL);
+    if (!connection->thread) {
+        printf("Ошибка при создании потока ввода-вывода\n");
+        DeleteCriticalSection(&connection->lock);
+        CloseHandle(connection->completionEvent);
+        connection->completionEvent = NULL;
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    return CARD_SUCCESS;
+}
+
+int card_async_submit(CardAsyncConnection* connection, CardAsyncRequest* request) {
+    if (!connection || !connection->thread || !request || !card_async_is_valid(request)) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    request->next = NULL;
+    request->result = CARD_SUCCESS;
+    request->isComplete = 0;
+    
+    EnterCriticalSection(&connection->lock);
+    if (connection->isStopping) {
+        LeaveCriticalSection(&connection->lock);
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    if (connection->tail) {
+        connection->tail->next = request;
+    } else {
+        connection->head = request;
+    }
+    connection->tail = request;
+    WakeConditionVariable(&connection->requestAvailable);
+    LeaveCriticalSection(&connection->lock);
+    
+    return CARD_SUCCESS;
+}
+
+int card_async_poll(CardAsyncConnection* connection, CardAsyncRequest** completed,
+                    size_t capacity, size_t* count) {
+    if (!connection || !connection->completionEvent || !completed || !count) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    size_t taken = 0;
+    
+    EnterCriticalSection(&connection->lock);
+    while (taken < capacity && connection->completedHead) {
+        CardAsyncRequest* request = connection->completedHead;
+        connection->completedHead = request->next;
+        request->next = NULL;
+        completed[taken++] = request;
+    }
+    
+    if (!connection->completedHead) {
+        connection->completedTail = NULL;
+        ResetEvent(connection->completionEvent);
+    }
+    LeaveCriticalSection(&connection->lock);
+    
+    *count = taken;
+    return CARD_SUCCESS;
+}
+
+int card_async_wait(CardAsyncConnection* connection, CardAsyncRequest* request, DWORD timeout) {
+    if (!connection || !connection->completionEvent || !request || request->onComplete) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    DWORD started = GetTickCount();
+    
+    EnterCriticalSection(&connection->lock);
+    while (!request->isComplete) {
+        DWORD remaining = INFINITE;
+        if (timeout != INFINITE) {
+            DWORD elapsed = GetTickCount() - started;
+            if (elapsed >= timeout) {
+                break;
+            }
+            remaining = timeout - elapsed;
+        }
+        SleepConditionVariableCS(&connection->requestCompleted, &connection->lock, remaining);
+    }
+    
+    if (!request->isComplete) {
+        LeaveCriticalSection(&connection->lock);
+        return CARD_ERROR_TRANSMIT_FAILED;
+    }
+    
+    // Ожидаемый запрос больше не должен вернуться из card_async_poll
+    CardAsyncRequest* previous = NULL;
+    CardAsyncRequest* current = connection->completedHead;
+    while (current && current != request) {
+        previous = current;
+        current = current->next;
+    }
+    
+    if (current) {
+        if (previous) {
+            previous->next = current->next;
+        } else {
+            connection->completedHead = current->next;
+        }
+        if (connection->completedTail == current) {
+            connection->completedTail = previous;
+        }
+        current->next = NULL;
+    }
+    
+    if (!connection->completedHead) {
+        ResetEvent(connection->completionEvent);
+    }
+    LeaveCriticalSection(&connection->lock);
+    
+    return request->result;
+}
+
+HANDLE card_async_get_event(CardAsyncConnection* connection) {
+    return connection ? connection->completionEvent : NULL;
+}
+
+int card_async_stop(CardAsyncConnection* connection) {
+    if (!connection || !connection->thread) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    EnterCriticalSection(&connection->lock);
+    connection->isStopping = 1;
+    WakeAllConditionVariable(&connection->requestAvailable);
+    LeaveCriticalSection(&connection->lock);
+    
+    WaitForSingleObject(connection->thread, INFINITE);
+    CloseHandle(connection->thread);
+    connection->thread = NULL;
+    
+    DeleteCriticalSection(&connection->lock);
+    CloseHandle(connection->completionEvent);
+    connection->completionEvent = NULL;
+    connection->completedHead = NULL;
+    connection->completedTail = NULL;
+    
+    return CARD_SUCCESS;
+}
+
+void card_async_prepare_transmit(CardAsyncRequest* request, const uint8_t* command, size_t commandLength,
+                                 uint8_t* response, size_t responseCapacity) {
+    memset(request, 0, sizeof(CardAsyncRequest));
+    request->operation = CARD_ASYNC_TRANSMIT;
+    request->command = command;
+    request->commandLength = commandLength;
+    request->buffer = response;
+    request->length = responseCapacity;
+}
+
+void card_async_prepare_read(CardAsyncRequest* request, uint16_t offset, uint8_t* buffer, size_t length) {
+    memset(request, 0, sizeof(CardAsyncRequest));
+    request->operation = CARD_ASYNC_READ_RANGE;
+    request->offset = offset;
+    request->buffer = buffer;
+    request->length = length;
+}
+
+void card_async_prepare_write(CardAsyncRequest* request, uint16_t offset, const uint8_t* buffer, size_t length) {
+    memset(request, 0, sizeof(CardAsyncRequest));
+    request->operation = CARD_ASYNC_WRITE_RANGE;
+    request->offset = offset;
+    request->buffer = (uint8_t*)buffer;
+    request->length = length;
+}
+
+void card_async_prepare_call(CardAsyncRequest* request, CardAsyncFunction function, void* argument) {
+    memset(request, 0, sizeof(CardAsyncRequest));
+    request->operation = CARD_ASYNC_CALL;
+    request->function = function;
+    request->argument = argument;
+} 
\ No newline at end of file
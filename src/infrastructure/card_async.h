@@ -0,0 +1,157 @@
+#ifndef CARD_ASYNC_H
+#define CARD_ASYNC_H
+
+#include <windows.h>
+#include "card_domain.h"
+#include "card_service.h"
+
+/**
+ * Слой инфраструктуры (Infrastructure Layer)
+ * Асинхронная работа с картой: запросы выполняются в отдельном потоке
+ * ввода-вывода подключения, вызывающий поток не блокируется в SCardTransmit.
+ * Завершение доставляется функцией обратного вызова либо через очередь
+ * завершений с событием Windows, которое можно ожидать вместе с другими
+ * объектами цикла событий (WaitForMultipleObjects).
+ */
+
+typedef enum {
+    CARD_ASYNC_TRANSMIT = 0,     /* Произвольная команда (card_service_execute_command) */
+    CARD_ASYNC_READ_RANGE = 1,   /* Чтение диапазона (card_service_read_into) */
+    CARD_ASYNC_WRITE_RANGE = 2,  /* Запись диапазона (card_service_write_from) */
+    CARD_ASYNC_CALL = 3          /* Функция вызывающего над сервисом */
+} CardAsyncOperation;
+
+typedef struct CardAsyncRequest CardAsyncRequest;
+
+/**
+ * Уведомление о завершении запроса, вызывается в потоке ввода-вывода
+ */
+typedef void (*CardAsyncCallback)(CardAsyncRequest* request, void* userData);
+
+/**
+ * Функция над сервисом для запросов CARD_ASYNC_CALL
+ */
+typedef int (*CardAsyncFunction)(CardService* service, void* argument);
+
+/**
+ * Запрос (дескриптор операции). Память запроса и буферов принадлежит
+ * вызывающему и должна оставаться действительной до завершения запроса.
+ */
+struct CardAsyncRequest {
+    CardAsyncOperation operation;
+    const uint8_t* command;      /* CARD_ASYNC_TRANSMIT: команда */
+    size_t commandLength;
+    uint8_t* buffer;             /* Ответ, прочитанные или записываемые данные */
+    size_t length;               /* Ёмкость или длина буфера; для команды — длина ответа после завершения */
+    uint16_t offset;             /* Адрес для диапазонных операций */
+    CardAsyncFunction function;  /* CARD_ASYNC_CALL */
+    void* argument;
+    CardAsyncCallback onComplete; /* NULL — запрос попадает в очередь завершений */
+    void* userData;
+    int result;                  /* Код ошибки из CardError */
+    volatile LONG isComplete;
+    CardAsyncRequest* next;      /* Служебное поле очередей */
+};
+
+/**
+ * Подключение с собственным потоком ввода-вывода
+ */
+typedef struct {
+    CardService* service;
+    HANDLE thread;
+    HANDLE completionEvent;      /* Установлено, пока очередь завершений не пуста */
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE requestAvailable;
+    CONDITION_VARIABLE requestCompleted;
+    CardAsyncRequest* head;
+    CardAsyncRequest* tail;
+    CardAsyncRequest* completedHead;
+    CardAsyncRequest* completedTail;
+    int isStopping;
+} CardAsyncConnection;
+
+/**
+ * Запуск потока ввода-вывода
+ * После запуска сервис используется только этим потоком до card_async_stop.
+ * @param connection Структура подключения (память вызывающего)
+ * @param service Инициализированный сервис
+ * @return Код ошибки из CardError
+ */
+int card_async_start(CardAsyncConnection* connection, CardService* service);
+
+/**
+ * Постановка запроса в очередь
+ * Запросы с данными (в том числе команды) должны иметь буфер вызывающего,
+ * иначе возвращается CARD_ERROR_INVALID_PARAMETER.
+ * @param connection Указатель на подключение
+ * @param request Заполненный запрос
+ * @return Код ошибки из CardError
+ */
+int card_async_submit(CardAsyncConnection* connection, CardAsyncRequest* request);
+
+/**
+ * Извлечение завершённых запросов без ожидания
+ * @param connection Указатель на подключение
+ * @param completed Массив для завершённых запросов
+ * @param capacity Размер массива
+ * @param count Количество извлечённых запросов
+ * @return Код ошибки из CardError
+ */
+int card_async_poll(CardAsyncConnection* connection, CardAsyncRequest** completed,
+                    size_t capacity, size_t* count);
+
+/**
+ * Ожидание завершения запроса без функции обратного вызова
+ * Запрос извлекается из очереди завершений.
+ * @param connection Указатель на подключение
+ * @param request Запрос
+ * @param timeout Время ожидания в миллисекундах или INFINITE
+ * @return Результат запроса или CARD_ERROR_TRANSMIT_FAILED по таймауту
+ */
+int card_async_wait(CardAsyncConnection* connection, CardAsyncRequest* request, DWORD timeout);
+
+/**
+ * Синхронное выполнение запроса над сервисом в текущем потоке
+ * Используется потоками-владельцами подключения (card_async, card_shared).
+ * @param service Сервис, принадлежащий текущему потоку
+ * @param request Заполненный запрос; для команды length получает длину ответа
+ * @return Код ошибки из CardError
+ */
+int card_async_execute(CardService* service, CardAsyncRequest* request);
+
+/**
+ * Событие очереди завершений для цикла событий вызывающего
+ * @param connection Указатель на подключение
+ * @return Описатель события (принадлежит подключению)
+ */
+HANDLE card_async_get_event(CardAsyncConnection* connection);
+
+/**
+ * Остановка потока: запросы из очереди выполняются, затем поток завершается
+ * @param connection Указатель на подключение
+ * @return Код ошибки из CardError
+ */
+int card_async_stop(CardAsyncConnection* connection);
+
+/**
+ * Заполнение запроса произвольной команды
+ */
+void card_async_prepare_transmit(CardAsyncRequest* request, const uint8_t* command, size_t commandLength,
+                                 uint8_t* response, size_t responseCapacity);
+
+/**
+ * Заполнение запроса чтения диапазона
+ */
+void card_async_prepare_read(CardAsyncRequest* request, uint16_t offset, uint8_t* buffer, size_t length);
+
+/**
+ * Заполнение запроса записи диапазона
+ */
+void card_async_prepare_write(CardAsyncRequest* request, uint16_t offset, const uint8_t* buffer, size_t length);
+
+/**
+ * Заполнение запроса вызова функции над сервисом
+ */
+void card_async_prepare_call(CardAsyncRequest* request, CardAsyncFunction function, void* argument);
+
+#endif /* CARD_ASYNC_H */ 
\ No newline at end of file
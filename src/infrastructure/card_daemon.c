@@ -0,0 +1,1035 @@
+#include "card_daemon.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define DAEMON_FRAME_SIZE (CARD_DAEMON_HEADER_SIZE + APDU_MAX_RESPONSE_LENGTH)
+#define DAEMON_INPUT_SIZE (CARD_DAEMON_HEADER_SIZE + CARD_DAEMON_MAX_PAYLOAD)
+#define DAEMON_OUTPUT_BLOCK 16384          /* Блок очереди ответов клиента */
+#define DAEMON_OUTPUT_LIMIT (256 * 1024)   /* Неотправленных ответов, после которых запросы не читаются */
+#define DAEMON_ACCEPT_BACKOFF 10           /* Пауза после ошибки accept, мс; удваивается */
+#define DAEMON_ACCEPT_BACKOFF_MAX 1000
+
+static void put16(uint8_t* buffer, uint16_t value) {
+    buffer[0] = (uint8_t)value;
+    buffer[1] = (uint8_t)(value >> 8);
+}
+
+static void put32(uint8_t* buffer, uint32_t value) {
+    buffer[0] = (uint8_t)value;
+    buffer[1] = (uint8_t)(value >> 8);
+    buffer[2] = (uint8_t)(value >> 16);
+    buffer[3] = (uint8_t)(value >> 24);
+}
+
+static uint16_t get16(const uint8_t* buffer) {
+    return (uint16_t)(buffer[0] | (buffer[1] << 8));
+}
+
+static uint32_t get32(const uint8_t* buffer) {
+    return (uint32_t)buffer[0] | ((uint32_t)buffer[1] << 8) |
+           ((uint32_t)buffer[2] << 16) | ((uint32_t)buffer[3] << 24);
+}
+
+int card_daemon_default_path(char* path, size_t size) {
+    if (!path || size == 0) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    DWORD length = GetTempPathA((DWORD)size, path);
+    if (length == 0 || length + sizeof(CARD_DAEMON_SOCKET_NAME) > size) {
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    memcpy(path + length, CARD_DAEMON_SOCKET_NAME, sizeof(CARD_DAEMON_SOCKET_NAME));
+    return CARD_SUCCESS;
+}
+
+size_t card_daemon_put_info(uint8_t* buffer, const CardInfo* info) {
+    size_t atrLength = info->atrLength <= CARD_ATR_MAX_LENGTH ? info->atrLength : CARD_ATR_MAX_LENGTH;
+    
+    buffer[0] = (uint8_t)atrLength;
+    buffer[1] = info->extendedLength ? 1 : 0;
+    put16(buffer + 2, 0);
+    put32(buffer + 4, (uint32_t)info->maxCommandData);
+    put32(buffer + 8, (uint32_t)info->maxResponseData);
+    put32(buffer + 12, (uint32_t)info->resetCount);
+    memcpy(buffer + CARD_DAEMON_INFO_SIZE, info->atr, atrLength);
+    return CARD_DAEMON_INFO_SIZE + atrLength;
+}
+
+int card_daemon_get_info(const uint8_t* data, size_t length, CardInfo* info) {
+    if (!data || !info || length < CARD_DAEMON_INFO_SIZE || data[0] > CARD_ATR_MAX_LENGTH ||
+        length < CARD_DAEMON_INFO_SIZE + (size_t)data[0]) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    memset(info, 0, sizeof(CardInfo));
+    info->atrLength = data[0];
+    info->extendedLength = data[1] != 0;
+    info->maxCommandData = get32(data + 4);
+    info->maxResponseData = get32(data + 8);
+    info->resetCount = get32(data + 12);
+    memcpy(info->atr, data + CARD_DAEMON_INFO_SIZE, info->atrLength);
+    return CARD_SUCCESS;
+}
+
+/* ---- Клиенты ---- */
+
+static int daemon_send_all(SOCKET socket, const uint8_t* data, size_t length) {
+    while (length > 0) {
+        int sent = send(socket, (const char*)data, (int)length, 0);
+        if (sent <= 0) {
+            return CARD_ERROR_TRANSMIT_FAILED;
+        }
+        data += sent;
+        length -= (size_t)sent;
+    }
+    return CARD_SUCCESS;
+}
+
+/**
+ * Снятие клиента с отправки: ответы больше не принимаются, ожидающие потоки просыпаются
+ * Вызывается под outputLock.
+ */
+static void daemon_stop_output(CardDaemonSession* session) {
+    session->isClosing = 1;
+    WakeAllConditionVariable(&session->outputReady);
+    WakeAllConditionVariable(&session->outputSent);
+}
+
+/**
+ * Постановка кадра ответа в очередь клиента; данные уже лежат в frame после заголовка
+ * Кадры копятся в блоках по DAEMON_OUTPUT_BLOCK байт и уходят в сокет из потока записи.
+ */
+static void daemon_respond(CardDaemonSession* session, uint8_t* frame, uint32_t id, int result,
+                           uint16_t flags, size_t length) {
+    put32(frame, (uint32_t)length);
+    put32(frame + 4, id);
+    put16(frame + 8, (uint16_t)(int16_t)result);
+    put16(frame + 10, flags);
+    
+    size_t size = CARD_DAEMON_HEADER_SIZE + length;
+    EnterCriticalSection(&session->outputLock);
+    if (session->isClosing) {
+        LeaveCriticalSection(&session->outputLock);
+        return;
+    }
+    
+    CardDaemonOutput* block = session->outputTail;
+    if (!block || block->capacity - block->length < size) {
+        block = session->outputSpare;
+        session->outputSpare = NULL;
+        if (!block) {
+            size_t capacity = size > DAEMON_OUTPUT_BLOCK ? size : DAEMON_OUTPUT_BLOCK;
+            block = (CardDaemonOutput*)malloc(sizeof(CardDaemonOutput) + capacity);
+            if (block) {
+                block->capacity = capacity;
+            }
+        }
+        if (block) {
+            block->next = NULL;
+            block->length = 0;
+            if (session->outputTail) {
+                session->outputTail->next = block;
+            } else {
+                session->outputHead = block;
+            }
+            session->outputTail = block;
+        }
+    }
+    
+    if (block) {
+        memcpy((uint8_t*)(block + 1) + block->length, frame, size);
+        block->length += size;
+        session->outputLength += size;
+        WakeConditionVariable(&session->outputReady);
+    } else {
+        // Пропущенный ответ сбил бы клиента с порядка ответов: клиент отключается
+        printf("Нет памяти под ответ клиенту демона, подключение закрыто\n");
+        shutdown(session->socket, SD_BOTH);
+        daemon_stop_output(session);
+    }
+    LeaveCriticalSection(&session->outputLock);
+}
+
+/**
+ * Освобождение ссылки на клиента; память освобождает последняя ссылка
+ */
+static void daemon_release_session(CardDaemonSession* session) {
+    if (InterlockedDecrement(&session->references) != 0) {
+        return;
+    }
+    
+    CardDaemon* daemon = session->daemon;
+    closesocket(session->socket);
+    while (session->outputHead) {
+        CardDaemonOutput* next = session->outputHead->next;
+        free(session->outputHead);
+        session->outputHead = next;
+    }
+    free(session->outputSpare);
+    DeleteCriticalSection(&session->outputLock);
+    free(session->lanes);
+    free(session);
+    
+    EnterCriticalSection(&daemon->sessionsLock);
+    daemon->sessionCount--;
+    WakeAllConditionVariable(&daemon->sessionsGone);
+    LeaveCriticalSection(&daemon->sessionsLock);
+}
+
+/**
+ * Поток записи: отправляет накопленные ответы клиента, не задерживая их источники
+ */
+static DWORD WINAPI daemon_writer_thread(LPVOID parameter) {
+    CardDaemonSession* session = (CardDaemonSession*)parameter;
+    
+    EnterCriticalSection(&session->outputLock);
+    while (!session->isClosing) {
+        CardDaemonOutput* blocks = session->outputHead;
+        if (!blocks) {
+            SleepConditionVariableCS(&session->outputReady, &session->outputLock, INFINITE);
+            continue;
+        }
+        session->outputHead = NULL;
+        session->outputTail = NULL;
+        LeaveCriticalSection(&session->outputLock);
+        
+        int result = CARD_SUCCESS;
+        size_t sent = 0;
+        for (CardDaemonOutput* block = blocks; block && result == CARD_SUCCESS; block = block->next) {
+            result = daemon_send_all(session->socket, (const uint8_t*)(block + 1), block->length);
+            sent += block->length;
+        }
+        
+        EnterCriticalSection(&session->outputLock);
+        while (blocks) {
+            CardDaemonOutput* next = blocks->next;
+            if (!session->outputSpare && blocks->capacity == DAEMON_OUTPUT_BLOCK) {
+                session->outputSpare = blocks;
+            } else {
+                free(blocks);
+            }
+            blocks = next;
+        }
+        session->outputLength -= sent;
+        WakeAllConditionVariable(&session->outputSent);
+        
+        // Клиент не принимает ответы: поток клиента заметит разрыв при чтении
+        if (result != CARD_SUCCESS) {
+            shutdown(session->socket, SD_BOTH);
+            daemon_stop_output(session);
+        }
+    }
+    LeaveCriticalSection(&session->outputLock);
+    
+    daemon_release_session(session);
+    return 0;
+}
+
+static void daemon_activate(CardDaemonReader* reader, CardDaemonLane* lane) {
+    lane->next = NULL;
+    lane->isActive = 1;
+    if (reader->activeTail) {
+        reader->activeTail->next = lane;
+    } else {
+        reader->activeHead = lane;
+    }
+    reader->activeTail = lane;
+}
+
+static void daemon_enqueue(CardDaemonReader* reader, CardDaemonRequest* request) {
+    CardDaemonLane* lane = request->lane;
+    InterlockedIncrement(&lane->session->references);
+    
+    // Очередь полна: поток клиента ждёт, пока считыватель возьмёт её запросы;
+    // незавершённая единица другого клиента держит считыватель не дольше CARD_DAEMON_UNIT_TIMEOUT
+    EnterCriticalSection(&reader->lock);
+    while (lane->queued >= CARD_DAEMON_MAX_QUEUED) {
+        SleepConditionVariableCS(&lane->session->laneSpace, &reader->lock, INFINITE);
+    }
+    lane->queued++;
+    request->next = NULL;
+    if (lane->tail) {
+        lane->tail->next = request;
+    } else {
+        lane->head = request;
+    }
+    lane->tail = request;
+    
+    // Дорожка с незавершённой единицей не стоит в круговой очереди: её ждут отдельно
+    if (!lane->isActive && lane != reader->locked) {
+        daemon_activate(reader, lane);
+    }
+    WakeConditionVariable(&reader->requestReady);
+    LeaveCriticalSection(&reader->lock);
+}
+
+/**
+ * Отмена запросов отключившегося клиента, ещё не взятых потоками считывателей
+ */
+static void daemon_cancel_lanes(CardDaemonSession* session) {
+    CardDaemon* daemon = session->daemon;
+    
+    for (size_t i = 0; i < daemon->config.readerCount; i++) {
+        CardDaemonReader* reader = &daemon->readers[i];
+        CardDaemonLane* lane = &session->lanes[i];
+        
+        EnterCriticalSection(&reader->lock);
+        CardDaemonRequest* pending = lane->head;
+        lane->head = NULL;
+        lane->tail = NULL;
+        lane->queued = 0;
+        
+        if (lane->isActive) {
+            CardDaemonLane* previous = NULL;
+            CardDaemonLane* current = reader->activeHead;
+            while (current != lane) {
+                previous = current;
+                current = current->next;
+            }
+            if (previous) {
+                previous->next = lane->next;
+            } else {
+                reader->activeHead = lane->next;
+            }
+            if (reader->activeTail == lane) {
+                reader->activeTail = previous;
+            }
+            lane->isActive = 0;
+        }
+        
+        // Незавершённая единица больше не продолжится: считыватель освобождается
+        if (reader->locked == lane) {
+            reader->locked = NULL;
+            WakeConditionVariable(&reader->requestReady);
+        }
+        LeaveCriticalSection(&reader->lock);
+        
+        while (pending) {
+            CardDaemonRequest* next = pending->next;
+            free(pending);
+            daemon_release_session(session);
+            pending = next;
+        }
+    }
+}
+
+static int daemon_dispatch(CardDaemonSession* session, const uint8_t* frame, size_t length, uint8_t* reply) {
+    CardDaemon* daemon = session->daemon;
+    uint32_t id = get32(frame + 4);
+    uint8_t operation = frame[8];
+    uint8_t readerIndex = frame[9];
+    uint16_t flags = get16(frame + 10);
+    const uint8_t* data = frame + CARD_DAEMON_HEADER_SIZE;
+    
+    if (operation == CARD_DAEMON_PING) {
+        daemon_respond(session, reply, id, CARD_SUCCESS, 0, 0);
+        return CARD_SUCCESS;
+    }
+    
+    if (operation == CARD_DAEMON_READERS) {
+        memcpy(reply + CARD_DAEMON_HEADER_SIZE, daemon->readerList, daemon->readerListLength);
+        daemon_respond(session, reply, id, CARD_SUCCESS, 0, daemon->readerListLength);
+        return CARD_SUCCESS;
+    }
+    
+    // У несуществующего считывателя нет очереди, ответы которой можно обогнать
+    if (readerIndex >= daemon->config.readerCount) {
+        daemon_respond(session, reply, id, CARD_ERROR_INVALID_PARAMETER, 0, 0);
+        return CARD_SUCCESS;
+    }
+    
+    // Отклонённые запросы тоже идут через очередь считывателя: ответ из этого потока
+    // обогнал бы ответы на запросы клиента, которые считыватель ещё выполняет
+    CardDaemonLane* lane = &session->lanes[readerIndex];
+    int rejected = CARD_SUCCESS;
+    uint16_t responseFlags = 0;
+    if (lane->isOverflow) {
+        // Единица длиннее CARD_DAEMON_MAX_UNIT оборвана на последнем допустимом запросе,
+        // её остальные запросы отклоняются, не закрепляя считыватель
+        lane->isOverflow = (flags & CARD_DAEMON_FLAG_MORE) != 0;
+        flags &= (uint16_t)~CARD_DAEMON_FLAG_MORE;
+        rejected = CARD_ERROR_INVALID_PARAMETER;
+        responseFlags = CARD_DAEMON_RESPONSE_SKIPPED;
+    } else {
+        if (!(flags & CARD_DAEMON_FLAG_MORE)) {
+            lane->unitLength = 0;
+        } else if (++lane->unitLength >= CARD_DAEMON_MAX_UNIT) {
+            flags &= (uint16_t)~CARD_DAEMON_FLAG_MORE;
+            lane->unitLength = 0;
+            lane->isOverflow = 1;
+        }
+        
+        if ((operation != CARD_DAEMON_INFO && operation != CARD_DAEMON_TRANSMIT) ||
+            (operation == CARD_DAEMON_TRANSMIT && length < CARD_DAEMON_TRANSMIT_PREFIX + 4)) {
+            rejected = CARD_ERROR_INVALID_PARAMETER;
+        }
+    }
+    
+    size_t commandLength = rejected == CARD_SUCCESS && operation == CARD_DAEMON_TRANSMIT ?
+                           length - CARD_DAEMON_TRANSMIT_PREFIX : 0;
+    CardDaemonRequest* request = (CardDaemonRequest*)malloc(sizeof(CardDaemonRequest) + commandLength);
+    if (!request) {
+        // Ответ в обход очереди сбил бы клиента с порядка ответов: клиент отключается
+        printf("Нет памяти под запрос клиента демона, подключение закрыто\n");
+        return CARD_ERROR_MEMORY_ALLOCATION;
+    }
+    
+    request->lane = lane;
+    request->id = id;
+    request->operation = operation;
+    request->flags = flags;
+    request->expectedStatus = 0;
+    request->statusMask = 0;
+    request->command = (const uint8_t*)(request + 1);
+    request->commandLength = commandLength;
+    request->rejected = rejected;
+    request->responseFlags = responseFlags;
+    if (rejected == CARD_SUCCESS && operation == CARD_DAEMON_TRANSMIT) {
+        request->expectedStatus = get16(data);
+        request->statusMask = get16(data + 2);
+        memcpy(request + 1, data + CARD_DAEMON_TRANSMIT_PREFIX, commandLength);
+    }
+    
+    daemon_enqueue(&daemon->readers[readerIndex], request);
+    return CARD_SUCCESS;
+}
+
+/**
+ * Снятие клиента: отмена его запросов и освобождение ссылки потока клиента
+ */
+static void daemon_close_session(CardDaemonSession* session) {
+    CardDaemon* daemon = session->daemon;
+    
+    shutdown(session->socket, SD_BOTH);
+    EnterCriticalSection(&session->outputLock);
+    daemon_stop_output(session);
+    LeaveCriticalSection(&session->outputLock);
+    daemon_cancel_lanes(session);
+    
+    EnterCriticalSection(&daemon->sessionsLock);
+    CardDaemonSession** link = &daemon->sessions;
+    while (*link && *link != session) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = session->next;
+    }
+    LeaveCriticalSection(&daemon->sessionsLock);
+    
+    daemon_release_session(session);
+}
+
+static DWORD WINAPI daemon_session_thread(LPVOID parameter) {
+    CardDaemonSession* session = (CardDaemonSession*)parameter;
+    CardDaemon* daemon = session->daemon;
+    
+    // Ответы этого потока: проверка связи, список считывателей и запросы к несуществующему считывателю
+    uint8_t* input = (uint8_t*)malloc(DAEMON_INPUT_SIZE);
+    uint8_t* reply = (uint8_t*)malloc(CARD_DAEMON_HEADER_SIZE + daemon->readerListLength);
+    size_t length = 0;
+    
+    while (input && reply && !daemon->isStopping) {
+        // Клиент не забирает ответы: новые запросы не читаются, пока очередь не уменьшится
+        EnterCriticalSection(&session->outputLock);
+        while (session->outputLength > DAEMON_OUTPUT_LIMIT && !session->isClosing) {
+            SleepConditionVariableCS(&session->outputSent, &session->outputLock, INFINITE);
+        }
+        int isClosing = session->isClosing;
+        LeaveCriticalSection(&session->outputLock);
+        if (isClosing) {
+            break;
+        }
+        
+        int received = recv(session->socket, (char*)input + length, (int)(DAEMON_INPUT_SIZE - length), 0);
+        if (received <= 0) {
+            break;
+        }
+        length += (size_t)received;
+        
+        // Одно чтение может принести много кадров: клиент не ждёт ответов
+        size_t position = 0;
+        int isMalformed = 0;
+        int isFailed = 0;
+        while (length - position >= CARD_DAEMON_HEADER_SIZE) {
+            uint32_t payload = get32(input + position);
+            if (payload > CARD_DAEMON_MAX_PAYLOAD) {
+                isMalformed = 1;
+                break;
+            }
+            if (length - position < CARD_DAEMON_HEADER_SIZE + payload) {
+                break;
+            }
+            
+            InterlockedIncrement64(&daemon->frames);
+            if (daemon_dispatch(session, input + position, payload, reply) != CARD_SUCCESS) {
+                isFailed = 1;
+                break;
+            }
+            position += CARD_DAEMON_HEADER_SIZE + payload;
+        }
+        
+        if (isMalformed) {
+            printf("Клиент демона отправил кадр длиннее допустимого, подключение закрыто\n");
+            break;
+        }
+        if (isFailed) {
+            break;
+        }
+        
+        memmove(input, input + position, length - position);
+        length -= position;
+    }
+    
+    free(input);
+    free(reply);
+    daemon_close_session(session);
+    return 0;
+}
+
+static DWORD WINAPI daemon_accept_thread(LPVOID parameter) {
+    CardDaemon* daemon = (CardDaemon*)parameter;
+    DWORD backoff = DAEMON_ACCEPT_BACKOFF;
+    
+    while (!daemon->isStopping) {
+        SOCKET connection = accept(daemon->listener, NULL, NULL);
+        if (connection == INVALID_SOCKET) {
+            if (daemon->isStopping) {
+                break;
+            }
+            
+            // Ошибка может держаться (нет дескрипторов или памяти): цикл не должен занимать процессор
+            printf("Ошибка при приёме подключения к демону: %d\n", WSAGetLastError());
+            Sleep(backoff);
+            backoff = backoff * 2 < DAEMON_ACCEPT_BACKOFF_MAX ? backoff * 2 : DAEMON_ACCEPT_BACKOFF_MAX;
+            continue;
+        }
+        backoff = DAEMON_ACCEPT_BACKOFF;
+        
+        CardDaemonSession* session = (CardDaemonSession*)calloc(1, sizeof(CardDaemonSession));
+        CardDaemonLane* lanes = (CardDaemonLane*)calloc(daemon->config.readerCount, sizeof(CardDaemonLane));
+        if (!session || !lanes) {
+            free(session);
+            free(lanes);
+            closesocket(connection);
+            continue;
+        }
+        
+        session->daemon = daemon;
+        session->socket = connection;
+        session->references = 2;
+        session->lanes = lanes;
+        for (size_t i = 0; i < daemon->config.readerCount; i++) {
+            lanes[i].session = session;
+        }
+        InitializeCriticalSection(&session->outputLock);
+        InitializeConditionVariable(&session->outputReady);
+        InitializeConditionVariable(&session->outputSent);
+        InitializeConditionVariable(&session->laneSpace);
+        
+        EnterCriticalSection(&daemon->sessionsLock);
+        session->next = daemon->sessions;
+        daemon->sessions = session;
+        daemon->sessionCount++;
+        LeaveCriticalSection(&daemon->sessionsLock);
+        
+        HANDLE writer = CreateThread(NULL, 0, daemon_writer_thread, session, 0, NULL);
+        HANDLE thread = writer ? CreateThread(NULL, 0, daemon_session_thread, session, 0, NULL) : NULL;
+        if (!thread) {
+            printf("Ошибка при создании потока клиента демона: %lu\n", (unsigned long)GetLastError());
+            if (writer) {
+                CloseHandle(writer);
+            } else {
+                InterlockedDecrement(&session->references);
+            }
+            daemon_close_session(session);
+            continue;
+        }
+        CloseHandle(writer);
+        CloseHandle(thread);
+        InterlockedIncrement64(&daemon->connections);
+    }
+    
+    return 0;
+}
+
+/* ---- Считыватели ---- */
+
+/**
+ * Сбор пакета: по одной единице от каждого клиента по кругу
+ * Если единица не уместилась или пришла не целиком, дорожка закрепляется
+ * за считывателем, и следующий пакет начинается с её продолжения. Продолжение
+ * ждётся не дольше CARD_DAEMON_UNIT_TIMEOUT: затем единица обрывается, и её
+ * запросы, пришедшие позже, отвечаются флагом CARD_DAEMON_RESPONSE_SKIPPED.
+ * @return Запросов в пакете; 0 — поток считывателя завершается
+ */
+static size_t daemon_take_batch(CardDaemonReader* reader, CardDaemonRequest** batch) {
+    size_t count = 0;
+    DWORD started = GetTickCount();
+    
+    EnterCriticalSection(&reader->lock);
+    for (;;) {
+        int isReady = reader->locked ? reader->locked->head != NULL : reader->activeHead != NULL;
+        if (isReady || reader->isStopping) {
+            break;
+        }
+        if (!reader->locked) {
+            SleepConditionVariableCS(&reader->requestReady, &reader->lock, INFINITE);
+            continue;
+        }
+        
+        DWORD elapsed = GetTickCount() - started;
+        if (elapsed >= CARD_DAEMON_UNIT_TIMEOUT) {
+            reader->locked->isSkipping = 1;
+            reader->locked = NULL;
+            continue;
+        }
+        SleepConditionVariableCS(&reader->requestReady, &reader->lock, CARD_DAEMON_UNIT_TIMEOUT - elapsed);
+    }
+    
+    while (count < CARD_DAEMON_MAX_BATCH) {
+        CardDaemonLane* lane = reader->locked;
+        if (lane) {
+            if (!lane->head) {
+                break;
+            }
+        } else {
+            lane = reader->activeHead;
+            if (!lane) {
+                break;
+            }
+            reader->activeHead = lane->next;
+            if (!reader->activeHead) {
+                reader->activeTail = NULL;
+            }
+            lane->isActive = 0;
+        }
+        
+        CardDaemonRequest* last = NULL;
+        while (lane->head && count < CARD_DAEMON_MAX_BATCH) {
+            last = lane->head;
+            lane->head = last->next;
+            lane->queued--;
+            batch[count++] = last;
+            if (!(last->flags & CARD_DAEMON_FLAG_MORE)) {
+                break;
+            }
+        }
+        if (!lane->head) {
+            lane->tail = NULL;
+        }
+        WakeConditionVariable(&lane->session->laneSpace);
+        
+        if (last->flags & CARD_DAEMON_FLAG_MORE) {
+            reader->locked = lane;
+            break;
+        }
+        reader->locked = NULL;
+        if (lane->head) {
+            daemon_activate(reader, lane);
+        }
+    }
+    LeaveCriticalSection(&reader->lock);
+    
+    return count;
+}
+
+static int daemon_connect(CardDaemonReader* reader) {
+    if (reader->isConnected) {
+        return CARD_SUCCESS;
+    }
+    if (reader->status != CARD_SUCCESS) {
+        return reader->status;
+    }
+    
+    int result = card_service_connect(&reader->service, reader->name);
+    reader->isConnected = result == CARD_SUCCESS;
+    return result;
+}
+
+static CardBatchPolicy daemon_policy(const CardDaemonRequest* request) {
+    return (CardBatchPolicy)((request->flags & CARD_DAEMON_FLAG_POLICY_MASK) >> CARD_DAEMON_FLAG_POLICY_SHIFT);
+}
+
+static int daemon_stops(CardBatchPolicy policy, int result) {
+    return result != CARD_SUCCESS &&
+           (policy == CARD_BATCH_STOP_ON_ERROR ||
+            (policy == CARD_BATCH_STOP_ON_TRANSMIT && result != CARD_ERROR_BAD_STATUS));
+}
+
+/**
+ * Конец части единицы, начинающейся с start: запросы той же дорожки до первого без MORE
+ */
+static size_t daemon_unit_end(CardDaemonRequest** batch, size_t start, size_t count) {
+    size_t end = start;
+    while (end < count && batch[end]->lane == batch[start]->lane &&
+           batch[end]->operation == CARD_DAEMON_TRANSMIT && batch[end]->rejected == CARD_SUCCESS) {
+        if (!(batch[end++]->flags & CARD_DAEMON_FLAG_MORE)) {
+            break;
+        }
+    }
+    return end;
+}
+
+/**
+ * Единица без условий остановки: одиночный запрос или правило CARD_BATCH_CONTINUE
+ */
+static int daemon_is_independent(CardDaemonRequest** batch, size_t start, size_t end) {
+    const CardDaemonRequest* request = batch[start];
+    return request->operation == CARD_DAEMON_TRANSMIT && !request->lane->isSkipping &&
+           (daemon_policy(request) == CARD_BATCH_CONTINUE ||
+            (end - start == 1 && !(request->flags & CARD_DAEMON_FLAG_MORE)));
+}
+
+static void daemon_complete(CardDaemonReader* reader, CardDaemonRequest* request, size_t slot,
+                            int result, uint16_t flags, size_t length) {
+    daemon_respond(request->lane->session, reader->frames + slot * DAEMON_FRAME_SIZE,
+                   request->id, result, flags, length);
+}
+
+/**
+ * Выполнение пакета
+ * Независимые запросы разных клиентов идут одним вызовом card_service_execute_batch;
+ * единица с правилом остановки — отдельным вызовом со своим правилом, а её
+ * запросы после остановки отвечаются флагом CARD_DAEMON_RESPONSE_SKIPPED.
+ */
+static void daemon_execute(CardDaemonReader* reader, CardDaemonRequest** batch, size_t count) {
+    CardBatchItem items[CARD_DAEMON_MAX_BATCH];
+    size_t i = 0;
+    
+    while (i < count) {
+        CardDaemonRequest* request = batch[i];
+        CardDaemonLane* lane = request->lane;
+        
+        // Отклонённый при приёме запрос отвечается на своём месте в очереди и,
+        // как ошибка выполнения, останавливает единицу по её правилу
+        if (request->rejected != CARD_SUCCESS) {
+            daemon_complete(reader, request, i, request->rejected, request->responseFlags, 0);
+            if (!(request->flags & CARD_DAEMON_FLAG_MORE)) {
+                lane->isSkipping = 0;
+            } else if (daemon_stops(daemon_policy(request), request->rejected)) {
+                lane->isSkipping = 1;
+            }
+            i++;
+            continue;
+        }
+        
+        if (lane->isSkipping) {
+            daemon_complete(reader, request, i, CARD_ERROR_TRANSMIT_FAILED, CARD_DAEMON_RESPONSE_SKIPPED, 0);
+            if (!(request->flags & CARD_DAEMON_FLAG_MORE)) {
+                lane->isSkipping = 0;
+            }
+            i++;
+            continue;
+        }
+        
+        int result = daemon_connect(reader);
+        if (result != CARD_SUCCESS) {
+            daemon_complete(reader, request, i, result, 0, 0);
+            i++;
+            continue;
+        }
+        
+        if (request->operation == CARD_DAEMON_INFO) {
+            uint8_t* data = reader->frames + i * DAEMON_FRAME_SIZE + CARD_DAEMON_HEADER_SIZE;
+            CardInfo info;
+            size_t length = 0;
+            result = reader->service.repository->get_info ?
+                     reader->service.repository->get_info(reader->service.context, &info) :
+                     CARD_ERROR_INVALID_PARAMETER;
+            if (result == CARD_SUCCESS) {
+                length = card_daemon_put_info(data, &info);
+            }
+            daemon_complete(reader, request, i, result, 0, length);
+            i++;
+            continue;
+        }
+        
+        CardBatchPolicy policy = daemon_policy(request);
+        size_t end = daemon_unit_end(batch, i, count);
+        if (daemon_is_independent(batch, i, end)) {
+            policy = CARD_BATCH_CONTINUE;
+            while (end < count) {
+                size_t next = daemon_unit_end(batch, end, count);
+                if (next == end || !daemon_is_independent(batch, end, next)) {
+                    break;
+                }
+                end = next;
+            }
+        }
+        
+        for (size_t k = i; k < end; k++) {
+            CardBatchItem* item = &items[k];
+            item->command = batch[k]->command;
+            item->commandLength = batch[k]->commandLength;
+            item->response = reader->frames + k * DAEMON_FRAME_SIZE + CARD_DAEMON_HEADER_SIZE;
+            item->responseLength = APDU_MAX_RESPONSE_LENGTH;
+            item->expectedStatus = batch[k]->expectedStatus;
+            item->statusMask = batch[k]->statusMask;
+            item->result = CARD_SUCCESS;
+        }
+        
+        size_t executed = 0;
+        result = card_service_execute_batch(&reader->service, &items[i], end - i, policy, &executed);
+        
+        int isLost = 0;
+        for (size_t k = i; k < end; k++) {
+            if (k < i + executed) {
+                isLost |= items[k].result == CARD_ERROR_CONNECT_FAILED;
+                daemon_complete(reader, batch[k], k, items[k].result, 0,
+                                items[k].result == CARD_SUCCESS || items[k].result == CARD_ERROR_BAD_STATUS ?
+                                items[k].responseLength : 0);
+            } else if (executed == 0 || policy == CARD_BATCH_CONTINUE) {
+                // Пакет не начался: ошибка подключения или транзакции
+                isLost |= result == CARD_ERROR_CONNECT_FAILED;
+                daemon_complete(reader, batch[k], k, result != CARD_SUCCESS ? result : CARD_ERROR_TRANSMIT_FAILED, 0, 0);
+            } else {
+                daemon_complete(reader, batch[k], k, CARD_ERROR_TRANSMIT_FAILED, CARD_DAEMON_RESPONSE_SKIPPED, 0);
+            }
+        }
+        
+        // Остановленная единица пропускает свои запросы, которые ещё придут
+        if (policy != CARD_BATCH_CONTINUE &&
+            (executed < end - i || daemon_stops(policy, items[end - 1].result)) &&
+            (batch[end - 1]->flags & CARD_DAEMON_FLAG_MORE)) {
+            lane->isSkipping = 1;
+        }
+        
+        // Карта извлечена: следующий пакет подключится заново
+        if (isLost) {
+            card_service_disconnect(&reader->service);
+            reader->isConnected = 0;
+        }
+        i = end;
+    }
+}
+
+static DWORD WINAPI daemon_reader_thread(LPVOID parameter) {
+    CardDaemonReader* reader = (CardDaemonReader*)parameter;
+    const CardDaemonConfig* config = &reader->daemon->config;
+    
+    // Контекст репозитория создаётся в потоке, который будет его использовать
+    reader->repositoryContext = calloc(1, config->contextSize);
+    reader->status = CARD_ERROR_MEMORY_ALLOCATION;
+    if (reader->repositoryContext) {
+        reader->context.context = reader->repositoryContext;
+        reader->status = card_service_initialize(&reader->service, config->repository, &reader->context);
+    }
+    
+    if (reader->status != CARD_SUCCESS) {
+        printf("Не удалось инициализировать считыватель %s: %d\n", reader->name, reader->status);
+    } else if (daemon_connect(reader) != CARD_SUCCESS) {
+        printf("Нет карты в считывателе %s, подключение при первом запросе\n", reader->name);
+    }
+    
+    CardDaemonRequest* batch[CARD_DAEMON_MAX_BATCH];
+    size_t count;
+    while ((count = daemon_take_batch(reader, batch)) > 0) {
+        daemon_execute(reader, batch, count);
+        
+        // Отклонённые при приёме запросы к картам не считаются
+        size_t requests = 0;
+        for (size_t i = 0; i < count; i++) {
+            CardDaemonSession* session = batch[i]->lane->session;
+            requests += batch[i]->rejected == CARD_SUCCESS;
+            free(batch[i]);
+            daemon_release_session(session);
+        }
+        InterlockedExchangeAdd64(&reader->daemon->requests, (LONG64)requests);
+        InterlockedIncrement64(&reader->daemon->batches);
+    }
+    
+    if (reader->isConnected) {
+        card_service_disconnect(&reader->service);
+        reader->isConnected = 0;
+    }
+    if (reader->status == CARD_SUCCESS) {
+        card_service_release(&reader->service);
+    }
+    free(reader->repositoryContext);
+    reader->repositoryContext = NULL;
+    return 0;
+}
+
+/* ---- Запуск и остановка ---- */
+
+int card_daemon_start(CardDaemon* daemon, const CardDaemonConfig* config) {
+    if (!daemon || !config || !config->repository || config->contextSize == 0 || !config->readerNames ||
+        config->readerCount == 0 || config->readerCount > CARD_DAEMON_MAX_READERS) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    memset(daemon, 0, sizeof(CardDaemon));
+    daemon->config = *config;
+    daemon->listener = INVALID_SOCKET;
+    InitializeCriticalSection(&daemon->sessionsLock);
+    InitializeConditionVariable(&daemon->sessionsGone);
+    
+    int result = CARD_SUCCESS;
+    if (config->socketPath) {
+        size_t length = strlen(config->socketPath);
+        if (length >= sizeof(daemon->socketPath)) {
+            result = CARD_ERROR_INVALID_PARAMETER;
+        } else {
+            memcpy(daemon->socketPath, config->socketPath, length + 1);
+        }
+    } else {
+        result = card_daemon_default_path(daemon->socketPath, sizeof(daemon->socketPath));
+    }
+    
+    // Ответ на CARD_DAEMON_READERS собирается один раз
+    if (result == CARD_SUCCESS) {
+        for (size_t i = 0; i < config->readerCount; i++) {
+            daemon->readerListLength += strlen(config->readerNames[i]) + 1;
+        }
+        daemon->readerList = (uint8_t*)malloc(daemon->readerListLength);
+        daemon->readers = (CardDaemonReader*)calloc(config->readerCount, sizeof(CardDaemonReader));
+        if (!daemon->readerList || !daemon->readers) {
+            result = CARD_ERROR_MEMORY_ALLOCATION;
+        }
+    }
+    
+    if (result == CARD_SUCCESS) {
+        uint8_t* position = daemon->readerList;
+        for (size_t i = 0; i < config->readerCount; i++) {
+            size_t length = strlen(config->readerNames[i]) + 1;
+            memcpy(position, config->readerNames[i], length);
+            position += length;
+            
+            CardDaemonReader* reader = &daemon->readers[i];
+            reader->daemon = daemon;
+            reader->index = i;
+            reader->name = config->readerNames[i];
+            InitializeCriticalSection(&reader->lock);
+            InitializeConditionVariable(&reader->requestReady);
+            reader->isInitialized = 1;
+        }
+        
+        for (size_t i = 0; i < config->readerCount && result == CARD_SUCCESS; i++) {
+            daemon->readers[i].frames = (uint8_t*)malloc(CARD_DAEMON_MAX_BATCH * DAEMON_FRAME_SIZE);
+            if (!daemon->readers[i].frames) {
+                result = CARD_ERROR_MEMORY_ALLOCATION;
+            }
+        }
+    }
+    
+    if (result == CARD_SUCCESS) {
+        WSADATA data;
+        if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+            printf("Ошибка при инициализации Winsock\n");
+            result = CARD_ERROR_INIT_FAILED;
+        } else {
+            daemon->winsockStarted = 1;
+        }
+    }
+    
+    if (result == CARD_SUCCESS) {
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path, daemon->socketPath, strlen(daemon->socketPath) + 1);
+        
+        // Файл сокета остаётся после аварийного завершения и мешает bind
+        DeleteFileA(daemon->socketPath);
+        
+        daemon->listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (daemon->listener == INVALID_SOCKET ||
+            bind(daemon->listener, (struct sockaddr*)&address, sizeof(address)) == SOCKET_ERROR ||
+            listen(daemon->listener, SOMAXCONN) == SOCKET_ERROR) {
+            printf("Ошибка при открытии сокета %s: %d\n", daemon->socketPath, WSAGetLastError());
+            result = CARD_ERROR_INIT_FAILED;
+        }
+    }
+    
+    for (size_t i = 0; i < config->readerCount && result == CARD_SUCCESS; i++) {
+        daemon->readers[i].thread = CreateThread(NULL, 0, daemon_reader_thread, &daemon->readers[i], 0, NULL);
+        if (!daemon->readers[i].thread) {
+            result = CARD_ERROR_INIT_FAILED;
+        }
+    }
+    
+    if (result == CARD_SUCCESS) {
+        daemon->acceptThread = CreateThread(NULL, 0, daemon_accept_thread, daemon, 0, NULL);
+        if (!daemon->acceptThread) {
+            result = CARD_ERROR_INIT_FAILED;
+        }
+    }
+    
+    if (result != CARD_SUCCESS) {
+        card_daemon_stop(daemon);
+    }
+    return result;
+}
+
+int card_daemon_stop(CardDaemon* daemon) {
+    if (!daemon) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    InterlockedExchange(&daemon->isStopping, 1);
+    
+    // Закрытие слушающего сокета прерывает accept
+    if (daemon->listener != INVALID_SOCKET) {
+        shutdown(daemon->listener, SD_BOTH);
+        closesocket(daemon->listener);
+        daemon->listener = INVALID_SOCKET;
+    }
+    if (daemon->acceptThread) {
+        WaitForSingleObject(daemon->acceptThread, INFINITE);
+        CloseHandle(daemon->acceptThread);
+        daemon->acceptThread = NULL;
+    }
+    
+    // Потоки клиентов выходят из recv; память клиентов освобождается,
+    // когда потоки считывателей ответят на взятые запросы
+    EnterCriticalSection(&daemon->sessionsLock);
+    for (CardDaemonSession* session = daemon->sessions; session; session = session->next) {
+        shutdown(session->socket, SD_BOTH);
+    }
+    while (daemon->sessionCount > 0) {
+        SleepConditionVariableCS(&daemon->sessionsGone, &daemon->sessionsLock, INFINITE);
+    }
+    LeaveCriticalSection(&daemon->sessionsLock);
+    
+    if (daemon->readers) {
+        // Запуск мог прерваться раньше, чем созданы блокировки считывателей
+        for (size_t i = 0; i < daemon->config.readerCount; i++) {
+            CardDaemonReader* reader = &daemon->readers[i];
+            if (!reader->isInitialized) {
+                continue;
+            }
+            EnterCriticalSection(&reader->lock);
+            reader->isStopping = 1;
+            WakeAllConditionVariable(&reader->requestReady);
+            LeaveCriticalSection(&reader->lock);
+        }
+        
+        for (size_t i = 0; i < daemon->config.readerCount; i++) {
+            CardDaemonReader* reader = &daemon->readers[i];
+            if (reader->thread) {
+                WaitForSingleObject(reader->thread, INFINITE);
+                CloseHandle(reader->thread);
+            }
+            free(reader->frames);
+            if (reader->isInitialized) {
+                DeleteCriticalSection(&reader->lock);
+                reader->isInitialized = 0;
+            }
+        }
+        free(daemon->readers);
+        daemon->readers = NULL;
+    }
+    
+    free(daemon->readerList);
+    daemon->readerList = NULL;
+    
+    if (daemon->winsockStarted) {
+        DeleteFileA(daemon->socketPath);
+        WSACleanup();
+        daemon->winsockStarted = 0;
+    }
+    DeleteCriticalSection(&daemon->sessionsLock);
+    return CARD_SUCCESS;
+} 
\ No newline at end of file
@@ -0,0 +1,228 @@
+#ifndef CARD_DAEMON_H
+#define CARD_DAEMON_H
+
+#include <winsock2.h>
+#include <afunix.h>
+#include <windows.h>
+#include <stdint.h>
+#include "card_domain.h"
+#include "card_service.h"
+#include "apdu.h"
+
+/**
+ * Слой инфраструктуры (Infrastructure Layer)
+ * Локальный демон доступа к картам. Демон один раз устанавливает контексты
+ * и подключения к считывателям и держит их открытыми, а клиенты отправляют
+ * запросы через Unix-сокет (AF_UNIX, Windows 10 1803 и новее).
+ *
+ * Каждым считывателем владеет свой поток с CardService. Запросы клиентов
+ * попадают в очереди «клиент — считыватель»; поток считывателя обходит их
+ * по кругу, берёт по одной единице от клиента и выполняет собранные запросы
+ * пакетом (card_service_execute_batch), поэтому общий считыватель делится
+ * между клиентами поровну, а запросы одной единицы не перемежаются с чужими.
+ * Единица держит считыватель ограниченно: если её продолжение не пришло за
+ * CARD_DAEMON_UNIT_TIMEOUT, остаток единицы пропускается, а запросы сверх
+ * CARD_DAEMON_MAX_UNIT отклоняются. В очереди клиента к считывателю не больше
+ * CARD_DAEMON_MAX_QUEUED запросов: пока она полна, запросы клиента не читаются.
+ *
+ * Кадр запроса: длина данных (4), номер запроса (4), операция (1),
+ * считыватель (1), флаги (2), данные. Кадр ответа: длина данных (4),
+ * номер запроса (4), результат CardError (2, со знаком), флаги (2), данные.
+ * Числа в порядке little-endian. Клиент может отправлять запросы, не
+ * дожидаясь ответов; ответы одного считывателя, включая отклонённые
+ * запросы, приходят в порядке запросов.
+ * Ответы копятся в очереди клиента и уходят в сокет из отдельного потока
+ * записи, поэтому ни поток клиента, ни потоки считывателей не ждут send.
+ * Пока клиент не забирает ответы, демон не читает его новые запросы.
+ * Клиентская сторона — card_daemon_client.h, программа — src/tools/card_daemond.c.
+ */
+
+#define CARD_DAEMON_SOCKET_NAME "card_daemon.sock"  /* Имя сокета во временном каталоге */
+#define CARD_DAEMON_HEADER_SIZE 12
+#define CARD_DAEMON_TRANSMIT_PREFIX 4                /* Ожидаемый статус и маска перед командой */
+#define CARD_DAEMON_MAX_PAYLOAD (CARD_DAEMON_TRANSMIT_PREFIX + APDU_MAX_COMMAND_LENGTH)
+#define CARD_DAEMON_MAX_READERS 255
+#define CARD_DAEMON_MAX_BATCH 16                     /* Запросов в одном пакете потока считывателя */
+#define CARD_DAEMON_MAX_QUEUED 64                    /* Ждущих запросов клиента к одному считывателю */
+#define CARD_DAEMON_MAX_UNIT 64                      /* Запросов в одной единице */
+#define CARD_DAEMON_UNIT_TIMEOUT 1000                /* Ожидание продолжения единицы, мс */
+
+typedef enum {
+    CARD_DAEMON_PING = 0,            /* Пустой ответ: проверка связи и замер задержки */
+    CARD_DAEMON_READERS = 1,         /* Ответ — имена считывателей, каждое с нулём в конце */
+    CARD_DAEMON_INFO = 2,            /* Ответ — сведения о карте (card_daemon_put_info) */
+    CARD_DAEMON_TRANSMIT = 3         /* Данные — ожидаемый статус (2), маска (2) и команда; ответ с SW1 SW2 */
+} CardDaemonOperation;
+
+/* Флаги запроса */
+#define CARD_DAEMON_FLAG_MORE 0x0001          /* Следующий запрос клиента к этому считывателю — из той же единицы */
+#define CARD_DAEMON_FLAG_POLICY_SHIFT 1       /* Биты 1-2 — CardBatchPolicy единицы */
+#define CARD_DAEMON_FLAG_POLICY_MASK 0x0006
+
+/* Флаги ответа */
+#define CARD_DAEMON_RESPONSE_SKIPPED 0x0001   /* Не выполнен: единица остановлена на ошибке или оборвана */
+
+#define CARD_DAEMON_INFO_SIZE 16              /* Сведения о карте без ATR */
+
+typedef struct CardDaemon CardDaemon;
+typedef struct CardDaemonSession CardDaemonSession;
+typedef struct CardDaemonLane CardDaemonLane;
+
+/**
+ * Запрос в очереди считывателя; данные размещаются одним блоком со структурой
+ */
+typedef struct CardDaemonRequest {
+    struct CardDaemonRequest* next;
+    CardDaemonLane* lane;
+    uint32_t id;
+    uint8_t operation;               /* CardDaemonOperation */
+    uint16_t flags;
+    uint16_t expectedStatus;
+    uint16_t statusMask;
+    const uint8_t* command;
+    size_t commandLength;
+    int rejected;                    /* Ошибка разбора: ответ по порядку очереди без выполнения */
+    uint16_t responseFlags;          /* Флаги ответа на отклонённый запрос */
+} CardDaemonRequest;
+
+/**
+ * Очередь запросов одного клиента к одному считывателю
+ */
+struct CardDaemonLane {
+    CardDaemonSession* session;
+    CardDaemonRequest* head;
+    CardDaemonRequest* tail;
+    CardDaemonLane* next;            /* Следующая дорожка в круговой очереди считывателя */
+    size_t queued;                   /* Запросов в очереди, не больше CARD_DAEMON_MAX_QUEUED */
+    int isActive;                    /* Дорожка стоит в очереди считывателя */
+    int isSkipping;                  /* Единица остановлена: запросы до её конца не выполняются */
+    
+    size_t unitLength;               /* Принято запросов текущей единицы (поток клиента) */
+    int isOverflow;                  /* Единица длиннее CARD_DAEMON_MAX_UNIT: остаток отклоняется */
+};
+
+/**
+ * Блок очереди ответов клиента; кадры размещаются одним блоком со структурой
+ */
+typedef struct CardDaemonOutput {
+    struct CardDaemonOutput* next;
+    size_t length;
+    size_t capacity;
+} CardDaemonOutput;
+
+/**
+ * Подключение клиента к демону
+ */
+struct CardDaemonSession {
+    CardDaemon* daemon;
+    SOCKET socket;
+    volatile LONG references;        /* Потоки клиента и записи, запросы в очередях */
+    CardDaemonLane* lanes;           /* По одной на считыватель */
+    CardDaemonSession* next;         /* Список клиентов демона */
+    CONDITION_VARIABLE laneSpace;    /* Считыватель взял запросы клиента (ждут под его lock) */
+    
+    CRITICAL_SECTION outputLock;     /* Ответы добавляют поток клиента и потоки считывателей */
+    CONDITION_VARIABLE outputReady;  /* Есть ответы для потока записи */
+    CONDITION_VARIABLE outputSent;   /* Поток записи отправил часть ответов */
+    CardDaemonOutput* outputHead;
+    CardDaemonOutput* outputTail;
+    CardDaemonOutput* outputSpare;   /* Отправленный блок для следующих ответов */
+    size_t outputLength;             /* Байт ответов, ещё не отправленных */
+    int isClosing;                   /* Клиент снят: ответы отбрасываются */
+};
+
+typedef struct {
+    CardDaemon* daemon;
+    size_t index;
+    const char* name;
+    HANDLE thread;
+    CardService service;
+    CardContext context;
+    void* repositoryContext;
+    int status;                      /* Результат инициализации сервиса */
+    int isConnected;                 /* Карта подключена; иначе подключение при следующем пакете */
+    uint8_t* frames;                 /* Кадры ответов пакета: заголовок и место под ответ */
+    
+    CRITICAL_SECTION lock;           /* Защищает очередь дорожек */
+    CONDITION_VARIABLE requestReady;
+    CardDaemonLane* activeHead;
+    CardDaemonLane* activeTail;
+    CardDaemonLane* locked;          /* Дорожка с незавершённой единицей: другие ждут */
+    int isStopping;
+    int isInitialized;               /* lock и requestReady созданы */
+} CardDaemonReader;
+
+typedef struct {
+    CardRepository* repository;      /* Репозиторий, общий для потоков считывателей */
+    size_t contextSize;              /* Размер контекста репозитория, например sizeof(WinScardContext) */
+    const char* const* readerNames;
+    size_t readerCount;
+    const char* socketPath;          /* NULL — CARD_DAEMON_SOCKET_NAME во временном каталоге */
+} CardDaemonConfig;
+
+struct CardDaemon {
+    CardDaemonConfig config;
+    char socketPath[108];            /* Размер sun_path */
+    SOCKET listener;
+    HANDLE acceptThread;
+    CardDaemonReader* readers;
+    uint8_t* readerList;             /* Готовый ответ на CARD_DAEMON_READERS */
+    size_t readerListLength;
+    
+    CRITICAL_SECTION sessionsLock;
+    CONDITION_VARIABLE sessionsGone;
+    CardDaemonSession* sessions;
+    size_t sessionCount;             /* Клиентов, память которых ещё не освобождена */
+    volatile LONG isStopping;
+    int winsockStarted;
+    
+    volatile LONG64 connections;     /* Принято подключений */
+    volatile LONG64 frames;          /* Принято кадров */
+    volatile LONG64 requests;        /* Выполнено запросов к картам */
+    volatile LONG64 batches;         /* Пакетов потоков считывателей */
+};
+
+/**
+ * Путь к сокету по умолчанию: CARD_DAEMON_SOCKET_NAME во временном каталоге
+ * @param path Буфер для пути
+ * @param size Размер буфера
+ * @return Код ошибки из CardError
+ */
+int card_daemon_default_path(char* path, size_t size);
+
+/**
+ * Запись сведений о карте в кадр ответа CARD_DAEMON_INFO
+ * @param buffer Буфер не меньше CARD_DAEMON_INFO_SIZE + CARD_ATR_MAX_LENGTH байт
+ * @param info Сведения о карте
+ * @return Длина записанных данных
+ */
+size_t card_daemon_put_info(uint8_t* buffer, const CardInfo* info);
+
+/**
+ * Разбор сведений о карте из ответа CARD_DAEMON_INFO
+ * @param data Данные ответа
+ * @param length Длина данных
+ * @param info Сведения о карте
+ * @return Код ошибки из CardError
+ */
+int card_daemon_get_info(const uint8_t* data, size_t length, CardInfo* info);
+
+/**
+ * Запуск демона: потоки считывателей и приём подключений
+ * Карты подключаются при запуске (или при первом запросе, если карты не было)
+ * и остаются подключёнными до остановки или извлечения.
+ * @param daemon Структура демона (память вызывающего)
+ * @param config Настройки (копируются; имена считывателей должны жить до остановки)
+ * @return Код ошибки из CardError
+ */
+int card_daemon_start(CardDaemon* daemon, const CardDaemonConfig* config);
+
+/**
+ * Остановка: приём подключений прекращается, клиенты отключаются,
+ * запросы в работе завершаются, затем потоки считывателей освобождают карты
+ * @param daemon Запущенный демон
+ * @return Код ошибки из CardError
+ */
+int card_daemon_stop(CardDaemon* daemon);
+
+#endif /* CARD_DAEMON_H */ 
\ No newline at end of file
@@ -0,0 +1,571 @@
+#include "card_daemon_client.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define CLIENT_BUFFER_SIZE (CARD_DAEMON_HEADER_SIZE + CARD_DAEMON_MAX_PAYLOAD)
+
+static void put16(uint8_t* buffer, uint16_t value) {
+    buffer[0] = (uint8_t)value;
+    buffer[1] = (uint8_t)(value >> 8);
+}
+
+static void put32(uint8_t* buffer, uint32_t value) {
+    buffer[0] = (uint8_t)value;
+    buffer[1] = (uint8_t)(value >> 8);
+    buffer[2] = (uint8_t)(value >> 16);
+    buffer[3] = (uint8_t)(value >> 24);
+}
+
+static uint16_t get16(const uint8_t* buffer) {
+    return (uint16_t)(buffer[0] | (buffer[1] << 8));
+}
+
+static uint32_t get32(const uint8_t* buffer) {
+    return (uint32_t)buffer[0] | ((uint32_t)buffer[1] << 8) |
+           ((uint32_t)buffer[2] << 16) | ((uint32_t)buffer[3] << 24);
+}
+
+int card_daemon_client_open(CardDaemonClient* client, const char* path) {
+    if (!client) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    memset(client, 0, sizeof(CardDaemonClient));
+    client->socket = INVALID_SOCKET;
+    
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path) {
+        if (strlen(path) >= sizeof(address.sun_path)) {
+            return CARD_ERROR_INVALID_PARAMETER;
+        }
+        memcpy(address.sun_path, path, strlen(path) + 1);
+    } else if (card_daemon_default_path(address.sun_path, sizeof(address.sun_path)) != CARD_SUCCESS) {
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    WSADATA data;
+    if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+        return CARD_ERROR_INIT_FAILED;
+    }
+    client->winsockStarted = 1;
+    
+    client->input = (uint8_t*)malloc(CLIENT_BUFFER_SIZE);
+    client->output = (uint8_t*)malloc(CLIENT_BUFFER_SIZE);
+    if (!client->input || !client->output) {
+        card_daemon_client_close(client);
+        return CARD_ERROR_MEMORY_ALLOCATION;
+    }
+    client->inputCapacity = CLIENT_BUFFER_SIZE;
+    
+    // Неблокирующий сокет: отправка чередуется с приёмом (client_wait)
+    u_long isNonBlocking = 1;
+    client->socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (client->socket == INVALID_SOCKET ||
+        connect(client->socket, (struct sockaddr*)&address, sizeof(address)) == SOCKET_ERROR ||
+        ioctlsocket(client->socket, FIONBIO, &isNonBlocking) == SOCKET_ERROR) {
+        printf("Не удалось подключиться к демону %s: %d\n", address.sun_path, WSAGetLastError());
+        card_daemon_client_close(client);
+        return CARD_ERROR_CONNECT_FAILED;
+    }
+    
+    return CARD_SUCCESS;
+}
+
+/**
+ * Место под кадр в буфере отправки; заголовок заполняется сразу
+ * @return Указатель на данные кадра или NULL, если буфер не удалось освободить
+ */
+static uint8_t* client_reserve(CardDaemonClient* client, uint8_t operation, size_t readerIndex,
+                               uint16_t flags, size_t length, uint32_t* id) {
+    if (client->outputLength + CARD_DAEMON_HEADER_SIZE + length > CLIENT_BUFFER_SIZE &&
+        card_daemon_client_flush(client) != CARD_SUCCESS) {
+        return NULL;
+    }
+    
+    uint8_t* frame = client->output + client->outputLength;
+    put32(frame, (uint32_t)length);
+    put32(frame + 4, client->nextId);
+    frame[8] = operation;
+    frame[9] = (uint8_t)readerIndex;
+    put16(frame + 10, flags);
+    
+    if (id) {
+        *id = client->nextId;
+    }
+    client->nextId++;
+    client->outputLength += CARD_DAEMON_HEADER_SIZE + length;
+    return frame + CARD_DAEMON_HEADER_SIZE;
+}
+
+int card_daemon_client_submit(CardDaemonClient* client, CardDaemonOperation operation, size_t readerIndex,
+                              uint16_t flags, const uint8_t* data, size_t length, uint32_t* id) {
+    if (!client || !client->output || (!data && length > 0) || length > CARD_DAEMON_MAX_PAYLOAD ||
+        readerIndex >= CARD_DAEMON_MAX_READERS) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    uint8_t* payload = client_reserve(client, (uint8_t)operation, readerIndex, flags, length, id);
+    if (!payload) {
+        return CARD_ERROR_TRANSMIT_FAILED;
+    }
+    if (length > 0) {
+        memcpy(payload, data, length);
+    }
+    return CARD_SUCCESS;
+}
+
+int card_daemon_client_submit_transmit(CardDaemonClient* client, size_t readerIndex, uint16_t flags,
+                                       const uint8_t* command, size_t length,
+                                       uint16_t expectedStatus, uint16_t statusMask, uint32_t* id) {
+    if (!client || !client->output || !command || length < 4 || length > APDU_MAX_COMMAND_LENGTH ||
+        readerIndex >= CARD_DAEMON_MAX_READERS) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    uint8_t* payload = client_reserve(client, CARD_DAEMON_TRANSMIT, readerIndex, flags,
+                                      CARD_DAEMON_TRANSMIT_PREFIX + length, id);
+    if (!payload) {
+        return CARD_ERROR_TRANSMIT_FAILED;
+    }
+    put16(payload, expectedStatus);
+    put16(payload + 2, statusMask);
+    memcpy(payload + CARD_DAEMON_TRANSMIT_PREFIX, command, length);
+    return CARD_SUCCESS;
+}
+
+/**
+ * Приём того, что уже прислал демон
+ * Неполный кадр переносится в начало буфера; если места нет и так, буфер растёт.
+ * @return Принято байт; 0 — данных пока нет; -1 — разрыв связи
+ */
+static int client_fill(CardDaemonClient* client) {
+    if (client->inputLength == client->inputCapacity && client->inputStart > 0) {
+        memmove(client->input, client->input + client->inputStart, client->inputLength - client->inputStart);
+        client->inputLength -= client->inputStart;
+        client->inputStart = 0;
+    }
+    if (client->inputLength == client->inputCapacity) {
+        uint8_t* input = (uint8_t*)realloc(client->input, client->inputCapacity * 2);
+        if (!input) {
+            return -1;
+        }
+        client->input = input;
+        client->inputCapacity *= 2;
+    }
+    
+    int received = recv(client->socket, (char*)client->input + client->inputLength,
+                        (int)(client->inputCapacity - client->inputLength), 0);
+    if (received > 0) {
+        client->inputLength += (size_t)received;
+        return received;
+    }
+    return received < 0 && WSAGetLastError() == WSAEWOULDBLOCK ? 0 : -1;
+}
+
+/**
+ * Ожидание данных от демона (и места в сокете, если isSending);
+ * пришедшие данные сразу принимаются в буфер
+ */
+static int client_wait(CardDaemonClient* client, int isSending) {
+    fd_set readable;
+    fd_set writable;
+    FD_ZERO(&readable);
+    FD_ZERO(&writable);
+    FD_SET(client->socket, &readable);
+    FD_SET(client->socket, &writable);
+    
+    if (select((int)client->socket + 1, &readable, isSending ? &writable : NULL, NULL, NULL) == SOCKET_ERROR) {
+        return CARD_ERROR_TRANSMIT_FAILED;
+    }
+    if (FD_ISSET(client->socket, &readable) && client_fill(client) < 0) {
+        return CARD_ERROR_TRANSMIT_FAILED;
+    }
+    return CARD_SUCCESS;
+}
+
+int card_daemon_client_flush(CardDaemonClient* client) {
+    if (!client || !client->output) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    size_t position = 0;
+    while (position < client->outputLength) {
+        int sent = send(client->socket, (const char*)client->output + position,
+                        (int)(client->outputLength - position), 0);
+        if (sent > 0) {
+            position += (size_t)sent;
+            continue;
+        }
+        
+        // Сокет заполнен: демон ждёт, пока клиент заберёт ответы
+        if (sent == 0 || WSAGetLastError() != WSAEWOULDBLOCK ||
+            client_wait(client, 1) != CARD_SUCCESS) {
+            return CARD_ERROR_TRANSMIT_FAILED;
+        }
+    }
+    
+    client->outputLength = 0;
+    return CARD_SUCCESS;
+}
+
+int card_daemon_client_receive(CardDaemonClient* client, CardDaemonResponse* response) {
+    if (!client || !client->input || !response) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    int result = card_daemon_client_flush(client);
+    if (result != CARD_SUCCESS) {
+        return result;
+    }
+    
+    for (;;) {
+        const uint8_t* frame = client->input + client->inputStart;
+        size_t available = client->inputLength - client->inputStart;
+        
+        if (available >= CARD_DAEMON_HEADER_SIZE) {
+            uint32_t length = get32(frame);
+            if (length > CLIENT_BUFFER_SIZE - CARD_DAEMON_HEADER_SIZE) {
+                return CARD_ERROR_TRANSMIT_FAILED;
+            }
+            if (available >= CARD_DAEMON_HEADER_SIZE + length) {
+                response->id = get32(frame + 4);
+                response->result = (int16_t)get16(frame + 8);
+                response->flags = get16(frame + 10);
+                response->data = frame + CARD_DAEMON_HEADER_SIZE;
+                response->length = length;
+                client->inputStart += CARD_DAEMON_HEADER_SIZE + length;
+                return CARD_SUCCESS;
+            }
+        }
+        
+        // Выданные ответы больше не нужны: неполный кадр переносится в начало буфера
+        if (client->inputStart > 0) {
+            memmove(client->input, frame, available);
+            client->inputStart = 0;
+            client->inputLength = available;
+        }
+        
+        int received = client_fill(client);
+        if (received < 0 || (received == 0 && client_wait(client, 0) != CARD_SUCCESS)) {
+            return CARD_ERROR_TRANSMIT_FAILED;
+        }
+    }
+}
+
+void card_daemon_client_close(CardDaemonClient* client) {
+    if (!client) {
+        return;
+    }
+    
+    if (client->input && client->socket != INVALID_SOCKET) {
+        closesocket(client->socket);
+    }
+    client->socket = INVALID_SOCKET;
+    free(client->input);
+    free(client->output);
+    client->input = NULL;
+    client->output = NULL;
+    client->isConnected = 0;
+    
+    if (client->winsockStarted) {
+        WSACleanup();
+        client->winsockStarted = 0;
+    }
+}
+
+/* ---- Репозиторий ---- */
+
+static CardDaemonClient* get_client(CardContext* context) {
+    if (!context || !context->context) {
+        return NULL;
+    }
+    CardDaemonClient* client = (CardDaemonClient*)context->context;
+    return client->input ? client : NULL;
+}
+
+/**
+ * Запрос с ожиданием ответа; клиент репозитория не держит других запросов в работе
+ */
+static int client_request(CardDaemonClient* client, CardDaemonOperation operation, size_t readerIndex,
+                          CardDaemonResponse* response) {
+    uint32_t id;
+    int result = card_daemon_client_submit(client, operation, readerIndex, 0, NULL, 0, &id);
+    if (result == CARD_SUCCESS) {
+        result = card_daemon_client_receive(client, response);
+    }
+    if (result == CARD_SUCCESS && response->id != id) {
+        result = CARD_ERROR_TRANSMIT_FAILED;
+    }
+    return result == CARD_SUCCESS ? response->result : result;
+}
+
+static int card_daemon_initialize(CardContext* context) {
+    if (!context || !context->context) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    CardDaemonClient* client = (CardDaemonClient*)context->context;
+    if (client->input) {
+        return CARD_SUCCESS;
+    }
+    return card_daemon_client_open(client, NULL);
+}
+
+static int card_daemon_list_readers(CardContext* context, char*** readers, size_t* readersCount) {
+    CardDaemonClient* client = get_client(context);
+    if (!client || !readers || !readersCount) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    CardDaemonResponse response;
+    int result = client_request(client, CARD_DAEMON_READERS, 0, &response);
+    if (result != CARD_SUCCESS) {
+        return result;
+    }
+    
+    size_t count = 0;
+    for (size_t i = 0; i < response.length; i++) {
+        count += response.data[i] == '\0';
+    }
+    
+    *readers = NULL;
+    *readersCount = count;
+    if (count == 0) {
+        return CARD_SUCCESS;
+    }
+    
+    // Массив указателей и имена одним блоком, как у winscard_list_readers
+    char** list = (char**)malloc(count * sizeof(char*) + response.length);
+    if (!list) {
+        return CARD_ERROR_MEMORY_ALLOCATION;
+    }
+    
+    char* names = (char*)(list + count);
+    memcpy(names, response.data, response.length);
+    for (size_t i = 0; i < count; i++) {
+        list[i] = names;
+        names += strlen(names) + 1;
+    }
+    
+    *readers = list;
+    return CARD_SUCCESS;
+}
+
+static int card_daemon_connect(CardContext* context, const char* readerName) {
+    CardDaemonClient* client = get_client(context);
+    if (!client || !readerName) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    CardDaemonResponse response;
+    int result = client_request(client, CARD_DAEMON_READERS, 0, &response);
+    if (result != CARD_SUCCESS) {
+        return result;
+    }
+    
+    size_t index = 0;
+    const char* name = (const char*)response.data;
+    const char* end = name + response.length;
+    while (name < end && strcmp(name, readerName) != 0) {
+        name += strlen(name) + 1;
+        index++;
+    }
+    if (name >= end) {
+        return CARD_ERROR_CONNECT_FAILED;
+    }
+    
+    // Демон держит карту подключённой; запрос сведений проверяет, что карта есть
+    result = client_request(client, CARD_DAEMON_INFO, index, &response);
+    client->readerIndex = index;
+    client->isConnected = result == CARD_SUCCESS;
+    return result == CARD_SUCCESS ? CARD_SUCCESS : CARD_ERROR_CONNECT_FAILED;
+}
+
+static int card_daemon_disconnect(CardContext* context) {
+    CardDaemonClient* client = get_client(context);
+    if (!client) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    client->isConnected = 0;
+    return CARD_SUCCESS;
+}
+
+static int card_daemon_release(CardContext* context) {
+    if (!context || !context->context) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    card_daemon_client_close((CardDaemonClient*)context->context);
+    return CARD_SUCCESS;
+}
+
+/**
+ * Копирование ответа демона в буфер вызывающего
+ */
+static int client_copy_response(const CardDaemonResponse* response, uint8_t* buffer, size_t* length) {
+    if (response->length > *length) {
+        *length = 0;
+        return CARD_ERROR_TRANSMIT_FAILED;
+    }
+    
+    memcpy(buffer, response->data, response->length);
+    *length = response->length;
+    return CARD_SUCCESS;
+}
+
+static int card_daemon_transmit(CardContext* context, const uint8_t* command, size_t commandLength,
+                                uint8_t* response, size_t* responseLength) {
+    CardDaemonClient* client = get_client(context);
+    if (!client || !command || !response || !responseLength) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    if (!client->isConnected) {
+        return CARD_ERROR_CONNECT_FAILED;
+    }
+    
+    uint32_t id;
+    CardDaemonResponse reply;
+    int result = card_daemon_client_submit_transmit(client, client->readerIndex, 0, command, commandLength,
+                                                    0, 0, &id);
+    if (result == CARD_SUCCESS) {
+        result = card_daemon_client_receive(client, &reply);
+    }
+    if (result == CARD_SUCCESS && reply.id != id) {
+        result = CARD_ERROR_TRANSMIT_FAILED;
+    }
+    if (result != CARD_SUCCESS) {
+        return result;
+    }
+    
+    // Статус карты разбирает сервис: неожиданный статус — тоже успешная передача
+    if (reply.result != CARD_SUCCESS && reply.result != CARD_ERROR_BAD_STATUS) {
+        return reply.result;
+    }
+    return client_copy_response(&reply, response, responseLength);
+}
+
+static int card_daemon_get_card_info(CardContext* context, CardInfo* info) {
+    CardDaemonClient* client = get_client(context);
+    if (!client || !info) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    if (!client->isConnected) {
+        return CARD_ERROR_CONNECT_FAILED;
+    }
+    
+    CardDaemonResponse response;
+    int result = client_request(client, CARD_DAEMON_INFO, client->readerIndex, &response);
+    if (result != CARD_SUCCESS) {
+        return result;
+    }
+    return card_daemon_get_info(response.data, response.length, info);
+}
+
+static int client_stops(CardBatchPolicy policy, int result) {
+    return result != CARD_SUCCESS &&
+           (policy == CARD_BATCH_STOP_ON_ERROR ||
+            (policy == CARD_BATCH_STOP_ON_TRANSMIT && result != CARD_ERROR_BAD_STATUS));
+}
+
+/**
+ * Пакет уходит демону одной записью как единица (CARD_DAEMON_FLAG_MORE):
+ * его команды не перемежаются с командами других клиентов, а правило
+ * остановки применяет сам демон. Пакет длиннее CARD_DAEMON_MAX_UNIT делится
+ * на единицы, которые отправляются по очереди; между ними считыватель может
+ * выполнить чужие запросы, а остановка единицы отменяет следующие.
+ */
+static int card_daemon_transmit_batch(CardContext* context, CardBatchItem* items, size_t count,
+                                      CardBatchPolicy policy, size_t* executed) {
+    if (executed) {
+        *executed = 0;
+    }
+    
+    CardDaemonClient* client = get_client(context);
+    if (!client || (!items && count > 0)) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    if (!client->isConnected) {
+        return CARD_ERROR_CONNECT_FAILED;
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        if (!items[i].command || !items[i].response) {
+            return CARD_ERROR_INVALID_PARAMETER;
+        }
+    }
+    
+    uint16_t flags = (uint16_t)(((unsigned)policy << CARD_DAEMON_FLAG_POLICY_SHIFT) & CARD_DAEMON_FLAG_POLICY_MASK);
+    int firstError = CARD_SUCCESS;
+    int isStopped = 0;
+    for (size_t start = 0; start < count && !isStopped; start += CARD_DAEMON_MAX_UNIT) {
+        size_t end = count - start > CARD_DAEMON_MAX_UNIT ? start + CARD_DAEMON_MAX_UNIT : count;
+        for (size_t i = start; i < end; i++) {
+            int result = card_daemon_client_submit_transmit(client, client->readerIndex,
+                                                            (uint16_t)(flags | (i + 1 < end ? CARD_DAEMON_FLAG_MORE : 0)),
+                                                            items[i].command, items[i].commandLength,
+                                                            items[i].expectedStatus, items[i].statusMask, NULL);
+            if (result != CARD_SUCCESS) {
+                return result;
+            }
+        }
+        
+        // Ответы одного считывателя приходят в порядке запросов; читаются все, даже пропущенные
+        for (size_t i = start; i < end; i++) {
+            CardDaemonResponse response;
+            int result = card_daemon_client_receive(client, &response);
+            if (result != CARD_SUCCESS) {
+                return result;
+            }
+            
+            CardBatchItem* item = &items[i];
+            if (response.flags & CARD_DAEMON_RESPONSE_SKIPPED) {
+                item->responseLength = 0;
+                isStopped = 1;
+                continue;
+            }
+            
+            item->result = response.result;
+            if (item->result == CARD_SUCCESS || item->result == CARD_ERROR_BAD_STATUS) {
+                if (client_copy_response(&response, item->response, &item->responseLength) != CARD_SUCCESS) {
+                    item->result = CARD_ERROR_TRANSMIT_FAILED;
+                }
+            } else {
+                item->responseLength = 0;
+            }
+            
+            if (executed) {
+                *executed = i + 1;
+            }
+            if (firstError == CARD_SUCCESS) {
+                firstError = item->result;
+            }
+            isStopped |= client_stops(policy, item->result);
+        }
+    }
+    
+    return firstError;
+}
+
+CardRepository card_daemon_create_repository(void) {
+    CardRepository repository = {
+        .initialize = card_daemon_initialize,
+        .list_readers = card_daemon_list_readers,
+        .connect = card_daemon_connect,
+        .disconnect = card_daemon_disconnect,
+        .release = card_daemon_release,
+        .transmit = card_daemon_transmit,
+        .get_info = card_daemon_get_card_info,
+        .transmit_batch = card_daemon_transmit_batch,
+        .reconnect = NULL,
+        .disconnect_with = NULL
+    };
+    
+    return repository;
+} 
\ No newline at end of file
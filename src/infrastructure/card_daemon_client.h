@@ -0,0 +1,112 @@
+#ifndef CARD_DAEMON_CLIENT_H
+#define CARD_DAEMON_CLIENT_H
+
+#include "card_daemon.h"
+
+/**
+ * Слой инфраструктуры (Infrastructure Layer)
+ * Клиент демона доступа к картам (card_daemon.h). Запросы копятся в буфере
+ * и уходят одной записью в сокет при чтении ответа или card_daemon_client_flush,
+ * поэтому пакет команд стоит одного обмена с демоном. Пока запросы уходят,
+ * клиент принимает готовые ответы: демон не читает запросы клиента, который
+ * не забирает ответы, и длинный конвейер иначе остановился бы. Репозиторий
+ * card_daemon_create_repository позволяет работать с картой через CardService,
+ * не устанавливая собственных контекстов PC/SC.
+ */
+
+/**
+ * Подключение к демону; контекст репозитория card_daemon_create_repository
+ */
+typedef struct {
+    SOCKET socket;
+    int winsockStarted;
+    uint32_t nextId;
+    uint8_t* input;                  /* Принятые данные */
+    size_t inputStart;               /* Начало ещё не выданных кадров */
+    size_t inputLength;
+    size_t inputCapacity;            /* Растёт, если ответы приходят во время отправки */
+    uint8_t* output;                 /* Кадры, ещё не отправленные демону */
+    size_t outputLength;
+    size_t readerIndex;              /* Считыватель, выбранный connect репозитория */
+    int isConnected;
+} CardDaemonClient;
+
+/**
+ * Ответ демона; данные действительны до следующего вызова функций клиента
+ */
+typedef struct {
+    uint32_t id;
+    int result;                      /* Код ошибки из CardError */
+    uint16_t flags;                  /* CARD_DAEMON_RESPONSE_* */
+    const uint8_t* data;
+    size_t length;
+} CardDaemonResponse;
+
+/**
+ * Подключение к демону
+ * @param client Структура клиента (память вызывающего)
+ * @param path Путь к сокету демона, NULL — путь по умолчанию
+ * @return Код ошибки из CardError
+ */
+int card_daemon_client_open(CardDaemonClient* client, const char* path);
+
+/**
+ * Постановка запроса в буфер отправки
+ * @param client Подключённый клиент
+ * @param operation Операция CardDaemonOperation
+ * @param readerIndex Номер считывателя в списке демона
+ * @param flags Флаги CARD_DAEMON_FLAG_*
+ * @param data Данные запроса (для CARD_DAEMON_TRANSMIT — с ожидаемым статусом и маской)
+ * @param length Длина данных
+ * @param id Номер запроса (может быть NULL)
+ * @return Код ошибки из CardError
+ */
+int card_daemon_client_submit(CardDaemonClient* client, CardDaemonOperation operation, size_t readerIndex,
+                              uint16_t flags, const uint8_t* data, size_t length, uint32_t* id);
+
+/**
+ * Постановка команды в буфер отправки
+ * @param client Подключённый клиент
+ * @param readerIndex Номер считывателя в списке демона
+ * @param flags Флаги CARD_DAEMON_FLAG_*
+ * @param command Команда APDU
+ * @param length Длина команды
+ * @param expectedStatus Ожидаемый статус (как в CardBatchItem)
+ * @param statusMask Маска статуса, 0 — успехом считаются 90 00 и 61 XX
+ * @param id Номер запроса (может быть NULL)
+ * @return Код ошибки из CardError
+ */
+int card_daemon_client_submit_transmit(CardDaemonClient* client, size_t readerIndex, uint16_t flags,
+                                       const uint8_t* command, size_t length,
+                                       uint16_t expectedStatus, uint16_t statusMask, uint32_t* id);
+
+/**
+ * Отправка накопленных запросов
+ * @param client Подключённый клиент
+ * @return Код ошибки из CardError
+ */
+int card_daemon_client_flush(CardDaemonClient* client);
+
+/**
+ * Получение следующего ответа; накопленные запросы сначала отправляются
+ * @param client Подключённый клиент
+ * @param response Ответ
+ * @return CARD_SUCCESS или CARD_ERROR_TRANSMIT_FAILED при разрыве связи
+ */
+int card_daemon_client_receive(CardDaemonClient* client, CardDaemonResponse* response);
+
+/**
+ * Отключение от демона
+ * @param client Клиент
+ */
+void card_daemon_client_close(CardDaemonClient* client);
+
+/**
+ * Создание репозитория, работающего через демон
+ * Контекст — CardDaemonClient; если он не открыт card_daemon_client_open
+ * (структура обнулена), initialize подключается к сокету по умолчанию.
+ * @return Структура репозитория
+ */
+CardRepository card_daemon_create_repository(void);
+
+#endif /* CARD_DAEMON_CLIENT_H */ 
\ No newline at end of file
@@ -0,0 +1,355 @@
+#include "card_image.h"
+#include "card_profile.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static const uint8_t uidCommand[] = { 0xFF, 0xCA, 0x00, 0x00, 0x00 };
+
+static uint32_t crc32(const uint8_t* data, size_t length) {
+    uint32_t crc = 0xFFFFFFFFUL;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320UL & (0U - (crc & 1U)));
+        }
+    }
+    return ~crc;
+}
+
+static size_t align_up(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static size_t page_length(const CardImageHeader* header, size_t page) {
+    size_t start = page * header->pageSize;
+    size_t rest = header->memorySize - start;
+    return rest < header->pageSize ? rest : header->pageSize;
+}
+
+/* ---- Снятие образа ---- */
+
+/**
+ * Заголовок без сигнатуры: ATR, UID и профиль подключённой карты
+ */
+static void image_describe(CardService* service, CardImageHeader* header) {
+    CardInfo info;
+    memset(&info, 0, sizeof(info));
+    if (service->repository->get_info && service->repository->get_info(service->context, &info) == CARD_SUCCESS) {
+        header->atrLength = (uint8_t)(info.atrLength < CARD_IMAGE_MAX_ATR ? info.atrLength : CARD_IMAGE_MAX_ATR);
+        memcpy(header->atr, info.atr, header->atrLength);
+        
+        CardAtr parsed;
+        if (card_atr_parse(info.atr, info.atrLength, &parsed) == CARD_SUCCESS && parsed.isStorageCard) {
+            header->storageCardName = parsed.storageCardName;
+        }
+    }
+    
+    CardData command = { (uint8_t*)uidCommand, sizeof(uidCommand), NULL };
+    CardData response = { NULL, 0, NULL };
+    if (card_service_execute_command(service, &command, &response) == CARD_SUCCESS &&
+        response.length > 2 && response.length - 2 <= CARD_IMAGE_MAX_UID &&
+        response.data[response.length - 2] == 0x90 && response.data[response.length - 1] == 0x00) {
+        header->uidLength = (uint8_t)(response.length - 2);
+        memcpy(header->uid, response.data, header->uidLength);
+    }
+    card_data_release(&response);
+    
+    if (service->profile) {
+        strncpy(header->profileName, service->profile->name, CARD_IMAGE_PROFILE_NAME - 1);
+    }
+    header->createdAt = (uint64_t)time(NULL);
+}
+
+/**
+ * Чтение памяти в отображение: целиком, а при ошибке — по страницам
+ */
+static int image_read(CardService* service, CardImageHeader* header, CardImagePage* pages, uint8_t* data) {
+    int result = card_service_read_into(service, (uint16_t)header->baseOffset, data, header->memorySize);
+    int wholeRead = result == CARD_SUCCESS;
+    
+    for (size_t page = 0; page < header->pageCount; page++) {
+        uint8_t* pageData = data + page * header->pageSize;
+        size_t length = page_length(header, page);
+        
+        if (!wholeRead) {
+            result = card_service_read_into(service, (uint16_t)(header->baseOffset + page * header->pageSize),
+                                            pageData, length);
+            // Потеря карты прерывает снятие, отказ в доступе к странице — нет
+            if (result == CARD_ERROR_CONNECT_FAILED || result == CARD_ERROR_TRANSMIT_FAILED) {
+                return result;
+            }
+            if (result != CARD_SUCCESS) {
+                memset(pageData, 0, length);
+                pages[page].crc = crc32(pageData, length);
+                continue;
+            }
+        }
+        
+        pages[page].crc = crc32(pageData, length);
+        pages[page].flags = CARD_IMAGE_PAGE_PRESENT;
+        header->presentPages++;
+    }
+    
+    return header->presentPages > 0 ? CARD_SUCCESS : CARD_ERROR_BAD_STATUS;
+}
+
+int card_image_dump(CardService* service, const char* path, uint16_t offset, size_t length,
+                    CardImageStats* stats) {
+    if (!service || !service->repository || !path) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    if (length == 0 && service->profile && service->profile->memorySize > offset) {
+        length = service->profile->memorySize - offset;
+    }
+    if (length == 0 || (size_t)offset + length > CARD_SERVICE_MAX_OFFSET + 1) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    // Страница индекса — страница записи карты, но не мельче CARD_IMAGE_MIN_PAGE
+    size_t pageSize = service->profile ? service->profile->pageSize : 0;
+    if (pageSize < CARD_IMAGE_MIN_PAGE) {
+        pageSize = CARD_IMAGE_MIN_PAGE;
+    }
+    size_t pageCount = (length + pageSize - 1) / pageSize;
+    size_t dataOffset = align_up(CARD_IMAGE_HEADER_SIZE + pageCount * sizeof(CardImagePage), CARD_IMAGE_ALIGNMENT);
+    size_t size = dataOffset + length;
+    
+    HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                              CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        printf("Ошибка при создании файла образа: %lu\n", (unsigned long)GetLastError());
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    // Отображение заданного размера само увеличивает файл
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, 0, (DWORD)size, NULL);
+    uint8_t* view = mapping ? (uint8_t*)MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size) : NULL;
+    if (!view) {
+        printf("Ошибка при отображении файла образа: %lu\n", (unsigned long)GetLastError());
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    CardImageHeader* header = (CardImageHeader*)view;
+    CardImagePage* pages = (CardImagePage*)(view + CARD_IMAGE_HEADER_SIZE);
+    header->version = CARD_IMAGE_VERSION;
+    header->headerSize = CARD_IMAGE_HEADER_SIZE;
+    header->baseOffset = offset;
+    header->memorySize = (uint32_t)length;
+    header->pageSize = (uint32_t)pageSize;
+    header->pageCount = (uint32_t)pageCount;
+    header->indexOffset = CARD_IMAGE_HEADER_SIZE;
+    header->dataOffset = (uint32_t)dataOffset;
+    
+    image_describe(service, header);
+    int result = image_read(service, header, pages, view + dataOffset);
+    
+    if (result == CARD_SUCCESS) {
+        // Сигнатура — после данных и их сброса на диск
+        FlushViewOfFile(view, 0);
+        memcpy(header->magic, CARD_IMAGE_MAGIC, sizeof(header->magic));
+        if (!FlushViewOfFile(view, CARD_IMAGE_HEADER_SIZE) || !FlushFileBuffers(file)) {
+            result = CARD_ERROR_INIT_FAILED;
+        }
+    }
+    
+    if (stats) {
+        stats->bytes = length;
+        stats->pages = pageCount;
+        stats->missingPages = pageCount - header->presentPages;
+        stats->commands = 0;
+    }
+    
+    UnmapViewOfFile(view);
+    CloseHandle(mapping);
+    CloseHandle(file);
+    
+    return result;
+}
+
+/* ---- Открытие и сравнение ---- */
+
+int card_image_open(CardImage* image, const char* path) {
+    if (!image || !path) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    memset(image, 0, sizeof(CardImage));
+    
+    image->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (image->file == INVALID_HANDLE_VALUE) {
+        image->file = NULL;
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(image->file, &size) || size.QuadPart < CARD_IMAGE_HEADER_SIZE) {
+        card_image_close(image);
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    image->size = (size_t)size.QuadPart;
+    
+    image->mapping = CreateFileMappingA(image->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    const uint8_t* view = image->mapping ? (const uint8_t*)MapViewOfFile(image->mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (!view) {
+        card_image_close(image);
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    // Проверяются только границы: данные используются прямо из отображения
+    const CardImageHeader* header = (const CardImageHeader*)view;
+    image->header = header;
+    if (memcmp(header->magic, CARD_IMAGE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != CARD_IMAGE_VERSION || header->pageSize == 0 || header->memorySize == 0 ||
+        header->pageCount != (header->memorySize + header->pageSize - 1) / header->pageSize ||
+        header->atrLength > CARD_IMAGE_MAX_ATR || header->uidLength > CARD_IMAGE_MAX_UID ||
+        header->indexOffset < header->headerSize ||
+        (uint64_t)header->indexOffset + (uint64_t)header->pageCount * sizeof(CardImagePage) > header->dataOffset ||
+        (uint64_t)header->dataOffset + header->memorySize > image->size ||
+        (uint64_t)header->baseOffset + header->memorySize > CARD_SERVICE_MAX_OFFSET + 1) {
+        card_image_close(image);
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    image->pages = (const CardImagePage*)(view + header->indexOffset);
+    image->data = view + header->dataOffset;
+    
+    return CARD_SUCCESS;
+}
+
+int card_image_verify(const CardImage* image, size_t* badPage) {
+    if (!image || !image->header) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    const CardImageHeader* header = image->header;
+    for (size_t page = 0; page < header->pageCount; page++) {
+        if (crc32(image->data + page * header->pageSize, page_length(header, page)) != image->pages[page].crc) {
+            if (badPage) {
+                *badPage = page;
+            }
+            return CARD_ERROR_BAD_STATUS;
+        }
+    }
+    
+    return CARD_SUCCESS;
+}
+
+int card_image_diff(const CardImage* left, const CardImage* right,
+                    uint32_t* pages, size_t capacity, size_t* count) {
+    if (!left || !left->header || !right || !right->header || !count || (capacity > 0 && !pages)) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    const CardImageHeader* a = left->header;
+    const CardImageHeader* b = right->header;
+    if (a->baseOffset != b->baseOffset || a->memorySize != b->memorySize || a->pageSize != b->pageSize) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    // Страницы сравниваются по CRC индекса, данные не читаются
+    size_t found = 0;
+    for (size_t page = 0; page < a->pageCount; page++) {
+        const CardImagePage* x = &left->pages[page];
+        const CardImagePage* y = &right->pages[page];
+        if (x->crc == y->crc && x->flags == y->flags) {
+            continue;
+        }
+        if (found < capacity) {
+            pages[found] = (uint32_t)page;
+        }
+        found++;
+    }
+    
+    *count = found;
+    return CARD_SUCCESS;
+}
+
+/* ---- Восстановление ---- */
+
+int card_image_restore(CardService* service, const CardImage* image, int differential,
+                       CardImageStats* stats) {
+    if (!service || !service->repository || !image || !image->header) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    const CardImageHeader* header = image->header;
+    if (service->profile && header->baseOffset + header->memorySize > service->profile->memorySize) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    // Образ проверяется целиком до первой записи: повреждённая страница не должна попасть на карту
+    int result = card_image_verify(image, NULL);
+    if (result != CARD_SUCCESS) {
+        return result;
+    }
+    
+    CardImageStats total;
+    memset(&total, 0, sizeof(total));
+    total.pages = header->pageCount;
+    
+    size_t page = 0;
+    while (page < header->pageCount && result == CARD_SUCCESS) {
+        if (!(image->pages[page].flags & CARD_IMAGE_PAGE_PRESENT)) {
+            total.missingPages++;
+            page++;
+            continue;
+        }
+        
+        // Непрерывный участок прочитанных страниц уходит одной операцией
+        size_t first = page;
+        size_t length = 0;
+        while (page < header->pageCount && (image->pages[page].flags & CARD_IMAGE_PAGE_PRESENT)) {
+            length += page_length(header, page);
+            page++;
+        }
+        
+        uint16_t address = (uint16_t)(header->baseOffset + first * header->pageSize);
+        const uint8_t* data = image->data + first * header->pageSize;
+        
+        if (differential) {
+            CardData target = { (uint8_t*)data, length, NULL };
+            CardSyncStats syncStats;
+            result = card_sync_image(service, address, &target, NULL, CARD_SYNC_DEFAULT_MERGE_GAP, &syncStats);
+            if (result == CARD_SUCCESS) {
+                total.bytes += syncStats.writtenBytes;
+                total.commands += syncStats.commandCount;
+            }
+        } else {
+            result = card_service_write_from(service, address, data, length);
+            if (result == CARD_SUCCESS) {
+                total.bytes += length;
+            }
+        }
+    }
+    
+    if (stats) {
+        *stats = total;
+    }
+    return result;
+}
+
+int card_image_close(CardImage* image) {
+    if (!image) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    if (image->header) {
+        UnmapViewOfFile((LPVOID)image->header);
+    }
+    if (image->mapping) {
+        CloseHandle(image->mapping);
+    }
+    if (image->file) {
+        CloseHandle(image->file);
+    }
+    memset(image, 0, sizeof(CardImage));
+    
+    return CARD_SUCCESS;
+} 
\ No newline at end of file
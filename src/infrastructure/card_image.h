@@ -0,0 +1,147 @@
+#ifndef CARD_IMAGE_H
+#define CARD_IMAGE_H
+
+#include <windows.h>
+#include <stdint.h>
+#include "card_domain.h"
+#include "card_service.h"
+#include "card_sync.h"
+
+/**
+ * Слой инфраструктуры (Infrastructure Layer)
+ * Снимок памяти карты в файле, который открывается отображением в память
+ * без разбора и копирования. Файл: заголовок (ATR, UID, профиль, адрес и
+ * размер образа), индекс страниц с CRC32 каждой страницы и данные,
+ * выровненные по CARD_IMAGE_ALIGNMENT. Образы сравниваются по индексу,
+ * не читая данные; восстановление пишет данные из отображения напрямую.
+ * Утилита командной строки — src/tools/card_dump.c.
+ */
+
+#define CARD_IMAGE_MAGIC "CARDIMG1"
+#define CARD_IMAGE_VERSION 1
+#define CARD_IMAGE_HEADER_SIZE 256
+#define CARD_IMAGE_ALIGNMENT 4096
+#define CARD_IMAGE_MIN_PAGE 16          /* Наименьшая страница индекса */
+#define CARD_IMAGE_MAX_ATR 36
+#define CARD_IMAGE_MAX_UID 12
+#define CARD_IMAGE_PROFILE_NAME 32
+
+#define CARD_IMAGE_PAGE_PRESENT 0x0001  /* Страница прочитана; иначе заполнена нулями */
+
+/**
+ * Заголовок файла образа (CARD_IMAGE_HEADER_SIZE байт, остаток — нули)
+ */
+typedef struct {
+    char magic[8];                  /* Записывается последним: неполный файл не открывается */
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t baseOffset;            /* Адрес начала образа в памяти карты */
+    uint32_t memorySize;            /* Байт в образе */
+    uint32_t pageSize;
+    uint32_t pageCount;
+    uint32_t presentPages;
+    uint32_t indexOffset;           /* Смещение индекса страниц в файле */
+    uint32_t dataOffset;            /* Смещение данных в файле */
+    uint16_t storageCardName;       /* Имя карты PC/SC часть 3, 0 — неизвестно */
+    uint8_t atrLength;
+    uint8_t uidLength;
+    uint64_t createdAt;             /* Время снятия образа, секунды с 1970 года */
+    uint8_t atr[CARD_IMAGE_MAX_ATR];
+    uint8_t uid[CARD_IMAGE_MAX_UID];
+    char profileName[CARD_IMAGE_PROFILE_NAME];
+} CardImageHeader;
+
+/**
+ * Элемент индекса страниц
+ */
+typedef struct {
+    uint32_t crc;                   /* CRC32 данных страницы */
+    uint32_t flags;                 /* CARD_IMAGE_PAGE_* */
+} CardImagePage;
+
+/**
+ * Открытый образ; все указатели ведут в отображение файла
+ */
+typedef struct {
+    HANDLE file;
+    HANDLE mapping;
+    const CardImageHeader* header;
+    const CardImagePage* pages;
+    const uint8_t* data;
+    size_t size;                    /* Размер файла */
+} CardImage;
+
+typedef struct {
+    size_t bytes;                   /* Байт прочитано или записано */
+    size_t pages;                   /* Страниц в образе */
+    size_t missingPages;            /* Страниц, не прочитанных при снятии или пропущенных при восстановлении */
+    size_t commands;                /* Команд записи при разностном восстановлении */
+} CardImageStats;
+
+/**
+ * Снятие образа памяти подключённой карты
+ * Память читается наибольшими блоками, которые допускают карта и считыватель,
+ * прямо в отображение файла. Если блок не читается (защищённые сектора),
+ * чтение повторяется по страницам, а непрочитанные страницы отмечаются в индексе.
+ * @param service Сервис, подключённый к карте
+ * @param path Путь к файлу образа, существующий файл перезаписывается
+ * @param offset Адрес начала образа в памяти карты
+ * @param length Длина образа; 0 — до конца памяти по профилю карты
+ * @param stats Статистика (может быть NULL)
+ * @return Код ошибки из CardError
+ */
+int card_image_dump(CardService* service, const char* path, uint16_t offset, size_t length,
+                    CardImageStats* stats);
+
+/**
+ * Открытие образа отображением в память (только чтение)
+ * @param image Структура образа (память вызывающего)
+ * @param path Путь к файлу образа
+ * @return CARD_SUCCESS или CARD_ERROR_INVALID_PARAMETER для повреждённого файла
+ */
+int card_image_open(CardImage* image, const char* path);
+
+/**
+ * Проверка данных образа по CRC32 индекса страниц
+ * @param image Открытый образ
+ * @param badPage Номер первой повреждённой страницы (может быть NULL)
+ * @return CARD_SUCCESS или CARD_ERROR_BAD_STATUS
+ */
+int card_image_verify(const CardImage* image, size_t* badPage);
+
+/**
+ * Сравнение двух образов одной области памяти по индексам страниц
+ * @param left Первый образ
+ * @param right Второй образ
+ * @param pages Массив для номеров различающихся страниц (может быть NULL)
+ * @param capacity Размер массива
+ * @param count Число различающихся страниц (может превышать capacity)
+ * @return CARD_SUCCESS или CARD_ERROR_INVALID_PARAMETER для образов разных областей
+ */
+int card_image_diff(const CardImage* left, const CardImage* right,
+                    uint32_t* pages, size_t capacity, size_t* count);
+
+/**
+ * Запись образа на подключённую карту
+ * Прочитанные страницы записываются непрерывными участками наибольшими
+ * блоками. В разностном режиме участок сначала читается с карты, и
+ * записываются только отличающиеся диапазоны (card_sync_image).
+ * Перед записью образ проверяется по CRC32 страниц (card_image_verify),
+ * повреждённый образ на карту не записывается.
+ * @param service Сервис, подключённый к карте
+ * @param image Открытый образ
+ * @param differential 1 — записывать только отличия
+ * @param stats Статистика (может быть NULL)
+ * @return Код ошибки из CardError; CARD_ERROR_BAD_STATUS для повреждённого образа
+ */
+int card_image_restore(CardService* service, const CardImage* image, int differential,
+                       CardImageStats* stats);
+
+/**
+ * Закрытие образа
+ * @param image Открытый образ
+ * @return Код ошибки из CardError
+ */
+int card_image_close(CardImage* image);
+
+#endif /* CARD_IMAGE_H */ 
\ No newline at end of file
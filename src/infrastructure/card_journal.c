@@ -0,0 +1,644 @@
+#include "card_journal.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define JOURNAL_MAGIC_LENGTH 8
+#define JOURNAL_MIN_CAPACITY 256
+#define JOURNAL_READ_RECORDS 1024       /* Записей за одно чтение при открытии */
+
+static const uint8_t uidCommand[] = { 0xFF, 0xCA, 0x00, 0x00, 0x00 };
+
+static void put32(uint8_t* target, uint32_t value) {
+    target[0] = (uint8_t)value;
+    target[1] = (uint8_t)(value >> 8);
+    target[2] = (uint8_t)(value >> 16);
+    target[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t get32(const uint8_t* source) {
+    return (uint32_t)source[0] | ((uint32_t)source[1] << 8) |
+           ((uint32_t)source[2] << 16) | ((uint32_t)source[3] << 24);
+}
+
+static uint32_t crc32(const uint8_t* data, size_t length) {
+    uint32_t crc = 0xFFFFFFFFUL;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320UL & (0U - (crc & 1U)));
+        }
+    }
+    return ~crc;
+}
+
+static uint64_t fnv1a(uint64_t hash, const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+static uint64_t data_hash(const uint8_t* data, size_t length) {
+    return fnv1a(0xCBF29CE484222325ULL, data, length);
+}
+
+/* ---- Индекс диапазонов ---- */
+
+static uint64_t range_key(const uint8_t* uid, size_t uidLength, uint16_t offset, uint32_t length) {
+    uint8_t range[6];
+    range[0] = (uint8_t)offset;
+    range[1] = (uint8_t)(offset >> 8);
+    put32(range + 2, length);
+    
+    uint64_t key = fnv1a(data_hash(uid, uidLength), range, sizeof(range));
+    return key ? key : 1;
+}
+
+static CardJournalEntry* index_find(CardJournal* journal, const uint8_t* uid, size_t uidLength,
+                                    uint16_t offset, uint32_t length, uint64_t key) {
+    size_t mask = journal->capacity - 1;
+    for (size_t i = (size_t)key & mask;; i = (i + 1) & mask) {
+        CardJournalEntry* entry = &journal->entries[i];
+        if (entry->key == 0) {
+            return entry;
+        }
+        if (entry->key == key && entry->offset == offset && entry->length == length &&
+            entry->uidLength == uidLength && memcmp(entry->uid, uid, uidLength) == 0) {
+            return entry;
+        }
+    }
+}
+
+static int index_grow(CardJournal* journal) {
+    size_t capacity = journal->capacity ? journal->capacity * 2 : JOURNAL_MIN_CAPACITY;
+    CardJournalEntry* entries = (CardJournalEntry*)calloc(capacity, sizeof(CardJournalEntry));
+    if (!entries) {
+        return CARD_ERROR_MEMORY_ALLOCATION;
+    }
+    
+    CardJournalEntry* old = journal->entries;
+    size_t oldCapacity = journal->capacity;
+    journal->entries = entries;
+    journal->capacity = capacity;
+    
+    for (size_t i = 0; i < oldCapacity; i++) {
+        if (old[i].key != 0) {
+            *index_find(journal, old[i].uid, old[i].uidLength, old[i].offset, old[i].length, old[i].key) = old[i];
+        }
+    }
+    
+    free(old);
+    return CARD_SUCCESS;
+}
+
+/**
+ * Новое состояние диапазона; последняя запись о диапазоне заменяет предыдущую
+ */
+static int index_update(CardJournal* journal, const uint8_t* uid, size_t uidLength, uint16_t offset,
+                        uint32_t length, uint64_t hash, CardJournalState state) {
+    // Заполнение не больше половины: цепочки поиска остаются короткими
+    if ((journal->count + 1) * 2 > journal->capacity) {
+        int result = index_grow(journal);
+        if (result != CARD_SUCCESS) {
+            return result;
+        }
+    }
+    
+    uint64_t key = range_key(uid, uidLength, offset, length);
+    CardJournalEntry* entry = index_find(journal, uid, uidLength, offset, length, key);
+    if (entry->key == 0) {
+        entry->key = key;
+        memcpy(entry->uid, uid, uidLength);
+        entry->uidLength = (uint8_t)uidLength;
+        entry->offset = offset;
+        entry->length = length;
+        journal->count++;
+    }
+    entry->state = (uint8_t)state;
+    entry->dataHash = hash;
+    
+    return CARD_SUCCESS;
+}
+
+static int index_is_confirmed(CardJournal* journal, const CardJournalCard* card, uint16_t offset,
+                              uint32_t length, uint64_t hash) {
+    uint64_t key = range_key(card->uid, card->uidLength, offset, length);
+    CardJournalEntry* entry = index_find(journal, card->uid, card->uidLength, offset, length, key);
+    return entry->key != 0 && entry->state == CARD_JOURNAL_CONFIRMED && entry->dataHash == hash;
+}
+
+/* ---- Формат записи ---- */
+
+/**
+ * Запись журнала: тип, длина UID, адрес, длина, хэш данных, UID, CRC32
+ */
+static void encode_record(uint8_t* record, CardJournalState state, const CardJournalCard* card,
+                          uint16_t offset, uint32_t length, uint64_t hash) {
+    memset(record, 0, CARD_JOURNAL_RECORD_SIZE);
+    record[0] = (uint8_t)state;
+    record[1] = (uint8_t)card->uidLength;
+    put32(record + 4, offset);
+    put32(record + 8, length);
+    put32(record + 12, (uint32_t)hash);
+    put32(record + 16, (uint32_t)(hash >> 32));
+    memcpy(record + 20, card->uid, card->uidLength);
+    put32(record + 32, crc32(record, 32));
+}
+
+static int decode_record(CardJournal* journal, const uint8_t* record) {
+    uint8_t state = record[0];
+    size_t uidLength = record[1];
+    uint32_t offset = get32(record + 4);
+    
+    if (get32(record + 32) != crc32(record, 32) || uidLength == 0 || uidLength > CARD_JOURNAL_MAX_UID ||
+        offset > CARD_SERVICE_MAX_OFFSET ||
+        (state != CARD_JOURNAL_PLANNED && state != CARD_JOURNAL_CONFIRMED)) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    uint64_t hash = (uint64_t)get32(record + 12) | ((uint64_t)get32(record + 16) << 32);
+    return index_update(journal, record + 20, uidLength, (uint16_t)offset, get32(record + 8),
+                        hash, (CardJournalState)state);
+}
+
+/* ---- Групповой сброс ---- */
+
+/**
+ * Добавление записи в буфер, вызывается под блокировкой
+ * Если буфер заполнен, ожидает, пока поток сброса заберёт его.
+ */
+static void journal_append(CardJournal* journal, const uint8_t* record) {
+    while (journal->activeLength + CARD_JOURNAL_RECORD_SIZE > journal->config.bufferSize &&
+           !journal->writeFailed) {
+        journal->syncRequested = 1;
+        WakeConditionVariable(&journal->commitRequested);
+        SleepConditionVariableCS(&journal->committed, &journal->lock, INFINITE);
+    }
+    
+    if (journal->writeFailed) {
+        return;
+    }
+    
+    // Первая запись в пустом буфере открывает окно группового сброса
+    if (journal->activeLength == 0) {
+        WakeConditionVariable(&journal->commitRequested);
+    }
+    
+    memcpy(journal->active + journal->activeLength, record, CARD_JOURNAL_RECORD_SIZE);
+    journal->activeLength += CARD_JOURNAL_RECORD_SIZE;
+    journal->appended++;
+    journal->stats.records++;
+}
+
+static DWORD WINAPI journal_commit_thread(LPVOID parameter) {
+    CardJournal* journal = (CardJournal*)parameter;
+    
+    EnterCriticalSection(&journal->lock);
+    for (;;) {
+        while (journal->activeLength == 0 && !journal->isStopping) {
+            SleepConditionVariableCS(&journal->commitRequested, &journal->lock, INFINITE);
+        }
+        if (journal->activeLength == 0) {
+            break;
+        }
+        
+        // Окно группы: записи других потоков за commitInterval уходят одним сбросом
+        if (!journal->syncRequested && !journal->isStopping) {
+            SleepConditionVariableCS(&journal->commitRequested, &journal->lock, journal->config.commitInterval);
+        }
+        
+        uint8_t* buffer = journal->active;
+        size_t length = journal->activeLength;
+        uint64_t target = journal->appended;
+        journal->active = journal->flushing;
+        journal->flushing = buffer;
+        journal->activeLength = 0;
+        journal->syncRequested = 0;
+        WakeAllConditionVariable(&journal->committed);
+        LeaveCriticalSection(&journal->lock);
+        
+        DWORD written = 0;
+        BOOL isWritten = WriteFile(journal->file, buffer, (DWORD)length, &written, NULL) &&
+                         written == (DWORD)length && FlushFileBuffers(journal->file);
+        
+        EnterCriticalSection(&journal->lock);
+        if (isWritten) {
+            journal->durable = target;
+            journal->stats.commits++;
+        } else {
+            printf("Ошибка при записи журнала: %lu\n", (unsigned long)GetLastError());
+            journal->writeFailed = 1;
+        }
+        WakeAllConditionVariable(&journal->committed);
+    }
+    LeaveCriticalSection(&journal->lock);
+    
+    return 0;
+}
+
+/* ---- Открытие ---- */
+
+static int journal_load(CardJournal* journal) {
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(journal->file, &size)) {
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    // Новый журнал начинается с сигнатуры
+    if (size.QuadPart == 0) {
+        DWORD written = 0;
+        if (!WriteFile(journal->file, CARD_JOURNAL_MAGIC, JOURNAL_MAGIC_LENGTH, &written, NULL) ||
+            written != JOURNAL_MAGIC_LENGTH || !FlushFileBuffers(journal->file)) {
+            return CARD_ERROR_INIT_FAILED;
+        }
+        return CARD_SUCCESS;
+    }
+    
+    uint8_t magic[JOURNAL_MAGIC_LENGTH];
+    DWORD read = 0;
+    if (!ReadFile(journal->file, magic, JOURNAL_MAGIC_LENGTH, &read, NULL) ||
+        read != JOURNAL_MAGIC_LENGTH || memcmp(magic, CARD_JOURNAL_MAGIC, JOURNAL_MAGIC_LENGTH) != 0) {
+        printf("Файл не является журналом записи\n");
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    uint8_t* buffer = (uint8_t*)malloc(JOURNAL_READ_RECORDS * CARD_JOURNAL_RECORD_SIZE);
+    if (!buffer) {
+        return CARD_ERROR_MEMORY_ALLOCATION;
+    }
+    
+    // Чтение до первой неполной или повреждённой записи
+    uint64_t valid = JOURNAL_MAGIC_LENGTH;
+    int isTail = 0;
+    while (!isTail) {
+        if (!ReadFile(journal->file, buffer, JOURNAL_READ_RECORDS * CARD_JOURNAL_RECORD_SIZE, &read, NULL)) {
+            free(buffer);
+            return CARD_ERROR_INIT_FAILED;
+        }
+        if (read == 0) {
+            break;
+        }
+        
+        for (size_t position = 0; position < read; position += CARD_JOURNAL_RECORD_SIZE) {
+            if (read - position < CARD_JOURNAL_RECORD_SIZE) {
+                isTail = 1;
+                break;
+            }
+            int result = decode_record(journal, buffer + position);
+            if (result == CARD_ERROR_MEMORY_ALLOCATION) {
+                free(buffer);
+                return result;
+            }
+            if (result != CARD_SUCCESS) {
+                isTail = 1;
+                break;
+            }
+            valid += CARD_JOURNAL_RECORD_SIZE;
+            journal->stats.loaded++;
+        }
+    }
+    free(buffer);
+    
+    // Хвост, оборванный сбоем, отрезается: новые записи идут сразу за последней целой
+    journal->stats.truncated = (size_t)((uint64_t)size.QuadPart - valid);
+    LARGE_INTEGER position;
+    position.QuadPart = (LONGLONG)valid;
+    if (!SetFilePointerEx(journal->file, position, NULL, FILE_BEGIN) ||
+        (journal->stats.truncated > 0 && !SetEndOfFile(journal->file))) {
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    return CARD_SUCCESS;
+}
+
+static void journal_free(CardJournal* journal) {
+    if (journal->file) {
+        CloseHandle(journal->file);
+    }
+    free(journal->active);
+    free(journal->flushing);
+    free(journal->entries);
+    journal->file = NULL;
+    journal->active = NULL;
+    journal->flushing = NULL;
+    journal->entries = NULL;
+}
+
+void card_journal_default_config(CardJournalConfig* config) {
+    if (!config) {
+        return;
+    }
+    
+    config->resume = 1;
+    config->commitInterval = CARD_JOURNAL_DEFAULT_INTERVAL;
+    config->bufferSize = CARD_JOURNAL_DEFAULT_BUFFER;
+}
+
+int card_journal_open(CardJournal* journal, const char* path, const CardJournalConfig* config) {
+    if (!journal || !path) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    memset(journal, 0, sizeof(CardJournal));
+    card_journal_default_config(&journal->config);
+    if (config) {
+        journal->config = *config;
+    }
+    if (journal->config.bufferSize < CARD_JOURNAL_RECORD_SIZE) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    journal->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                                OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (journal->file == INVALID_HANDLE_VALUE) {
+        printf("Ошибка при открытии журнала: %lu\n", (unsigned long)GetLastError());
+        journal->file = NULL;
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    journal->active = (uint8_t*)malloc(journal->config.bufferSize);
+    journal->flushing = (uint8_t*)malloc(journal->config.bufferSize);
+    int result = journal->active && journal->flushing ? index_grow(journal) : CARD_ERROR_MEMORY_ALLOCATION;
+    if (result == CARD_SUCCESS) {
+        result = journal_load(journal);
+    }
+    if (result != CARD_SUCCESS) {
+        journal_free(journal);
+        return result;
+    }
+    
+    InitializeCriticalSection(&journal->lock);
+    InitializeConditionVariable(&journal->commitRequested);
+    InitializeConditionVariable(&journal->committed);
+    
+    journal->thread = CreateThread(NULL, 0, journal_commit_thread, journal, 0, NULL);
+    if (!journal->thread) {
+        DeleteCriticalSection(&journal->lock);
+        journal_free(journal);
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    return CARD_SUCCESS;
+}
+
+/* ---- Запись на карту ---- */
+
+int card_journal_identify(CardService* service, CardJournalCard* card) {
+    if (!service || !card) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    CardData command = { (uint8_t*)uidCommand, sizeof(uidCommand), NULL };
+    CardData response = { NULL, 0, NULL };
+    
+    int result = card_service_execute_command(service, &command, &response);
+    if (result == CARD_SUCCESS) {
+        if (response.length < 3 || response.length - 2 > CARD_JOURNAL_MAX_UID ||
+            response.data[response.length - 2] != 0x90 || response.data[response.length - 1] != 0x00) {
+            result = CARD_ERROR_BAD_STATUS;
+        } else {
+            card->uidLength = response.length - 2;
+            memcpy(card->uid, response.data, card->uidLength);
+        }
+    }
+    
+    card_data_release(&response);
+    return result;
+}
+
+static int journal_card_valid(const CardJournalCard* card) {
+    return card && card->uidLength > 0 && card->uidLength <= CARD_JOURNAL_MAX_UID;
+}
+
+int card_journal_is_confirmed(CardJournal* journal, const CardJournalCard* card, uint16_t offset,
+                              const uint8_t* data, size_t length) {
+    if (!journal || !journal->thread || !journal_card_valid(card) || !data) {
+        return 0;
+    }
+    
+    uint64_t hash = data_hash(data, length);
+    
+    EnterCriticalSection(&journal->lock);
+    int confirmed = index_is_confirmed(journal, card, offset, (uint32_t)length, hash);
+    LeaveCriticalSection(&journal->lock);
+    
+    return confirmed;
+}
+
+/**
+ * Отметка состояния диапазона в индексе и в журнале
+ */
+static int journal_mark(CardJournal* journal, const CardJournalCard* card, uint16_t offset,
+                        size_t length, uint64_t hash, CardJournalState state) {
+    uint8_t record[CARD_JOURNAL_RECORD_SIZE];
+    encode_record(record, state, card, offset, (uint32_t)length, hash);
+    
+    EnterCriticalSection(&journal->lock);
+    int result = index_update(journal, card->uid, card->uidLength, offset, (uint32_t)length, hash, state);
+    if (result == CARD_SUCCESS) {
+        journal_append(journal, record);
+        if (journal->writeFailed) {
+            result = CARD_ERROR_INIT_FAILED;
+        }
+    }
+    LeaveCriticalSection(&journal->lock);
+    
+    return result;
+}
+
+/**
+ * Пропуск подтверждённого диапазона или запись о плане
+ * @return CARD_SUCCESS и признак пропуска или код ошибки из CardError
+ */
+static int journal_plan(CardJournal* journal, const CardJournalCard* card, uint16_t offset,
+                        const uint8_t* data, size_t length, uint64_t* hash, int* skipped) {
+    *hash = data_hash(data, length);
+    *skipped = 0;
+    
+    if (journal->config.resume) {
+        EnterCriticalSection(&journal->lock);
+        *skipped = index_is_confirmed(journal, card, offset, (uint32_t)length, *hash);
+        if (*skipped) {
+            journal->stats.skipped++;
+        }
+        LeaveCriticalSection(&journal->lock);
+        
+        if (*skipped) {
+            return CARD_SUCCESS;
+        }
+    }
+    
+    return journal_mark(journal, card, offset, length, *hash, CARD_JOURNAL_PLANNED);
+}
+
+/**
+ * Запись на карту и подтверждение в журнале
+ */
+static int journal_perform(CardJournal* journal, CardService* service, const CardJournalCard* card,
+                           uint16_t offset, const uint8_t* data, size_t length, uint64_t hash) {
+    int result = card_service_write_from(service, offset, data, length);
+    if (result != CARD_SUCCESS) {
+        return result;
+    }
+    
+    result = journal_mark(journal, card, offset, length, hash, CARD_JOURNAL_CONFIRMED);
+    if (result == CARD_SUCCESS) {
+        EnterCriticalSection(&journal->lock);
+        journal->stats.written++;
+        LeaveCriticalSection(&journal->lock);
+    }
+    
+    return result;
+}
+
+static int journal_write_valid(CardJournal* journal, CardService* service, const CardJournalCard* card,
+                               uint16_t offset, const uint8_t* data, size_t length) {
+    return journal && journal->thread && service && journal_card_valid(card) && data && length > 0 &&
+           (size_t)offset + length <= CARD_SERVICE_MAX_OFFSET + 1;
+}
+
+int card_journal_write(CardJournal* journal, CardService* service, const CardJournalCard* card,
+                       uint16_t offset, const uint8_t* data, size_t length, int* skipped) {
+    if (!journal_write_valid(journal, service, card, offset, data, length)) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    uint64_t hash = 0;
+    int isSkipped = 0;
+    int result = journal_plan(journal, card, offset, data, length, &hash, &isSkipped);
+    
+    if (result == CARD_SUCCESS && !isSkipped) {
+        result = journal_perform(journal, service, card, offset, data, length, hash);
+    }
+    
+    if (skipped) {
+        *skipped = isSkipped;
+    }
+    return result;
+}
+
+int card_journal_write_batch(CardJournal* journal, CardService* service, const CardJournalCard* card,
+                             CardJournalWrite* writes, size_t count, int stopOnError, size_t* executed) {
+    if (executed) {
+        *executed = 0;
+    }
+    if (!journal || !journal->thread || !service || !journal_card_valid(card) || !writes) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        if (!journal_write_valid(journal, service, card, writes[i].offset, writes[i].data, writes[i].length)) {
+            return CARD_ERROR_INVALID_PARAMETER;
+        }
+    }
+    
+    // Сначала планы: после сбоя видно весь пакет, а не только начатые диапазоны
+    uint64_t* hashes = (uint64_t*)malloc((count > 0 ? count : 1) * sizeof(uint64_t));
+    if (!hashes) {
+        return CARD_ERROR_MEMORY_ALLOCATION;
+    }
+    
+    int firstError = CARD_SUCCESS;
+    for (size_t i = 0; i < count; i++) {
+        writes[i].result = journal_plan(journal, card, writes[i].offset, writes[i].data, writes[i].length,
+                                        &hashes[i], &writes[i].skipped);
+        if (writes[i].result != CARD_SUCCESS) {
+            free(hashes);
+            return writes[i].result;
+        }
+    }
+    
+    size_t done = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!writes[i].skipped) {
+            writes[i].result = journal_perform(journal, service, card, writes[i].offset, writes[i].data,
+                                               writes[i].length, hashes[i]);
+        }
+        done++;
+        
+        if (writes[i].result != CARD_SUCCESS && firstError == CARD_SUCCESS) {
+            firstError = writes[i].result;
+            if (stopOnError) {
+                break;
+            }
+        }
+    }
+    
+    free(hashes);
+    if (executed) {
+        *executed = done;
+    }
+    return firstError;
+}
+
+int card_journal_unconfirmed(CardJournal* journal, const CardJournalCard* card,
+                             CardJournalRange* ranges, size_t capacity, size_t* count) {
+    if (!journal || !journal->thread || !journal_card_valid(card) || !count || (capacity > 0 && !ranges)) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    size_t found = 0;
+    
+    EnterCriticalSection(&journal->lock);
+    for (size_t i = 0; i < journal->capacity; i++) {
+        const CardJournalEntry* entry = &journal->entries[i];
+        if (entry->key == 0 || entry->state != CARD_JOURNAL_PLANNED || entry->uidLength != card->uidLength ||
+            memcmp(entry->uid, card->uid, card->uidLength) != 0) {
+            continue;
+        }
+        if (found < capacity) {
+            ranges[found].offset = entry->offset;
+            ranges[found].length = entry->length;
+            ranges[found].dataHash = entry->dataHash;
+        }
+        found++;
+    }
+    LeaveCriticalSection(&journal->lock);
+    
+    *count = found;
+    return CARD_SUCCESS;
+}
+
+int card_journal_sync(CardJournal* journal) {
+    if (!journal || !journal->thread) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    EnterCriticalSection(&journal->lock);
+    uint64_t target = journal->appended;
+    if (journal->durable < target) {
+        journal->syncRequested = 1;
+        WakeConditionVariable(&journal->commitRequested);
+    }
+    while (journal->durable < target && !journal->writeFailed) {
+        SleepConditionVariableCS(&journal->committed, &journal->lock, INFINITE);
+    }
+    int result = journal->writeFailed ? CARD_ERROR_INIT_FAILED : CARD_SUCCESS;
+    LeaveCriticalSection(&journal->lock);
+    
+    return result;
+}
+
+int card_journal_close(CardJournal* journal) {
+    if (!journal || !journal->thread) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    EnterCriticalSection(&journal->lock);
+    journal->isStopping = 1;
+    WakeConditionVariable(&journal->commitRequested);
+    LeaveCriticalSection(&journal->lock);
+    
+    // Поток сброса дописывает буфер перед завершением
+    WaitForSingleObject(journal->thread, INFINITE);
+    CloseHandle(journal->thread);
+    journal->thread = NULL;
+    
+    int result = journal->writeFailed ? CARD_ERROR_INIT_FAILED : CARD_SUCCESS;
+    DeleteCriticalSection(&journal->lock);
+    journal_free(journal);
+    
+    return result;
+} 
\ No newline at end of file
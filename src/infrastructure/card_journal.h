@@ -0,0 +1,204 @@
+#ifndef CARD_JOURNAL_H
+#define CARD_JOURNAL_H
+
+#include <windows.h>
+#include "card_domain.h"
+#include "card_service.h"
+
+/**
+ * Слой инфраструктуры (Infrastructure Layer)
+ * Журнал записи на карты для восстановления после сбоя. Перед записью
+ * диапазона в журнал добавляется запись о плане, после подтверждённой
+ * записи — о выполнении: UID карты, адрес, длина и хэш данных.
+ * Журнал только дописывается. Записи копятся в буфере и сбрасываются на
+ * диск группами одним FlushFileBuffers (group commit), поэтому тысячи
+ * записей в минуту не ждут диска по одной. После перезапуска режим
+ * возобновления пропускает диапазоны, уже подтверждённые на той же карте.
+ */
+
+#define CARD_JOURNAL_MAGIC "CRDJRNL1"
+#define CARD_JOURNAL_RECORD_SIZE 36
+#define CARD_JOURNAL_MAX_UID 10
+#define CARD_JOURNAL_DEFAULT_INTERVAL 20         /* Период сброса на диск, мс */
+#define CARD_JOURNAL_DEFAULT_BUFFER (64 * 1024)
+
+typedef enum {
+    CARD_JOURNAL_PLANNED = 1,      /* Запись диапазона начата */
+    CARD_JOURNAL_CONFIRMED = 2     /* Диапазон записан на карту */
+} CardJournalState;
+
+/**
+ * Карта, к которой относятся записи журнала
+ */
+typedef struct {
+    uint8_t uid[CARD_JOURNAL_MAX_UID];
+    size_t uidLength;
+} CardJournalCard;
+
+/**
+ * Диапазон записи в пакетном задании
+ */
+typedef struct {
+    uint16_t offset;
+    const uint8_t* data;
+    size_t length;
+    int result;                    /* Код ошибки из CardError */
+    int skipped;                   /* Диапазон уже подтверждён, запись не выполнялась */
+} CardJournalWrite;
+
+/**
+ * Диапазон, запись которого начата, но не подтверждена
+ */
+typedef struct {
+    uint16_t offset;
+    size_t length;
+    uint64_t dataHash;
+} CardJournalRange;
+
+typedef struct {
+    int resume;                    /* Пропускать диапазоны, уже подтверждённые для карты */
+    DWORD commitInterval;          /* Наибольшая задержка сброса на диск, мс */
+    size_t bufferSize;             /* Сброс раньше срока при заполнении буфера */
+} CardJournalConfig;
+
+/**
+ * Элемент индекса диапазонов; открытая адресация
+ */
+typedef struct {
+    uint64_t key;                  /* 0 — свободная ячейка */
+    uint8_t uid[CARD_JOURNAL_MAX_UID];
+    uint8_t uidLength;
+    uint8_t state;                 /* CardJournalState */
+    uint16_t offset;
+    uint32_t length;
+    uint64_t dataHash;
+} CardJournalEntry;
+
+typedef struct {
+    size_t loaded;                 /* Записей прочитано при открытии */
+    size_t truncated;              /* Байт оборванного хвоста, отброшенных при открытии */
+    size_t written;                /* Диапазонов записано на карты */
+    size_t skipped;                /* Диапазонов пропущено при возобновлении */
+    size_t commits;                /* Сбросов на диск */
+    size_t records;                /* Записей добавлено в журнал */
+} CardJournalStats;
+
+typedef struct {
+    CardJournalConfig config;
+    HANDLE file;
+    HANDLE thread;
+    
+    CRITICAL_SECTION lock;         /* Защищает буфер, индекс и счётчики */
+    CONDITION_VARIABLE commitRequested;
+    CONDITION_VARIABLE committed;  /* Изменился durable или освободился буфер */
+    uint8_t* active;               /* Буфер, в который добавляются записи */
+    uint8_t* flushing;             /* Буфер, который пишет поток сброса */
+    size_t activeLength;
+    uint64_t appended;             /* Номер последней добавленной записи */
+    uint64_t durable;              /* Номер последней записи на диске */
+    int syncRequested;
+    int isStopping;
+    int writeFailed;
+    
+    CardJournalEntry* entries;
+    size_t capacity;               /* Степень двойки */
+    size_t count;
+    
+    CardJournalStats stats;
+} CardJournal;
+
+/**
+ * Параметры по умолчанию: возобновление включено, сброс каждые 20 мс
+ * @param config Структура параметров
+ */
+void card_journal_default_config(CardJournalConfig* config);
+
+/**
+ * Открытие журнала: существующие записи читаются в индекс, оборванная
+ * при сбое последняя запись отбрасывается, новые записи дописываются
+ * @param journal Структура журнала (память вызывающего)
+ * @param path Путь к файлу журнала
+ * @param config Параметры (NULL — по умолчанию)
+ * @return Код ошибки из CardError
+ */
+int card_journal_open(CardJournal* journal, const char* path, const CardJournalConfig* config);
+
+/**
+ * Определение карты по UID (FF CA 00 00 00)
+ * @param service Сервис, подключённый к карте
+ * @param card Структура для UID
+ * @return Код ошибки из CardError
+ */
+int card_journal_identify(CardService* service, CardJournalCard* card);
+
+/**
+ * Проверка, подтверждена ли запись данных в диапазон карты
+ * @param journal Указатель на журнал
+ * @param card Карта
+ * @param offset Адрес диапазона
+ * @param data Данные
+ * @param length Длина данных
+ * @return 1 — подтверждена, 0 — нет
+ */
+int card_journal_is_confirmed(CardJournal* journal, const CardJournalCard* card, uint16_t offset,
+                              const uint8_t* data, size_t length);
+
+/**
+ * Запись диапазона на карту через журнал
+ * В режиме возобновления подтверждённый ранее диапазон не записывается.
+ * Возврат не ждёт сброса журнала на диск: неподтверждённый на диске
+ * диапазон после сбоя просто будет записан повторно.
+ * @param journal Указатель на журнал
+ * @param service Сервис, подключённый к карте
+ * @param card Карта
+ * @param offset Адрес начала записи (0..CARD_SERVICE_MAX_OFFSET)
+ * @param data Данные
+ * @param length Длина данных
+ * @param skipped Признак пропуска (может быть NULL)
+ * @return Код ошибки из CardError
+ */
+int card_journal_write(CardJournal* journal, CardService* service, const CardJournalCard* card,
+                       uint16_t offset, const uint8_t* data, size_t length, int* skipped);
+
+/**
+ * Пакетная запись: планы всех диапазонов попадают в журнал до первой
+ * записи на карту, результат каждого диапазона — в его структуре
+ * @param journal Указатель на журнал
+ * @param service Сервис, подключённый к карте
+ * @param card Карта
+ * @param writes Диапазоны
+ * @param count Количество диапазонов
+ * @param stopOnError Прекратить пакет после первой ошибки
+ * @param executed Количество обработанных диапазонов, включая пропущенные (может быть NULL)
+ * @return CARD_SUCCESS или код первой ошибки из CardError
+ */
+int card_journal_write_batch(CardJournal* journal, CardService* service, const CardJournalCard* card,
+                             CardJournalWrite* writes, size_t count, int stopOnError, size_t* executed);
+
+/**
+ * Диапазоны карты, запись которых начата, но не подтверждена
+ * @param journal Указатель на журнал
+ * @param card Карта
+ * @param ranges Массив для диапазонов
+ * @param capacity Размер массива
+ * @param count Число найденных диапазонов (может превышать capacity)
+ * @return Код ошибки из CardError
+ */
+int card_journal_unconfirmed(CardJournal* journal, const CardJournalCard* card,
+                             CardJournalRange* ranges, size_t capacity, size_t* count);
+
+/**
+ * Ожидание сброса на диск всех добавленных записей
+ * @param journal Указатель на журнал
+ * @return Код ошибки из CardError
+ */
+int card_journal_sync(CardJournal* journal);
+
+/**
+ * Сброс оставшихся записей и закрытие журнала
+ * @param journal Указатель на журнал
+ * @return Код ошибки из CardError
+ */
+int card_journal_close(CardJournal* journal);
+
+#endif /* CARD_JOURNAL_H */ 
\ No newline at end of file
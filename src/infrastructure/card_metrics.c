@@ -0,0 +1,432 @@
+#include "card_metrics.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+static CardMetrics* volatile activeMetrics = NULL;
+static volatile LONG64 counterFrequency = 0;
+
+/**
+ * Текстовый вывод с подсчётом полной длины, как у snprintf
+ */
+typedef struct {
+    char* buffer;
+    size_t capacity;
+    size_t length;
+} MetricsWriter;
+
+static void metrics_print(MetricsWriter* writer, const char* format, ...) {
+    char* target = NULL;
+    size_t available = 0;
+    if (writer->length < writer->capacity) {
+        target = writer->buffer + writer->length;
+        available = writer->capacity - writer->length;
+    }
+    
+    va_list arguments;
+    va_start(arguments, format);
+    int printed = vsnprintf(target, available, format, arguments);
+    va_end(arguments);
+    
+    if (printed > 0) {
+        writer->length += (size_t)printed;
+    }
+}
+
+uint64_t card_metrics_now(void) {
+    LARGE_INTEGER counter;
+    LONG64 frequency = counterFrequency;
+    
+    // Частота постоянна, гонка при первом чтении безвредна
+    if (frequency == 0) {
+        LARGE_INTEGER value;
+        QueryPerformanceFrequency(&value);
+        frequency = value.QuadPart;
+        InterlockedExchange64(&counterFrequency, frequency);
+    }
+    
+    QueryPerformanceCounter(&counter);
+    uint64_t ticks = (uint64_t)counter.QuadPart;
+    
+    // Деление в два шага, чтобы не переполнить 64 бита
+    return (ticks / (uint64_t)frequency) * 1000000000ULL +
+           (ticks % (uint64_t)frequency) * 1000000000ULL / (uint64_t)frequency;
+}
+
+int card_metrics_initialize(CardMetrics* metrics) {
+    if (!metrics) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    memset(metrics, 0, sizeof(CardMetrics));
+    return CARD_SUCCESS;
+}
+
+void card_metrics_install(CardMetrics* metrics) {
+    InterlockedExchangePointer((PVOID volatile*)&activeMetrics, metrics);
+}
+
+CardMetrics* card_metrics_active(void) {
+    return activeMetrics;
+}
+
+CardMetricsReader* card_metrics_reader(CardMetrics* metrics, const char* readerName) {
+    if (!metrics || !readerName) {
+        return NULL;
+    }
+    
+    for (size_t i = 0; i < CARD_METRICS_MAX_READERS; i++) {
+        CardMetricsReader* reader = &metrics->readers[i];
+        
+        // Свободный слот занимается атомарно, имя публикуется после копирования
+        if (reader->state == 0 && InterlockedCompareExchange(&reader->state, 1, 0) == 0) {
+            strncpy(reader->name, readerName, sizeof(reader->name) - 1);
+            reader->name[sizeof(reader->name) - 1] = '\0';
+            InterlockedExchange(&reader->state, 2);
+            return reader;
+        }
+        
+        // Слот занимается другим потоком: ждём публикации имени
+        while (reader->state == 1) {
+            YieldProcessor();
+        }
+        
+        if (strncmp(reader->name, readerName, sizeof(reader->name) - 1) == 0) {
+            return reader;
+        }
+    }
+    
+    return NULL;
+}
+
+/**
+ * Номер корзины для задержки в микросекундах
+ */
+static size_t metrics_bucket(uint64_t value) {
+    if (value < CARD_METRICS_LINEAR_BUCKETS) {
+        return (size_t)value;
+    }
+    
+    unsigned exponent = 4;
+    while (exponent < CARD_METRICS_MAX_EXPONENT && (value >> (exponent + 1)) != 0) {
+        exponent++;
+    }
+    
+    // Всё, что выше диапазона, попадает в последнюю корзину
+    if ((value >> (exponent + 1)) != 0) {
+        return CARD_METRICS_BUCKETS - 1;
+    }
+    
+    size_t sub = (size_t)((value >> (exponent - 3)) & (CARD_METRICS_SUB_BUCKETS - 1));
+    return CARD_METRICS_LINEAR_BUCKETS + (exponent - 4) * CARD_METRICS_SUB_BUCKETS + sub;
+}
+
+/**
+ * Верхняя граница корзины в микросекундах
+ */
+static uint64_t metrics_bucket_limit(size_t index) {
+    if (index < CARD_METRICS_LINEAR_BUCKETS) {
+        return index;
+    }
+    
+    size_t position = index - CARD_METRICS_LINEAR_BUCKETS;
+    unsigned exponent = (unsigned)(position / CARD_METRICS_SUB_BUCKETS) + 4;
+    uint64_t sub = position % CARD_METRICS_SUB_BUCKETS;
+    uint64_t step = 1ULL << (exponent - 3);
+    
+    return (1ULL << exponent) + (sub + 1) * step - 1;
+}
+
+static void metrics_record_latency(CardMetricsHistogram* histogram, uint64_t elapsed) {
+    LONG64 micros = (LONG64)(elapsed / 1000);
+    
+    InterlockedIncrement(&histogram->buckets[metrics_bucket((uint64_t)micros)]);
+    InterlockedIncrement64(&histogram->count);
+    InterlockedExchangeAdd64(&histogram->sum, micros);
+    
+    LONG64 current = histogram->max;
+    while (micros > current) {
+        LONG64 previous = InterlockedCompareExchange64(&histogram->max, micros, current);
+        if (previous == current) {
+            break;
+        }
+        current = previous;
+    }
+}
+
+/**
+ * Увеличение счётчика по ключу в таблице с открытой адресацией
+ */
+static void metrics_count_key(CardMetrics* metrics, CardMetricsKeyCount* table, size_t size, LONG key) {
+    size_t start = ((ULONG)key * 2654435761UL) % size;
+    
+    for (size_t i = 0; i < size; i++) {
+        CardMetricsKeyCount* slot = &table[(start + i) % size];
+        LONG current = slot->key;
+        
+        if (current == 0) {
+            current = InterlockedCompareExchange(&slot->key, key, 0);
+            if (current == 0) {
+                current = key;
+            }
+        }
+        
+        if (current == key) {
+            InterlockedIncrement(&slot->count);
+            return;
+        }
+    }
+    
+    InterlockedIncrement64(&metrics->droppedKeys);
+}
+
+void card_metrics_record_transmit(CardMetrics* metrics, CardMetricsReader* reader,
+                                  const uint8_t* command, size_t commandLength,
+                                  const uint8_t* response, size_t responseLength,
+                                  LONG scardResult, uint64_t elapsed) {
+    if (!metrics) {
+        return;
+    }
+    
+    int failed = scardResult != SCARD_S_SUCCESS;
+    LONG64 received = failed ? 0 : (LONG64)responseLength;
+    
+    if (reader) {
+        InterlockedIncrement64(&reader->transmit.calls);
+        InterlockedExchangeAdd64(&reader->transmit.bytesOut, (LONG64)commandLength);
+        InterlockedExchangeAdd64(&reader->transmit.bytesIn, received);
+        if (failed) {
+            InterlockedIncrement64(&reader->transmit.errors);
+        }
+        metrics_record_latency(&reader->transmitLatency, elapsed);
+    }
+    
+    if (command && commandLength >= 2) {
+        CardMetricsInstruction* instruction = &metrics->instructions[command[1]];
+        InterlockedIncrement64(&instruction->counters.calls);
+        InterlockedExchangeAdd64(&instruction->counters.bytesOut, (LONG64)commandLength);
+        InterlockedExchangeAdd64(&instruction->counters.bytesIn, received);
+        if (failed) {
+            InterlockedIncrement64(&instruction->counters.errors);
+        }
+        metrics_record_latency(&instruction->latency, elapsed);
+    }
+    
+    if (failed) {
+        metrics_count_key(metrics, metrics->errorCodes, CARD_METRICS_MAX_ERROR_CODES, scardResult);
+        return;
+    }
+    
+    // Учитываются все статусные слова, кроме 9000; бит 16 отличает ключ от пустого слота
+    if (response && responseLength >= 2) {
+        LONG statusWord = ((LONG)response[responseLength - 2] << 8) | response[responseLength - 1];
+        if (statusWord != 0x9000) {
+            metrics_count_key(metrics, metrics->statusWords, CARD_METRICS_MAX_STATUS_WORDS,
+                              statusWord | 0x10000);
+        }
+    }
+}
+
+void card_metrics_record_connect(CardMetrics* metrics, CardMetricsReader* reader,
+                                 LONG scardResult, uint64_t elapsed) {
+    if (!metrics) {
+        return;
+    }
+    
+    if (reader) {
+        InterlockedIncrement64(&reader->connect.calls);
+        if (scardResult != SCARD_S_SUCCESS) {
+            InterlockedIncrement64(&reader->connect.errors);
+        }
+        metrics_record_latency(&reader->connectLatency, elapsed);
+    }
+    
+    if (scardResult != SCARD_S_SUCCESS) {
+        metrics_count_key(metrics, metrics->errorCodes, CARD_METRICS_MAX_ERROR_CODES, scardResult);
+    }
+}
+
+int card_metrics_snapshot(const CardMetrics* metrics, CardMetrics* snapshot) {
+    if (!metrics || !snapshot || metrics == snapshot) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    // Копия не атомарна в целом, но каждый счётчик читается целиком
+    memcpy(snapshot, (const void*)metrics, sizeof(CardMetrics));
+    
+    // Слоты, занятые во время копирования, в снимок не попадают
+    for (size_t i = 0; i < CARD_METRICS_MAX_READERS; i++) {
+        if (snapshot->readers[i].state != 2) {
+            memset(&snapshot->readers[i], 0, sizeof(CardMetricsReader));
+        }
+    }
+    
+    return CARD_SUCCESS;
+}
+
+void card_metrics_summarize(const CardMetricsHistogram* histogram, CardMetricsLatency* latency) {
+    memset(latency, 0, sizeof(CardMetricsLatency));
+    
+    uint64_t total = 0;
+    for (size_t i = 0; i < CARD_METRICS_BUCKETS; i++) {
+        total += (uint64_t)histogram->buckets[i];
+    }
+    
+    if (total == 0) {
+        return;
+    }
+    
+    latency->count = total;
+    latency->mean = (uint64_t)histogram->sum / total;
+    latency->max = (uint64_t)histogram->max;
+    
+    uint64_t* targets[] = { &latency->p50, &latency->p90, &latency->p99 };
+    uint64_t ranks[] = { (total * 50 + 99) / 100, (total * 90 + 99) / 100, (total * 99 + 99) / 100 };
+    
+    uint64_t seen = 0;
+    size_t next = 0;
+    for (size_t i = 0; i < CARD_METRICS_BUCKETS && next < 3; i++) {
+        seen += (uint64_t)histogram->buckets[i];
+        while (next < 3 && seen >= ranks[next]) {
+            uint64_t limit = metrics_bucket_limit(i);
+            *targets[next++] = limit < latency->max ? limit : latency->max;
+        }
+    }
+}
+
+static void metrics_dump_counters(MetricsWriter* writer, CardMetricsFormat format,
+                                  const CardMetricsCounters* counters,
+                                  const CardMetricsHistogram* histogram) {
+    CardMetricsLatency latency;
+    card_metrics_summarize(histogram, &latency);
+    
+    if (format == CARD_METRICS_JSON) {
+        metrics_print(writer, "\"calls\":%lld,\"errors\":%lld,\"bytes_out\":%lld,\"bytes_in\":%lld,"
+                      "\"latency_us\":{\"mean\":%llu,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"max\":%llu}",
+                      (long long)counters->calls, (long long)counters->errors,
+                      (long long)counters->bytesOut, (long long)counters->bytesIn,
+                      (unsigned long long)latency.mean, (unsigned long long)latency.p50,
+                      (unsigned long long)latency.p90, (unsigned long long)latency.p99,
+                      (unsigned long long)latency.max);
+    } else {
+        metrics_print(writer, "вызовов %lld, ошибок %lld, отправлено %lld Б, получено %lld Б, "
+                      "задержка мкс: среднее %llu, p50 %llu, p90 %llu, p99 %llu, max %llu\n",
+                      (long long)counters->calls, (long long)counters->errors,
+                      (long long)counters->bytesOut, (long long)counters->bytesIn,
+                      (unsigned long long)latency.mean, (unsigned long long)latency.p50,
+                      (unsigned long long)latency.p90, (unsigned long long)latency.p99,
+                      (unsigned long long)latency.max);
+    }
+}
+
+/**
+ * Имя считывателя в строке JSON: кавычки и обратная косая черта экранируются
+ */
+static void metrics_dump_name(MetricsWriter* writer, const char* name) {
+    for (const char* c = name; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            metrics_print(writer, "\\%c", *c);
+        } else if ((unsigned char)*c < 0x20) {
+            metrics_print(writer, "\\u%04x", (unsigned)(unsigned char)*c);
+        } else {
+            metrics_print(writer, "%c", *c);
+        }
+    }
+}
+
+int card_metrics_dump(const CardMetrics* metrics, CardMetricsFormat format,
+                      char* buffer, size_t capacity, size_t* written) {
+    if (!metrics || (!buffer && capacity > 0) || !written) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    MetricsWriter writer = { buffer, capacity, 0 };
+    int json = format == CARD_METRICS_JSON;
+    int first = 1;
+    
+    metrics_print(&writer, json ? "{\"readers\":[" : "Считыватели:\n");
+    for (size_t i = 0; i < CARD_METRICS_MAX_READERS; i++) {
+        const CardMetricsReader* reader = &metrics->readers[i];
+        if (reader->state != 2) {
+            continue;
+        }
+        
+        if (json) {
+            metrics_print(&writer, "%s{\"name\":\"", first ? "" : ",");
+            metrics_dump_name(&writer, reader->name);
+            metrics_print(&writer, "\",\"transmit\":{");
+            metrics_dump_counters(&writer, format, &reader->transmit, &reader->transmitLatency);
+            metrics_print(&writer, "},\"connect\":{");
+            metrics_dump_counters(&writer, format, &reader->connect, &reader->connectLatency);
+            metrics_print(&writer, "}}");
+        } else {
+            metrics_print(&writer, "  %s\n    обмен: ", reader->name);
+            metrics_dump_counters(&writer, format, &reader->transmit, &reader->transmitLatency);
+            metrics_print(&writer, "    подключение: ");
+            metrics_dump_counters(&writer, format, &reader->connect, &reader->connectLatency);
+        }
+        first = 0;
+    }
+    
+    first = 1;
+    metrics_print(&writer, json ? "],\"instructions\":[" : "Инструкции:\n");
+    for (size_t ins = 0; ins < 256; ins++) {
+        const CardMetricsInstruction* instruction = &metrics->instructions[ins];
+        if (instruction->counters.calls == 0) {
+            continue;
+        }
+        
+        if (json) {
+            metrics_print(&writer, "%s{\"ins\":%u,", first ? "" : ",", (unsigned)ins);
+            metrics_dump_counters(&writer, format, &instruction->counters, &instruction->latency);
+            metrics_print(&writer, "}");
+        } else {
+            metrics_print(&writer, "  INS %02X: ", (unsigned)ins);
+            metrics_dump_counters(&writer, format, &instruction->counters, &instruction->latency);
+        }
+        first = 0;
+    }
+    
+    first = 1;
+    metrics_print(&writer, json ? "],\"scard_errors\":{" : "Ошибки PC/SC:\n");
+    for (size_t i = 0; i < CARD_METRICS_MAX_ERROR_CODES; i++) {
+        const CardMetricsKeyCount* slot = &metrics->errorCodes[i];
+        if (slot->key == 0) {
+            continue;
+        }
+        
+        if (json) {
+            metrics_print(&writer, "%s\"0x%08lX\":%ld", first ? "" : ",",
+                          (unsigned long)slot->key, (long)slot->count);
+        } else {
+            metrics_print(&writer, "  0x%08lX: %ld\n", (unsigned long)slot->key, (long)slot->count);
+        }
+        first = 0;
+    }
+    
+    first = 1;
+    metrics_print(&writer, json ? "},\"status_words\":{" : "Статусные слова:\n");
+    for (size_t i = 0; i < CARD_METRICS_MAX_STATUS_WORDS; i++) {
+        const CardMetricsKeyCount* slot = &metrics->statusWords[i];
+        if (slot->key == 0) {
+            continue;
+        }
+        
+        if (json) {
+            metrics_print(&writer, "%s\"%04lX\":%ld", first ? "" : ",",
+                          (unsigned long)(slot->key & 0xFFFF), (long)slot->count);
+        } else {
+            metrics_print(&writer, "  %04lX: %ld\n", (unsigned long)(slot->key & 0xFFFF), (long)slot->count);
+        }
+        first = 0;
+    }
+    
+    if (json) {
+        metrics_print(&writer, "},\"dropped\":%lld}\n", (long long)metrics->droppedKeys);
+    } else {
+        metrics_print(&writer, "Потеряно записей: %lld\n", (long long)metrics->droppedKeys);
+    }
+    
+    *written = writer.length;
+    return CARD_SUCCESS;
+} 
\ No newline at end of file
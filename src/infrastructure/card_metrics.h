@@ -0,0 +1,181 @@
+#ifndef CARD_METRICS_H
+#define CARD_METRICS_H
+
+#include <windows.h>
+#include <winscard.h>
+#include <stdint.h>
+#include "card_domain.h"
+
+/**
+ * Слой инфраструктуры (Infrastructure Layer)
+ * Метрики обмена с картами: счётчики и гистограммы задержек по считывателям
+ * и байтам инструкции. Запись выполняется атомарными операциями без блокировок,
+ * поэтому метрики можно держать включёнными постоянно.
+ */
+
+#define CARD_METRICS_MAX_READERS 32
+#define CARD_METRICS_MAX_ERROR_CODES 32
+#define CARD_METRICS_MAX_STATUS_WORDS 64
+
+/* Гистограмма в микросекундах: 16 линейных корзин, далее по 8 корзин на
+ * каждую степень двойки до 2^30 мкс; относительная погрешность не более 12,5% */
+#define CARD_METRICS_LINEAR_BUCKETS 16
+#define CARD_METRICS_SUB_BUCKETS 8
+#define CARD_METRICS_MAX_EXPONENT 29
+#define CARD_METRICS_BUCKETS (CARD_METRICS_LINEAR_BUCKETS + \
+                              (CARD_METRICS_MAX_EXPONENT - 3) * CARD_METRICS_SUB_BUCKETS)
+
+typedef struct {
+    volatile LONG buckets[CARD_METRICS_BUCKETS];
+    volatile LONG64 count;
+    volatile LONG64 sum;      /* Сумма задержек, мкс */
+    volatile LONG64 max;      /* Максимальная задержка, мкс */
+} CardMetricsHistogram;
+
+typedef struct {
+    volatile LONG64 calls;
+    volatile LONG64 errors;   /* Ошибки PC/SC */
+    volatile LONG64 bytesOut; /* Байт команд */
+    volatile LONG64 bytesIn;  /* Байт ответов */
+} CardMetricsCounters;
+
+/**
+ * Счётчик по ключу (код PC/SC или статусное слово), 0 — свободный слот
+ */
+typedef struct {
+    volatile LONG key;
+    volatile LONG count;
+} CardMetricsKeyCount;
+
+typedef struct {
+    volatile LONG state;      /* 0 — свободен, 1 — занимается, 2 — готов */
+    char name[256];
+    CardMetricsCounters transmit;
+    CardMetricsHistogram transmitLatency;
+    CardMetricsCounters connect;
+    CardMetricsHistogram connectLatency;
+} CardMetricsReader;
+
+typedef struct {
+    CardMetricsCounters counters;
+    CardMetricsHistogram latency;
+} CardMetricsInstruction;
+
+/**
+ * Реестр метрик. Структура велика (около 300 КБ): размещается статически
+ * или в куче.
+ */
+typedef struct {
+    CardMetricsReader readers[CARD_METRICS_MAX_READERS];
+    CardMetricsInstruction instructions[256];
+    CardMetricsKeyCount errorCodes[CARD_METRICS_MAX_ERROR_CODES];
+    CardMetricsKeyCount statusWords[CARD_METRICS_MAX_STATUS_WORDS];
+    volatile LONG64 droppedKeys;  /* Записей, не поместившихся в таблицы */
+} CardMetrics;
+
+/**
+ * Сводка гистограммы
+ */
+typedef struct {
+    uint64_t count;
+    uint64_t mean;            /* мкс */
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t max;
+} CardMetricsLatency;
+
+typedef enum {
+    CARD_METRICS_TEXT = 0,
+    CARD_METRICS_JSON = 1
+} CardMetricsFormat;
+
+/**
+ * Монотонное время в наносекундах (QueryPerformanceCounter)
+ * @return Наносекунды от произвольной точки отсчёта
+ */
+uint64_t card_metrics_now(void);
+
+/**
+ * Инициализация реестра
+ * @param metrics Реестр (память вызывающего)
+ * @return Код ошибки из CardError
+ */
+int card_metrics_initialize(CardMetrics* metrics);
+
+/**
+ * Подключение реестра к адаптеру WinSCard для всех контекстов процесса
+ * @param metrics Реестр или NULL для выключения записи
+ */
+void card_metrics_install(CardMetrics* metrics);
+
+/**
+ * Текущий реестр процесса
+ * @return Реестр или NULL, если запись выключена
+ */
+CardMetrics* card_metrics_active(void);
+
+/**
+ * Поиск или регистрация считывателя
+ * @param metrics Реестр
+ * @param readerName Имя считывателя
+ * @return Слот считывателя или NULL, если слоты закончились
+ */
+CardMetricsReader* card_metrics_reader(CardMetrics* metrics, const char* readerName);
+
+/**
+ * Запись обмена SCardTransmit
+ * @param metrics Реестр
+ * @param reader Слот считывателя (может быть NULL)
+ * @param command Команда
+ * @param commandLength Длина команды
+ * @param response Ответ
+ * @param responseLength Длина ответа
+ * @param scardResult Результат SCardTransmit
+ * @param elapsed Длительность в наносекундах
+ */
+void card_metrics_record_transmit(CardMetrics* metrics, CardMetricsReader* reader,
+                                  const uint8_t* command, size_t commandLength,
+                                  const uint8_t* response, size_t responseLength,
+                                  LONG scardResult, uint64_t elapsed);
+
+/**
+ * Запись подключения SCardConnect
+ * @param metrics Реестр
+ * @param reader Слот считывателя (может быть NULL)
+ * @param scardResult Результат SCardConnect
+ * @param elapsed Длительность в наносекундах
+ */
+void card_metrics_record_connect(CardMetrics* metrics, CardMetricsReader* reader,
+                                 LONG scardResult, uint64_t elapsed);
+
+/**
+ * Снимок реестра: копия счётчиков для последующего анализа
+ * Запись в реестр во время снимка не блокируется.
+ * @param metrics Реестр
+ * @param snapshot Структура для копии (память вызывающего)
+ * @return Код ошибки из CardError
+ */
+int card_metrics_snapshot(const CardMetrics* metrics, CardMetrics* snapshot);
+
+/**
+ * Сводка гистограммы: среднее, перцентили и максимум
+ * @param histogram Гистограмма
+ * @param latency Результат
+ */
+void card_metrics_summarize(const CardMetricsHistogram* histogram, CardMetricsLatency* latency);
+
+/**
+ * Вывод метрик в текстовом виде или в JSON
+ * @param metrics Реестр или снимок
+ * @param format Формат из CardMetricsFormat
+ * @param buffer Буфер для текста (может быть NULL при capacity == 0)
+ * @param capacity Размер буфера
+ * @param written Длина полного текста без завершающего нуля; если она не меньше
+ *                capacity, текст усечён
+ * @return Код ошибки из CardError
+ */
+int card_metrics_dump(const CardMetrics* metrics, CardMetricsFormat format,
+                      char* buffer, size_t capacity, size_t* written);
+
+#endif /* CARD_METRICS_H */ 
\ No newline at end of file
@@ -0,0 +1,318 @@
+#include "card_monitor.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+static void card_monitor_notify(CardMonitor* monitor, CardMonitorEventType type, size_t index) {
+    if (!monitor->config.onEvent) {
+        return;
+    }
+    
+    CardMonitorReader* reader = &monitor->readers[index];
+    CardMonitorEvent event;
+    memset(&event, 0, sizeof(event));
+    
+    event.type = type;
+    event.readerIndex = index;
+    event.readerName = reader->name;
+    if (type == CARD_MONITOR_CARD_INSERTED) {
+        event.atr = reader->atr;
+        event.atrLength = reader->atrLength;
+        if (reader->isInitialized && reader->connection.isConnected) {
+            event.connection = &reader->connectionContext;
+        }
+    }
+    
+    monitor->config.onEvent(&event, monitor->config.userData);
+}
+
+static void card_monitor_card_inserted(CardMonitor* monitor, size_t index, const SCARD_READERSTATE* state) {
+    CardMonitorReader* reader = &monitor->readers[index];
+    
+    reader->isPresent = 1;
+    reader->atrLength = state->cbAtr < sizeof(reader->atr) ? state->cbAtr : sizeof(reader->atr);
+    memcpy(reader->atr, state->rgbAtr, reader->atrLength);
+    
+    if (monitor->config.autoConnect) {
+        if (!reader->isInitialized) {
+            reader->connectionContext.context = &reader->connection;
+            reader->isInitialized = winscard_initialize(&reader->connectionContext) == CARD_SUCCESS;
+        }
+        if (reader->isInitialized) {
+            winscard_connect(&reader->connectionContext, reader->name);
+        }
+    }
+    
+    card_monitor_notify(monitor, CARD_MONITOR_CARD_INSERTED, index);
+}
+
+static void card_monitor_card_removed(CardMonitor* monitor, size_t index) {
+    CardMonitorReader* reader = &monitor->readers[index];
+    
+    reader->isPresent = 0;
+    reader->atrLength = 0;
+    card_monitor_notify(monitor, CARD_MONITOR_CARD_REMOVED, index);
+    
+    if (reader->isInitialized) {
+        winscard_disconnect(&reader->connectionContext);
+    }
+}
+
+static void card_monitor_release_reader(CardMonitorReader* reader) {
+    if (reader->isInitialized) {
+        winscard_release(&reader->connectionContext);
+        reader->isInitialized = 0;
+    }
+}
+
+/**
+ * Сверка списка считывателей после уведомления PnP
+ * Слоты readers не перемещаются: обработчик держит указатели на их подключения.
+ * Уплотняется только массив states, слот каждого элемента — в stateSlots.
+ */
+static void card_monitor_refresh_readers(CardMonitor* monitor) {
+    char* const* names = NULL;
+    size_t count = 0;
+    
+    // Монитор уже знает об изменении: список перечитывается без проверки PnP
+    winscard_invalidate_readers(&monitor->cardContext);
+    if (winscard_get_readers(&monitor->cardContext, &names, &count) != CARD_SUCCESS) {
+        return;
+    }
+    
+    // PnP сравнивает с числом всех считывателей: иначе лишние, не поместившиеся
+    // в readers, давали бы постоянное расхождение и ожидание не блокировалось бы
+    if (count > CARD_MONITOR_MAX_READERS && count != monitor->systemReaderCount) {
+        printf("Считывателей больше %d, остальные не отслеживаются\n", CARD_MONITOR_MAX_READERS);
+    }
+    monitor->systemReaderCount = count;
+    
+    // Удалённые считыватели
+    size_t i = 0;
+    while (i < monitor->readerCount) {
+        size_t slot = monitor->stateSlots[i];
+        int found = 0;
+        for (size_t j = 0; j < count && !found; j++) {
+            found = strcmp(monitor->readers[slot].name, names[j]) == 0;
+        }
+        
+        if (found) {
+            i++;
+            continue;
+        }
+        
+        if (monitor->readers[slot].isPresent) {
+            card_monitor_card_removed(monitor, slot);
+        }
+        card_monitor_notify(monitor, CARD_MONITOR_READER_REMOVED, slot);
+        card_monitor_release_reader(&monitor->readers[slot]);
+        monitor->readers[slot].isUsed = 0;
+        
+        monitor->readerCount--;
+        if (i != monitor->readerCount) {
+            monitor->states[i] = monitor->states[monitor->readerCount];
+            monitor->stateSlots[i] = monitor->stateSlots[monitor->readerCount];
+        }
+    }
+    
+    // Новые считыватели занимают свободные слоты и начинают с состояния UNAWARE,
+    // поэтому уже вставленные карты придут событиями установки при следующем ожидании
+    for (size_t j = 0; j < count && monitor->readerCount < CARD_MONITOR_MAX_READERS; j++) {
+        int found = 0;
+        size_t slot = CARD_MONITOR_MAX_READERS;
+        for (i = 0; i < CARD_MONITOR_MAX_READERS && !found; i++) {
+            if (monitor->readers[i].isUsed) {
+                found = strcmp(monitor->readers[i].name, names[j]) == 0;
+            } else if (slot == CARD_MONITOR_MAX_READERS) {
+                slot = i;
+            }
+        }
+        
+        if (found) {
+            continue;
+        }
+        
+        CardMonitorReader* reader = &monitor->readers[slot];
+        memset(reader, 0, sizeof(CardMonitorReader));
+        strncpy(reader->name, names[j], sizeof(reader->name) - 1);
+        reader->isUsed = 1;
+        
+        size_t index = monitor->readerCount++;
+        memset(&monitor->states[index], 0, sizeof(SCARD_READERSTATE));
+        monitor->states[index].dwCurrentState = SCARD_STATE_UNAWARE;
+        monitor->stateSlots[index] = slot;
+        
+        card_monitor_notify(monitor, CARD_MONITOR_READER_ADDED, slot);
+    }
+    
+    // Элементы states могли переместиться
+    for (i = 0; i < monitor->readerCount; i++) {
+        monitor->states[i].szReader = monitor->readers[monitor->stateSlots[i]].name;
+    }
+}
+
+static void card_monitor_process(CardMonitor* monitor) {
+    int readersChanged = 0;
+    SCARD_READERSTATE* pnp = &monitor->states[monitor->readerCount];
+    
+    for (size_t i = 0; i < monitor->readerCount; i++) {
+        SCARD_READERSTATE* state = &monitor->states[i];
+        size_t slot = monitor->stateSlots[i];
+        if (!(state->dwEventState & SCARD_STATE_CHANGED)) {
+            continue;
+        }
+        
+        state->dwCurrentState = state->dwEventState & ~SCARD_STATE_CHANGED;
+        
+        if (state->dwEventState & (SCARD_STATE_UNKNOWN | SCARD_STATE_UNAVAILABLE)) {
+            readersChanged = 1;
+            continue;
+        }
+        
+        int isPresent = (state->dwEventState & SCARD_STATE_PRESENT) &&
+                        !(state->dwEventState & SCARD_STATE_MUTE);
+        
+        if (isPresent && !monitor->readers[slot].isPresent) {
+            card_monitor_card_inserted(monitor, slot, state);
+        } else if (!isPresent && monitor->readers[slot].isPresent) {
+            card_monitor_card_removed(monitor, slot);
+        }
+    }
+    
+    if (pnp->dwEventState & SCARD_STATE_CHANGED) {
+        readersChanged = 1;
+    }
+    
+    if (readersChanged) {
+        card_monitor_refresh_readers(monitor);
+    }
+}
+
+static DWORD WINAPI card_monitor_thread(LPVOID parameter) {
+    CardMonitor* monitor = (CardMonitor*)parameter;
+    
+    // Контекст PC/SC создаётся в потоке, который в нём ожидает
+    EnterCriticalSection(&monitor->contextLock);
+    monitor->cardContext.context = &monitor->monitorContext;
+    monitor->startResult = winscard_initialize(&monitor->cardContext);
+    LeaveCriticalSection(&monitor->contextLock);
+    if (monitor->startResult == CARD_SUCCESS) {
+        card_monitor_refresh_readers(monitor);
+    }
+    SetEvent(monitor->readyEvent);
+    
+    if (monitor->startResult != CARD_SUCCESS) {
+        return 0;
+    }
+    
+    while (!monitor->isStopping) {
+        // Псевдосчитыватель PnP всегда последний; в старшем слове — число считывателей в системе
+        SCARD_READERSTATE* pnp = &monitor->states[monitor->readerCount];
+        memset(pnp, 0, sizeof(SCARD_READERSTATE));
+        pnp->szReader = WINSCARD_PNP_READER;
+        pnp->dwCurrentState = (DWORD)monitor->systemReaderCount << 16;
+        
+        LONG result = SCardGetStatusChange(monitor->monitorContext.hContext, INFINITE,
+                                           monitor->states, (DWORD)(monitor->readerCount + 1));
+        
+        if (result == SCARD_E_CANCELLED || monitor->isStopping) {
+            break;
+        }
+        
+        if (result == SCARD_E_TIMEOUT) {
+            continue;
+        }
+        
+        // Служба PC/SC останавливается после отключения последнего считывателя:
+        // новый контекст запускает её снова и ожидание продолжается через PnP
+        // (под contextLock, чтобы card_monitor_stop не отменял ожидание в закрытом контексте)
+        if (result == SCARD_E_NO_SERVICE || result == SCARD_E_SERVICE_STOPPED) {
+            EnterCriticalSection(&monitor->contextLock);
+            winscard_release(&monitor->cardContext);
+            int restarted = !monitor->isStopping && winscard_initialize(&monitor->cardContext) == CARD_SUCCESS;
+            LeaveCriticalSection(&monitor->contextLock);
+            if (!restarted) {
+                break;
+            }
+            card_monitor_refresh_readers(monitor);
+            continue;
+        }
+        
+        if (result != SCARD_S_SUCCESS) {
+            printf("Ошибка при ожидании изменения состояния считывателей: %X\n", (unsigned int)result);
+            break;
+        }
+        
+        card_monitor_process(monitor);
+    }
+    
+    for (size_t i = 0; i < CARD_MONITOR_MAX_READERS; i++) {
+        card_monitor_release_reader(&monitor->readers[i]);
+    }
+    EnterCriticalSection(&monitor->contextLock);
+    winscard_release(&monitor->cardContext);
+    LeaveCriticalSection(&monitor->contextLock);
+    
+    return 0;
+}
+
+int card_monitor_start(CardMonitor* monitor, const CardMonitorConfig* config) {
+    if (!monitor || !config || !config->onEvent) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    memset(monitor, 0, sizeof(CardMonitor));
+    monitor->config = *config;
+    
+    monitor->readyEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (!monitor->readyEvent) {
+        return CARD_ERROR_INIT_FAILED;
+    }
+    InitializeCriticalSection(&monitor->contextLock);
+    
+    monitor->thread = CreateThread(NULL, 0, card_monitor_thread, monitor, 0, NULL);
+    if (!monitor->thread) {
+        DeleteCriticalSection(&monitor->contextLock);
+        CloseHandle(monitor->readyEvent);
+        monitor->readyEvent = NULL;
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    WaitForSingleObject(monitor->readyEvent, INFINITE);
+    
+    if (monitor->startResult != CARD_SUCCESS) {
+        int result = monitor->startResult;
+        card_monitor_stop(monitor);
+        return result;
+    }
+    
+    return CARD_SUCCESS;
+}
+
+int card_monitor_stop(CardMonitor* monitor) {
+    if (!monitor) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    InterlockedExchange(&monitor->isStopping, 1);
+    
+    if (monitor->thread) {
+        // Отмена повторяется, пока поток не выйдет: он мог быть между вызовами PC/SC
+        do {
+            EnterCriticalSection(&monitor->contextLock);
+            SCardCancel(monitor->monitorContext.hContext);
+            LeaveCriticalSection(&monitor->contextLock);
+        } while (WaitForSingleObject(monitor->thread, 50) == WAIT_TIMEOUT);
+        CloseHandle(monitor->thread);
+        monitor->thread = NULL;
+    }
+    
+    // Событие и блокировка создаются вместе в card_monitor_start
+    if (monitor->readyEvent) {
+        DeleteCriticalSection(&monitor->contextLock);
+        CloseHandle(monitor->readyEvent);
+        monitor->readyEvent = NULL;
+    }
+    
+    return CARD_SUCCESS;
+} 
\ No newline at end of file
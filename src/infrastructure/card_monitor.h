@@ -0,0 +1,90 @@
+#ifndef CARD_MONITOR_H
+#define CARD_MONITOR_H
+
+#include <windows.h>
+#include <winscard.h>
+#include "card_domain.h"
+#include "winscard_adapter.h"
+
+/**
+ * Слой инфраструктуры (Infrastructure Layer)
+ * Отслеживание установки и извлечения карт через SCardGetStatusChange.
+ * Поток монитора блокируется в PC/SC до изменения состояния любого
+ * считывателя, включая подключение новых считывателей (\\?PnP?\Notification).
+ */
+
+#define CARD_MONITOR_MAX_READERS 32
+
+typedef enum {
+    CARD_MONITOR_CARD_INSERTED = 0,
+    CARD_MONITOR_CARD_REMOVED = 1,
+    CARD_MONITOR_READER_ADDED = 2,
+    CARD_MONITOR_READER_REMOVED = 3
+} CardMonitorEventType;
+
+typedef struct {
+    CardMonitorEventType type;
+    size_t readerIndex;        /* Слот считывателя; не меняется до его извлечения */
+    const char* readerName;
+    const uint8_t* atr;        /* ATR вставленной карты, иначе NULL */
+    size_t atrLength;
+    CardContext* connection;   /* Подключение к карте при автоподключении, иначе NULL */
+} CardMonitorEvent;
+
+/**
+ * Обработчик событий, вызывается в потоке монитора
+ * Подключение из события принадлежит монитору и действует до события
+ * извлечения карты; его можно передать в card_service_attach.
+ */
+typedef void (*CardMonitorCallback)(const CardMonitorEvent* event, void* userData);
+
+typedef struct {
+    CardMonitorCallback onEvent;
+    void* userData;
+    int autoConnect;           /* Подключаться к карте до вызова обработчика */
+} CardMonitorConfig;
+
+typedef struct {
+    char name[256];
+    int isPresent;
+    BYTE atr[CARD_ATR_MAX_LENGTH];
+    DWORD atrLength;
+    WinScardContext connection;
+    CardContext connectionContext;
+    int isInitialized;         /* Для подключения создан собственный контекст PC/SC */
+    int isUsed;                /* Слот занят подключённым считывателем */
+} CardMonitorReader;
+
+typedef struct {
+    CardMonitorConfig config;
+    WinScardContext monitorContext;
+    CardContext cardContext;
+    CardMonitorReader readers[CARD_MONITOR_MAX_READERS]; /* Слоты не перемещаются: подключения выданы обработчику */
+    SCARD_READERSTATE states[CARD_MONITOR_MAX_READERS + 1];
+    size_t stateSlots[CARD_MONITOR_MAX_READERS]; /* Слот readers для каждого элемента states */
+    size_t readerCount;        /* Отслеживаемых считывателей, элементов states без PnP */
+    size_t systemReaderCount;  /* Считывателей в системе, включая не поместившиеся в readers */
+    CRITICAL_SECTION contextLock; /* Пересоздание контекста монитора и SCardCancel */
+    HANDLE thread;
+    HANDLE readyEvent;
+    int startResult;
+    volatile LONG isStopping;
+} CardMonitor;
+
+/**
+ * Запуск потока монитора
+ * Карты, уже находящиеся в считывателях, приходят событиями установки.
+ * @param monitor Структура монитора (память вызывающего)
+ * @param config Параметры монитора
+ * @return Код ошибки из CardError
+ */
+int card_monitor_start(CardMonitor* monitor, const CardMonitorConfig* config);
+
+/**
+ * Остановка потока монитора и закрытие подключений
+ * @param monitor Указатель на монитор
+ * @return Код ошибки из CardError
+ */
+int card_monitor_stop(CardMonitor* monitor);
+
+#endif /* CARD_MONITOR_H */ 
\ No newline at end of file
@@ -0,0 +1,778 @@
+#include "card_personalize.h"
+#include "card_metrics.h"
+#include <string.h>
+#include <stdlib.h>
+
+#define PERSO_PRESENCE_TIMEOUT 250      /* Период проверки остановки при ожидании карты, мс */
+#define PERSO_JOURNAL_BUFFER (64 * 1024)
+#define PERSO_NO_READER ((size_t)-1)
+
+static const uint8_t uidCommand[] = { 0xFF, 0xCA, 0x00, 0x00, 0x00 };
+
+/* ---- Разбор записей ---- */
+
+static int hex_value(char symbol) {
+    if (symbol >= '0' && symbol <= '9') {
+        return symbol - '0';
+    }
+    if (symbol >= 'A' && symbol <= 'F') {
+        return symbol - 'A' + 10;
+    }
+    if (symbol >= 'a' && symbol <= 'f') {
+        return symbol - 'a' + 10;
+    }
+    return -1;
+}
+
+/**
+ * Разбор шестнадцатеричного текста; пробелы между байтами допускаются
+ * @return Число байт или -1 для неверного текста и переполнения
+ */
+static long decode_hex(const char* text, size_t length, uint8_t* target, size_t capacity) {
+    size_t count = 0;
+    int high = -1;
+    
+    for (size_t i = 0; i < length; i++) {
+        if (text[i] == ' ') {
+            continue;
+        }
+        int value = hex_value(text[i]);
+        if (value < 0) {
+            return -1;
+        }
+        if (high < 0) {
+            high = value;
+            continue;
+        }
+        if (count >= capacity) {
+            return -1;
+        }
+        target[count++] = (uint8_t)((high << 4) | value);
+        high = -1;
+    }
+    
+    return high < 0 ? (long)count : -1;
+}
+
+static int decode_field(const CardPersoField* field, const char* text, size_t length, uint8_t* image) {
+    uint8_t* target = image + field->imageOffset;
+    
+    if (field->encoding == CARD_PERSO_FIELD_HEX) {
+        return decode_hex(text, length, target, field->length) >= 0 ? CARD_SUCCESS : CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    if (length > field->length) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    memcpy(target, text, length);
+    return CARD_SUCCESS;
+}
+
+static int build_binary_image(const CardPersoConfig* config, const uint8_t* record, uint8_t* image) {
+    if (config->fieldCount == 0) {
+        size_t length = config->recordSize < config->imageLength ? config->recordSize : config->imageLength;
+        memcpy(image, record, length);
+        return CARD_SUCCESS;
+    }
+    
+    for (size_t i = 0; i < config->fieldCount; i++) {
+        const CardPersoField* field = &config->fields[i];
+        memcpy(image + field->imageOffset, record + field->source, field->length);
+    }
+    
+    return CARD_SUCCESS;
+}
+
+static int build_csv_image(const CardPersoConfig* config, const char* line, size_t length, uint8_t* image) {
+    const char* columns[CARD_PERSO_MAX_FIELDS];
+    size_t columnLengths[CARD_PERSO_MAX_FIELDS];
+    size_t columnCount = 0;
+    
+    size_t start = 0;
+    for (size_t i = 0; i <= length; i++) {
+        if (i < length && line[i] != ',') {
+            continue;
+        }
+        if (columnCount >= CARD_PERSO_MAX_FIELDS) {
+            return CARD_ERROR_INVALID_PARAMETER;
+        }
+        columns[columnCount] = line + start;
+        columnLengths[columnCount] = i - start;
+        columnCount++;
+        start = i + 1;
+    }
+    
+    // Без описания полей столбцы записываются подряд с начала образа
+    if (config->fieldCount == 0) {
+        size_t position = 0;
+        for (size_t i = 0; i < columnCount; i++) {
+            long decoded = decode_hex(columns[i], columnLengths[i], image + position,
+                                      config->imageLength - position);
+            if (decoded < 0) {
+                return CARD_ERROR_INVALID_PARAMETER;
+            }
+            position += (size_t)decoded;
+        }
+        return CARD_SUCCESS;
+    }
+    
+    for (size_t i = 0; i < config->fieldCount; i++) {
+        const CardPersoField* field = &config->fields[i];
+        if (field->source >= columnCount ||
+            decode_field(field, columns[field->source], columnLengths[field->source], image) != CARD_SUCCESS) {
+            return CARD_ERROR_INVALID_PARAMETER;
+        }
+    }
+    
+    return CARD_SUCCESS;
+}
+
+/* ---- Очереди ---- */
+
+static void push_back(CardPersoJob** head, CardPersoJob** tail, CardPersoJob* job) {
+    job->next = NULL;
+    if (*tail) {
+        (*tail)->next = job;
+    } else {
+        *head = job;
+    }
+    *tail = job;
+}
+
+/**
+ * Условие завершения потоков считывателей, вызывается под блокировкой
+ */
+static int perso_work_finished(CardPersoPipeline* pipeline) {
+    return pipeline->isStopping || (pipeline->parseDone && !pipeline->readyHead && pipeline->processing == 0);
+}
+
+/* ---- Стадия записи карт ---- */
+
+/**
+ * Ожидание установки (present = 1) или извлечения (present = 0) карты
+ * @return CARD_SUCCESS или CARD_ERROR_CONNECT_FAILED, если ожидание прервано
+ */
+static int perso_wait_card(CardPersoWorker* worker, int present) {
+    CardPersoPipeline* pipeline = worker->pipeline;
+    SCARD_READERSTATE state;
+    memset(&state, 0, sizeof(state));
+    state.szReader = worker->readerName;
+    state.dwCurrentState = SCARD_STATE_UNAWARE;
+    
+    for (;;) {
+        LONG result = SCardGetStatusChange(worker->presenceContext, PERSO_PRESENCE_TIMEOUT, &state, 1);
+        if (result == SCARD_S_SUCCESS) {
+            DWORD eventState = state.dwEventState;
+            state.dwCurrentState = eventState & ~SCARD_STATE_CHANGED;
+            
+            // Карта без ответа на сброс (MUTE) не персонализируется, её нужно извлечь
+            if (present && (eventState & SCARD_STATE_PRESENT) && !(eventState & SCARD_STATE_MUTE)) {
+                return CARD_SUCCESS;
+            }
+            if (!present && (eventState & SCARD_STATE_EMPTY)) {
+                return CARD_SUCCESS;
+            }
+        } else if (result != SCARD_E_TIMEOUT) {
+            return CARD_ERROR_CONNECT_FAILED;
+        }
+        
+        // Ожидание заканчивается вместе с заданиями: последнюю карту можно не извлекать
+        EnterCriticalSection(&pipeline->lock);
+        int finished = perso_work_finished(pipeline);
+        LeaveCriticalSection(&pipeline->lock);
+        
+        if (finished) {
+            return CARD_ERROR_CONNECT_FAILED;
+        }
+    }
+}
+
+static void perso_read_uid(CardPersoWorker* worker, CardPersoJob* job) {
+    CardData command = { (uint8_t*)uidCommand, sizeof(uidCommand), NULL };
+    CardData response = { NULL, 0, NULL };
+    
+    if (card_service_execute_command(&worker->service, &command, &response) == CARD_SUCCESS &&
+        response.length >= 2 && response.data[response.length - 2] == 0x90 &&
+        response.data[response.length - 1] == 0x00) {
+        size_t length = response.length - 2;
+        job->uidLength = length < CARD_PERSO_MAX_UID ? length : CARD_PERSO_MAX_UID;
+        memcpy(job->uid, response.data, job->uidLength);
+    }
+    
+    card_data_release(&response);
+}
+
+static int perso_write_card(CardPersoWorker* worker, CardPersoJob* job) {
+    const CardPersoConfig* config = &worker->pipeline->config;
+    
+    int result = card_service_connect(&worker->service, worker->readerName);
+    if (result != CARD_SUCCESS) {
+        return result;
+    }
+    
+    job->uidLength = 0;
+    if (config->readUid) {
+        perso_read_uid(worker, job);
+    }
+    
+    result = card_service_write_from(&worker->service, config->cardOffset, job->image, config->imageLength);
+    
+    if (result == CARD_SUCCESS && config->verify) {
+        result = card_service_read_into(&worker->service, config->cardOffset,
+                                        worker->verifyBuffer, config->imageLength);
+        if (result == CARD_SUCCESS && memcmp(worker->verifyBuffer, job->image, config->imageLength) != 0) {
+            result = CARD_ERROR_BAD_STATUS;
+        }
+    }
+    
+    // Снятие питания: следующая карта в считывателе начинает с холодного сброса
+    card_service_disconnect_with(&worker->service, CARD_DISPOSITION_UNPOWER);
+    return result;
+}
+
+static void perso_complete(CardPersoWorker* worker, CardPersoJob* job) {
+    CardPersoPipeline* pipeline = worker->pipeline;
+    size_t maxAttempts = pipeline->config.maxAttempts > 0 ? pipeline->config.maxAttempts : 1;
+    
+    EnterCriticalSection(&pipeline->lock);
+    pipeline->processing--;
+    
+    if (job->result != CARD_SUCCESS && job->attempts < maxAttempts && !pipeline->isStopping) {
+        // Повтор на следующей карте: запись возвращается в начало очереди
+        job->next = pipeline->readyHead;
+        pipeline->readyHead = job;
+        if (!pipeline->readyTail) {
+            pipeline->readyTail = job;
+        }
+        pipeline->stats.retries++;
+        WakeConditionVariable(&pipeline->jobReady);
+    } else {
+        push_back(&pipeline->resultHead, &pipeline->resultTail, job);
+        WakeConditionVariable(&pipeline->resultReady);
+    }
+    
+    if (perso_work_finished(pipeline)) {
+        WakeAllConditionVariable(&pipeline->jobReady);
+    }
+    LeaveCriticalSection(&pipeline->lock);
+}
+
+static CardPersoJob* perso_take_job(CardPersoPipeline* pipeline) {
+    EnterCriticalSection(&pipeline->lock);
+    while (!pipeline->readyHead && !perso_work_finished(pipeline)) {
+        SleepConditionVariableCS(&pipeline->jobReady, &pipeline->lock, INFINITE);
+    }
+    
+    CardPersoJob* job = NULL;
+    if (pipeline->readyHead && !pipeline->isStopping) {
+        job = pipeline->readyHead;
+        pipeline->readyHead = job->next;
+        if (!pipeline->readyHead) {
+            pipeline->readyTail = NULL;
+        }
+        job->next = NULL;
+        pipeline->processing++;
+    }
+    LeaveCriticalSection(&pipeline->lock);
+    
+    return job;
+}
+
+static DWORD WINAPI perso_worker_thread(LPVOID parameter) {
+    CardPersoWorker* worker = (CardPersoWorker*)parameter;
+    CardPersoPipeline* pipeline = worker->pipeline;
+    const CardPersoConfig* config = &pipeline->config;
+    int result = CARD_ERROR_MEMORY_ALLOCATION;
+    
+    // Контекст репозитория создаётся в потоке, который будет его использовать
+    worker->repositoryContext = calloc(1, config->contextSize);
+    worker->verifyBuffer = (uint8_t*)malloc(config->imageLength);
+    if (worker->repositoryContext && worker->verifyBuffer) {
+        worker->context.context = worker->repositoryContext;
+        result = card_service_initialize(&worker->service, config->repository, &worker->context);
+    }
+    
+    if (result == CARD_SUCCESS && config->waitForCards &&
+        SCardEstablishContext(SCARD_SCOPE_USER, NULL, NULL, &worker->presenceContext) != SCARD_S_SUCCESS) {
+        card_service_release(&worker->service);
+        result = CARD_ERROR_INIT_FAILED;
+    }
+    
+    if (result != CARD_SUCCESS) {
+        printf("Не удалось инициализировать поток считывателя %s: %d\n", worker->readerName, result);
+    }
+    
+    while (result == CARD_SUCCESS) {
+        // Задание берётся, только когда в считывателе есть карта
+        if (config->waitForCards && perso_wait_card(worker, 1) != CARD_SUCCESS) {
+            break;
+        }
+        
+        CardPersoJob* job = perso_take_job(pipeline);
+        if (!job) {
+            break;
+        }
+        
+        uint64_t started = card_metrics_now();
+        job->attempts++;
+        job->readerIndex = worker->index;
+        job->result = perso_write_card(worker, job);
+        job->elapsed = card_metrics_now() - started;
+        
+        InterlockedIncrement(job->result == CARD_SUCCESS ? &worker->personalized : &worker->failed);
+        perso_complete(worker, job);
+        
+        if (config->waitForCards && perso_wait_card(worker, 0) != CARD_SUCCESS) {
+            break;
+        }
+    }
+    
+    if (result == CARD_SUCCESS) {
+        if (config->waitForCards) {
+            SCardReleaseContext(worker->presenceContext);
+        }
+        card_service_release(&worker->service);
+    }
+    free(worker->verifyBuffer);
+    free(worker->repositoryContext);
+    worker->verifyBuffer = NULL;
+    worker->repositoryContext = NULL;
+    
+    // Без потоков считывателей оставшиеся записи обработать некому
+    EnterCriticalSection(&pipeline->lock);
+    pipeline->workersRunning--;
+    if (pipeline->workersRunning == 0) {
+        if (!pipeline->parseDone || pipeline->readyHead) {
+            InterlockedExchange(&pipeline->isStopping, 1);
+        }
+        WakeAllConditionVariable(&pipeline->slotFree);
+        WakeAllConditionVariable(&pipeline->resultReady);
+    }
+    LeaveCriticalSection(&pipeline->lock);
+    
+    return 0;
+}
+
+/* ---- Стадия журнала ---- */
+
+static void journal_write(CardPersoPipeline* pipeline, const CardPersoJob* job) {
+    FILE* journal = pipeline->journal;
+    
+    fprintf(journal, "%zu,", job->recordIndex);
+    if (job->readerIndex == PERSO_NO_READER) {
+        fprintf(journal, "-,");
+    } else {
+        fprintf(journal, "%zu,", job->readerIndex);
+    }
+    fprintf(journal, "%zu,%d,", job->attempts, job->result);
+    for (size_t i = 0; i < job->uidLength; i++) {
+        fprintf(journal, "%02X", job->uid[i]);
+    }
+    fprintf(journal, ",%.3f\n", (double)job->elapsed / 1000000.0);
+}
+
+static DWORD WINAPI perso_journal_thread(LPVOID parameter) {
+    CardPersoPipeline* pipeline = (CardPersoPipeline*)parameter;
+    
+    for (;;) {
+        EnterCriticalSection(&pipeline->lock);
+        while (!pipeline->resultHead && !(pipeline->parseDone && pipeline->workersRunning == 0)) {
+            SleepConditionVariableCS(&pipeline->resultReady, &pipeline->lock, INFINITE);
+        }
+        
+        // Результаты забираются пачкой, запись в файл идёт без блокировки
+        CardPersoJob* batch = pipeline->resultHead;
+        pipeline->resultHead = NULL;
+        pipeline->resultTail = NULL;
+        LeaveCriticalSection(&pipeline->lock);
+        
+        if (!batch) {
+            break;
+        }
+        
+        size_t personalized = 0;
+        size_t failed = 0;
+        CardPersoJob* last = batch;
+        for (CardPersoJob* job = batch; job; job = job->next) {
+            journal_write(pipeline, job);
+            if (job->result == CARD_SUCCESS) {
+                personalized++;
+            } else if (job->readerIndex != PERSO_NO_READER) {
+                failed++;
+            }
+            last = job;
+        }
+        
+        // Журнал сбрасывается, когда очередь пуста: на ходу записи копятся в буфере
+        EnterCriticalSection(&pipeline->lock);
+        int idle = pipeline->resultHead == NULL;
+        LeaveCriticalSection(&pipeline->lock);
+        if (idle && fflush(pipeline->journal) != 0) {
+            pipeline->journalFailed = 1;
+        }
+        
+        EnterCriticalSection(&pipeline->lock);
+        last->next = pipeline->freeSlots;
+        pipeline->freeSlots = batch;
+        pipeline->stats.personalized += personalized;
+        pipeline->stats.failed += failed;
+        WakeConditionVariable(&pipeline->slotFree);
+        LeaveCriticalSection(&pipeline->lock);
+    }
+    
+    if (fflush(pipeline->journal) != 0 || ferror(pipeline->journal)) {
+        pipeline->journalFailed = 1;
+    }
+    
+    return 0;
+}
+
+/* ---- Стадия разбора ---- */
+
+static CardPersoJob* perso_take_slot(CardPersoPipeline* pipeline) {
+    EnterCriticalSection(&pipeline->lock);
+    while (!pipeline->freeSlots && !pipeline->isStopping) {
+        SleepConditionVariableCS(&pipeline->slotFree, &pipeline->lock, INFINITE);
+    }
+    
+    CardPersoJob* job = pipeline->isStopping ? NULL : pipeline->freeSlots;
+    if (job) {
+        pipeline->freeSlots = job->next;
+        job->next = NULL;
+    }
+    LeaveCriticalSection(&pipeline->lock);
+    
+    return job;
+}
+
+/**
+ * Поиск следующей записи во входном файле
+ * @return 1 и границы записи или 0 в конце файла
+ */
+static int perso_next_record(CardPersoPipeline* pipeline, size_t* position, const uint8_t** record, size_t* length) {
+    const CardPersoConfig* config = &pipeline->config;
+    
+    if (config->format == CARD_PERSO_INPUT_BINARY) {
+        if (pipeline->inputSize - *position < config->recordSize) {
+            return 0;
+        }
+        *record = pipeline->input + *position;
+        *length = config->recordSize;
+        *position += config->recordSize;
+        return 1;
+    }
+    
+    while (*position < pipeline->inputSize) {
+        const uint8_t* begin = pipeline->input + *position;
+        size_t rest = pipeline->inputSize - *position;
+        const uint8_t* end = (const uint8_t*)memchr(begin, '\n', rest);
+        size_t lineLength = end ? (size_t)(end - begin) : rest;
+        
+        *position += lineLength + (end ? 1 : 0);
+        if (lineLength > 0 && begin[lineLength - 1] == '\r') {
+            lineLength--;
+        }
+        
+        // Пустые строки пропускаются
+        if (lineLength > 0) {
+            *record = begin;
+            *length = lineLength;
+            return 1;
+        }
+    }
+    
+    return 0;
+}
+
+static void perso_parse(CardPersoPipeline* pipeline) {
+    const CardPersoConfig* config = &pipeline->config;
+    size_t position = 0;
+    size_t recordIndex = 0;
+    const uint8_t* record = NULL;
+    size_t length = 0;
+    
+    if (config->format == CARD_PERSO_INPUT_CSV && config->skipHeader) {
+        perso_next_record(pipeline, &position, &record, &length);
+    }
+    
+    while (perso_next_record(pipeline, &position, &record, &length)) {
+        CardPersoJob* job = perso_take_slot(pipeline);
+        if (!job) {
+            break;
+        }
+        
+        job->recordIndex = recordIndex++;
+        job->attempts = 0;
+        job->readerIndex = PERSO_NO_READER;
+        job->uidLength = 0;
+        job->elapsed = 0;
+        
+        if (config->templateImage) {
+            memcpy(job->image, config->templateImage, config->imageLength);
+        } else {
+            memset(job->image, 0, config->imageLength);
+        }
+        
+        job->result = config->format == CARD_PERSO_INPUT_BINARY ?
+                      build_binary_image(config, record, job->image) :
+                      build_csv_image(config, (const char*)record, length, job->image);
+        
+        // Неразобранная запись сразу уходит в журнал
+        EnterCriticalSection(&pipeline->lock);
+        pipeline->stats.records++;
+        if (job->result == CARD_SUCCESS) {
+            push_back(&pipeline->readyHead, &pipeline->readyTail, job);
+            WakeConditionVariable(&pipeline->jobReady);
+        } else {
+            pipeline->stats.malformed++;
+            push_back(&pipeline->resultHead, &pipeline->resultTail, job);
+            WakeConditionVariable(&pipeline->resultReady);
+        }
+        LeaveCriticalSection(&pipeline->lock);
+    }
+    
+    EnterCriticalSection(&pipeline->lock);
+    pipeline->parseDone = 1;
+    WakeAllConditionVariable(&pipeline->jobReady);
+    WakeAllConditionVariable(&pipeline->resultReady);
+    LeaveCriticalSection(&pipeline->lock);
+}
+
+/* ---- Запуск ---- */
+
+static int perso_validate(const CardPersoConfig* config) {
+    if (!config->repository || !config->readerNames || config->readerCount == 0 ||
+        config->contextSize == 0 || config->imageLength == 0 ||
+        (size_t)config->cardOffset + config->imageLength > CARD_SERVICE_MAX_OFFSET + 1 ||
+        config->fieldCount > CARD_PERSO_MAX_FIELDS || (config->fieldCount > 0 && !config->fields)) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    if (config->format == CARD_PERSO_INPUT_BINARY && config->recordSize == 0) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    for (size_t i = 0; i < config->fieldCount; i++) {
+        const CardPersoField* field = &config->fields[i];
+        if (field->imageOffset + field->length > config->imageLength) {
+            return CARD_ERROR_INVALID_PARAMETER;
+        }
+        if (config->format == CARD_PERSO_INPUT_BINARY &&
+            (field->encoding != CARD_PERSO_FIELD_RAW || field->source + field->length > config->recordSize)) {
+            return CARD_ERROR_INVALID_PARAMETER;
+        }
+        if (config->format == CARD_PERSO_INPUT_CSV &&
+            (field->encoding == CARD_PERSO_FIELD_RAW || field->source >= CARD_PERSO_MAX_FIELDS)) {
+            return CARD_ERROR_INVALID_PARAMETER;
+        }
+    }
+    
+    return CARD_SUCCESS;
+}
+
+static int perso_open_input(CardPersoPipeline* pipeline, const char* path) {
+    pipeline->inputFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                                      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (pipeline->inputFile == INVALID_HANDLE_VALUE) {
+        printf("Ошибка при открытии входного файла: %lu\n", (unsigned long)GetLastError());
+        pipeline->inputFile = NULL;
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(pipeline->inputFile, &size)) {
+        printf("Ошибка при открытии входного файла: %lu\n", (unsigned long)GetLastError());
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    // Пустой файл не отображается: записей нет
+    pipeline->inputSize = (size_t)size.QuadPart;
+    if (pipeline->inputSize == 0) {
+        return CARD_SUCCESS;
+    }
+    
+    pipeline->inputMapping = CreateFileMappingA(pipeline->inputFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!pipeline->inputMapping) {
+        printf("Ошибка при отображении входного файла: %lu\n", (unsigned long)GetLastError());
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    pipeline->input = (const uint8_t*)MapViewOfFile(pipeline->inputMapping, FILE_MAP_READ, 0, 0, 0);
+    if (!pipeline->input) {
+        printf("Ошибка при отображении входного файла: %lu\n", (unsigned long)GetLastError());
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    return CARD_SUCCESS;
+}
+
+static void perso_cleanup(CardPersoPipeline* pipeline) {
+    if (pipeline->input) {
+        UnmapViewOfFile((LPVOID)pipeline->input);
+    }
+    if (pipeline->inputMapping) {
+        CloseHandle(pipeline->inputMapping);
+    }
+    if (pipeline->inputFile) {
+        CloseHandle(pipeline->inputFile);
+    }
+    if (pipeline->journal && fclose(pipeline->journal) != 0) {
+        pipeline->journalFailed = 1;
+    }
+    
+    free(pipeline->workers);
+    free(pipeline->slots);
+    free(pipeline->images);
+    pipeline->input = NULL;
+    pipeline->inputMapping = NULL;
+    pipeline->inputFile = NULL;
+    pipeline->journal = NULL;
+    pipeline->workers = NULL;
+    pipeline->slots = NULL;
+    pipeline->images = NULL;
+}
+
+void card_perso_default_config(CardPersoConfig* config) {
+    if (!config) {
+        return;
+    }
+    
+    memset(config, 0, sizeof(CardPersoConfig));
+    config->format = CARD_PERSO_INPUT_BINARY;
+    config->verify = 1;
+    config->maxAttempts = 1;
+}
+
+int card_perso_run(CardPersoPipeline* pipeline, const CardPersoConfig* config,
+                   const char* inputPath, const char* journalPath) {
+    if (!pipeline || !config || !inputPath || !journalPath) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    int result = perso_validate(config);
+    if (result != CARD_SUCCESS) {
+        return result;
+    }
+    
+    memset(pipeline, 0, sizeof(CardPersoPipeline));
+    pipeline->config = *config;
+    
+    result = perso_open_input(pipeline, inputPath);
+    if (result != CARD_SUCCESS) {
+        perso_cleanup(pipeline);
+        return result;
+    }
+    
+    pipeline->journal = fopen(journalPath, "ab");
+    if (!pipeline->journal) {
+        perso_cleanup(pipeline);
+        return CARD_ERROR_INIT_FAILED;
+    }
+    setvbuf(pipeline->journal, NULL, _IOFBF, PERSO_JOURNAL_BUFFER);
+    
+    // Заголовок пишется только в новый журнал, прерванный запуск дописывается
+    fseek(pipeline->journal, 0, SEEK_END);
+    if (ftell(pipeline->journal) == 0) {
+        fprintf(pipeline->journal, "record,reader,attempts,result,uid,ms\n");
+    }
+    
+    // Несколько слотов на считыватель: пока карта пишется, следующие образы уже готовы
+    pipeline->workerCount = config->readerCount;
+    pipeline->slotCount = config->readerCount * CARD_PERSO_SLOTS_PER_READER;
+    pipeline->workers = (CardPersoWorker*)calloc(pipeline->workerCount, sizeof(CardPersoWorker));
+    pipeline->slots = (CardPersoJob*)calloc(pipeline->slotCount, sizeof(CardPersoJob));
+    pipeline->images = (uint8_t*)malloc(pipeline->slotCount * config->imageLength);
+    if (!pipeline->workers || !pipeline->slots || !pipeline->images) {
+        perso_cleanup(pipeline);
+        return CARD_ERROR_MEMORY_ALLOCATION;
+    }
+    
+    for (size_t i = 0; i < pipeline->slotCount; i++) {
+        pipeline->slots[i].image = pipeline->images + i * config->imageLength;
+        pipeline->slots[i].next = i + 1 < pipeline->slotCount ? &pipeline->slots[i + 1] : NULL;
+    }
+    pipeline->freeSlots = &pipeline->slots[0];
+    
+    InitializeCriticalSection(&pipeline->lock);
+    InitializeConditionVariable(&pipeline->slotFree);
+    InitializeConditionVariable(&pipeline->jobReady);
+    InitializeConditionVariable(&pipeline->resultReady);
+    pipeline->workersRunning = pipeline->workerCount;
+    
+    uint64_t started = card_metrics_now();
+    
+    HANDLE journalThread = CreateThread(NULL, 0, perso_journal_thread, pipeline, 0, NULL);
+    if (!journalThread) {
+        DeleteCriticalSection(&pipeline->lock);
+        perso_cleanup(pipeline);
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    for (size_t i = 0; i < pipeline->workerCount; i++) {
+        CardPersoWorker* worker = &pipeline->workers[i];
+        worker->pipeline = pipeline;
+        worker->index = i;
+        worker->readerName = config->readerNames[i];
+        
+        worker->thread = CreateThread(NULL, 0, perso_worker_thread, worker, 0, NULL);
+        if (!worker->thread) {
+            printf("Ошибка при создании потока считывателя %s\n", worker->readerName);
+            EnterCriticalSection(&pipeline->lock);
+            pipeline->workersRunning--;
+            if (pipeline->workersRunning == 0) {
+                InterlockedExchange(&pipeline->isStopping, 1);
+            }
+            LeaveCriticalSection(&pipeline->lock);
+        }
+    }
+    
+    // Разбор идёт в вызывающем потоке
+    perso_parse(pipeline);
+    
+    for (size_t i = 0; i < pipeline->workerCount; i++) {
+        if (pipeline->workers[i].thread) {
+            WaitForSingleObject(pipeline->workers[i].thread, INFINITE);
+            CloseHandle(pipeline->workers[i].thread);
+            pipeline->workers[i].thread = NULL;
+        }
+    }
+    WaitForSingleObject(journalThread, INFINITE);
+    CloseHandle(journalThread);
+    
+    pipeline->stats.elapsed = card_metrics_now() - started;
+    if (pipeline->stats.elapsed > 0) {
+        pipeline->stats.cardsPerHour = (double)pipeline->stats.personalized * 3600.0 * 1e9 /
+                                       (double)pipeline->stats.elapsed;
+    }
+    
+    int stopped = pipeline->isStopping != 0;
+    DeleteCriticalSection(&pipeline->lock);
+    perso_cleanup(pipeline);
+    
+    if (pipeline->journalFailed || stopped) {
+        return CARD_ERROR_INIT_FAILED;
+    }
+    return CARD_SUCCESS;
+}
+
+int card_perso_cancel(CardPersoPipeline* pipeline) {
+    if (!pipeline || !pipeline->workers) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    EnterCriticalSection(&pipeline->lock);
+    InterlockedExchange(&pipeline->isStopping, 1);
+    WakeAllConditionVariable(&pipeline->slotFree);
+    WakeAllConditionVariable(&pipeline->jobReady);
+    WakeAllConditionVariable(&pipeline->resultReady);
+    LeaveCriticalSection(&pipeline->lock);
+    
+    // Ожидание карты прерывается сразу, не дожидаясь периода проверки
+    for (size_t i = 0; i < pipeline->workerCount; i++) {
+        if (pipeline->workers[i].presenceContext) {
+            SCardCancel(pipeline->workers[i].presenceContext);
+        }
+    }
+    
+    return CARD_SUCCESS;
+} 
\ No newline at end of file
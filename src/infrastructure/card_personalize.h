@@ -0,0 +1,170 @@
+#ifndef CARD_PERSONALIZE_H
+#define CARD_PERSONALIZE_H
+
+#include <windows.h>
+#include <winscard.h>
+#include <stdio.h>
+#include "card_domain.h"
+#include "card_service.h"
+
+/**
+ * Слой инфраструктуры (Infrastructure Layer)
+ * Конвейер массовой персонализации карт. Три стадии работают в своих потоках:
+ * разбор входного файла (отображается в память) в образы карт, запись с
+ * проверкой на каждом считывателе, где есть карта, и запись результатов в
+ * журнал. Стадии связаны очередями фиксированного числа слотов, поэтому
+ * разбор и журнал не задерживают обмен с картами, а память не растёт
+ * с размером входного файла.
+ */
+
+#define CARD_PERSO_MAX_FIELDS 32
+#define CARD_PERSO_MAX_UID 10
+#define CARD_PERSO_SLOTS_PER_READER 4
+
+typedef enum {
+    CARD_PERSO_INPUT_BINARY = 0,     /* Записи фиксированной длины recordSize */
+    CARD_PERSO_INPUT_CSV = 1         /* Строки с полями через запятую, без кавычек */
+} CardPersoInputFormat;
+
+typedef enum {
+    CARD_PERSO_FIELD_RAW = 0,        /* Байты записи как есть (двоичный вход) */
+    CARD_PERSO_FIELD_HEX = 1,        /* Поле CSV в шестнадцатеричном виде */
+    CARD_PERSO_FIELD_TEXT = 2        /* Поле CSV как текст, дополняется нулями */
+} CardPersoFieldEncoding;
+
+/**
+ * Поле записи и его место в образе карты
+ */
+typedef struct {
+    size_t source;                   /* Смещение в двоичной записи или номер столбца CSV */
+    size_t imageOffset;              /* Смещение в образе карты */
+    size_t length;                   /* Длина в образе; короткое поле дополняется нулями */
+    CardPersoFieldEncoding encoding;
+} CardPersoField;
+
+typedef struct {
+    CardRepository* repository;      /* Репозиторий, общий для всех потоков считывателей */
+    size_t contextSize;              /* Размер контекста репозитория, например sizeof(WinScardContext) */
+    const char* const* readerNames;
+    size_t readerCount;
+    
+    CardPersoInputFormat format;
+    size_t recordSize;               /* Длина двоичной записи */
+    int skipHeader;                  /* Первая строка CSV — заголовок */
+    
+    /* Образ карты: шаблон, поверх которого раскладываются поля записи.
+       Без полей двоичная запись целиком становится образом, а столбцы CSV
+       в шестнадцатеричном виде записываются подряд. */
+    const uint8_t* templateImage;    /* Может быть NULL — образ заполняется нулями */
+    size_t imageLength;
+    uint16_t cardOffset;             /* Адрес образа в памяти карты */
+    const CardPersoField* fields;
+    size_t fieldCount;
+    
+    int verify;                      /* Чтение образа после записи и сравнение */
+    int readUid;                     /* UID карты (FF CA) в журнале */
+    size_t maxAttempts;              /* Попыток на запись с разными картами, 0 — одна */
+    int waitForCards;                /* Ожидать установки и извлечения карты (PC/SC); 0 — подключаться сразу */
+} CardPersoConfig;
+
+/**
+ * Задание конвейера: запись входного файла и её образ
+ */
+typedef struct CardPersoJob {
+    size_t recordIndex;
+    uint8_t* image;
+    size_t attempts;
+    size_t readerIndex;
+    int result;                      /* Код ошибки из CardError */
+    uint8_t uid[CARD_PERSO_MAX_UID];
+    size_t uidLength;
+    uint64_t elapsed;                /* Длительность последней попытки, нс */
+    struct CardPersoJob* next;
+} CardPersoJob;
+
+typedef struct CardPersoPipeline CardPersoPipeline;
+
+typedef struct {
+    CardPersoPipeline* pipeline;
+    size_t index;
+    const char* readerName;
+    HANDLE thread;
+    CardService service;
+    CardContext context;
+    void* repositoryContext;
+    SCARDCONTEXT presenceContext;    /* Отслеживание карты при waitForCards */
+    uint8_t* verifyBuffer;
+    volatile LONG personalized;      /* Карт записано этим считывателем */
+    volatile LONG failed;
+} CardPersoWorker;
+
+typedef struct {
+    size_t records;                  /* Записей разобрано */
+    size_t personalized;
+    size_t failed;                   /* Записей без успешной карты после всех попыток */
+    size_t retries;
+    size_t malformed;                /* Записей, не разобранных в образ */
+    uint64_t elapsed;                /* Длительность запуска, нс */
+    double cardsPerHour;
+} CardPersoStats;
+
+struct CardPersoPipeline {
+    CardPersoConfig config;
+    HANDLE inputFile;
+    HANDLE inputMapping;
+    const uint8_t* input;
+    size_t inputSize;
+    FILE* journal;
+    
+    CardPersoWorker* workers;
+    size_t workerCount;
+    CardPersoJob* slots;
+    uint8_t* images;
+    size_t slotCount;
+    
+    CRITICAL_SECTION lock;           /* Защищает три очереди и счётчики ниже */
+    CONDITION_VARIABLE slotFree;
+    CONDITION_VARIABLE jobReady;
+    CONDITION_VARIABLE resultReady;
+    CardPersoJob* freeSlots;
+    CardPersoJob* readyHead;
+    CardPersoJob* readyTail;
+    CardPersoJob* resultHead;
+    CardPersoJob* resultTail;
+    size_t processing;               /* Заданий в работе у потоков считывателей */
+    size_t workersRunning;
+    int parseDone;
+    volatile LONG isStopping;
+    int journalFailed;
+    
+    CardPersoStats stats;
+};
+
+/**
+ * Параметры по умолчанию: двоичный вход, проверка записи, одна попытка
+ * @param config Структура параметров
+ */
+void card_perso_default_config(CardPersoConfig* config);
+
+/**
+ * Запуск персонализации и ожидание её завершения
+ * Входной файл отображается в память; журнал (CSV: запись, считыватель,
+ * попытки, результат, UID, мс) дописывается в конец файла.
+ * @param pipeline Структура конвейера (память вызывающего)
+ * @param config Параметры
+ * @param inputPath Файл персонализационных данных
+ * @param journalPath Файл журнала результатов
+ * @return CARD_SUCCESS, если входной файл обработан до конца, иначе код ошибки из CardError
+ */
+int card_perso_run(CardPersoPipeline* pipeline, const CardPersoConfig* config,
+                   const char* inputPath, const char* journalPath);
+
+/**
+ * Прерывание персонализации из другого потока
+ * Карты, запись которых уже начата, дописываются; новые задания не выдаются.
+ * @param pipeline Указатель на конвейер
+ * @return Код ошибки из CardError
+ */
+int card_perso_cancel(CardPersoPipeline* pipeline);
+
+#endif /* CARD_PERSONALIZE_H */ 
\ No newline at end of file
@@ -0,0 +1,573 @@
+#include "card_replay.h"
+#include "card_metrics.h"
+#include "card_simulator.h"
+#include <string.h>
+#include <stdlib.h>
+
+#define REPLAY_RECORD_HEADER 17
+#define REPLAY_MAGIC_LENGTH 8
+
+static void put32(uint8_t* target, uint32_t value) {
+    target[0] = (uint8_t)value;
+    target[1] = (uint8_t)(value >> 8);
+    target[2] = (uint8_t)(value >> 16);
+    target[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t get32(const uint8_t* source) {
+    return (uint32_t)source[0] | ((uint32_t)source[1] << 8) |
+           ((uint32_t)source[2] << 16) | ((uint32_t)source[3] << 24);
+}
+
+static CardRecorderContext* get_recorder_context(CardContext* context) {
+    if (!context || !context->context) {
+        return NULL;
+    }
+    return (CardRecorderContext*)context->context;
+}
+
+static CardReplayContext* get_replay_context(CardContext* context) {
+    if (!context || !context->context) {
+        return NULL;
+    }
+    return (CardReplayContext*)context->context;
+}
+
+/* ---- Запись ---- */
+
+static void recorder_write(CardRecorderContext* recorder, CardReplayRecordType type, uint64_t elapsed,
+                           int result, const uint8_t* first, size_t firstLength,
+                           const uint8_t* second, size_t secondLength) {
+    if (!recorder->file) {
+        return;
+    }
+    
+    uint64_t micros = elapsed / 1000;
+    uint8_t header[REPLAY_RECORD_HEADER];
+    header[0] = (uint8_t)type;
+    put32(header + 1, micros > 0xFFFFFFFFULL ? 0xFFFFFFFFUL : (uint32_t)micros);
+    put32(header + 5, (uint32_t)result);
+    put32(header + 9, (uint32_t)firstLength);
+    put32(header + 13, (uint32_t)secondLength);
+    
+    if (fwrite(header, sizeof(header), 1, recorder->file) != 1 ||
+        (firstLength > 0 && fwrite(first, firstLength, 1, recorder->file) != 1) ||
+        (secondLength > 0 && fwrite(second, secondLength, 1, recorder->file) != 1)) {
+        recorder->writeFailed = 1;
+        return;
+    }
+    
+    recorder->recorded++;
+}
+
+int card_recorder_open(CardRecorderContext* recorder, CardRepository* inner, CardContext* innerContext,
+                       const char* path) {
+    if (!recorder || !inner || !innerContext || !path) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    memset(recorder, 0, sizeof(CardRecorderContext));
+    recorder->inner = inner;
+    recorder->innerContext = innerContext;
+    
+    recorder->file = fopen(path, "wb");
+    if (!recorder->file) {
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    // Крупный буфер: запись в файл не должна заметно менять длительность обмена
+    setvbuf(recorder->file, NULL, _IOFBF, 64 * 1024);
+    
+    if (fwrite(CARD_REPLAY_MAGIC, REPLAY_MAGIC_LENGTH, 1, recorder->file) != 1) {
+        fclose(recorder->file);
+        recorder->file = NULL;
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    return CARD_SUCCESS;
+}
+
+int card_recorder_close(CardRecorderContext* recorder) {
+    if (!recorder || !recorder->file) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    if (fclose(recorder->file) != 0) {
+        recorder->writeFailed = 1;
+    }
+    recorder->file = NULL;
+    
+    return recorder->writeFailed ? CARD_ERROR_INIT_FAILED : CARD_SUCCESS;
+}
+
+static int recorder_initialize(CardContext* context) {
+    CardRecorderContext* recorder = get_recorder_context(context);
+    if (!recorder) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    return recorder->inner->initialize(recorder->innerContext);
+}
+
+static int recorder_list_readers(CardContext* context, char*** readers, size_t* readersCount) {
+    CardRecorderContext* recorder = get_recorder_context(context);
+    if (!recorder) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    return recorder->inner->list_readers(recorder->innerContext, readers, readersCount);
+}
+
+static int recorder_connect(CardContext* context, const char* readerName) {
+    CardRecorderContext* recorder = get_recorder_context(context);
+    if (!recorder) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    uint64_t started = card_metrics_now();
+    int result = recorder->inner->connect(recorder->innerContext, readerName);
+    recorder_write(recorder, CARD_REPLAY_RECORD_CONNECT, card_metrics_now() - started, result, NULL, 0, NULL, 0);
+    
+    return result;
+}
+
+static int recorder_disconnect(CardContext* context) {
+    CardRecorderContext* recorder = get_recorder_context(context);
+    if (!recorder) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    if (recorder->file) {
+        fflush(recorder->file);
+    }
+    return recorder->inner->disconnect(recorder->innerContext);
+}
+
+static int recorder_release(CardContext* context) {
+    CardRecorderContext* recorder = get_recorder_context(context);
+    if (!recorder) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    return recorder->inner->release(recorder->innerContext);
+}
+
+static int recorder_transmit(CardContext* context, const uint8_t* command, size_t commandLength,
+                             uint8_t* response, size_t* responseLength) {
+    CardRecorderContext* recorder = get_recorder_context(context);
+    if (!recorder) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    uint64_t started = card_metrics_now();
+    int result = recorder->inner->transmit(recorder->innerContext, command, commandLength,
+                                           response, responseLength);
+    uint64_t elapsed = card_metrics_now() - started;
+    
+    recorder_write(recorder, CARD_REPLAY_RECORD_TRANSMIT, elapsed, result, command, commandLength,
+                   response, result == CARD_SUCCESS ? *responseLength : 0);
+    return result;
+}
+
+static int recorder_get_info(CardContext* context, CardInfo* info) {
+    CardRecorderContext* recorder = get_recorder_context(context);
+    if (!recorder) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    int result = recorder->inner->get_info(recorder->innerContext, info);
+    if (result != CARD_SUCCESS) {
+        return result;
+    }
+    
+    if (!recorder->hasInfo || info->atrLength != recorder->lastInfo.atrLength ||
+        memcmp(info->atr, recorder->lastInfo.atr, info->atrLength) != 0 ||
+        info->extendedLength != recorder->lastInfo.extendedLength ||
+        info->maxCommandData != recorder->lastInfo.maxCommandData ||
+        info->maxResponseData != recorder->lastInfo.maxResponseData) {
+        // Сведения: длина ATR, ATR, признак расширенной длины, два ограничения
+        uint8_t payload[1 + CARD_ATR_MAX_LENGTH + 1 + 8];
+        size_t length = 0;
+        payload[length++] = (uint8_t)info->atrLength;
+        memcpy(payload + length, info->atr, info->atrLength);
+        length += info->atrLength;
+        payload[length++] = (uint8_t)(info->extendedLength != 0);
+        put32(payload + length, (uint32_t)info->maxCommandData);
+        put32(payload + length + 4, (uint32_t)info->maxResponseData);
+        length += 8;
+        
+        recorder_write(recorder, CARD_REPLAY_RECORD_INFO, 0, CARD_SUCCESS, payload, length, NULL, 0);
+        recorder->lastInfo = *info;
+        recorder->hasInfo = 1;
+    }
+    
+    return CARD_SUCCESS;
+}
+
+static int recorder_transmit_batch(CardContext* context, CardBatchItem* items, size_t count,
+                                   CardBatchPolicy policy, size_t* executed) {
+    CardRecorderContext* recorder = get_recorder_context(context);
+    if (!recorder) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    if (!recorder->inner->transmit_batch) {
+        return card_batch_execute(context, recorder_transmit, items, count, policy, executed);
+    }
+    
+    size_t done = 0;
+    uint64_t started = card_metrics_now();
+    int result = recorder->inner->transmit_batch(recorder->innerContext, items, count, policy, &done);
+    uint64_t elapsed = card_metrics_now() - started;
+    
+    for (size_t i = 0; i < done; i++) {
+        recorder_write(recorder, CARD_REPLAY_RECORD_TRANSMIT, elapsed / done, items[i].result,
+                       items[i].command, items[i].commandLength,
+                       items[i].response, items[i].result == CARD_SUCCESS ? items[i].responseLength : 0);
+    }
+    
+    if (executed) {
+        *executed = done;
+    }
+    return result;
+}
+
+static int recorder_reconnect(CardContext* context, CardDisposition initialization) {
+    CardRecorderContext* recorder = get_recorder_context(context);
+    if (!recorder || !recorder->inner->reconnect) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    uint64_t started = card_metrics_now();
+    int result = recorder->inner->reconnect(recorder->innerContext, initialization);
+    recorder_write(recorder, CARD_REPLAY_RECORD_CONNECT, card_metrics_now() - started, result, NULL, 0, NULL, 0);
+    
+    return result;
+}
+
+static int recorder_disconnect_with(CardContext* context, CardDisposition disposition) {
+    CardRecorderContext* recorder = get_recorder_context(context);
+    if (!recorder) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    if (recorder->file) {
+        fflush(recorder->file);
+    }
+    if (!recorder->inner->disconnect_with) {
+        return recorder->inner->disconnect(recorder->innerContext);
+    }
+    return recorder->inner->disconnect_with(recorder->innerContext, disposition);
+}
+
+CardRepository card_recorder_create_repository() {
+    CardRepository repository = {
+        .initialize = recorder_initialize,
+        .list_readers = recorder_list_readers,
+        .connect = recorder_connect,
+        .disconnect = recorder_disconnect,
+        .release = recorder_release,
+        .transmit = recorder_transmit,
+        .get_info = recorder_get_info,
+        .transmit_batch = recorder_transmit_batch,
+        .reconnect = recorder_reconnect,
+        .disconnect_with = recorder_disconnect_with
+    };
+    
+    return repository;
+}
+
+/* ---- Воспроизведение ---- */
+
+/**
+ * Разбор сведений о карте из записи
+ */
+static int replay_parse_info(const uint8_t* payload, size_t length, CardInfo* info) {
+    if (length < 1 || payload[0] > CARD_ATR_MAX_LENGTH || length != (size_t)payload[0] + 10) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    memset(info, 0, sizeof(CardInfo));
+    info->atrLength = payload[0];
+    memcpy(info->atr, payload + 1, info->atrLength);
+    info->extendedLength = payload[1 + info->atrLength];
+    info->maxCommandData = get32(payload + 2 + info->atrLength);
+    info->maxResponseData = get32(payload + 6 + info->atrLength);
+    
+    return CARD_SUCCESS;
+}
+
+/**
+ * Проверка структуры всех записей сессии
+ */
+static int replay_validate(const uint8_t* session, size_t size) {
+    size_t position = REPLAY_MAGIC_LENGTH;
+    
+    while (position < size) {
+        if (size - position < REPLAY_RECORD_HEADER) {
+            return CARD_ERROR_INVALID_PARAMETER;
+        }
+        
+        const uint8_t* record = session + position;
+        size_t firstLength = get32(record + 9);
+        size_t secondLength = get32(record + 13);
+        if (record[0] > CARD_REPLAY_RECORD_INFO ||
+            firstLength > size - position - REPLAY_RECORD_HEADER ||
+            secondLength > size - position - REPLAY_RECORD_HEADER - firstLength) {
+            return CARD_ERROR_INVALID_PARAMETER;
+        }
+        
+        position += REPLAY_RECORD_HEADER + firstLength + secondLength;
+    }
+    
+    return CARD_SUCCESS;
+}
+
+/**
+ * Следующая запись с применением встреченных сведений о карте
+ * @return Указатель на запись или NULL в конце сессии
+ */
+static const uint8_t* replay_next(CardReplayContext* replay) {
+    for (int wrapped = 0; ; ) {
+        if (replay->position >= replay->size) {
+            if (!replay->loop || wrapped) {
+                return NULL;
+            }
+            replay->position = REPLAY_MAGIC_LENGTH;
+            wrapped = 1;
+            continue;
+        }
+        
+        const uint8_t* record = replay->session + replay->position;
+        if (record[0] != CARD_REPLAY_RECORD_INFO) {
+            return record;
+        }
+        
+        if (replay_parse_info(record + REPLAY_RECORD_HEADER, get32(record + 9), &replay->info) == CARD_SUCCESS) {
+            replay->hasInfo = 1;
+        }
+        replay->position += REPLAY_RECORD_HEADER + get32(record + 9) + get32(record + 13);
+    }
+}
+
+static void replay_delay(CardReplayContext* replay, uint32_t micros) {
+    switch (replay->timing) {
+        case CARD_REPLAY_ORIGINAL_TIMING:
+            card_simulator_delay(micros);
+            break;
+        case CARD_REPLAY_SCALED_TIMING:
+            card_simulator_delay((uint32_t)((double)micros * replay->timeScale));
+            break;
+        default:
+            break;
+    }
+}
+
+int card_replay_open(CardReplayContext* replay, const char* path, CardReplayTiming timing, double timeScale) {
+    if (!replay || !path || timing < CARD_REPLAY_ORIGINAL_TIMING || timing > CARD_REPLAY_SCALED_TIMING ||
+        (timing == CARD_REPLAY_SCALED_TIMING && timeScale < 0.0)) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    memset(replay, 0, sizeof(CardReplayContext));
+    replay->timing = timing;
+    replay->timeScale = timeScale;
+    
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    
+    if (size < REPLAY_MAGIC_LENGTH) {
+        fclose(file);
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    replay->session = (uint8_t*)malloc((size_t)size);
+    if (!replay->session) {
+        fclose(file);
+        return CARD_ERROR_MEMORY_ALLOCATION;
+    }
+    
+    size_t read = fread(replay->session, 1, (size_t)size, file);
+    fclose(file);
+    
+    if (read != (size_t)size || memcmp(replay->session, CARD_REPLAY_MAGIC, REPLAY_MAGIC_LENGTH) != 0 ||
+        replay_validate(replay->session, (size_t)size) != CARD_SUCCESS) {
+        card_replay_close(replay);
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    replay->size = (size_t)size;
+    card_replay_rewind(replay);
+    return CARD_SUCCESS;
+}
+
+void card_replay_rewind(CardReplayContext* replay) {
+    replay->position = REPLAY_MAGIC_LENGTH;
+    replay->hasInfo = 0;
+    replay_next(replay);
+}
+
+void card_replay_close(CardReplayContext* replay) {
+    if (!replay) {
+        return;
+    }
+    
+    free(replay->session);
+    replay->session = NULL;
+    replay->size = 0;
+    replay->position = 0;
+}
+
+static int replay_initialize(CardContext* context) {
+    CardReplayContext* replay = get_replay_context(context);
+    if (!replay || !replay->session) {
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    // Загруженная сессия сохраняется, сбрасывается только подключение
+    replay->isConnected = 0;
+    return CARD_SUCCESS;
+}
+
+static int replay_list_readers(CardContext* context, char*** readers, size_t* readersCount) {
+    if (!get_replay_context(context) || !readers || !readersCount) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    *readers = NULL;
+    *readersCount = 0;
+    return CARD_SUCCESS;
+}
+
+static int replay_connection(CardContext* context) {
+    CardReplayContext* replay = get_replay_context(context);
+    if (!replay || !replay->session) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    // Записанное подключение воспроизводится с его задержкой и результатом
+    const uint8_t* record = replay_next(replay);
+    int result = CARD_SUCCESS;
+    if (record && record[0] == CARD_REPLAY_RECORD_CONNECT) {
+        replay_delay(replay, get32(record + 1));
+        result = (int)get32(record + 5);
+        replay->position += REPLAY_RECORD_HEADER;
+        replay_next(replay);
+    }
+    
+    replay->isConnected = result == CARD_SUCCESS;
+    return result;
+}
+
+static int replay_connect(CardContext* context, const char* readerName) {
+    (void)readerName;
+    return replay_connection(context);
+}
+
+static int replay_disconnect(CardContext* context) {
+    CardReplayContext* replay = get_replay_context(context);
+    if (!replay) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    replay->isConnected = 0;
+    return CARD_SUCCESS;
+}
+
+static int replay_release(CardContext* context) {
+    return replay_disconnect(context);
+}
+
+static int replay_transmit(CardContext* context, const uint8_t* command, size_t commandLength,
+                           uint8_t* response, size_t* responseLength) {
+    CardReplayContext* replay = get_replay_context(context);
+    if (!replay || !command || !response || !responseLength) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    if (!replay->isConnected) {
+        return CARD_ERROR_CONNECT_FAILED;
+    }
+    
+    const uint8_t* record = replay_next(replay);
+    if (!record || record[0] != CARD_REPLAY_RECORD_TRANSMIT) {
+        replay->mismatches++;
+        return CARD_ERROR_TRANSMIT_FAILED;
+    }
+    
+    size_t recordedCommand = get32(record + 9);
+    size_t recordedResponse = get32(record + 13);
+    const uint8_t* payload = record + REPLAY_RECORD_HEADER;
+    
+    // Расхождение с записью означает изменение сценария: позиция не сдвигается
+    if (recordedCommand != commandLength || memcmp(payload, command, commandLength) != 0) {
+        replay->mismatches++;
+        return CARD_ERROR_TRANSMIT_FAILED;
+    }
+    
+    replay->position += REPLAY_RECORD_HEADER + recordedCommand + recordedResponse;
+    replay->replayed++;
+    replay_delay(replay, get32(record + 1));
+    
+    int result = (int)get32(record + 5);
+    if (result != CARD_SUCCESS) {
+        return result;
+    }
+    
+    if (*responseLength < recordedResponse) {
+        return CARD_ERROR_TRANSMIT_FAILED;
+    }
+    
+    memcpy(response, payload + recordedCommand, recordedResponse);
+    *responseLength = recordedResponse;
+    return CARD_SUCCESS;
+}
+
+static int replay_get_info(CardContext* context, CardInfo* info) {
+    CardReplayContext* replay = get_replay_context(context);
+    if (!replay || !info) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    if (!replay->isConnected || !replay->hasInfo) {
+        return CARD_ERROR_CONNECT_FAILED;
+    }
+    
+    *info = replay->info;
+    return CARD_SUCCESS;
+}
+
+static int replay_transmit_batch(CardContext* context, CardBatchItem* items, size_t count,
+                                 CardBatchPolicy policy, size_t* executed) {
+    return card_batch_execute(context, replay_transmit, items, count, policy, executed);
+}
+
+static int replay_reconnect(CardContext* context, CardDisposition initialization) {
+    (void)initialization;
+    return replay_connection(context);
+}
+
+static int replay_disconnect_with(CardContext* context, CardDisposition disposition) {
+    (void)disposition;
+    return replay_disconnect(context);
+}
+
+CardRepository card_replay_create_repository() {
+    CardRepository repository = {
+        .initialize = replay_initialize,
+        .list_readers = replay_list_readers,
+        .connect = replay_connect,
+        .disconnect = replay_disconnect,
+        .release = replay_release,
+        .transmit = replay_transmit,
+        .get_info = replay_get_info,
+        .transmit_batch = replay_transmit_batch,
+        .reconnect = replay_reconnect,
+        .disconnect_with = replay_disconnect_with
+    };
+    
+    return repository;
+} 
\ No newline at end of file
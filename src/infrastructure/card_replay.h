@@ -0,0 +1,123 @@
+#ifndef CARD_REPLAY_H
+#define CARD_REPLAY_H
+
+#include <windows.h>
+#include <stdio.h>
+#include "card_domain.h"
+
+/**
+ * Слой инфраструктуры (Infrastructure Layer)
+ * Запись и воспроизведение сессий обмена с картой.
+ * Записывающий репозиторий оборачивает любой CardRepository и сохраняет
+ * каждую команду, ответ и длительность в компактный двоичный файл.
+ * Воспроизводящий репозиторий отвечает на команды из файла без считывателя
+ * с исходными, нулевыми или масштабированными задержками.
+ */
+
+#define CARD_REPLAY_MAGIC "APDUREC1"
+
+/**
+ * Типы записей файла сессии. Каждая запись: тип (1 байт), длительность
+ * в мкс (4), результат CardError (4), длина команды (4), длина ответа (4),
+ * затем команда и ответ; числа в порядке little-endian.
+ * В записи сведений о карте вместо команды хранится CardInfo.
+ */
+typedef enum {
+    CARD_REPLAY_RECORD_TRANSMIT = 0,
+    CARD_REPLAY_RECORD_CONNECT = 1,
+    CARD_REPLAY_RECORD_INFO = 2
+} CardReplayRecordType;
+
+typedef enum {
+    CARD_REPLAY_ORIGINAL_TIMING = 0,  /* Задержки как при записи */
+    CARD_REPLAY_ZERO_LATENCY = 1,     /* Без задержек */
+    CARD_REPLAY_SCALED_TIMING = 2     /* Задержки, умноженные на timeScale */
+} CardReplayTiming;
+
+/**
+ * Контекст записывающего репозитория
+ */
+typedef struct {
+    CardRepository* inner;
+    CardContext* innerContext;
+    FILE* file;
+    CardInfo lastInfo;        /* Повторяющиеся сведения о карте не записываются */
+    int hasInfo;
+    unsigned long recorded;
+    int writeFailed;
+} CardRecorderContext;
+
+/**
+ * Контекст воспроизводящего репозитория
+ */
+typedef struct {
+    uint8_t* session;         /* Файл сессии целиком */
+    size_t size;
+    size_t position;
+    CardInfo info;            /* Сведения о карте на текущей позиции */
+    int hasInfo;
+    int isConnected;
+    CardReplayTiming timing;
+    double timeScale;
+    int loop;                 /* По окончании записи воспроизведение начинается сначала */
+    unsigned long replayed;
+    unsigned long mismatches; /* Команд, не совпавших с записанными */
+} CardReplayContext;
+
+/**
+ * Начало записи: открытие файла сессии
+ * @param recorder Контекст записи (память вызывающего)
+ * @param inner Оборачиваемый репозиторий
+ * @param innerContext Контекст оборачиваемого репозитория
+ * @param path Путь к файлу сессии, существующий файл перезаписывается
+ * @return Код ошибки из CardError
+ */
+int card_recorder_open(CardRecorderContext* recorder, CardRepository* inner, CardContext* innerContext,
+                       const char* path);
+
+/**
+ * Завершение записи и закрытие файла
+ * @param recorder Контекст записи
+ * @return CARD_SUCCESS или CARD_ERROR_INIT_FAILED, если запись в файл не удалась
+ */
+int card_recorder_close(CardRecorderContext* recorder);
+
+/**
+ * Создание записывающего репозитория; контекст карты указывает на CardRecorderContext
+ * Пакеты команд передаются оборачиваемому репозиторию целиком и записываются
+ * поэлементно с равной долей общей длительности.
+ * @return Структура репозитория
+ */
+CardRepository card_recorder_create_repository();
+
+/**
+ * Загрузка файла сессии для воспроизведения
+ * @param replay Контекст воспроизведения (память вызывающего)
+ * @param path Путь к файлу сессии
+ * @param timing Режим задержек из CardReplayTiming
+ * @param timeScale Множитель задержек для CARD_REPLAY_SCALED_TIMING
+ * @return Код ошибки из CardError
+ */
+int card_replay_open(CardReplayContext* replay, const char* path, CardReplayTiming timing, double timeScale);
+
+/**
+ * Возврат к началу записанной сессии
+ * @param replay Контекст воспроизведения
+ */
+void card_replay_rewind(CardReplayContext* replay);
+
+/**
+ * Освобождение загруженной сессии
+ * @param replay Контекст воспроизведения
+ */
+void card_replay_close(CardReplayContext* replay);
+
+/**
+ * Создание воспроизводящего репозитория; контекст карты указывает на CardReplayContext
+ * Команды должны следовать в записанном порядке, иначе возвращается
+ * CARD_ERROR_TRANSMIT_FAILED и увеличивается счётчик mismatches.
+ * @return Структура репозитория
+ */
+CardRepository card_replay_create_repository();
+
+#endif /* CARD_REPLAY_H */ 
\ No newline at end of file
@@ -0,0 +1,167 @@
+#include "card_script_runner.h"
+#include "card_metrics.h"
+#include "apdu.h"
+#include <stdio.h>
+#include <string.h>
+
+int card_script_load(CardScriptRun* run, const char* path, size_t* errorLine) {
+    if (!run || !path) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    memset(run, 0, sizeof(CardScriptRun));
+    if (errorLine) {
+        *errorLine = 0;
+    }
+    
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size < 0) {
+        fclose(file);
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    char* text = (char*)malloc((size_t)size + 1);
+    if (!text) {
+        fclose(file);
+        return CARD_ERROR_MEMORY_ALLOCATION;
+    }
+    
+    size_t read = fread(text, 1, (size_t)size, file);
+    fclose(file);
+    if (read != (size_t)size) {
+        free(text);
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    // Текст нужен только для разбора: команды копируются в пул программы
+    int result = card_script_parse(&run->program, text, read, errorLine);
+    free(text);
+    if (result != CARD_SUCCESS) {
+        return result;
+    }
+    
+    run->steps = (CardScriptStepStats*)calloc(run->program.count ? run->program.count : 1,
+                                              sizeof(CardScriptStepStats));
+    if (!run->steps) {
+        card_script_free(&run->program);
+        return CARD_ERROR_MEMORY_ALLOCATION;
+    }
+    return CARD_SUCCESS;
+}
+
+int card_script_execute(CardScriptRun* run, CardService* service, int stopOnMismatch) {
+    if (!run || !run->steps || !service) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    const CardScriptInstruction* instructions = run->program.instructions;
+    size_t count = run->program.count;
+    memset(run->steps, 0, (count ? count : 1) * sizeof(CardScriptStepStats));
+    run->elapsedNs = 0;
+    run->commands = 0;
+    run->mismatches = 0;
+    run->failedInstruction = 0;
+    run->failedStatus = 0;
+    run->hasFailure = 0;
+    
+    // Буфер ответа выделяется один раз на всё выполнение
+    uint8_t* buffer = (uint8_t*)malloc(APDU_MAX_RESPONSE_LENGTH);
+    if (!buffer) {
+        return CARD_ERROR_MEMORY_ALLOCATION;
+    }
+    
+    uint32_t remaining[CARD_SCRIPT_MAX_DEPTH];
+    size_t depth = 0;
+    int result = CARD_SUCCESS;
+    
+    uint64_t started = card_metrics_now();
+    size_t pc = 0;
+    while (pc < count) {
+        const CardScriptInstruction* instruction = &instructions[pc];
+        
+        if (instruction->opcode == CARD_SCRIPT_LOOP) {
+            remaining[depth++] = instruction->operand;
+            pc++;
+            continue;
+        }
+        
+        if (instruction->opcode == CARD_SCRIPT_END) {
+            // Повтор начинается с инструкции после LOOP
+            if (--remaining[depth - 1] > 0) {
+                pc = instruction->operand + 1;
+            } else {
+                depth--;
+                pc++;
+            }
+            continue;
+        }
+        
+        CardData command = { run->program.pool + instruction->operand, instruction->length, NULL };
+        CardData response = { buffer, APDU_MAX_RESPONSE_LENGTH, NULL };
+        
+        uint64_t stepStarted = card_metrics_now();
+        result = card_service_execute_command(service, &command, &response);
+        uint64_t duration = card_metrics_now() - stepStarted;
+        
+        CardScriptStepStats* step = &run->steps[pc];
+        if (step->count == 0 || duration < step->minNs) {
+            step->minNs = duration;
+        }
+        if (duration > step->maxNs) {
+            step->maxNs = duration;
+        }
+        step->totalNs += duration;
+        step->count++;
+        run->commands++;
+        
+        if (result != CARD_SUCCESS || response.length < 2) {
+            if (result == CARD_SUCCESS) {
+                result = CARD_ERROR_TRANSMIT_FAILED;
+            }
+            if (!run->hasFailure) {
+                run->hasFailure = 1;
+                run->failedInstruction = pc;
+            }
+            break;
+        }
+        
+        uint16_t sw = (uint16_t)((response.data[response.length - 2] << 8) | response.data[response.length - 1]);
+        if (!card_script_status_matches(instruction, sw)) {
+            step->mismatches++;
+            run->mismatches++;
+            if (!run->hasFailure) {
+                run->hasFailure = 1;
+                run->failedInstruction = pc;
+                run->failedStatus = sw;
+            }
+            if (stopOnMismatch) {
+                break;
+            }
+        }
+        pc++;
+    }
+    run->elapsedNs = card_metrics_now() - started;
+    
+    free(buffer);
+    if (result == CARD_SUCCESS && run->mismatches > 0) {
+        result = CARD_ERROR_BAD_STATUS;
+    }
+    return result;
+}
+
+void card_script_unload(CardScriptRun* run) {
+    if (!run) {
+        return;
+    }
+    
+    card_script_free(&run->program);
+    free(run->steps);
+    run->steps = NULL;
+} 
\ No newline at end of file
@@ -0,0 +1,69 @@
+#ifndef CARD_SCRIPT_RUNNER_H
+#define CARD_SCRIPT_RUNNER_H
+
+#include <stdint.h>
+#include "card_domain.h"
+#include "card_service.h"
+#include "card_script.h"
+
+/**
+ * Слой инфраструктуры (Infrastructure Layer)
+ * Неинтерактивное выполнение сценария APDU (card_script) на подключённой карте.
+ * Файл разбирается до подключения; при выполнении команды берутся из пула
+ * программы, ответ принимается в заранее выделенный буфер, а время каждого
+ * шага измеряется card_metrics_now и копится по инструкциям сценария.
+ */
+
+/**
+ * Статистика шага сценария (инструкции SEND) за все повторы
+ */
+typedef struct {
+    uint64_t count;                 /* Выполнений */
+    uint64_t totalNs;
+    uint64_t minNs;
+    uint64_t maxNs;
+    uint64_t mismatches;            /* Ответов с неожиданным статусом */
+} CardScriptStepStats;
+
+/**
+ * Загруженный сценарий и результаты его выполнения
+ */
+typedef struct {
+    CardScript program;
+    CardScriptStepStats* steps;     /* По одному на инструкцию программы */
+    uint64_t elapsedNs;             /* Время выполнения сценария целиком */
+    uint64_t commands;              /* Отправлено команд */
+    uint64_t mismatches;
+    size_t failedInstruction;       /* Первая инструкция с неожиданным статусом или ошибкой */
+    uint16_t failedStatus;          /* Статус её ответа */
+    int hasFailure;
+} CardScriptRun;
+
+/**
+ * Загрузка и разбор файла сценария
+ * @param run Структура выполнения (память вызывающего)
+ * @param path Путь к файлу сценария
+ * @param errorLine Номер строки с ошибкой разбора (может быть NULL)
+ * @return Код ошибки из CardError
+ */
+int card_script_load(CardScriptRun* run, const char* path, size_t* errorLine);
+
+/**
+ * Выполнение загруженного сценария
+ * Статистика предыдущего выполнения сбрасывается. Ошибка обмена с картой
+ * прерывает сценарий всегда, неожиданный статус — при stopOnMismatch.
+ * @param run Загруженный сценарий
+ * @param service Сервис, подключённый к карте
+ * @param stopOnMismatch 1 — остановиться на первом неожиданном статусе
+ * @return CARD_SUCCESS, CARD_ERROR_BAD_STATUS, если были неожиданные статусы,
+ *         или код ошибки обмена
+ */
+int card_script_execute(CardScriptRun* run, CardService* service, int stopOnMismatch);
+
+/**
+ * Освобождение сценария
+ * @param run Загруженный сценарий
+ */
+void card_script_unload(CardScriptRun* run);
+
+#endif /* CARD_SCRIPT_RUNNER_H */ 
\ No newline at end of file
@@ -0,0 +1,266 @@
+#include "card_shared.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+/**
+ * Добавление элемента в очередь (много производителей)
+ * Обмен head упорядочивает производителей; до записи next элемент
+ * не виден владельцу, который в этом случае повторит попытку позже.
+ */
+static void card_shared_push(CardSharedConnection* shared, CardSharedUnit* unit) {
+    unit->next = NULL;
+    CardSharedUnit* previous = (CardSharedUnit*)InterlockedExchangePointer((PVOID volatile*)&shared->head, unit);
+    InterlockedExchangePointer((PVOID volatile*)&previous->next, unit);
+}
+
+/**
+ * Извлечение элемента из очереди (только поток-владелец)
+ * @return Единица или NULL, если очередь пуста или добавление ещё не завершено
+ */
+static CardSharedUnit* card_shared_pop(CardSharedConnection* shared) {
+    CardSharedUnit* tail = shared->tail;
+    CardSharedUnit* next = tail->next;
+    
+    if (tail == &shared->stub) {
+        if (!next) {
+            return NULL;
+        }
+        shared->tail = next;
+        tail = next;
+        next = next->next;
+    }
+    
+    if (next) {
+        shared->tail = next;
+        return tail;
+    }
+    
+    if (tail != shared->head) {
+        return NULL;
+    }
+    
+    // Последний элемент извлекается после возврата служебного в конец очереди
+    card_shared_push(shared, &shared->stub);
+    next = tail->next;
+    if (next) {
+        shared->tail = next;
+        return tail;
+    }
+    
+    return NULL;
+}
+
+static void card_shared_run(CardSharedConnection* shared, CardSharedUnit* unit) {
+    unit->executed = 0;
+    unit->result = CARD_SUCCESS;
+    
+    for (size_t i = 0; i < unit->count; i++) {
+        CardAsyncRequest* request = &unit->requests[i];
+        request->result = card_async_execute(shared->service, request);
+        request->isComplete = 1;
+        unit->executed++;
+        
+        if (request->result != CARD_SUCCESS) {
+            if (unit->result == CARD_SUCCESS) {
+                unit->result = request->result;
+            }
+            if (unit->stopOnError) {
+                break;
+            }
+        }
+    }
+    
+    InterlockedIncrement64(&shared->completedUnits);
+    
+    // После завершения вызывающий может освободить единицу, поэтому она больше не трогается
+    if (unit->onComplete) {
+        InterlockedExchange(&unit->isComplete, 1);
+        unit->onComplete(unit, unit->userData);
+        return;
+    }
+    
+    InterlockedExchange(&unit->isComplete, 1);
+    if (shared->waiters > 0) {
+        EnterCriticalSection(&shared->waitLock);
+        WakeAllConditionVariable(&shared->unitCompleted);
+        LeaveCriticalSection(&shared->waitLock);
+    }
+}
+
+static DWORD WINAPI card_shared_thread(LPVOID parameter) {
+    CardSharedConnection* shared = (CardSharedConnection*)parameter;
+    
+    for (;;) {
+        CardSharedUnit* unit = card_shared_pop(shared);
+        if (unit) {
+            card_shared_run(shared, unit);
+            continue;
+        }
+        
+        // Производитель, увидевший isIdle, разбудит владельца; повторная проверка
+        // после установки флага исключает потерю единицы, добавленной в промежутке
+        InterlockedExchange(&shared->isIdle, 1);
+        unit = card_shared_pop(shared);
+        if (unit) {
+            InterlockedExchange(&shared->isIdle, 0);
+            card_shared_run(shared, unit);
+            continue;
+        }
+        
+        // Остановка после выполнения всех принятых единиц
+        if (shared->isStopped) {
+            break;
+        }
+        
+        WaitForSingleObject(shared->wakeEvent, INFINITE);
+        InterlockedExchange(&shared->isIdle, 0);
+    }
+    
+    return 0;
+}
+
+int card_shared_start(CardSharedConnection* shared, CardService* service) {
+    if (!shared || !service) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    memset(shared, 0, sizeof(CardSharedConnection));
+    shared->service = service;
+    shared->head = &shared->stub;
+    shared->tail = &shared->stub;
+    
+    shared->wakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (!shared->wakeEvent) {
+        printf("Ошибка при создании события очереди\n");
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    InitializeCriticalSection(&shared->waitLock);
+    InitializeConditionVariable(&shared->unitCompleted);
+    
+    shared->thread = CreateThread(NULL, 0, card_shared_thread, shared, 0, NULL);
+    if (!shared->thread) {
+        printf("Ошибка при создании потока-владельца подключения\n");
+        DeleteCriticalSection(&shared->waitLock);
+        CloseHandle(shared->wakeEvent);
+        shared->wakeEvent = NULL;
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    return CARD_SUCCESS;
+}
+
+void card_shared_prepare(CardSharedUnit* unit, CardAsyncRequest* requests, size_t count, int stopOnError) {
+    memset(unit, 0, sizeof(CardSharedUnit));
+    unit->requests = requests;
+    unit->count = count;
+    unit->stopOnError = stopOnError;
+}
+
+int card_shared_submit(CardSharedConnection* shared, CardSharedUnit* unit) {
+    if (!shared || !shared->thread || !unit || !unit->requests || unit->count == 0) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    for (size_t i = 0; i < unit->count; i++) {
+        if (unit->requests[i].operation == CARD_ASYNC_CALL && !unit->requests[i].function) {
+            return CARD_ERROR_INVALID_PARAMETER;
+        }
+        unit->requests[i].result = CARD_SUCCESS;
+        unit->requests[i].isComplete = 0;
+    }
+    
+    unit->executed = 0;
+    unit->result = CARD_SUCCESS;
+    unit->isComplete = 0;
+    
+    // Счётчик не даёт card_shared_stop завершить поток, пока добавление не закончено
+    InterlockedIncrement(&shared->submitting);
+    if (shared->isStopping) {
+        InterlockedDecrement(&shared->submitting);
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    card_shared_push(shared, unit);
+    
+    if (InterlockedCompareExchange(&shared->isIdle, 0, 1) == 1) {
+        SetEvent(shared->wakeEvent);
+    }
+    InterlockedDecrement(&shared->submitting);
+    
+    return CARD_SUCCESS;
+}
+
+int card_shared_wait(CardSharedConnection* shared, CardSharedUnit* unit, DWORD timeout) {
+    if (!shared || !shared->wakeEvent || !unit || unit->onComplete) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    if (unit->isComplete) {
+        return unit->result;
+    }
+    
+    DWORD started = GetTickCount();
+    
+    // Владелец будит ожидающих, только если счётчик ненулевой
+    InterlockedIncrement(&shared->waiters);
+    EnterCriticalSection(&shared->waitLock);
+    while (!unit->isComplete) {
+        DWORD remaining = INFINITE;
+        if (timeout != INFINITE) {
+            DWORD elapsed = GetTickCount() - started;
+            if (elapsed >= timeout) {
+                break;
+            }
+            remaining = timeout - elapsed;
+        }
+        SleepConditionVariableCS(&shared->unitCompleted, &shared->waitLock, remaining);
+    }
+    LeaveCriticalSection(&shared->waitLock);
+    InterlockedDecrement(&shared->waiters);
+    
+    if (!unit->isComplete) {
+        return CARD_ERROR_TRANSMIT_FAILED;
+    }
+    
+    return unit->result;
+}
+
+int card_shared_execute(CardSharedConnection* shared, CardSharedUnit* unit) {
+    if (!unit || unit->onComplete) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    int result = card_shared_submit(shared, unit);
+    if (result != CARD_SUCCESS) {
+        return result;
+    }
+    
+    return card_shared_wait(shared, unit, INFINITE);
+}
+
+int card_shared_stop(CardSharedConnection* shared) {
+    if (!shared || !shared->thread) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    // Новые единицы не принимаются; начатые добавления дожидаются завершения
+    InterlockedExchange(&shared->isStopping, 1);
+    while (shared->submitting > 0) {
+        YieldProcessor();
+    }
+    
+    InterlockedExchange(&shared->isStopped, 1);
+    SetEvent(shared->wakeEvent);
+    
+    WaitForSingleObject(shared->thread, INFINITE);
+    CloseHandle(shared->thread);
+    shared->thread = NULL;
+    
+    DeleteCriticalSection(&shared->waitLock);
+    CloseHandle(shared->wakeEvent);
+    shared->wakeEvent = NULL;
+    
+    return CARD_SUCCESS;
+} 
\ No newline at end of file
@@ -0,0 +1,115 @@
+#ifndef CARD_SHARED_H
+#define CARD_SHARED_H
+
+#include <windows.h>
+#include "card_domain.h"
+#include "card_service.h"
+#include "card_async.h"
+
+/**
+ * Слой инфраструктуры (Infrastructure Layer)
+ * Подключение, общее для многих потоков. CardService и контекст считывателя
+ * не синхронизированы, поэтому с ними работает только поток-владелец.
+ * Остальные потоки ставят единицы работы в очередь подключения без блокировок
+ * (много производителей, один потребитель). Запросы одной единицы (например,
+ * аутентификация и чтение) выполняются подряд и не перемежаются с чужими.
+ * Каждое подключение обслуживается своим потоком, глобальной блокировки
+ * на все считыватели нет.
+ */
+
+typedef struct CardSharedUnit CardSharedUnit;
+
+/**
+ * Уведомление о завершении единицы, вызывается в потоке-владельце
+ */
+typedef void (*CardSharedCallback)(CardSharedUnit* unit, void* userData);
+
+/**
+ * Единица работы: запросы, выполняемые подряд без вмешательства других потоков.
+ * Память единицы, запросов и их буферов принадлежит вызывающему и должна
+ * оставаться действительной до завершения единицы.
+ */
+struct CardSharedUnit {
+    CardAsyncRequest* requests;  /* Запросы card_async_prepare_*; onComplete запросов не вызывается */
+    size_t count;
+    int stopOnError;             /* Остальные запросы не выполняются после первой ошибки */
+    CardSharedCallback onComplete; /* NULL — завершение ожидается card_shared_wait */
+    void* userData;
+    size_t executed;             /* Выполнено запросов */
+    int result;                  /* Первая ошибка среди запросов или CARD_SUCCESS */
+    volatile LONG isComplete;
+    CardSharedUnit* volatile next; /* Служебное поле очереди */
+};
+
+/**
+ * Общее подключение с потоком-владельцем
+ */
+typedef struct {
+    CardService* service;
+    HANDLE thread;
+    HANDLE wakeEvent;               /* Автосброс: поток-владелец ждёт новые единицы */
+    CardSharedUnit* volatile head;  /* Последняя поставленная единица (сторона производителей) */
+    CardSharedUnit* tail;           /* Следующая единица (сторона владельца) */
+    CardSharedUnit stub;            /* Служебный элемент пустой очереди */
+    volatile LONG isIdle;           /* Владелец готовится ждать wakeEvent */
+    volatile LONG submitting;       /* Потоков внутри card_shared_submit */
+    volatile LONG isStopping;
+    volatile LONG isStopped;        /* Новых единиц больше не будет */
+    CRITICAL_SECTION waitLock;      /* Только для ожидающих card_shared_wait */
+    CONDITION_VARIABLE unitCompleted;
+    volatile LONG waiters;
+    volatile LONG64 completedUnits;
+} CardSharedConnection;
+
+/**
+ * Запуск потока-владельца
+ * После запуска сервис используется только этим потоком до card_shared_stop.
+ * @param shared Структура подключения (память вызывающего)
+ * @param service Инициализированный сервис с подключённой картой
+ * @return Код ошибки из CardError
+ */
+int card_shared_start(CardSharedConnection* shared, CardService* service);
+
+/**
+ * Заполнение единицы работы
+ * @param unit Единица
+ * @param requests Массив запросов
+ * @param count Количество запросов
+ * @param stopOnError Прекращать выполнение после первой ошибки
+ */
+void card_shared_prepare(CardSharedUnit* unit, CardAsyncRequest* requests, size_t count, int stopOnError);
+
+/**
+ * Постановка единицы в очередь без блокировок; безопасно из любого потока
+ * @param shared Указатель на подключение
+ * @param unit Заполненная единица
+ * @return Код ошибки из CardError
+ */
+int card_shared_submit(CardSharedConnection* shared, CardSharedUnit* unit);
+
+/**
+ * Ожидание завершения единицы без функции обратного вызова
+ * После таймаута единица остаётся в очереди и не может быть освобождена.
+ * @param shared Указатель на подключение
+ * @param unit Единица
+ * @param timeout Время ожидания в миллисекундах или INFINITE
+ * @return Результат единицы или CARD_ERROR_TRANSMIT_FAILED по таймауту
+ */
+int card_shared_wait(CardSharedConnection* shared, CardSharedUnit* unit, DWORD timeout);
+
+/**
+ * Постановка единицы в очередь и ожидание её завершения
+ * @param shared Указатель на подключение
+ * @param unit Заполненная единица без функции обратного вызова
+ * @return Результат единицы
+ */
+int card_shared_execute(CardSharedConnection* shared, CardSharedUnit* unit);
+
+/**
+ * Остановка: поставленные единицы выполняются, затем поток завершается
+ * @param shared Указатель на подключение
+ * @return Код ошибки из CardError
+ */
+int card_shared_stop(CardSharedConnection* shared);
+
+#endif /* CARD_SHARED_H */ 
\ No newline at end of file
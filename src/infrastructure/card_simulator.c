@@ -0,0 +1,341 @@
+#include "card_simulator.h"
+#include "card_metrics.h"
+#include "apdu.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+/**
+ * ATR карты общего вида: T=0 и T=1, таблица возможностей карты (тег 7),
+ * бит 0x40 третьего байта — расширенные Lc/Le. Последний байт — TCK.
+ */
+static const uint8_t simulatorAtr[] = {
+    0x3B, 0x85, 0x80, 0x01, 0x80, 0x73, 0xC0, 0x21, 0x00, 0x00
+};
+
+#define SIMULATOR_ATR_CAPABILITIES 8
+
+static CardSimulatorContext* get_simulator_context(CardContext* context) {
+    if (!context || !context->context) {
+        return NULL;
+    }
+    return (CardSimulatorContext*)context->context;
+}
+
+void card_simulator_delay(uint32_t micros) {
+    if (micros == 0) {
+        return;
+    }
+    
+    uint64_t deadline = card_metrics_now() + (uint64_t)micros * 1000;
+    if (micros >= 20000) {
+        Sleep((micros - 16000) / 1000);
+    }
+    
+    while (card_metrics_now() < deadline) {
+        YieldProcessor();
+    }
+}
+
+/**
+ * Решение о внедрении ошибки (xorshift32)
+ */
+static int simulator_inject_error(CardSimulatorContext* simulator) {
+    if (simulator->config.errorRate == 0) {
+        return 0;
+    }
+    
+    uint32_t x = simulator->random;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    simulator->random = x;
+    
+    return x % simulator->config.errorRate == 0;
+}
+
+static int simulator_status(uint8_t* response, size_t* responseLength, uint16_t status) {
+    if (*responseLength < 2) {
+        return CARD_ERROR_TRANSMIT_FAILED;
+    }
+    
+    response[0] = (uint8_t)(status >> 8);
+    response[1] = (uint8_t)status;
+    *responseLength = 2;
+    return CARD_SUCCESS;
+}
+
+void card_simulator_default_config(CardSimulatorConfig* config) {
+    static const uint8_t uid[] = { 0x04, 0xA2, 0x3B, 0x5C };
+    
+    memset(config, 0, sizeof(CardSimulatorConfig));
+    config->memorySize = CARD_SIMULATOR_MAX_MEMORY;
+    config->seed = 0x2545F491;
+    memcpy(config->uid, uid, sizeof(uid));
+    config->uidLength = sizeof(uid);
+}
+
+int card_simulator_initialize(CardContext* context) {
+    CardSimulatorContext* simulator = get_simulator_context(context);
+    if (!simulator) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    memset(simulator, 0, sizeof(CardSimulatorContext));
+    
+    CardSimulatorConfig config;
+    card_simulator_default_config(&config);
+    return card_simulator_configure(context, &config);
+}
+
+int card_simulator_configure(CardContext* context, const CardSimulatorConfig* config) {
+    CardSimulatorContext* simulator = get_simulator_context(context);
+    if (!simulator || !config || config->memorySize == 0 ||
+        config->memorySize > CARD_SIMULATOR_MAX_MEMORY || config->uidLength > CARD_SIMULATOR_MAX_UID ||
+        config->atrLength > CARD_ATR_MAX_LENGTH) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    if (!simulator->memory || simulator->config.memorySize != config->memorySize) {
+        uint8_t* memory = (uint8_t*)calloc(config->memorySize, 1);
+        if (!memory) {
+            return CARD_ERROR_MEMORY_ALLOCATION;
+        }
+        free(simulator->memory);
+        simulator->memory = memory;
+    }
+    
+    simulator->config = *config;
+    simulator->random = config->seed ? config->seed : 1;
+    
+    return CARD_SUCCESS;
+}
+
+int card_simulator_list_readers(CardContext* context, char*** readers, size_t* readersCount) {
+    if (!get_simulator_context(context) || !readers || !readersCount) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    // Массив указателей и имя одним блоком, как у winscard_list_readers
+    char** list = (char**)malloc(sizeof(char*) + sizeof(CARD_SIMULATOR_READER));
+    if (!list) {
+        return CARD_ERROR_MEMORY_ALLOCATION;
+    }
+    
+    list[0] = (char*)(list + 1);
+    memcpy(list[0], CARD_SIMULATOR_READER, sizeof(CARD_SIMULATOR_READER));
+    
+    *readers = list;
+    *readersCount = 1;
+    return CARD_SUCCESS;
+}
+
+int card_simulator_connect(CardContext* context, const char* readerName) {
+    CardSimulatorContext* simulator = get_simulator_context(context);
+    if (!simulator || !readerName) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    if (!simulator->hasHandle) {
+        card_simulator_delay(simulator->config.connectLatency);
+        simulator->hasHandle = 1;
+    }
+    simulator->isConnected = 1;
+    return CARD_SUCCESS;
+}
+
+int card_simulator_disconnect(CardContext* context) {
+    return card_simulator_disconnect_with(context, CARD_DISPOSITION_LEAVE);
+}
+
+int card_simulator_release(CardContext* context) {
+    CardSimulatorContext* simulator = get_simulator_context(context);
+    if (!simulator) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    free(simulator->memory);
+    simulator->memory = NULL;
+    simulator->isConnected = 0;
+    simulator->hasHandle = 0;
+    return CARD_SUCCESS;
+}
+
+int card_simulator_transmit(CardContext* context, const uint8_t* command, size_t commandLength,
+                            uint8_t* response, size_t* responseLength) {
+    CardSimulatorContext* simulator = get_simulator_context(context);
+    if (!simulator || !command || !response || !responseLength) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    if (!simulator->isConnected) {
+        return CARD_ERROR_CONNECT_FAILED;
+    }
+    
+    simulator->transmitCount++;
+    card_simulator_delay(simulator->config.transmitLatency);
+    
+    if (simulator_inject_error(simulator)) {
+        simulator->injectedErrors++;
+        if (simulator->config.errorStatus == 0) {
+            return CARD_ERROR_TRANSMIT_FAILED;
+        }
+        return simulator_status(response, responseLength, simulator->config.errorStatus);
+    }
+    
+    ApduCommand parsed;
+    if (apdu_parse(command, commandLength, &parsed) != CARD_SUCCESS) {
+        return simulator_status(response, responseLength, 0x6700);
+    }
+    
+    if (parsed.cla != 0xFF) {
+        return simulator_status(response, responseLength, 0x6E00);
+    }
+    
+    if (parsed.extended && !simulator->config.extendedLength) {
+        return simulator_status(response, responseLength, 0x6700);
+    }
+    
+    size_t address = ((size_t)(parsed.p1 & 0x7F) << 8) | parsed.p2;
+    
+    switch (parsed.ins) {
+        case 0xB0: {
+            // Чтение без Le (случай 1) карта отклоняет: длина ответа не задана
+            size_t length = parsed.expectedLength;
+            if (length == 0) {
+                return simulator_status(response, responseLength, 0x6700);
+            }
+            if (address + length > simulator->config.memorySize) {
+                return simulator_status(response, responseLength, 0x6B00);
+            }
+            if (*responseLength < length + 2) {
+                return CARD_ERROR_TRANSMIT_FAILED;
+            }
+            
+            memcpy(response, simulator->memory + address, length);
+            response[length] = 0x90;
+            response[length + 1] = 0x00;
+            *responseLength = length + 2;
+            return CARD_SUCCESS;
+        }
+        case 0xD0:
+        case 0xD6:
+            if (parsed.dataLength == 0) {
+                return simulator_status(response, responseLength, 0x6700);
+            }
+            if (address + parsed.dataLength > simulator->config.memorySize) {
+                return simulator_status(response, responseLength, 0x6B00);
+            }
+            
+            memcpy(simulator->memory + address, parsed.data, parsed.dataLength);
+            return simulator_status(response, responseLength, 0x9000);
+        case 0xCA:
+            // P1 = 00 — UID; историческая часть ATS у карты памяти отсутствует
+            if (parsed.p1 != 0x00) {
+                return simulator_status(response, responseLength, 0x6A81);
+            }
+            if (*responseLength < simulator->config.uidLength + 2) {
+                return CARD_ERROR_TRANSMIT_FAILED;
+            }
+            
+            memcpy(response, simulator->config.uid, simulator->config.uidLength);
+            response[simulator->config.uidLength] = 0x90;
+            response[simulator->config.uidLength + 1] = 0x00;
+            *responseLength = simulator->config.uidLength + 2;
+            return CARD_SUCCESS;
+        default:
+            return simulator_status(response, responseLength, 0x6D00);
+    }
+}
+
+int card_simulator_get_info(CardContext* context, CardInfo* info) {
+    CardSimulatorContext* simulator = get_simulator_context(context);
+    if (!simulator || !info) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    if (!simulator->isConnected) {
+        return CARD_ERROR_CONNECT_FAILED;
+    }
+    
+    memset(info, 0, sizeof(CardInfo));
+    if (simulator->config.atrLength > 0) {
+        memcpy(info->atr, simulator->config.atr, simulator->config.atrLength);
+        info->atrLength = simulator->config.atrLength;
+    } else {
+        memcpy(info->atr, simulatorAtr, sizeof(simulatorAtr));
+        info->atrLength = sizeof(simulatorAtr);
+        if (simulator->config.extendedLength) {
+            info->atr[SIMULATOR_ATR_CAPABILITIES] = 0x40;
+        }
+        
+        uint8_t checksum = 0;
+        for (size_t i = 1; i < info->atrLength - 1; i++) {
+            checksum ^= info->atr[i];
+        }
+        info->atr[info->atrLength - 1] = checksum;
+    }
+    info->extendedLength = simulator->config.extendedLength;
+    info->resetCount = simulator->resetCount;
+    info->maxCommandData = simulator->config.extendedLength ? APDU_EXTENDED_MAX_LC : APDU_SHORT_MAX_LC;
+    info->maxResponseData = simulator->config.extendedLength ? APDU_EXTENDED_MAX_LE : APDU_SHORT_MAX_LE;
+    
+    return CARD_SUCCESS;
+}
+
+int card_simulator_transmit_batch(CardContext* context, CardBatchItem* items, size_t count,
+                                  CardBatchPolicy policy, size_t* executed) {
+    if (!get_simulator_context(context)) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    return card_batch_execute(context, card_simulator_transmit, items, count, policy, executed);
+}
+
+int card_simulator_reconnect(CardContext* context, CardDisposition initialization) {
+    CardSimulatorContext* simulator = get_simulator_context(context);
+    if (!simulator) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    if (!simulator->hasHandle) {
+        return CARD_ERROR_CONNECT_FAILED;
+    }
+    
+    if (initialization != CARD_DISPOSITION_LEAVE) {
+        card_simulator_delay(simulator->config.resetLatency);
+        simulator->resetCount++;
+    }
+    simulator->isConnected = 1;
+    return CARD_SUCCESS;
+}
+
+int card_simulator_disconnect_with(CardContext* context, CardDisposition disposition) {
+    CardSimulatorContext* simulator = get_simulator_context(context);
+    if (!simulator) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    simulator->isConnected = 0;
+    if (!simulator->config.persistent || disposition != CARD_DISPOSITION_LEAVE) {
+        simulator->hasHandle = 0;
+    }
+    return CARD_SUCCESS;
+}
+
+CardRepository card_simulator_create_repository() {
+    CardRepository repository = {
+        .initialize = card_simulator_initialize,
+        .list_readers = card_simulator_list_readers,
+        .connect = card_simulator_connect,
+        .disconnect = card_simulator_disconnect,
+        .release = card_simulator_release,
+        .transmit = card_simulator_transmit,
+        .get_info = card_simulator_get_info,
+        .transmit_batch = card_simulator_transmit_batch,
+        .reconnect = card_simulator_reconnect,
+        .disconnect_with = card_simulator_disconnect_with
+    };
+    
+    return repository;
+} 
\ No newline at end of file
@@ -0,0 +1,150 @@
+#ifndef CARD_SIMULATOR_H
+#define CARD_SIMULATOR_H
+
+#include <windows.h>
+#include "card_domain.h"
+
+/**
+ * Слой инфраструктуры (Infrastructure Layer)
+ * Эмулятор карты памяти за считывателем PC/SC без оборудования:
+ * FF B0 — чтение, FF D0/FF D6 — запись, FF CA — UID. Задержка каждой
+ * команды, внедрение ошибок и ATR (а с ним профиль карты) настраиваются. Используется для измерений
+ * (src/bench) и проверки сервисов без считывателя.
+ */
+
+#define CARD_SIMULATOR_READER "Simulated Memory Card 0"
+#define CARD_SIMULATOR_MAX_MEMORY 0x8000
+#define CARD_SIMULATOR_MAX_UID 10
+
+typedef struct {
+    size_t memorySize;          /* Размер памяти, не больше CARD_SIMULATOR_MAX_MEMORY (адрес в P1 & 0x7F, P2) */
+    int extendedLength;         /* Поддержка APDU расширенной длины */
+    uint32_t transmitLatency;   /* Задержка каждой команды, мкс */
+    uint32_t connectLatency;    /* Задержка установки подключения, мкс */
+    uint32_t resetLatency;      /* Задержка сброса карты при повторном подключении, мкс */
+    int persistent;             /* Сохранять подключение при отключении без сброса, как winscard_set_persistent */
+    uint32_t errorRate;         /* Ошибка в среднем на каждую errorRate-ю команду, 0 — без ошибок */
+    uint16_t errorStatus;       /* Статус внедрённой ошибки, 0 — ошибка передачи */
+    uint32_t seed;              /* Начальное значение генератора ошибок */
+    uint8_t uid[CARD_SIMULATOR_MAX_UID];
+    size_t uidLength;
+    uint8_t atr[CARD_ATR_MAX_LENGTH]; /* ATR для выбора профиля карты */
+    size_t atrLength;           /* 0 — карта общего вида без профиля, расширенная длина по extendedLength */
+} CardSimulatorConfig;
+
+typedef struct {
+    CardSimulatorConfig config;
+    uint8_t* memory;
+    int isConnected;
+    int hasHandle;              /* Подключение установлено (в том числе сохранено между сессиями) */
+    unsigned long resetCount;   /* Сбросов через card_simulator_reconnect */
+    uint32_t random;
+    unsigned long transmitCount;
+    unsigned long injectedErrors;
+} CardSimulatorContext;
+
+/**
+ * Параметры по умолчанию: 32 КБ, короткие APDU, без задержек и ошибок
+ * @param config Структура параметров
+ */
+void card_simulator_default_config(CardSimulatorConfig* config);
+
+/**
+ * Точная задержка: короткие ожидания выполняются без переключения потока,
+ * Sleep (разрешение около 15 мс) используется только для длинной части
+ * @param micros Задержка в микросекундах
+ */
+void card_simulator_delay(uint32_t micros);
+
+/**
+ * Инициализация эмулятора с параметрами по умолчанию
+ * @param context Контекст карты с CardSimulatorContext внутри
+ * @return Код ошибки из CardError
+ */
+int card_simulator_initialize(CardContext* context);
+
+/**
+ * Замена параметров эмулятора; память карты сохраняется, если её размер не изменился
+ * @param context Контекст карты
+ * @param config Новые параметры
+ * @return Код ошибки из CardError
+ */
+int card_simulator_configure(CardContext* context, const CardSimulatorConfig* config);
+
+/**
+ * Получение списка из одного считывателя CARD_SIMULATOR_READER
+ * Список освобождается одним вызовом free.
+ * @param context Контекст карты
+ * @param readers Указатель для сохранения массива имён
+ * @param readersCount Указатель для сохранения количества
+ * @return Код ошибки из CardError
+ */
+int card_simulator_list_readers(CardContext* context, char*** readers, size_t* readersCount);
+
+/**
+ * Подключение к эмулированной карте (имя считывателя не проверяется)
+ * Сохранённое подключение используется без задержки connectLatency.
+ * @param context Контекст карты
+ * @param readerName Имя считывателя
+ * @return Код ошибки из CardError
+ */
+int card_simulator_connect(CardContext* context, const char* readerName);
+
+/**
+ * Отключение от эмулированной карты
+ * @param context Контекст карты
+ * @return Код ошибки из CardError
+ */
+int card_simulator_disconnect(CardContext* context);
+
+/**
+ * Освобождение памяти эмулятора
+ * @param context Контекст карты
+ * @return Код ошибки из CardError
+ */
+int card_simulator_release(CardContext* context);
+
+/**
+ * Выполнение команды эмулированной картой
+ * @param context Контекст карты
+ * @param command Команда
+ * @param commandLength Длина команды
+ * @param response Буфер ответа
+ * @param responseLength Ёмкость буфера на входе, длина ответа на выходе
+ * @return Код ошибки из CardError
+ */
+int card_simulator_transmit(CardContext* context, const uint8_t* command, size_t commandLength,
+                            uint8_t* response, size_t* responseLength);
+
+/**
+ * Сведения об эмулированной карте
+ * @param context Контекст карты
+ * @param info Структура для сведений
+ * @return Код ошибки из CardError
+ */
+int card_simulator_get_info(CardContext* context, CardInfo* info);
+
+/**
+ * Пакетная передача команд эмулированной карте
+ */
+int card_simulator_transmit_batch(CardContext* context, CardBatchItem* items, size_t count,
+                                  CardBatchPolicy policy, size_t* executed);
+
+/**
+ * Повторное подключение без установки нового; сброс стоит resetLatency,
+ * содержимое памяти сохраняется при любом сбросе
+ */
+int card_simulator_reconnect(CardContext* context, CardDisposition initialization);
+
+/**
+ * Отключение с указанным действием над картой
+ */
+int card_simulator_disconnect_with(CardContext* context, CardDisposition disposition);
+
+/**
+ * Создание репозитория эмулятора
+ * @return Структура репозитория
+ */
+CardRepository card_simulator_create_repository();
+
+#endif /* CARD_SIMULATOR_H */ 
\ No newline at end of file
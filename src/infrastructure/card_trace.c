@@ -0,0 +1,211 @@
+#include "card_trace.h"
+#include <stdio.h>
+#include <string.h>
+
+static CardTrace* volatile activeTrace = NULL;
+static CardTrace* volatile crashTrace = NULL;
+
+static LONG WINAPI card_trace_crash_filter(EXCEPTION_POINTERS* exception) {
+    (void)exception;
+    
+    CardTrace* trace = crashTrace;
+    if (trace && trace->header) {
+        FlushViewOfFile(trace->header, 0);
+    }
+    
+    return EXCEPTION_CONTINUE_SEARCH;
+}
+
+int card_trace_open(CardTrace* trace, const char* path, size_t recordCount) {
+    if (!trace || !path || recordCount > 0x80000000UL) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    memset(trace, 0, sizeof(CardTrace));
+    
+    size_t count = CARD_TRACE_MIN_RECORDS;
+    while (count < recordCount) {
+        count <<= 1;
+    }
+    
+    uint64_t size = CARD_TRACE_HEADER_SIZE + (uint64_t)count * CARD_TRACE_RECORD_SIZE;
+    
+    trace->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                              CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (trace->file == INVALID_HANDLE_VALUE) {
+        printf("Ошибка при создании файла трассы: %lu\n", (unsigned long)GetLastError());
+        trace->file = NULL;
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    // Отображение заданного размера само увеличивает файл
+    trace->mapping = CreateFileMappingA(trace->file, NULL, PAGE_READWRITE,
+                                        (DWORD)(size >> 32), (DWORD)size, NULL);
+    if (!trace->mapping) {
+        printf("Ошибка при отображении файла трассы: %lu\n", (unsigned long)GetLastError());
+        CloseHandle(trace->file);
+        trace->file = NULL;
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    uint8_t* view = (uint8_t*)MapViewOfFile(trace->mapping, FILE_MAP_WRITE, 0, 0, (SIZE_T)size);
+    if (!view) {
+        printf("Ошибка при отображении файла трассы: %lu\n", (unsigned long)GetLastError());
+        CloseHandle(trace->mapping);
+        CloseHandle(trace->file);
+        trace->mapping = NULL;
+        trace->file = NULL;
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    // Новое отображение заполнено нулями: все записи пусты
+    trace->header = (CardTraceHeader*)view;
+    trace->records = (CardTraceRecord*)(view + CARD_TRACE_HEADER_SIZE);
+    trace->mask = (uint32_t)(count - 1);
+    
+    memcpy(trace->header->magic, CARD_TRACE_MAGIC, sizeof(trace->header->magic));
+    trace->header->version = CARD_TRACE_VERSION;
+    trace->header->recordSize = CARD_TRACE_RECORD_SIZE;
+    trace->header->recordCount = (uint32_t)count;
+    
+    return CARD_SUCCESS;
+}
+
+int card_trace_flush(CardTrace* trace) {
+    if (!trace || !trace->header) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    if (!FlushViewOfFile(trace->header, 0) || !FlushFileBuffers(trace->file)) {
+        printf("Ошибка при сбросе трассы: %lu\n", (unsigned long)GetLastError());
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    return CARD_SUCCESS;
+}
+
+void card_trace_flush_on_crash(CardTrace* trace) {
+    InterlockedExchangePointer((PVOID volatile*)&crashTrace, trace);
+    SetUnhandledExceptionFilter(trace ? card_trace_crash_filter : NULL);
+}
+
+int card_trace_close(CardTrace* trace) {
+    if (!trace || !trace->header) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    if (card_trace_active() == trace) {
+        card_trace_install(NULL);
+    }
+    if (crashTrace == trace) {
+        card_trace_flush_on_crash(NULL);
+    }
+    
+    int result = card_trace_flush(trace);
+    
+    UnmapViewOfFile(trace->header);
+    CloseHandle(trace->mapping);
+    CloseHandle(trace->file);
+    memset(trace, 0, sizeof(CardTrace));
+    
+    return result;
+}
+
+void card_trace_install(CardTrace* trace) {
+    InterlockedExchangePointer((PVOID volatile*)&activeTrace, trace);
+}
+
+CardTrace* card_trace_active(void) {
+    return activeTrace;
+}
+
+uint8_t card_trace_reader(CardTrace* trace, const char* readerName) {
+    if (!trace || !trace->header || !readerName) {
+        return CARD_TRACE_NO_READER;
+    }
+    
+    CardTraceHeader* header = trace->header;
+    
+    for (uint8_t i = 0; i < CARD_TRACE_MAX_READERS; i++) {
+        volatile LONG* state = (volatile LONG*)&header->readerState[i];
+        char* name = header->readerNames[i];
+        
+        if (*state == 0 && InterlockedCompareExchange(state, 1, 0) == 0) {
+            strncpy(name, readerName, CARD_TRACE_READER_NAME - 1);
+            InterlockedExchange(state, 2);
+            return i;
+        }
+        
+        while (*state == 1) {
+            YieldProcessor();
+        }
+        
+        // Длинные имена хранятся усечёнными
+        if (strncmp(name, readerName, CARD_TRACE_READER_NAME - 1) == 0) {
+            return i;
+        }
+    }
+    
+    return CARD_TRACE_NO_READER;
+}
+
+void card_trace_record(CardTrace* trace, uint8_t readerId, CardTraceType type,
+                       const uint8_t* command, size_t commandLength,
+                       const uint8_t* response, size_t responseLength,
+                       LONG scardResult, uint64_t started, uint64_t elapsed) {
+    if (!trace || !trace->header) {
+        return;
+    }
+    
+    if (!command) {
+        commandLength = 0;
+    }
+    if (!response) {
+        responseLength = 0;
+    }
+    
+    // Номер записи выдаётся атомарно, самые старые записи перезаписываются
+    LONG64 sequence = InterlockedIncrement64((volatile LONG64*)&trace->header->head) - 1;
+    CardTraceRecord* record = &trace->records[(uint64_t)sequence & trace->mask];
+    
+    InterlockedExchange64((volatile LONG64*)&record->sequence, 0);
+    
+    // Ответу достаётся не меньше половины места, остальное — команде
+    size_t responseStored = responseLength < CARD_TRACE_DATA_SIZE / 2 ? responseLength : CARD_TRACE_DATA_SIZE / 2;
+    size_t commandStored = commandLength < CARD_TRACE_DATA_SIZE - responseStored
+                         ? commandLength : CARD_TRACE_DATA_SIZE - responseStored;
+    if (responseLength > responseStored) {
+        responseStored = responseLength < CARD_TRACE_DATA_SIZE - commandStored
+                       ? responseLength : CARD_TRACE_DATA_SIZE - commandStored;
+    }
+    
+    uint64_t micros = elapsed / 1000;
+    
+    record->timestamp = started;
+    record->elapsed = micros > 0xFFFFFFFFULL ? 0xFFFFFFFFUL : (uint32_t)micros;
+    record->result = (int32_t)scardResult;
+    record->commandLength = commandLength > 0xFFFF ? 0xFFFF : (uint16_t)commandLength;
+    record->responseLength = responseLength > 0xFFFF ? 0xFFFF : (uint16_t)responseLength;
+    record->readerId = readerId;
+    record->type = (uint8_t)type;
+    record->commandStored = (uint8_t)commandStored;
+    record->responseStored = (uint8_t)responseStored;
+    
+    if (commandStored > 0) {
+        memcpy(record->data, command, commandStored);
+    }
+    
+    if (responseStored > 0) {
+        uint8_t* target = record->data + commandStored;
+        if (responseStored == responseLength) {
+            memcpy(target, response, responseStored);
+        } else {
+            // Усечённый ответ: начало данных и статусное слово
+            memcpy(target, response, responseStored - 2);
+            memcpy(target + responseStored - 2, response + responseLength - 2, 2);
+        }
+    }
+    
+    // Публикация: номер записывается последним
+    InterlockedExchange64((volatile LONG64*)&record->sequence, sequence + 1);
+} 
\ No newline at end of file
@@ -0,0 +1,141 @@
+#ifndef CARD_TRACE_H
+#define CARD_TRACE_H
+
+#include <windows.h>
+#include <stdint.h>
+#include "card_domain.h"
+
+/**
+ * Слой инфраструктуры (Infrastructure Layer)
+ * Трасса обмена с картами: кольцевой буфер записей фиксированного размера
+ * в отображённом в память файле. Запись выполняется без блокировок из любых
+ * потоков и не меняет временные характеристики обмена так, как printf.
+ * Страницы отображения записываются системой и после аварийного завершения
+ * процесса; card_trace_flush дополнительно сбрасывает их на диск.
+ * Файл читается утилитой src/tools/trace_decode.c.
+ */
+
+#define CARD_TRACE_MAGIC "APDUTRC1"
+#define CARD_TRACE_VERSION 1
+#define CARD_TRACE_HEADER_SIZE 4096
+#define CARD_TRACE_RECORD_SIZE 128
+#define CARD_TRACE_DATA_SIZE (CARD_TRACE_RECORD_SIZE - 32)
+#define CARD_TRACE_MAX_READERS 32
+#define CARD_TRACE_READER_NAME 64
+#define CARD_TRACE_NO_READER 0xFF
+#define CARD_TRACE_MIN_RECORDS 64
+
+typedef enum {
+    CARD_TRACE_TRANSMIT = 0,  /* SCardTransmit: команда и ответ */
+    CARD_TRACE_CONNECT = 1    /* SCardConnect: без данных */
+} CardTraceType;
+
+/**
+ * Заголовок файла трассы (CARD_TRACE_HEADER_SIZE байт)
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t recordCount;     /* Степень двойки */
+    uint32_t reserved;
+    volatile int64_t head;    /* Номер следующей записи */
+    volatile int32_t readerState[CARD_TRACE_MAX_READERS]; /* 0 — свободен, 1 — занимается, 2 — готов */
+    char readerNames[CARD_TRACE_MAX_READERS][CARD_TRACE_READER_NAME];
+} CardTraceHeader;
+
+/**
+ * Запись трассы (CARD_TRACE_RECORD_SIZE байт)
+ * В data сначала хранится команда, затем ответ. Усечённый ответ сохраняет
+ * начало и последние два байта (SW1 SW2).
+ */
+typedef struct {
+    volatile int64_t sequence; /* Номер записи + 1; 0 — запись не завершена */
+    uint64_t timestamp;        /* Начало операции, нс (card_metrics_now) */
+    uint32_t elapsed;          /* Длительность, мкс */
+    int32_t result;            /* Код PC/SC */
+    uint16_t commandLength;    /* Исходные длины */
+    uint16_t responseLength;
+    uint8_t readerId;
+    uint8_t type;              /* CardTraceType */
+    uint8_t commandStored;     /* Сохранено байт в data */
+    uint8_t responseStored;
+    uint8_t data[CARD_TRACE_DATA_SIZE];
+} CardTraceRecord;
+
+typedef struct {
+    HANDLE file;
+    HANDLE mapping;
+    CardTraceHeader* header;
+    CardTraceRecord* records;
+    uint32_t mask;
+} CardTrace;
+
+/**
+ * Создание файла трассы и отображение его в память
+ * @param trace Структура трассы (память вызывающего)
+ * @param path Путь к файлу, существующий файл перезаписывается
+ * @param recordCount Количество записей, округляется вверх до степени двойки
+ * @return Код ошибки из CardError
+ */
+int card_trace_open(CardTrace* trace, const char* path, size_t recordCount);
+
+/**
+ * Сброс отображения на диск
+ * @param trace Трасса
+ * @return Код ошибки из CardError
+ */
+int card_trace_flush(CardTrace* trace);
+
+/**
+ * Сброс трассы на диск при необработанном исключении
+ * @param trace Трасса или NULL для отключения
+ */
+void card_trace_flush_on_crash(CardTrace* trace);
+
+/**
+ * Закрытие трассы с сбросом на диск
+ * @param trace Трасса
+ * @return Код ошибки из CardError
+ */
+int card_trace_close(CardTrace* trace);
+
+/**
+ * Подключение трассы к адаптеру WinSCard для всех контекстов процесса
+ * @param trace Трасса или NULL для выключения записи
+ */
+void card_trace_install(CardTrace* trace);
+
+/**
+ * Текущая трасса процесса
+ * @return Трасса или NULL, если запись выключена
+ */
+CardTrace* card_trace_active(void);
+
+/**
+ * Поиск или регистрация считывателя в заголовке трассы
+ * @param trace Трасса
+ * @param readerName Имя считывателя
+ * @return Идентификатор считывателя или CARD_TRACE_NO_READER
+ */
+uint8_t card_trace_reader(CardTrace* trace, const char* readerName);
+
+/**
+ * Добавление записи
+ * @param trace Трасса
+ * @param readerId Идентификатор считывателя
+ * @param type Тип операции из CardTraceType
+ * @param command Команда (может быть NULL)
+ * @param commandLength Длина команды
+ * @param response Ответ (может быть NULL)
+ * @param responseLength Длина ответа
+ * @param scardResult Код PC/SC
+ * @param started Начало операции, нс
+ * @param elapsed Длительность, нс
+ */
+void card_trace_record(CardTrace* trace, uint8_t readerId, CardTraceType type,
+                       const uint8_t* command, size_t commandLength,
+                       const uint8_t* response, size_t responseLength,
+                       LONG scardResult, uint64_t started, uint64_t elapsed);
+
+#endif /* CARD_TRACE_H */ 
\ No newline at end of file
@@ -0,0 +1,286 @@
+#include "reader_pool.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+/**
+ * Извлечение задания из начала очереди потока
+ */
+static ReaderPoolJob* reader_pool_pop(ReaderPoolWorker* worker) {
+    EnterCriticalSection(&worker->queueLock);
+    
+    ReaderPoolJob* job = worker->head;
+    if (job) {
+        worker->head = job->next;
+        if (!worker->head) {
+            worker->tail = NULL;
+        }
+        job->next = NULL;
+    }
+    
+    LeaveCriticalSection(&worker->queueLock);
+    return job;
+}
+
+/**
+ * Поиск задания: сначала своя очередь, затем очереди остальных потоков
+ */
+static ReaderPoolJob* reader_pool_take(ReaderPoolWorker* worker) {
+    ReaderPool* pool = worker->pool;
+    
+    ReaderPoolJob* job = reader_pool_pop(worker);
+    
+    for (size_t i = 1; !job && i < pool->workerCount; i++) {
+        ReaderPoolWorker* victim = &pool->workers[(worker->index + i) % pool->workerCount];
+        job = reader_pool_pop(victim);
+        if (job) {
+            InterlockedIncrement(&worker->stolen);
+        }
+    }
+    
+    // pending меняется только под pool->lock; до pending++ в submit
+    // счётчик может кратковременно уйти в минус, ожидание это учитывает
+    if (job) {
+        EnterCriticalSection(&pool->lock);
+        pool->pending--;
+        LeaveCriticalSection(&pool->lock);
+    }
+    
+    return job;
+}
+
+static void reader_pool_run(ReaderPoolWorker* worker, ReaderPoolJob* job) {
+    ReaderPool* pool = worker->pool;
+    
+    // Подключение восстанавливается перед заданием, если карта была недоступна
+    if (!worker->isConnected) {
+        worker->isConnected = card_service_connect(&worker->service, worker->readerName) == CARD_SUCCESS;
+    }
+    
+    job->readerIndex = worker->index;
+    if (worker->isConnected) {
+        job->result = job->run(&worker->service, job->argument);
+        if (job->result == CARD_ERROR_CONNECT_FAILED) {
+            card_service_disconnect(&worker->service);
+            worker->isConnected = 0;
+        }
+    } else {
+        job->result = CARD_ERROR_CONNECT_FAILED;
+    }
+    
+    InterlockedIncrement(&worker->completed);
+    
+    if (pool->config.onComplete) {
+        pool->config.onComplete(job, pool->config.userData);
+    }
+    
+    EnterCriticalSection(&pool->lock);
+    pool->inFlight--;
+    if (pool->inFlight == 0) {
+        WakeAllConditionVariable(&pool->stateChanged);
+    }
+    LeaveCriticalSection(&pool->lock);
+}
+
+static DWORD WINAPI reader_pool_worker(LPVOID parameter) {
+    ReaderPoolWorker* worker = (ReaderPoolWorker*)parameter;
+    ReaderPool* pool = worker->pool;
+    int result = CARD_ERROR_MEMORY_ALLOCATION;
+    
+    // Контекст репозитория создаётся в потоке, который будет его использовать
+    worker->repositoryContext = calloc(1, pool->config.contextSize);
+    if (worker->repositoryContext) {
+        worker->context.context = worker->repositoryContext;
+        result = card_service_initialize(&worker->service, pool->config.repository, &worker->context);
+    }
+    
+    if (result == CARD_SUCCESS) {
+        worker->isConnected = card_service_connect(&worker->service, worker->readerName) == CARD_SUCCESS;
+    } else {
+        printf("Не удалось инициализировать поток считывателя %s: %d\n", worker->readerName, result);
+    }
+    
+    EnterCriticalSection(&pool->lock);
+    worker->isActive = result == CARD_SUCCESS;
+    pool->startedCount++;
+    if (worker->isActive) {
+        pool->activeCount++;
+    }
+    WakeAllConditionVariable(&pool->stateChanged);
+    LeaveCriticalSection(&pool->lock);
+    
+    if (!worker->isActive) {
+        free(worker->repositoryContext);
+        worker->repositoryContext = NULL;
+        return 0;
+    }
+    
+    for (;;) {
+        ReaderPoolJob* job = reader_pool_take(worker);
+        if (job) {
+            reader_pool_run(worker, job);
+            continue;
+        }
+        
+        EnterCriticalSection(&pool->lock);
+        while (pool->pending <= 0 && !pool->isStopping) {
+            SleepConditionVariableCS(&pool->workAvailable, &pool->lock, INFINITE);
+        }
+        int finished = pool->isStopping && pool->pending <= 0;
+        LeaveCriticalSection(&pool->lock);
+        
+        if (finished) {
+            break;
+        }
+    }
+    
+    if (worker->isConnected) {
+        card_service_disconnect(&worker->service);
+        worker->isConnected = 0;
+    }
+    card_service_release(&worker->service);
+    free(worker->repositoryContext);
+    worker->repositoryContext = NULL;
+    
+    return 0;
+}
+
+int reader_pool_start(ReaderPool* pool, const ReaderPoolConfig* config) {
+    if (!pool || !config || !config->repository || !config->readerNames ||
+        config->readerCount == 0 || config->contextSize == 0) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    memset(pool, 0, sizeof(ReaderPool));
+    pool->config = *config;
+    
+    pool->workers = (ReaderPoolWorker*)calloc(config->readerCount, sizeof(ReaderPoolWorker));
+    if (!pool->workers) {
+        return CARD_ERROR_MEMORY_ALLOCATION;
+    }
+    pool->workerCount = config->readerCount;
+    
+    InitializeCriticalSection(&pool->lock);
+    InitializeConditionVariable(&pool->workAvailable);
+    InitializeConditionVariable(&pool->stateChanged);
+    
+    for (size_t i = 0; i < pool->workerCount; i++) {
+        ReaderPoolWorker* worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->index = i;
+        worker->readerName = config->readerNames[i];
+        InitializeCriticalSection(&worker->queueLock);
+        
+        worker->thread = CreateThread(NULL, 0, reader_pool_worker, worker, 0, NULL);
+        if (!worker->thread) {
+            printf("Ошибка при создании потока считывателя %s\n", worker->readerName);
+            EnterCriticalSection(&pool->lock);
+            pool->startedCount++;
+            LeaveCriticalSection(&pool->lock);
+        }
+    }
+    
+    // Ожидаем, пока каждый поток создаст свой контекст
+    EnterCriticalSection(&pool->lock);
+    while (pool->startedCount < pool->workerCount) {
+        SleepConditionVariableCS(&pool->stateChanged, &pool->lock, INFINITE);
+    }
+    size_t activeCount = pool->activeCount;
+    LeaveCriticalSection(&pool->lock);
+    
+    if (activeCount == 0) {
+        reader_pool_stop(pool);
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    return CARD_SUCCESS;
+}
+
+int reader_pool_submit(ReaderPool* pool, ReaderPoolJob* job) {
+    if (!pool || !pool->workers || !job || !job->run) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    // Очередь выбирается по кругу среди работающих потоков
+    ReaderPoolWorker* worker = NULL;
+    for (size_t attempt = 0; attempt < pool->workerCount && !worker; attempt++) {
+        size_t index = (size_t)(DWORD)InterlockedIncrement(&pool->nextWorker) % pool->workerCount;
+        if (pool->workers[index].isActive) {
+            worker = &pool->workers[index];
+        }
+    }
+    
+    if (!worker) {
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    job->next = NULL;
+    job->result = CARD_SUCCESS;
+    
+    EnterCriticalSection(&pool->lock);
+    if (pool->isStopping) {
+        LeaveCriticalSection(&pool->lock);
+        return CARD_ERROR_INIT_FAILED;
+    }
+    pool->inFlight++;
+    LeaveCriticalSection(&pool->lock);
+    
+    EnterCriticalSection(&worker->queueLock);
+    if (worker->tail) {
+        worker->tail->next = job;
+    } else {
+        worker->head = job;
+    }
+    worker->tail = job;
+    LeaveCriticalSection(&worker->queueLock);
+    
+    // Счётчик увеличивается после вставки, поэтому разбуженный поток найдёт задание
+    EnterCriticalSection(&pool->lock);
+    pool->pending++;
+    WakeConditionVariable(&pool->workAvailable);
+    LeaveCriticalSection(&pool->lock);
+    
+    return CARD_SUCCESS;
+}
+
+int reader_pool_wait_idle(ReaderPool* pool) {
+    if (!pool || !pool->workers) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    EnterCriticalSection(&pool->lock);
+    while (pool->inFlight > 0) {
+        SleepConditionVariableCS(&pool->stateChanged, &pool->lock, INFINITE);
+    }
+    LeaveCriticalSection(&pool->lock);
+    
+    return CARD_SUCCESS;
+}
+
+int reader_pool_stop(ReaderPool* pool) {
+    if (!pool || !pool->workers) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    EnterCriticalSection(&pool->lock);
+    pool->isStopping = 1;
+    WakeAllConditionVariable(&pool->workAvailable);
+    LeaveCriticalSection(&pool->lock);
+    
+    for (size_t i = 0; i < pool->workerCount; i++) {
+        ReaderPoolWorker* worker = &pool->workers[i];
+        if (worker->thread) {
+            WaitForSingleObject(worker->thread, INFINITE);
+            CloseHandle(worker->thread);
+            worker->thread = NULL;
+        }
+        DeleteCriticalSection(&worker->queueLock);
+    }
+    
+    DeleteCriticalSection(&pool->lock);
+    free(pool->workers);
+    pool->workers = NULL;
+    pool->workerCount = 0;
+    
+    return CARD_SUCCESS;
+} 
\ No newline at end of file
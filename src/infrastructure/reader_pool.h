@@ -0,0 +1,122 @@
+#ifndef READER_POOL_H
+#define READER_POOL_H
+
+#include <windows.h>
+#include "card_domain.h"
+#include "card_service.h"
+
+/**
+ * Слой инфраструктуры (Infrastructure Layer)
+ * Пул потоков для параллельной работы с несколькими считывателями.
+ * Каждый поток владеет своим контекстом репозитория (для WinSCard —
+ * собственный SCardEstablishContext) и подключением к одному считывателю.
+ */
+
+typedef struct ReaderPoolJob ReaderPoolJob;
+
+/**
+ * Функция задания, выполняется в потоке считывателя
+ * @param service Сервис, подключённый к считывателю потока
+ * @param argument Аргумент задания
+ * @return Код ошибки из CardError
+ */
+typedef int (*ReaderPoolJobFunction)(CardService* service, void* argument);
+
+/**
+ * Задание пула. Память задания принадлежит вызывающему и должна
+ * оставаться действительной до вызова функции завершения.
+ */
+struct ReaderPoolJob {
+    ReaderPoolJobFunction run;
+    void* argument;
+    int result;              /* Код ошибки из CardError */
+    size_t readerIndex;      /* Индекс считывателя, выполнившего задание */
+    ReaderPoolJob* next;     /* Служебное поле очереди */
+};
+
+/**
+ * Уведомление о завершении задания, вызывается в потоке считывателя
+ */
+typedef void (*ReaderPoolCompletion)(ReaderPoolJob* job, void* userData);
+
+typedef struct {
+    CardRepository* repository;      /* Репозиторий, общий для всех потоков */
+    size_t contextSize;              /* Размер контекста репозитория, например sizeof(WinScardContext) */
+    const char* const* readerNames;  /* Имена считывателей, по одному потоку на каждый */
+    size_t readerCount;
+    ReaderPoolCompletion onComplete; /* Может быть NULL */
+    void* userData;
+} ReaderPoolConfig;
+
+typedef struct ReaderPool ReaderPool;
+
+/**
+ * Поток считывателя с собственной очередью заданий
+ */
+typedef struct {
+    ReaderPool* pool;
+    size_t index;
+    const char* readerName;
+    HANDLE thread;
+    CRITICAL_SECTION queueLock;
+    ReaderPoolJob* head;
+    ReaderPoolJob* tail;
+    CardService service;
+    CardContext context;
+    void* repositoryContext;
+    int isActive;            /* Контекст репозитория создан, поток принимает задания */
+    int isConnected;
+    volatile LONG completed; /* Выполнено заданий */
+    volatile LONG stolen;    /* Из них взято из очередей других потоков */
+} ReaderPoolWorker;
+
+struct ReaderPool {
+    ReaderPoolConfig config;
+    ReaderPoolWorker* workers;
+    size_t workerCount;
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE workAvailable;
+    CONDITION_VARIABLE stateChanged;
+    LONG pending;            /* Заданий в очередях, под lock */
+    LONG inFlight;           /* Заданий принято и ещё не завершено */
+    size_t startedCount;     /* Потоков, закончивших запуск */
+    size_t activeCount;
+    volatile LONG nextWorker;
+    int isStopping;
+};
+
+/**
+ * Запуск пула: по одному потоку на считыватель
+ * Возвращает управление после запуска всех потоков.
+ * @param pool Структура пула (память вызывающего)
+ * @param config Параметры пула
+ * @return CARD_SUCCESS, если запущен хотя бы один поток, иначе код ошибки из CardError
+ */
+int reader_pool_start(ReaderPool* pool, const ReaderPoolConfig* config);
+
+/**
+ * Постановка задания в очередь
+ * Задание распределяется по очередям потоков, свободные потоки забирают
+ * задания из чужих очередей.
+ * @param pool Указатель на пул
+ * @param job Задание
+ * @return Код ошибки из CardError
+ */
+int reader_pool_submit(ReaderPool* pool, ReaderPoolJob* job);
+
+/**
+ * Ожидание завершения всех принятых заданий
+ * @param pool Указатель на пул
+ * @return Код ошибки из CardError
+ */
+int reader_pool_wait_idle(ReaderPool* pool);
+
+/**
+ * Остановка пула: оставшиеся задания выполняются, затем потоки
+ * отключаются от считывателей и освобождают свои контексты
+ * @param pool Указатель на пул
+ * @return Код ошибки из CardError
+ */
+int reader_pool_stop(ReaderPool* pool);
+
+#endif /* READER_POOL_H */ 
\ No newline at end of file
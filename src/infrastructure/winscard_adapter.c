@@ -1,4 +1,6 @@
 #include "winscard_adapter.h"
+#include "apdu.h"
+#include "card_profile.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -10,6 +12,114 @@ static WinScardContext* get_winscard_context(CardContext* context) {
     return (WinScardContext*)context->context;
 }
 
+/**
+ * Признак расширенных Lc/Le из таблицы возможностей карты в ATR
+ */
+static int atr_supports_extended_length(const BYTE* atr, DWORD atrLength) {
+    CardAtr parsed;
+    if (card_atr_parse(atr, atrLength, &parsed) != CARD_SUCCESS) {
+        return 0;
+    }
+    return parsed.extendedLength;
+}
+
+/**
+ * Протоколы для подключения по политике, ATR карты в считывателе и её профилю
+ * ATR до подключения берётся из состояния считывателя.
+ */
+static DWORD winscard_select_protocols(WinScardContext* winscardContext) {
+    switch (winscardContext->protocolPolicy) {
+        case WINSCARD_PROTOCOL_T0_ONLY:
+            return SCARD_PROTOCOL_T0;
+        case WINSCARD_PROTOCOL_T1_ONLY:
+            return SCARD_PROTOCOL_T1;
+        default:
+            break;
+    }
+    
+    SCARD_READERSTATE state;
+    memset(&state, 0, sizeof(state));
+    state.szReader = winscardContext->readerName;
+    state.dwCurrentState = SCARD_STATE_UNAWARE;
+    
+    uint16_t protocols = CARD_ATR_PROTOCOL_T0 | CARD_ATR_PROTOCOL_T1;
+    if (SCardGetStatusChange(winscardContext->hContext, 0, &state, 1) == SCARD_S_SUCCESS &&
+        state.cbAtr > 0 && state.cbAtr <= sizeof(state.rgbAtr)) {
+        protocols = card_profile_select_protocols(state.rgbAtr, state.cbAtr);
+    }
+    
+    // T=1 передаёт блоки больше 256 байт и цепочки без GET RESPONSE
+    if (winscardContext->protocolPolicy == WINSCARD_PROTOCOL_PREFER_T1 && (protocols & CARD_ATR_PROTOCOL_T1)) {
+        return SCARD_PROTOCOL_T1;
+    }
+    
+    DWORD selected = 0;
+    if (protocols & CARD_ATR_PROTOCOL_T0) {
+        selected |= SCARD_PROTOCOL_T0;
+    }
+    if (protocols & CARD_ATR_PROTOCOL_T1) {
+        selected |= SCARD_PROTOCOL_T1;
+    }
+    return selected;
+}
+
+/**
+ * Структура ввода-вывода для согласованного протокола, вычисляется один раз
+ * при подключении и используется всеми последующими командами
+ */
+static void winscard_update_pci(WinScardContext* winscardContext) {
+    switch (winscardContext->dwActiveProtocol) {
+        case SCARD_PROTOCOL_T0:
+            winscardContext->pci = SCARD_PCI_T0;
+            break;
+        case SCARD_PROTOCOL_T1:
+            winscardContext->pci = SCARD_PCI_T1;
+            break;
+        default:
+            winscardContext->pci = NULL;
+            break;
+    }
+}
+
+/**
+ * Чтение ATR подключённой карты и определение её возможностей
+ * @return Результат SCardStatus
+ */
+static LONG winscard_load_card_info(WinScardContext* winscardContext) {
+    DWORD readerLength = 0;
+    DWORD state = 0;
+    DWORD protocol = 0;
+    
+    winscardContext->atrLength = sizeof(winscardContext->atr);
+    LONG result = SCardStatus(winscardContext->hCard, NULL, &readerLength, &state, &protocol,
+                              winscardContext->atr, &(winscardContext->atrLength));
+    if (result == SCARD_S_SUCCESS) {
+        winscardContext->dwActiveProtocol = protocol;
+    } else {
+        // Извлечение и сброс карты обрабатываются вызывающим
+        if (result != SCARD_W_RESET_CARD && result != SCARD_W_REMOVED_CARD) {
+            printf("Ошибка при получении ATR карты: %X\n", (unsigned int)result);
+        }
+        winscardContext->atrLength = 0;
+    }
+    
+    switch (winscardContext->extendedMode) {
+        case WINSCARD_EXTENDED_ON:
+            winscardContext->extendedLength = 1;
+            break;
+        case WINSCARD_EXTENDED_OFF:
+            winscardContext->extendedLength = 0;
+            break;
+        default:
+            winscardContext->extendedLength = atr_supports_extended_length(winscardContext->atr,
+                                                                           winscardContext->atrLength);
+            break;
+    }
+    
+    winscard_update_pci(winscardContext);
+    return result;
+}
+
 int winscard_initialize(CardContext* context) {
     if (!context || !context->context) {
         return CARD_ERROR_INVALID_PARAMETER;
@@ -31,95 +141,238 @@ int winscard_initialize(CardContext* context) {
     return CARD_SUCCESS;
 }
 
-int winscard_list_readers(CardContext* context, char*** readers, size_t* readersCount) {
+/**
+ * Освобождение мультистроки кэшированного списка считывателей
+ */
+static void winscard_clear_readers(WinScardContext* winscardContext) {
+    WinScardReaderList* list = &winscardContext->readers;
+    
+    if (list->buffer) {
+        SCardFreeMemory(winscardContext->hContext, list->buffer);
+        list->buffer = NULL;
+    }
+    
+    list->count = 0;
+    list->isValid = 0;
+}
+
+/**
+ * Проверка уведомления PnP без ожидания
+ * @return 1, если набор считывателей мог измениться и список нужно перечитать
+ */
+static int winscard_readers_changed(WinScardContext* winscardContext) {
+    WinScardReaderList* list = &winscardContext->readers;
+    if (!list->isValid) {
+        return 1;
+    }
+    
+    SCARD_READERSTATE pnp;
+    memset(&pnp, 0, sizeof(pnp));
+    pnp.szReader = WINSCARD_PNP_READER;
+    pnp.dwCurrentState = list->pnpState;
+    
+    LONG result = SCardGetStatusChange(winscardContext->hContext, 0, &pnp, 1);
+    if (result == SCARD_E_TIMEOUT) {
+        return 0;
+    }
+    
+    // Без поддержки уведомлений PnP список перечитывается при каждом запросе
+    return 1;
+}
+
+/**
+ * Перечитывание списка считывателей одним вызовом SCardListReaders
+ */
+static int winscard_refresh_readers(WinScardContext* winscardContext) {
+    WinScardReaderList* list = &winscardContext->readers;
+    LPSTR buffer = NULL;
+    DWORD bufferLength = SCARD_AUTOALLOCATE;
+    
+    winscard_clear_readers(winscardContext);
+    
+    LONG result = SCardListReaders(winscardContext->hContext, NULL, (LPSTR)&buffer, &bufferLength);
+    if (result == SCARD_E_NO_READERS_AVAILABLE) {
+        buffer = NULL;
+    } else if (result != SCARD_S_SUCCESS) {
+        printf("Ошибка при получении списка считывателей: %X\n", (unsigned int)result);
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    // Индекс имён (разделены нулевыми байтами) строится по месту
+    list->buffer = buffer;
+    if (buffer) {
+        char* currentReader = buffer;
+        while (*currentReader != '\0' && list->count < WINSCARD_MAX_READERS) {
+            list->names[list->count++] = currentReader;
+            currentReader += strlen(currentReader) + 1;
+        }
+    }
+    
+    // Старшее слово состояния PnP — число считывателей
+    list->pnpState = (DWORD)(list->count << 16);
+    list->isValid = 1;
+    
+    return CARD_SUCCESS;
+}
+
+int winscard_get_readers(CardContext* context, char* const** readers, size_t* readersCount) {
     if (!context || !context->context || !readers || !readersCount) {
         return CARD_ERROR_INVALID_PARAMETER;
     }
     
     WinScardContext* winscardContext = get_winscard_context(context);
     
-    DWORD readersBufferSize = 0;
-    LONG result;
-    
-    // Получаем размер буфера для списка считывателей
-    result = SCardListReaders(winscardContext->hContext, NULL, NULL, &readersBufferSize);
-    if (result != SCARD_S_SUCCESS) {
-        if (result == SCARD_E_NO_READERS_AVAILABLE) {
-            *readersCount = 0;
-            *readers = NULL;
-            return CARD_SUCCESS;
+    if (winscard_readers_changed(winscardContext)) {
+        int result = winscard_refresh_readers(winscardContext);
+        if (result != CARD_SUCCESS) {
+            return result;
         }
-        printf("Ошибка при получении размера буфера считывателей: %X\n", (unsigned int)result);
-        return CARD_ERROR_INIT_FAILED;
     }
     
-    // Выделяем память для буфера
-    char* readersBuffer = (char*)malloc(readersBufferSize);
-    if (!readersBuffer) {
-        return CARD_ERROR_MEMORY_ALLOCATION;
+    *readers = winscardContext->readers.names;
+    *readersCount = winscardContext->readers.count;
+    return CARD_SUCCESS;
+}
+
+void winscard_invalidate_readers(CardContext* context) {
+    WinScardContext* winscardContext = get_winscard_context(context);
+    if (winscardContext) {
+        winscardContext->readers.isValid = 0;
     }
-    
-    // Получаем список считывателей
-    result = SCardListReaders(winscardContext->hContext, NULL, readersBuffer, &readersBufferSize);
-    if (result != SCARD_S_SUCCESS) {
-        free(readersBuffer);
-        printf("Ошибка при получении списка считывателей: %X\n", (unsigned int)result);
-        return CARD_ERROR_INIT_FAILED;
+}
+
+int winscard_list_readers(CardContext* context, char*** readers, size_t* readersCount) {
+    if (!context || !context->context || !readers || !readersCount) {
+        return CARD_ERROR_INVALID_PARAMETER;
     }
     
-    // Подсчет количества считывателей (разделены нулевыми байтами)
+    char* const* names = NULL;
     size_t count = 0;
-    char* currentReader = readersBuffer;
-    while (*currentReader != '\0') {
-        count++;
-        currentReader += strlen(currentReader) + 1;
+    int result = winscard_get_readers(context, &names, &count);
+    if (result != CARD_SUCCESS) {
+        return result;
     }
     
     *readersCount = count;
+    *readers = NULL;
     if (count == 0) {
-        free(readersBuffer);
-        *readers = NULL;
         return CARD_SUCCESS;
     }
     
-    // Выделяем память для массива указателей на имена считывателей
-    *readers = (char**)malloc(count * sizeof(char*));
-    if (!*readers) {
-        free(readersBuffer);
+    // Имена в мультистроке идут подряд: копируются одним блоком вслед за массивом указателей
+    const char* last = names[count - 1];
+    size_t namesLength = (size_t)(last - names[0]) + strlen(last) + 1;
+    char** copy = (char**)malloc(count * sizeof(char*) + namesLength);
+    if (!copy) {
         return CARD_ERROR_MEMORY_ALLOCATION;
     }
     
-    // Заполняем массив указателей
-    currentReader = readersBuffer;
+    char* copyNames = (char*)(copy + count);
+    memcpy(copyNames, names[0], namesLength);
     for (size_t i = 0; i < count; i++) {
-        size_t len = strlen(currentReader) + 1;
-        (*readers)[i] = (char*)malloc(len);
-        if (!(*readers)[i]) {
-            // Освобождаем ранее выделенную память
-            for (size_t j = 0; j < i; j++) {
-                free((*readers)[j]);
-            }
-            free(*readers);
-            free(readersBuffer);
-            return CARD_ERROR_MEMORY_ALLOCATION;
-        }
-        strcpy((*readers)[i], currentReader);
-        currentReader += len;
+        copy[i] = copyNames + (names[i] - names[0]);
     }
     
-    free(readersBuffer);
+    *readers = copy;
     return CARD_SUCCESS;
 }
 
 void winscard_free_readers(char** readers, size_t readersCount) {
-    if (!readers) {
-        return;
+    // Имена размещены в том же блоке, что и массив указателей
+    (void)readersCount;
+    free(readers);
+}
+
+/**
+ * Преобразование действия домена в значение PC/SC
+ */
+static DWORD winscard_disposition(CardDisposition disposition) {
+    switch (disposition) {
+        case CARD_DISPOSITION_RESET:
+            return SCARD_RESET_CARD;
+        case CARD_DISPOSITION_UNPOWER:
+            return SCARD_UNPOWER_CARD;
+        default:
+            return SCARD_LEAVE_CARD;
+    }
+}
+
+/**
+ * Закрытие hCard независимо от постоянного режима
+ */
+static LONG winscard_close_handle(WinScardContext* winscardContext, DWORD disposition) {
+    LONG result = SCARD_S_SUCCESS;
+    
+    if (winscardContext->hasHandle) {
+        result = SCardDisconnect(winscardContext->hCard, disposition);
+        winscardContext->hasHandle = 0;
     }
     
-    for (size_t i = 0; i < readersCount; i++) {
-        free(readers[i]);
+    winscardContext->isConnected = 0;
+    return result;
+}
+
+/**
+ * Восстановление после сброса карты другим приложением (SCARD_W_RESET_CARD)
+ * Карта уже сброшена, поэтому SCardReconnect выполняется без повторного сброса
+ */
+static LONG winscard_recover_reset(WinScardContext* winscardContext) {
+    LONG result = SCardReconnect(winscardContext->hCard, SCARD_SHARE_SHARED,
+                                 winscardContext->preferredProtocols, SCARD_LEAVE_CARD,
+                                 &(winscardContext->dwActiveProtocol));
+    if (result == SCARD_S_SUCCESS) {
+        winscardContext->resetCount++;
+        winscard_load_card_info(winscardContext);
+    }
+    
+    return result;
+}
+
+/**
+ * Проверка сохранённого hCard перед новой сессией
+ */
+static LONG winscard_resume_handle(WinScardContext* winscardContext) {
+    LONG result = winscard_load_card_info(winscardContext);
+    if (result == SCARD_W_RESET_CARD) {
+        return winscard_recover_reset(winscardContext);
+    }
+    
+    return result;
+}
+
+/**
+ * Учёт операции в метриках и трассе, если они подключены
+ * Слоты считывателя ищутся заново только при смене реестра или трассы.
+ */
+static void winscard_observe(WinScardContext* winscardContext, CardMetrics* metrics, CardTrace* trace,
+                             CardTraceType type, const uint8_t* command, size_t commandLength,
+                             const uint8_t* response, size_t responseLength,
+                             LONG result, uint64_t started) {
+    uint64_t elapsed = card_metrics_now() - started;
+    
+    if (metrics) {
+        if (winscardContext->metrics != metrics) {
+            winscardContext->metrics = metrics;
+            winscardContext->metricsReader = card_metrics_reader(metrics, winscardContext->readerName);
+        }
+        
+        if (type == CARD_TRACE_CONNECT) {
+            card_metrics_record_connect(metrics, winscardContext->metricsReader, result, elapsed);
+        } else {
+            card_metrics_record_transmit(metrics, winscardContext->metricsReader, command, commandLength,
+                                         response, responseLength, result, elapsed);
+        }
+    }
+    
+    if (trace) {
+        if (winscardContext->trace != trace) {
+            winscardContext->trace = trace;
+            winscardContext->traceReader = card_trace_reader(trace, winscardContext->readerName);
+        }
+        
+        card_trace_record(trace, winscardContext->traceReader, type, command, commandLength,
+                          response, responseLength, result, started, elapsed);
     }
-    free(readers);
 }
 
 int winscard_connect(CardContext* context, const char* readerName) {
@@ -129,57 +382,151 @@ int winscard_connect(CardContext* context, const char* readerName) {
     
     WinScardContext* winscardContext = get_winscard_context(context);
     
+    // Сохранённое подключение к тому же считывателю используется без SCardConnect,
+    // если карта не извлекалась
+    if (winscardContext->hasHandle) {
+        if (strcmp(winscardContext->readerName, readerName) == 0 &&
+            winscard_resume_handle(winscardContext) == SCARD_S_SUCCESS) {
+            winscardContext->isConnected = 1;
+            return CARD_SUCCESS;
+        }
+        winscard_close_handle(winscardContext, SCARD_LEAVE_CARD);
+    }
+    
     // Сохраняем имя считывателя
+    memset(winscardContext->readerName, 0, sizeof(winscardContext->readerName));
     strncpy(winscardContext->readerName, readerName, sizeof(winscardContext->readerName) - 1);
+    winscardContext->metrics = NULL;
+    winscardContext->trace = NULL;
+    winscardContext->preferredProtocols = winscard_select_protocols(winscardContext);
+    
+    CardMetrics* metrics = card_metrics_active();
+    CardTrace* trace = card_trace_active();
+    uint64_t started = (metrics || trace) ? card_metrics_now() : 0;
     
     // Подключаемся к карте в указанном считывателе
     LONG result = SCardConnect(winscardContext->hContext, 
                            winscardContext->readerName,
                            SCARD_SHARE_SHARED, 
-                           SCARD_PROTOCOL_T0 | SCARD_PROTOCOL_T1,
+                           winscardContext->preferredProtocols,
                            &(winscardContext->hCard), 
                            &(winscardContext->dwActiveProtocol));
     
+    // Предпочтение T=1 не обязательно: считыватель может не согласовать его
+    if (result == SCARD_E_PROTO_MISMATCH && winscardContext->protocolPolicy == WINSCARD_PROTOCOL_PREFER_T1 &&
+        winscardContext->preferredProtocols != (SCARD_PROTOCOL_T0 | SCARD_PROTOCOL_T1)) {
+        winscardContext->preferredProtocols = SCARD_PROTOCOL_T0 | SCARD_PROTOCOL_T1;
+        result = SCardConnect(winscardContext->hContext, winscardContext->readerName, SCARD_SHARE_SHARED,
+                              winscardContext->preferredProtocols, &(winscardContext->hCard),
+                              &(winscardContext->dwActiveProtocol));
+    }
+    
+    if (metrics || trace) {
+        winscard_observe(winscardContext, metrics, trace, CARD_TRACE_CONNECT, NULL, 0, NULL, 0, result, started);
+    }
+    
     if (result != SCARD_S_SUCCESS) {
         printf("Ошибка при подключении к карте: %X\n", (unsigned int)result);
         return CARD_ERROR_CONNECT_FAILED;
     }
     
+    winscardContext->hasHandle = 1;
     winscardContext->isConnected = 1;
+    winscard_load_card_info(winscardContext);
     return CARD_SUCCESS;
 }
 
 int winscard_disconnect(CardContext* context) {
+    return winscard_disconnect_with(context, CARD_DISPOSITION_LEAVE);
+}
+
+int winscard_disconnect_with(CardContext* context, CardDisposition disposition) {
     if (!context || !context->context) {
         return CARD_ERROR_INVALID_PARAMETER;
     }
     
     WinScardContext* winscardContext = get_winscard_context(context);
     
-    if (winscardContext->isConnected) {
-        LONG result = SCardDisconnect(winscardContext->hCard, SCARD_LEAVE_CARD);
-        if (result != SCARD_S_SUCCESS) {
-            printf("Ошибка при отключении от карты: %X\n", (unsigned int)result);
-            return CARD_ERROR_CONNECT_FAILED;
-        }
+    // В постоянном режиме hCard остаётся открытым до следующей сессии
+    if (winscardContext->persistent && disposition == CARD_DISPOSITION_LEAVE) {
         winscardContext->isConnected = 0;
+        return CARD_SUCCESS;
+    }
+    
+    LONG result = winscard_close_handle(winscardContext, winscard_disposition(disposition));
+    if (result != SCARD_S_SUCCESS) {
+        printf("Ошибка при отключении от карты: %X\n", (unsigned int)result);
+        return CARD_ERROR_CONNECT_FAILED;
     }
     
     return CARD_SUCCESS;
 }
 
-int winscard_release(CardContext* context) {
+int winscard_reconnect(CardContext* context, CardDisposition initialization) {
+    if (!context || !context->context) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    WinScardContext* winscardContext = get_winscard_context(context);
+    
+    if (!winscardContext->hasHandle) {
+        return CARD_ERROR_CONNECT_FAILED;
+    }
+    
+    LONG result = SCardReconnect(winscardContext->hCard, SCARD_SHARE_SHARED,
+                                 winscardContext->preferredProtocols,
+                                 winscard_disposition(initialization),
+                                 &(winscardContext->dwActiveProtocol));
+    
+    // Сброс, найденный через SCARD_W_RESET_CARD, учитывается в winscard_recover_reset
+    int recovered = result == SCARD_W_RESET_CARD;
+    if (recovered) {
+        result = winscard_recover_reset(winscardContext);
+    }
+    
+    if (result != SCARD_S_SUCCESS) {
+        printf("Ошибка при повторном подключении к карте: %X\n", (unsigned int)result);
+        winscard_close_handle(winscardContext, SCARD_LEAVE_CARD);
+        return CARD_ERROR_CONNECT_FAILED;
+    }
+    
+    if (initialization != CARD_DISPOSITION_LEAVE && !recovered) {
+        winscardContext->resetCount++;
+    }
+    
+    winscardContext->isConnected = 1;
+    winscard_load_card_info(winscardContext);
+    return CARD_SUCCESS;
+}
+
+int winscard_set_persistent(CardContext* context, int persistent) {
     if (!context || !context->context) {
         return CARD_ERROR_INVALID_PARAMETER;
     }
     
     WinScardContext* winscardContext = get_winscard_context(context);
+    winscardContext->persistent = persistent != 0;
+    
+    // Сохранённый hCard без сессии закрывается при выключении режима
+    if (!winscardContext->persistent && !winscardContext->isConnected) {
+        winscard_close_handle(winscardContext, SCARD_LEAVE_CARD);
+    }
     
-    // Отключаемся от карты, если подключены
-    if (winscardContext->isConnected) {
-        winscard_disconnect(context);
+    return CARD_SUCCESS;
+}
+
+int winscard_release(CardContext* context) {
+    if (!context || !context->context) {
+        return CARD_ERROR_INVALID_PARAMETER;
     }
     
+    WinScardContext* winscardContext = get_winscard_context(context);
+    
+    // Закрываем подключение, в том числе сохранённое между сессиями
+    winscard_close_handle(winscardContext, SCARD_LEAVE_CARD);
+    
+    winscard_clear_readers(winscardContext);
+    
     // Освобождаем контекст
     if (winscardContext->hContext) {
         LONG result = SCardReleaseContext(winscardContext->hContext);
@@ -206,24 +553,37 @@ int winscard_transmit(CardContext* context, const uint8_t* command, size_t comma
         return CARD_ERROR_CONNECT_FAILED;
     }
     
-    SCARD_IO_REQUEST ioRequest;
+    DWORD dwResponseLength = 0;
+    LONG result = SCARD_W_RESET_CARD;
+    CardMetrics* metrics = card_metrics_active();
+    CardTrace* trace = card_trace_active();
     
-    // Определяем структуру ввода-вывода в зависимости от активного протокола
-    if (winscardContext->dwActiveProtocol == SCARD_PROTOCOL_T0) {
-        ioRequest = *SCARD_PCI_T0;
-    } else if (winscardContext->dwActiveProtocol == SCARD_PROTOCOL_T1) {
-        ioRequest = *SCARD_PCI_T1;
-    } else {
-        printf("Неподдерживаемый протокол\n");
-        return CARD_ERROR_TRANSMIT_FAILED;
+    // После сброса карты другим приложением команда повторяется один раз
+    for (int attempt = 0; attempt < 2 && result == SCARD_W_RESET_CARD; attempt++) {
+        if (attempt > 0 && winscard_recover_reset(winscardContext) != SCARD_S_SUCCESS) {
+            break;
+        }
+        
+        // Структура ввода-вывода определена при подключении
+        if (!winscardContext->pci) {
+            printf("Неподдерживаемый протокол\n");
+            return CARD_ERROR_TRANSMIT_FAILED;
+        }
+        
+        dwResponseLength = (DWORD)*responseLength;
+        
+        uint64_t started = (metrics || trace) ? card_metrics_now() : 0;
+        
+        // Отправляем команду на карту и получаем ответ
+        result = SCardTransmit(winscardContext->hCard, winscardContext->pci, command, (DWORD)commandLength,
+                               NULL, response, &dwResponseLength);
+        
+        if (metrics || trace) {
+            winscard_observe(winscardContext, metrics, trace, CARD_TRACE_TRANSMIT, command, commandLength,
+                             response, dwResponseLength, result, started);
+        }
     }
     
-    DWORD dwResponseLength = (DWORD)*responseLength;
-    
-    // Отправляем команду на карту и получаем ответ
-    LONG result = SCardTransmit(winscardContext->hCard, &ioRequest, command, (DWORD)commandLength,
-                          NULL, response, &dwResponseLength);
-    
     if (result != SCARD_S_SUCCESS) {
         printf("Ошибка при передаче данных карте: %X\n", (unsigned int)result);
         return CARD_ERROR_TRANSMIT_FAILED;
@@ -233,6 +593,135 @@ int winscard_transmit(CardContext* context, const uint8_t* command, size_t comma
     return CARD_SUCCESS;
 }
 
+int winscard_set_extended_mode(CardContext* context, WinScardExtendedMode mode) {
+    if (!context || !context->context || mode < WINSCARD_EXTENDED_AUTO || mode > WINSCARD_EXTENDED_OFF) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    WinScardContext* winscardContext = get_winscard_context(context);
+    winscardContext->extendedMode = mode;
+    
+    return CARD_SUCCESS;
+}
+
+int winscard_set_protocol_policy(CardContext* context, WinScardProtocolPolicy policy) {
+    if (!context || !context->context || policy < WINSCARD_PROTOCOL_PREFER_T1 || policy > WINSCARD_PROTOCOL_READER) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    WinScardContext* winscardContext = get_winscard_context(context);
+    winscardContext->protocolPolicy = policy;
+    
+    return CARD_SUCCESS;
+}
+
+/**
+ * Числовой атрибут считывателя; 0, если считыватель его не сообщает
+ */
+static DWORD winscard_get_attrib_dword(SCARDHANDLE hCard, DWORD attribute) {
+    BYTE buffer[sizeof(DWORD)];
+    DWORD length = sizeof(buffer);
+    
+    if (SCardGetAttrib(hCard, attribute, buffer, &length) != SCARD_S_SUCCESS || length == 0) {
+        return 0;
+    }
+    
+    // Значение в порядке little-endian, длина от 1 до 4 байт
+    DWORD value = 0;
+    for (DWORD i = length; i > 0; i--) {
+        value = (value << 8) | buffer[i - 1];
+    }
+    return value;
+}
+
+int winscard_get_link_info(CardContext* context, WinScardLinkInfo* link) {
+    if (!context || !context->context || !link) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    WinScardContext* winscardContext = get_winscard_context(context);
+    
+    if (!winscardContext->isConnected) {
+        return CARD_ERROR_CONNECT_FAILED;
+    }
+    
+    memset(link, 0, sizeof(WinScardLinkInfo));
+    link->protocol = winscardContext->dwActiveProtocol;
+    link->ifsd = winscard_get_attrib_dword(winscardContext->hCard, SCARD_ATTR_CURRENT_IFSD);
+    link->ifsc = winscard_get_attrib_dword(winscardContext->hCard, SCARD_ATTR_CURRENT_IFSC);
+    link->clock = winscard_get_attrib_dword(winscardContext->hCard, SCARD_ATTR_CURRENT_CLK);
+    link->f = winscard_get_attrib_dword(winscardContext->hCard, SCARD_ATTR_CURRENT_F);
+    link->d = winscard_get_attrib_dword(winscardContext->hCard, SCARD_ATTR_CURRENT_D);
+    
+    // Скорость обмена: частота (кГц) * D / F
+    if (link->clock > 0 && link->f > 0 && link->d > 0) {
+        link->baudRate = (DWORD)((uint64_t)link->clock * 1000 * link->d / link->f);
+    }
+    
+    return CARD_SUCCESS;
+}
+
+int winscard_get_info(CardContext* context, CardInfo* info) {
+    if (!context || !context->context || !info) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    WinScardContext* winscardContext = get_winscard_context(context);
+    
+    if (!winscardContext->isConnected) {
+        return CARD_ERROR_CONNECT_FAILED;
+    }
+    
+    memcpy(info->atr, winscardContext->atr, winscardContext->atrLength);
+    info->atrLength = winscardContext->atrLength;
+    info->extendedLength = winscardContext->extendedLength;
+    info->maxCommandData = winscardContext->extendedLength ? APDU_EXTENDED_MAX_LC : APDU_SHORT_MAX_LC;
+    info->maxResponseData = winscardContext->extendedLength ? APDU_EXTENDED_MAX_LE : APDU_SHORT_MAX_LE;
+    info->resetCount = winscardContext->resetCount;
+    
+    return CARD_SUCCESS;
+}
+
+int winscard_transmit_batch(CardContext* context, CardBatchItem* items, size_t count,
+                            CardBatchPolicy policy, size_t* executed) {
+    if (executed) {
+        *executed = 0;
+    }
+    
+    if (!context || !context->context || (!items && count > 0)) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    WinScardContext* winscardContext = get_winscard_context(context);
+    
+    if (!winscardContext->isConnected) {
+        printf("Нет подключения к карте\n");
+        return CARD_ERROR_CONNECT_FAILED;
+    }
+    
+    // Вся последовательность выполняется без вмешательства других процессов
+    LONG result = SCardBeginTransaction(winscardContext->hCard);
+    if (result == SCARD_W_RESET_CARD && winscard_recover_reset(winscardContext) == SCARD_S_SUCCESS) {
+        result = SCardBeginTransaction(winscardContext->hCard);
+    }
+    if (result != SCARD_S_SUCCESS) {
+        printf("Ошибка при начале транзакции: %X\n", (unsigned int)result);
+        return CARD_ERROR_TRANSMIT_FAILED;
+    }
+    
+    int batchResult = card_batch_execute(context, winscard_transmit, items, count, policy, executed);
+    
+    result = SCardEndTransaction(winscardContext->hCard, SCARD_LEAVE_CARD);
+    if (result != SCARD_S_SUCCESS) {
+        printf("Ошибка при завершении транзакции: %X\n", (unsigned int)result);
+        if (batchResult == CARD_SUCCESS) {
+            batchResult = CARD_ERROR_TRANSMIT_FAILED;
+        }
+    }
+    
+    return batchResult;
+}
+
 CardRepository winscard_create_repository() {
     CardRepository repository = {
         .initialize = winscard_initialize,
@@ -240,7 +729,11 @@ CardRepository winscard_create_repository() {
         .connect = winscard_connect,
         .disconnect = winscard_disconnect,
         .release = winscard_release,
-        .transmit = winscard_transmit
+        .transmit = winscard_transmit,
+        .get_info = winscard_get_info,
+        .transmit_batch = winscard_transmit_batch,
+        .reconnect = winscard_reconnect,
+        .disconnect_with = winscard_disconnect_with
     };
     
     return repository;
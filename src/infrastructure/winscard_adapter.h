@@ -4,18 +4,85 @@
 #include <windows.h>
 #include <winscard.h>
 #include "card_domain.h"
+#include "card_metrics.h"
+#include "card_trace.h"
 
 /**
  * Слой инфраструктуры (Infrastructure Layer)
  * Адаптер для работы с WinSCard API
  */
 
+/**
+ * Режим использования APDU расширенной длины
+ */
+typedef enum {
+    WINSCARD_EXTENDED_AUTO = 0,   /* Определяется по историческим байтам ATR */
+    WINSCARD_EXTENDED_ON = 1,     /* Принудительно включён */
+    WINSCARD_EXTENDED_OFF = 2     /* Принудительно выключен */
+} WinScardExtendedMode;
+
+/**
+ * Выбор протокола при подключении
+ */
+typedef enum {
+    WINSCARD_PROTOCOL_PREFER_T1 = 0,  /* T=1, если карта его предлагает, иначе по ATR и профилю */
+    WINSCARD_PROTOCOL_T0_ONLY = 1,    /* Только T=0 */
+    WINSCARD_PROTOCOL_T1_ONLY = 2,    /* Только T=1 */
+    WINSCARD_PROTOCOL_READER = 3      /* По ATR и профилю карты, выбор T=0/T=1 за считывателем */
+} WinScardProtocolPolicy;
+
+/**
+ * Параметры канала с картой, сообщаемые считывателем (0 — не сообщается)
+ */
+typedef struct {
+    DWORD protocol;           /* SCARD_PROTOCOL_T0 или SCARD_PROTOCOL_T1 */
+    DWORD ifsd;               /* Размер информационного поля считывателя (T=1) */
+    DWORD ifsc;               /* Размер информационного поля карты (T=1) */
+    DWORD clock;              /* Частота, кГц */
+    DWORD f;                  /* Коэффициент преобразования частоты F */
+    DWORD d;                  /* Коэффициент скорости D */
+    DWORD baudRate;           /* Скорость обмена, бит/с (clock * D / F) */
+} WinScardLinkInfo;
+
+#define WINSCARD_MAX_READERS 64
+
+/* Псевдосчитыватель для уведомлений о подключении и отключении считывателей */
+#define WINSCARD_PNP_READER "\\\\?PnP?\\Notification"
+
+/**
+ * Кэшированный список считывателей
+ * Имена хранятся в мультистроке, выделенной PC/SC, без копирования;
+ * список перечитывается только после уведомления об изменении набора считывателей.
+ */
+typedef struct {
+    LPSTR buffer;                       /* Мультистрока SCardListReaders (SCARD_AUTOALLOCATE) */
+    char* names[WINSCARD_MAX_READERS];  /* Указатели на имена внутри buffer */
+    size_t count;
+    DWORD pnpState;                     /* Ожидаемое состояние \\?PnP?\Notification */
+    int isValid;
+} WinScardReaderList;
+
 typedef struct {
     SCARDCONTEXT hContext;
     SCARDHANDLE hCard;
     DWORD dwActiveProtocol;
+    DWORD preferredProtocols;   /* Протоколы по политике, ATR и профилю для SCardConnect/SCardReconnect */
+    LPCSCARD_IO_REQUEST pci;    /* Структура ввода-вывода согласованного протокола */
+    WinScardProtocolPolicy protocolPolicy;
     char readerName[256];
     int isConnected;
+    BYTE atr[CARD_ATR_MAX_LENGTH];
+    DWORD atrLength;
+    WinScardExtendedMode extendedMode;
+    int extendedLength;
+    WinScardReaderList readers;
+    int hasHandle;              /* hCard открыт (в том числе сохранён между сессиями) */
+    int persistent;             /* Не закрывать hCard при отключении без сброса */
+    unsigned long resetCount;   /* Сбросов карты, обработанных через SCardReconnect */
+    CardMetrics* metrics;       /* Реестр, к которому привязан metricsReader */
+    CardMetricsReader* metricsReader;
+    CardTrace* trace;           /* Трасса, к которой относится traceReader */
+    uint8_t traceReader;
 } WinScardContext;
 
 /**
@@ -26,7 +93,8 @@ typedef struct {
 int winscard_initialize(CardContext* context);
 
 /**
- * Получение списка доступных считывателей
+ * Получение копии списка доступных считывателей
+ * Массив указателей и имена размещаются одним блоком памяти.
  * @param context Контекст карты с WinScardContext внутри
  * @param readers Указатель на массив строк с именами считывателей (будет выделена память)
  * @param readersCount Количество найденных считывателей
@@ -41,6 +109,23 @@ int winscard_list_readers(CardContext* context, char*** readers, size_t* readers
  */
 void winscard_free_readers(char** readers, size_t readersCount);
 
+/**
+ * Получение кэшированного списка считывателей без выделения памяти
+ * PC/SC опрашивается только при изменении набора считывателей.
+ * Указатели действительны до следующего вызова с этим контекстом.
+ * @param context Контекст карты с WinScardContext внутри
+ * @param readers Указатель на массив имён считывателей (принадлежит контексту)
+ * @param readersCount Количество считывателей
+ * @return Код ошибки из CardError
+ */
+int winscard_get_readers(CardContext* context, char* const** readers, size_t* readersCount);
+
+/**
+ * Принудительное перечитывание списка считывателей при следующем запросе
+ * @param context Контекст карты с WinScardContext внутри
+ */
+void winscard_invalidate_readers(CardContext* context);
+
 /**
  * Подключение к считывателю карт
  * @param context Контекст карты с WinScardContext внутри
@@ -56,6 +141,35 @@ int winscard_connect(CardContext* context, const char* readerName);
  */
 int winscard_disconnect(CardContext* context);
 
+/**
+ * Отключение от считывателя с выбором действия над картой
+ * В постоянном режиме отключение без сброса сохраняет hCard для следующего
+ * подключения к тому же считывателю.
+ * @param context Контекст карты с WinScardContext внутри
+ * @param disposition Действие из CardDisposition
+ * @return Код ошибки из CardError
+ */
+int winscard_disconnect_with(CardContext* context, CardDisposition disposition);
+
+/**
+ * Повторное подключение к карте через SCardReconnect без закрытия hCard
+ * @param context Контекст карты с WinScardContext внутри
+ * @param initialization CARD_DISPOSITION_RESET — тёплый сброс,
+ *                       CARD_DISPOSITION_UNPOWER — холодный,
+ *                       CARD_DISPOSITION_LEAVE — согласование без сброса
+ * @return Код ошибки из CardError
+ */
+int winscard_reconnect(CardContext* context, CardDisposition initialization);
+
+/**
+ * Включение постоянного подключения между сессиями
+ * Вызывается после инициализации
+ * @param context Контекст карты с WinScardContext внутри
+ * @param persistent 1 — сохранять hCard при отключении, 0 — закрывать
+ * @return Код ошибки из CardError
+ */
+int winscard_set_persistent(CardContext* context, int persistent);
+
 /**
  * Освобождение ресурсов WinSCard
  * @param context Контекст карты с WinScardContext внутри
@@ -75,6 +189,52 @@ int winscard_release(CardContext* context);
 int winscard_transmit(CardContext* context, const uint8_t* command, size_t commandLength, 
                       uint8_t* response, size_t* responseLength);
 
+/**
+ * Пакетная отправка команд в рамках одной транзакции PC/SC
+ * @param context Контекст карты с WinScardContext внутри
+ * @param items Массив команд, результаты записываются в него же
+ * @param count Количество команд
+ * @param policy Правила остановки из CardBatchPolicy
+ * @param executed Количество выполненных команд (может быть NULL)
+ * @return CARD_SUCCESS или код ошибки первой неуспешной команды
+ */
+int winscard_transmit_batch(CardContext* context, CardBatchItem* items, size_t count,
+                            CardBatchPolicy policy, size_t* executed);
+
+/**
+ * Выбор режима APDU расширенной длины
+ * Вызывается после инициализации, действует начиная со следующего подключения
+ * @param context Контекст карты с WinScardContext внутри
+ * @param mode Режим из WinScardExtendedMode
+ * @return Код ошибки из CardError
+ */
+int winscard_set_extended_mode(CardContext* context, WinScardExtendedMode mode);
+
+/**
+ * Выбор политики протокола
+ * Вызывается после инициализации, действует начиная со следующего подключения
+ * @param context Контекст карты с WinScardContext внутри
+ * @param policy Политика из WinScardProtocolPolicy
+ * @return Код ошибки из CardError
+ */
+int winscard_set_protocol_policy(CardContext* context, WinScardProtocolPolicy policy);
+
+/**
+ * Согласованный протокол и параметры канала из SCardGetAttrib
+ * @param context Контекст карты с WinScardContext внутри
+ * @param link Структура для параметров
+ * @return Код ошибки из CardError
+ */
+int winscard_get_link_info(CardContext* context, WinScardLinkInfo* link);
+
+/**
+ * Получение ATR и возможностей подключённой карты
+ * @param context Контекст карты с WinScardContext внутри
+ * @param info Структура для сведений о карте
+ * @return Код ошибки из CardError
+ */
+int winscard_get_info(CardContext* context, CardInfo* info);
+
 /**
  * Создание репозитория карт, использующего WinSCard
  * @return Структура репозитория с функциями WinSCard
@@ -0,0 +1,167 @@
+#include "card_cache.h"
+#include <string.h>
+
+/**
+ * Установка или сброс битов [start, end) битовой карты
+ * Целые байты обрабатываются через memset
+ */
+static void valid_map_fill(uint8_t* map, size_t start, size_t end, int value) {
+    while (start < end && (start & 7) != 0) {
+        if (value) {
+            map[start >> 3] |= (uint8_t)(1u << (start & 7));
+        } else {
+            map[start >> 3] &= (uint8_t)~(1u << (start & 7));
+        }
+        start++;
+    }
+    
+    size_t wholeBytes = (end - start) >> 3;
+    if (wholeBytes > 0) {
+        memset(map + (start >> 3), value ? 0xFF : 0x00, wholeBytes);
+        start += wholeBytes << 3;
+    }
+    
+    while (start < end) {
+        if (value) {
+            map[start >> 3] |= (uint8_t)(1u << (start & 7));
+        } else {
+            map[start >> 3] &= (uint8_t)~(1u << (start & 7));
+        }
+        start++;
+    }
+}
+
+static int valid_map_test(const uint8_t* map, size_t position) {
+    return (map[position >> 3] >> (position & 7)) & 1;
+}
+
+CardMemoryCache* card_cache_create(size_t capacity) {
+    if (capacity == 0) {
+        return NULL;
+    }
+    
+    CardMemoryCache* cache = (CardMemoryCache*)calloc(1, sizeof(CardMemoryCache));
+    if (!cache) {
+        return NULL;
+    }
+    
+    cache->image = (uint8_t*)malloc(capacity);
+    cache->validMap = (uint8_t*)calloc((capacity + 7) / 8, 1);
+    if (!cache->image || !cache->validMap) {
+        card_cache_free(cache);
+        return NULL;
+    }
+    
+    cache->capacity = capacity;
+    return cache;
+}
+
+void card_cache_free(CardMemoryCache* cache) {
+    if (!cache) {
+        return;
+    }
+    
+    free(cache->image);
+    free(cache->validMap);
+    free(cache);
+}
+
+void card_cache_invalidate(CardMemoryCache* cache) {
+    if (!cache) {
+        return;
+    }
+    
+    memset(cache->validMap, 0, (cache->capacity + 7) / 8);
+}
+
+void card_cache_reset_identity(CardMemoryCache* cache) {
+    if (!cache) {
+        return;
+    }
+    
+    card_cache_invalidate(cache);
+    cache->identityLength = 0;
+}
+
+void card_cache_invalidate_range(CardMemoryCache* cache, size_t offset, size_t length) {
+    if (!cache || offset >= cache->capacity) {
+        return;
+    }
+    
+    size_t end = length > cache->capacity - offset ? cache->capacity : offset + length;
+    valid_map_fill(cache->validMap, offset, end, 0);
+}
+
+int card_cache_set_identity(CardMemoryCache* cache, const uint8_t* identity, size_t identityLength) {
+    if (!cache || !identity) {
+        return 0;
+    }
+    
+    if (identityLength > sizeof(cache->identity)) {
+        identityLength = sizeof(cache->identity);
+    }
+    
+    if (cache->identityLength == identityLength &&
+        memcmp(cache->identity, identity, identityLength) == 0) {
+        return 0;
+    }
+    
+    card_cache_reset_identity(cache);
+    memcpy(cache->identity, identity, identityLength);
+    cache->identityLength = identityLength;
+    
+    return 1;
+}
+
+void card_cache_find_missing(const CardMemoryCache* cache, size_t offset, size_t length,
+                             size_t* missingOffset, size_t* missingLength) {
+    *missingOffset = offset;
+    *missingLength = length;
+    
+    // Без идентичности карты кэшу нельзя доверять
+    if (!cache || cache->identityLength == 0 || offset >= cache->capacity ||
+        length > cache->capacity - offset) {
+        return;
+    }
+    
+    size_t start = offset;
+    size_t end = offset + length;
+    
+    // Пропуск действительных байт с начала (полные байты карты — сразу по 8)
+    while (start < end) {
+        if ((start & 7) == 0 && end - start >= 8 && cache->validMap[start >> 3] == 0xFF) {
+            start += 8;
+        } else if (valid_map_test(cache->validMap, start)) {
+            start++;
+        } else {
+            break;
+        }
+    }
+    
+    // Пропуск действительных байт с конца
+    while (end > start) {
+        if ((end & 7) == 0 && end - start >= 8 && cache->validMap[(end >> 3) - 1] == 0xFF) {
+            end -= 8;
+        } else if (valid_map_test(cache->validMap, end - 1)) {
+            end--;
+        } else {
+            break;
+        }
+    }
+    
+    *missingOffset = start;
+    *missingLength = end - start;
+}
+
+void card_cache_store(CardMemoryCache* cache, size_t offset, const uint8_t* data, size_t length) {
+    if (!cache || !data || offset >= cache->capacity) {
+        return;
+    }
+    
+    if (length > cache->capacity - offset) {
+        length = cache->capacity - offset;
+    }
+    
+    memcpy(cache->image + offset, data, length);
+    valid_map_fill(cache->validMap, offset, offset + length, 1);
+} 
\ No newline at end of file
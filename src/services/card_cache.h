@@ -0,0 +1,90 @@
+#ifndef CARD_CACHE_H
+#define CARD_CACHE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "card_domain.h"
+
+/**
+ * Слой сервисов (Service Layer)
+ * Кэш образа памяти карты: копия памяти и карта действительных байт.
+ * Кэш привязан к идентичности карты (ATR и UID).
+ */
+
+#define CARD_CACHE_UID_MAX_LENGTH 16
+#define CARD_CACHE_IDENTITY_MAX_LENGTH (CARD_ATR_MAX_LENGTH + CARD_CACHE_UID_MAX_LENGTH)
+
+typedef struct {
+    uint8_t* image;          /* Образ памяти карты */
+    uint8_t* validMap;       /* Битовая карта действительных байт образа */
+    size_t capacity;         /* Размер образа в байтах */
+    uint8_t identity[CARD_CACHE_IDENTITY_MAX_LENGTH];
+    size_t identityLength;   /* 0 — карта не определена */
+    size_t hits;             /* Чтений, полностью обслуженных из кэша */
+    size_t misses;           /* Чтений, потребовавших обращения к карте */
+} CardMemoryCache;
+
+/**
+ * Создание кэша
+ * @param capacity Размер кэшируемой памяти карты (начиная с адреса 0)
+ * @return Указатель на кэш или NULL при ошибке выделения памяти
+ */
+CardMemoryCache* card_cache_create(size_t capacity);
+
+/**
+ * Освобождение кэша
+ * @param cache Указатель на кэш
+ */
+void card_cache_free(CardMemoryCache* cache);
+
+/**
+ * Сброс всего содержимого; кэш остаётся привязан к той же карте
+ * @param cache Указатель на кэш
+ */
+void card_cache_invalidate(CardMemoryCache* cache);
+
+/**
+ * Сброс содержимого и идентичности карты, когда карта могла смениться
+ * До следующего card_cache_set_identity кэш не используется.
+ * @param cache Указатель на кэш
+ */
+void card_cache_reset_identity(CardMemoryCache* cache);
+
+/**
+ * Сброс диапазона
+ * @param cache Указатель на кэш
+ * @param offset Адрес начала диапазона
+ * @param length Длина диапазона
+ */
+void card_cache_invalidate_range(CardMemoryCache* cache, size_t offset, size_t length);
+
+/**
+ * Привязка кэша к карте; при смене карты содержимое сбрасывается
+ * @param cache Указатель на кэш
+ * @param identity Идентичность карты (ATR и UID)
+ * @param identityLength Длина идентичности
+ * @return 1, если карта сменилась и кэш сброшен, иначе 0
+ */
+int card_cache_set_identity(CardMemoryCache* cache, const uint8_t* identity, size_t identityLength);
+
+/**
+ * Поиск недействительной части диапазона
+ * @param cache Указатель на кэш
+ * @param offset Адрес начала диапазона
+ * @param length Длина диапазона
+ * @param missingOffset Начало наименьшего отрезка, покрывающего все недействительные байты
+ * @param missingLength Длина этого отрезка, 0 — диапазон полностью в кэше
+ */
+void card_cache_find_missing(const CardMemoryCache* cache, size_t offset, size_t length,
+                             size_t* missingOffset, size_t* missingLength);
+
+/**
+ * Сохранение данных в кэш (часть за пределами кэша отбрасывается)
+ * @param cache Указатель на кэш
+ * @param offset Адрес начала данных
+ * @param data Данные
+ * @param length Длина данных
+ */
+void card_cache_store(CardMemoryCache* cache, size_t offset, const uint8_t* data, size_t length);
+
+#endif /* CARD_CACHE_H */ 
\ No newline at end of file
@@ -1,11 +1,221 @@
 #include "card_service.h"
+#include "apdu.h"
 #include <string.h>
 
 static int service_read_data_callback(void* service_ptr, uint8_t address, size_t length, CardData* data);
 static int service_write_data_callback(void* service_ptr, uint8_t address, const CardData* data);
 static int service_rewrite_data_callback(void* service_ptr, uint8_t address, const CardData* data);
+static int service_read_range_callback(void* service_ptr, uint16_t offset, size_t length, CardData* data);
+static int service_write_range_callback(void* service_ptr, uint16_t offset, const CardData* data);
 static int service_execute_command_callback(void* service_ptr, const CardData* command, CardData* response);
 
+/**
+ * Проверка статусного слова в конце ответа карты
+ */
+static int check_status_word(const uint8_t* response, size_t responseLength) {
+    if (responseLength < 2) {
+        return CARD_ERROR_TRANSMIT_FAILED;
+    }
+    
+    if (response[responseLength - 2] != 0x90 || response[responseLength - 1] != 0x00) {
+        return CARD_ERROR_BAD_STATUS;
+    }
+    
+    return CARD_SUCCESS;
+}
+
+/**
+ * Проверка, может ли команда изменить память карты
+ * Чтение, GET DATA и GET RESPONSE кэш не затрагивают
+ */
+static int command_may_modify(const uint8_t* command, size_t commandLength) {
+    if (commandLength < APDU_HEADER_LENGTH) {
+        return 1;
+    }
+    
+    switch (command[1]) {
+        case 0xB0:
+        case 0xB1:
+        case 0xB2:
+        case 0xB3:
+        case 0xCA:
+        case 0xCB:
+        case 0xC0:
+            return 0;
+        default:
+            return 1;
+    }
+}
+
+static void refresh_cache_identity(CardService* service);
+
+/**
+ * Проверка, не сбрасывал ли репозиторий карту незаметно для сервиса
+ * Пока карта была сброшена, другое приложение могло изменить её память
+ */
+static void check_card_reset(CardService* service) {
+    CardInfo info;
+    
+    if (!service->repository->get_info ||
+        service->repository->get_info(service->context, &info) != CARD_SUCCESS ||
+        info.resetCount == service->resetCount) {
+        return;
+    }
+    
+    service->resetCount = info.resetCount;
+    card_cache_invalidate(service->cache);
+    refresh_cache_identity(service);
+}
+
+/**
+ * Передача команды через репозиторий
+ * При ошибке передачи карта могла быть извлечена или сброшена, кэш сбрасывается
+ */
+static int service_transmit(CardService* service, const uint8_t* command, size_t commandLength,
+                            uint8_t* response, size_t* responseLength) {
+    int result = service->repository->transmit(service->context, command, commandLength,
+                                               response, responseLength);
+    if (service->cache) {
+        if (result != CARD_SUCCESS) {
+            card_cache_invalidate(service->cache);
+        } else {
+            check_card_reset(service);
+        }
+    }
+    
+    return result;
+}
+
+/**
+ * Определение идентичности карты (ATR и UID) для привязки кэша
+ */
+static void refresh_cache_identity(CardService* service) {
+    if (!service->cache) {
+        return;
+    }
+    
+    uint8_t identity[CARD_CACHE_IDENTITY_MAX_LENGTH];
+    size_t identityLength = 0;
+    CardInfo info;
+    
+    if (!service->repository->get_info ||
+        service->repository->get_info(service->context, &info) != CARD_SUCCESS) {
+        card_cache_reset_identity(service->cache);
+        return;
+    }
+    
+    memcpy(identity, info.atr, info.atrLength);
+    identityLength = info.atrLength;
+    
+    // GET DATA (UID); карты без UID определяются только по ATR
+    uint8_t command[5] = { 0xFF, 0xCA, 0x00, 0x00, 0x00 };
+    uint8_t response[APDU_SHORT_MAX_LE + 2];
+    size_t responseLength = sizeof(response);
+    if (service->repository->transmit(service->context, command, sizeof(command),
+                                      response, &responseLength) == CARD_SUCCESS &&
+        check_status_word(response, responseLength) == CARD_SUCCESS) {
+        size_t uidLength = responseLength - 2;
+        if (uidLength > CARD_CACHE_UID_MAX_LENGTH) {
+            uidLength = CARD_CACHE_UID_MAX_LENGTH;
+        }
+        memcpy(identity + identityLength, response, uidLength);
+        identityLength += uidLength;
+    }
+    
+    if (identityLength == 0) {
+        card_cache_reset_identity(service->cache);
+        return;
+    }
+    
+    card_cache_set_identity(service->cache, identity, identityLength);
+}
+
+/**
+ * Максимальная длина ответа (данные и статус) для текущего подключения
+ */
+static size_t max_response_length(const CardService* service) {
+    return (service->extendedLength ? APDU_EXTENDED_MAX_LE : APDU_SHORT_MAX_LE) + 2;
+}
+
+/**
+ * Выделение рабочего буфера под самую длинную команду или ответ
+ * @return 1, если буфер готов, 0 при ошибке выделения памяти
+ */
+static int reserve_scratch(CardService* service) {
+    size_t capacity = APDU_MAX_COMMAND_LENGTH > APDU_MAX_RESPONSE_LENGTH ?
+                      APDU_MAX_COMMAND_LENGTH : APDU_MAX_RESPONSE_LENGTH;
+    if (service->scratch) {
+        return 1;
+    }
+    
+    service->scratch = (uint8_t*)malloc(capacity);
+    if (!service->scratch) {
+        return 0;
+    }
+    
+    service->scratchCapacity = capacity;
+    return 1;
+}
+
+/**
+ * Установка размеров блоков по возможностям подключённой карты
+ * Без рабочего буфера карта используется только с короткими APDU
+ */
+static void apply_card_info(CardService* service) {
+    CardInfo info;
+    
+    service->extendedLength = 0;
+    service->readChunkSize = APDU_SHORT_MAX_LE;
+    service->writeChunkSize = APDU_SHORT_MAX_LC;
+    service->profile = NULL;
+    service->writePageSize = 1;
+    
+    if (!service->repository->get_info ||
+        service->repository->get_info(service->context, &info) != CARD_SUCCESS) {
+        return;
+    }
+    service->resetCount = info.resetCount;
+    
+    // Буфер для расширенных APDU выделяется один раз и переживает переподключения
+    if (info.extendedLength && !reserve_scratch(service)) {
+        return;
+    }
+    
+    service->extendedLength = info.extendedLength;
+    size_t maxLe = info.extendedLength ? APDU_EXTENDED_MAX_LE : APDU_SHORT_MAX_LE;
+    size_t maxLc = info.extendedLength ? APDU_EXTENDED_MAX_LC : APDU_SHORT_MAX_LC;
+    
+    if (info.maxResponseData > 0) {
+        service->readChunkSize = info.maxResponseData < maxLe ? info.maxResponseData : maxLe;
+    } else {
+        service->readChunkSize = maxLe;
+    }
+    
+    if (info.maxCommandData > 0) {
+        service->writeChunkSize = info.maxCommandData < maxLc ? info.maxCommandData : maxLc;
+    } else {
+        service->writeChunkSize = maxLc;
+    }
+    
+    // Профиль известной карты ограничивает блоки её собственными размерами
+    const CardProfile* profile = card_profile_find(info.atr, info.atrLength, NULL);
+    if (!profile) {
+        return;
+    }
+    
+    service->profile = profile;
+    if (profile->readChunkSize > 0 && profile->readChunkSize < service->readChunkSize) {
+        service->readChunkSize = profile->readChunkSize;
+    }
+    if (profile->writeChunkSize > 0 && profile->writeChunkSize < service->writeChunkSize) {
+        service->writeChunkSize = profile->writeChunkSize;
+    }
+    if (profile->pageSize > 1 && service->writeChunkSize >= profile->pageSize) {
+        service->writePageSize = profile->pageSize;
+        service->writeChunkSize -= service->writeChunkSize % profile->pageSize;
+    }
+}
+
 int card_service_initialize(CardService* service, CardRepository* repository, CardContext* context) {
     if (!service || !repository || !context) {
         return CARD_ERROR_INVALID_PARAMETER;
@@ -13,16 +223,67 @@ int card_service_initialize(CardService* service, CardRepository* repository, Ca
     
     service->repository = repository;
     service->context = context;
+    service->extendedLength = 0;
+    service->readChunkSize = APDU_SHORT_MAX_LE;
+    service->writeChunkSize = APDU_SHORT_MAX_LC;
+    service->cache = NULL;
+    service->scratch = NULL;
+    service->scratchCapacity = 0;
+    service->resetCount = 0;
+    service->autoExchange = 1;
+    service->profile = NULL;
+    service->writePageSize = 1;
     
     return repository->initialize(context);
 }
 
+int card_service_attach(CardService* service, CardRepository* repository, CardContext* context) {
+    if (!service || !repository || !context) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    service->repository = repository;
+    service->context = context;
+    service->cache = NULL;
+    service->scratch = NULL;
+    service->scratchCapacity = 0;
+    service->resetCount = 0;
+    service->autoExchange = 1;
+    service->profile = NULL;
+    service->writePageSize = 1;
+    apply_card_info(service);
+    
+    return CARD_SUCCESS;
+}
+
+int card_service_detach(CardService* service) {
+    if (!service) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    card_cache_free(service->cache);
+    service->cache = NULL;
+    free(service->scratch);
+    service->scratch = NULL;
+    service->scratchCapacity = 0;
+    service->repository = NULL;
+    service->context = NULL;
+    
+    return CARD_SUCCESS;
+}
+
 int card_service_connect(CardService* service, const char* readerName) {
     if (!service || !service->repository || !service->context || !readerName) {
         return CARD_ERROR_INVALID_PARAMETER;
     }
     
-    return service->repository->connect(service->context, readerName);
+    int result = service->repository->connect(service->context, readerName);
+    if (result == CARD_SUCCESS) {
+        apply_card_info(service);
+        refresh_cache_identity(service);
+    }
+    
+    return result;
 }
 
 int card_service_disconnect(CardService* service) {
@@ -30,27 +291,262 @@ int card_service_disconnect(CardService* service) {
         return CARD_ERROR_INVALID_PARAMETER;
     }
     
+    // После отключения карта может быть заменена без ведома сервиса
+    if (service->cache) {
+        card_cache_reset_identity(service->cache);
+    }
+    
+    return service->repository->disconnect(service->context);
+}
+
+int card_service_disconnect_with(CardService* service, CardDisposition disposition) {
+    if (!service || !service->repository || !service->context) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    if (service->cache) {
+        card_cache_reset_identity(service->cache);
+    }
+    
+    if (service->repository->disconnect_with) {
+        return service->repository->disconnect_with(service->context, disposition);
+    }
+    
+    // Репозиторий без выбора действия умеет только оставлять карту как есть
+    if (disposition != CARD_DISPOSITION_LEAVE) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
     return service->repository->disconnect(service->context);
 }
 
+int card_service_reset(CardService* service, CardDisposition initialization) {
+    if (!service || !service->repository || !service->context ||
+        initialization == CARD_DISPOSITION_LEAVE || !service->repository->reconnect) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    if (service->cache) {
+        card_cache_reset_identity(service->cache);
+    }
+    
+    int result = service->repository->reconnect(service->context, initialization);
+    if (result == CARD_SUCCESS) {
+        apply_card_info(service);
+        refresh_cache_identity(service);
+    }
+    
+    return result;
+}
+
 int card_service_release(CardService* service) {
     if (!service || !service->repository || !service->context) {
         return CARD_ERROR_INVALID_PARAMETER;
     }
     
+    card_cache_free(service->cache);
+    service->cache = NULL;
+    free(service->scratch);
+    service->scratch = NULL;
+    service->scratchCapacity = 0;
+    
     return service->repository->release(service->context);
 }
 
+/**
+ * Отправка команды без учёта кэша
+ */
+static int execute_command_raw(CardService* service, const CardData* command, CardData* response) {
+    // Инициализация буфера для ответа, если он не инициализирован
+    if (!response->data) {
+        int reserved = card_data_reserve(response, max_response_length(service));
+        if (reserved != CARD_SUCCESS) {
+            return reserved;
+        }
+    }
+    
+    size_t responseLength = response->length;
+    int result = service_transmit(service, command->data, command->length,
+                                  response->data, &responseLength);
+    
+    response->length = responseLength;
+    return result;
+}
+
+/**
+ * Обмен с обработкой статусов протокола ISO 7816-4
+ * Данные ответов GET RESPONSE принимаются сразу за уже полученными,
+ * поверх статусного слова предыдущего ответа.
+ */
+static int exchange_command(CardService* service, const uint8_t* command, size_t commandLength,
+                            uint8_t* response, size_t capacity, size_t* responseLength) {
+    ApduCommand parsed;
+    uint8_t shortCommand[APDU_HEADER_LENGTH + 1 + APDU_SHORT_MAX_LC + 1];
+    size_t length = capacity;
+    int result;
+    
+    *responseLength = 0;
+    
+    // Нераспознанная команда передаётся как есть
+    if (apdu_parse(command, commandLength, &parsed) != CARD_SUCCESS) {
+        result = service_transmit(service, command, commandLength, response, &length);
+        *responseLength = length;
+        return result;
+    }
+    
+    // Расширенная команда для карты без расширенных APDU: данные передаются
+    // цепочкой коротких команд, Le ограничивается 256 (остаток — через 61 XX)
+    if (parsed.extended && !service->extendedLength) {
+        if (parsed.dataLength > APDU_SHORT_MAX_LC && (parsed.cla & 0x80)) {
+            return CARD_ERROR_INVALID_PARAMETER;
+        }
+        
+        while (parsed.dataLength > APDU_SHORT_MAX_LC) {
+            size_t pieceLength = 0;
+            result = apdu_encode(shortCommand, sizeof(shortCommand), (uint8_t)(parsed.cla | APDU_CLA_CHAINING),
+                                 parsed.ins, parsed.p1, parsed.p2, parsed.data, APDU_SHORT_MAX_LC, 0, 0,
+                                 &pieceLength);
+            if (result != CARD_SUCCESS) {
+                return result;
+            }
+            
+            length = capacity;
+            result = service_transmit(service, shortCommand, pieceLength, response, &length);
+            *responseLength = length;
+            if (result != CARD_SUCCESS || check_status_word(response, length) != CARD_SUCCESS) {
+                // Часть цепочки не принята: вызывающий получает статус карты
+                return result;
+            }
+            
+            parsed.data += APDU_SHORT_MAX_LC;
+            parsed.dataLength -= APDU_SHORT_MAX_LC;
+        }
+        
+        if (parsed.expectedLength > APDU_SHORT_MAX_LE) {
+            parsed.expectedLength = APDU_SHORT_MAX_LE;
+        }
+        parsed.extended = 0;
+        
+        result = apdu_encode(shortCommand, sizeof(shortCommand), parsed.cla, parsed.ins, parsed.p1, parsed.p2,
+                             parsed.data, parsed.dataLength, parsed.expectedLength, 0, &commandLength);
+        if (result != CARD_SUCCESS) {
+            return result;
+        }
+        command = shortCommand;
+    }
+    
+    length = capacity;
+    result = service_transmit(service, command, commandLength, response, &length);
+    
+    size_t received = 0;
+    int lengthCorrected = 0;
+    int afterGetResponse = 0;
+    
+    while (result == CARD_SUCCESS && length >= 2) {
+        uint8_t sw1 = response[received + length - 2];
+        uint8_t sw2 = response[received + length - 1];
+        
+        // 6C XX: повтор той же команды с Le = XX (один раз)
+        if (sw1 == APDU_SW1_WRONG_LENGTH && length == 2 && !lengthCorrected && !parsed.extended) {
+            size_t retryLength = 0;
+            lengthCorrected = 1;
+            if (apdu_encode(shortCommand, sizeof(shortCommand), parsed.cla, parsed.ins, parsed.p1, parsed.p2,
+                            parsed.data, parsed.dataLength, sw2 ? sw2 : APDU_SHORT_MAX_LE, 0,
+                            &retryLength) != CARD_SUCCESS) {
+                break;
+            }
+            
+            length = capacity - received;
+            result = service_transmit(service, shortCommand, retryLength, response + received, &length);
+            continue;
+        }
+        
+        // 61 XX: остаток ответа забирается GET RESPONSE в тот же буфер
+        if (sw1 == APDU_SW1_MORE_DATA) {
+            // Карта не продвигается — возвращаем её статус как есть
+            if (afterGetResponse && length == 2) {
+                break;
+            }
+            
+            received += length - 2;
+            size_t room = capacity - received;
+            size_t expected = sw2 ? sw2 : APDU_SHORT_MAX_LE;
+            if (room < 3) {
+                length = 2;
+                break;
+            }
+            if (expected > room - 2) {
+                expected = room - 2;
+            }
+            
+            uint8_t getResponse[APDU_HEADER_LENGTH + 1] = {
+                apdu_get_response_class(parsed.cla), APDU_INS_GET_RESPONSE, 0x00, 0x00,
+                (uint8_t)(expected & 0xFF)
+            };
+            
+            afterGetResponse = 1;
+            length = room;
+            result = service_transmit(service, getResponse, sizeof(getResponse), response + received, &length);
+            continue;
+        }
+        
+        break;
+    }
+    
+    *responseLength = received + length;
+    return result;
+}
+
 int card_service_read_data(CardService* service, uint8_t address, size_t length, CardData* data) {
     if (!service || !service->repository || !service->context || !data) {
         return CARD_ERROR_INVALID_PARAMETER;
     }
     
+    int extended = apdu_needs_extended(0, length);
+    if (extended && !service->extendedLength) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    // Диапазон целиком в кэше: ответ с 90 00 формируется без обращения к карте
+    if (service->cache && length > 0) {
+        size_t missingOffset = 0;
+        size_t missingLength = 0;
+        card_cache_find_missing(service->cache, address, length, &missingOffset, &missingLength);
+        
+        if (missingLength == 0 && (!data->data || data->length >= length + 2)) {
+            if (!data->data && card_data_reserve(data, length + 2) != CARD_SUCCESS) {
+                return CARD_ERROR_MEMORY_ALLOCATION;
+            }
+            memcpy(data->data, service->cache->image + address, length);
+            data->data[length] = 0x90;
+            data->data[length + 1] = 0x00;
+            data->length = length + 2;
+            service->cache->hits++;
+            return CARD_SUCCESS;
+        }
+        
+        service->cache->misses++;
+    }
+    
     // Формирование APDU команды для чтения данных
-    uint8_t commandData[5] = { 0xFF, 0xB0, 0x00, address, (uint8_t)length };
-    CardData command = { commandData, 5 };
+    uint8_t commandData[APDU_HEADER_LENGTH + 3];
+    size_t commandLength = 0;
+    int result = apdu_encode(commandData, sizeof(commandData), 0xFF, 0xB0, 0x00, address,
+                             NULL, 0, length, extended, &commandLength);
+    if (result != CARD_SUCCESS) {
+        return result;
+    }
+    
+    CardData command = { commandData, commandLength, NULL };
+    
+    result = execute_command_raw(service, &command, data);
+    
+    if (result == CARD_SUCCESS && service->cache && length > 0 && data->length == length + 2 &&
+        check_status_word(data->data, data->length) == CARD_SUCCESS) {
+        card_cache_store(service->cache, address, data->data, length);
+    }
     
-    return card_service_execute_command(service, &command, data);
+    return result;
 }
 
 int card_service_write_data(CardService* service, uint8_t address, const CardData* data) {
@@ -58,29 +554,35 @@ int card_service_write_data(CardService* service, uint8_t address, const CardDat
         return CARD_ERROR_INVALID_PARAMETER;
     }
     
-    // Формирование APDU команды для записи данных
-    size_t commandLength = 5 + data->length;
-    uint8_t* commandData = (uint8_t*)malloc(commandLength);
-    if (!commandData) {
-        return CARD_ERROR_MEMORY_ALLOCATION;
+    int extended = apdu_needs_extended(data->length, 0);
+    if (extended && !service->extendedLength) {
+        return CARD_ERROR_INVALID_PARAMETER;
     }
     
-    commandData[0] = 0xFF;    // CLA
-    commandData[1] = 0xD0;    // INS (запись)
-    commandData[2] = 0x00;    // P1
-    commandData[3] = address; // P2 (адрес)
-    commandData[4] = (uint8_t)data->length; // Lc (длина данных)
-    memcpy(commandData + 5, data->data, data->length);
+    // Формирование APDU команды для записи данных (P2 — адрес, Lc — длина данных)
+    uint8_t shortCommand[APDU_HEADER_LENGTH + 1 + APDU_SHORT_MAX_LC];
+    uint8_t* commandData = extended ? service->scratch : shortCommand;
+    size_t commandCapacity = extended ? service->scratchCapacity : sizeof(shortCommand);
+    size_t commandLength = 0;
+    
+    int result = apdu_encode(commandData, commandCapacity, 0xFF, 0xD0, 0x00, address,
+                             data->data, data->length, 0, extended, &commandLength);
+    if (result != CARD_SUCCESS) {
+        return result;
+    }
     
-    CardData command = { commandData, commandLength };
-    CardData response;
-    response.data = (uint8_t*)malloc(258); // Максимальный размер ответа
-    response.length = 258;
+    // Ответ на запись содержит только статусное слово
+    uint8_t responseData[APDU_SHORT_MAX_LE + 2];
+    CardData command = { commandData, commandLength, NULL };
+    CardData response = { responseData, sizeof(responseData), NULL };
     
-    int result = card_service_execute_command(service, &command, &response);
+    result = execute_command_raw(service, &command, &response);
     
-    free(commandData);
-    free(response.data);
+    // WRITE BINARY может объединять данные с содержимым памяти (ISO 7816-4),
+    // поэтому итоговые байты неизвестны и диапазон сбрасывается
+    if (service->cache) {
+        card_cache_invalidate_range(service->cache, address, data->length);
+    }
     
     return result;
 }
@@ -90,65 +592,401 @@ int card_service_rewrite_data(CardService* service, uint8_t address, const CardD
         return CARD_ERROR_INVALID_PARAMETER;
     }
     
-    // Формирование APDU команды для перезаписи данных
-    size_t commandLength = 5 + data->length;
-    uint8_t* commandData = (uint8_t*)malloc(commandLength);
-    if (!commandData) {
-        return CARD_ERROR_MEMORY_ALLOCATION;
+    int extended = apdu_needs_extended(data->length, 0);
+    if (extended && !service->extendedLength) {
+        return CARD_ERROR_INVALID_PARAMETER;
     }
     
-    commandData[0] = 0xFF;    // CLA
-    commandData[1] = 0xD6;    // INS (UPDATE BINARY)
-    commandData[2] = 0x00;    // P1
-    commandData[3] = address; // P2 (адрес)
-    commandData[4] = (uint8_t)data->length; // Lc (длина данных)
-    memcpy(commandData + 5, data->data, data->length);
+    // Формирование APDU команды для перезаписи данных (P2 — адрес, Lc — длина данных)
+    uint8_t shortCommand[APDU_HEADER_LENGTH + 1 + APDU_SHORT_MAX_LC];
+    uint8_t* commandData = extended ? service->scratch : shortCommand;
+    size_t commandCapacity = extended ? service->scratchCapacity : sizeof(shortCommand);
+    size_t commandLength = 0;
     
-    CardData command = { commandData, commandLength };
-    CardData response;
-    response.data = (uint8_t*)malloc(258); // Максимальный размер ответа
-    response.length = 258;
+    int result = apdu_encode(commandData, commandCapacity, 0xFF, 0xD6, 0x00, address,
+                             data->data, data->length, 0, extended, &commandLength);
+    if (result != CARD_SUCCESS) {
+        return result;
+    }
+    
+    // Ответ на запись содержит только статусное слово
+    uint8_t responseData[APDU_SHORT_MAX_LE + 2];
+    CardData command = { commandData, commandLength, NULL };
+    CardData response = { responseData, sizeof(responseData), NULL };
+    
+    result = execute_command_raw(service, &command, &response);
+    
+    if (service->cache) {
+        if (result == CARD_SUCCESS && check_status_word(response.data, response.length) == CARD_SUCCESS) {
+            card_cache_store(service->cache, address, data->data, data->length);
+        } else {
+            card_cache_invalidate_range(service->cache, address, data->length);
+        }
+    }
     
-    int result = card_service_execute_command(service, &command, &response);
+    return result;
+}
+
+/**
+ * Чтение диапазона с карты блоками максимального размера
+ * Ответы принимаются сразу на своё место в target; capacity >= length
+ */
+static int read_range_from_card(CardService* service, uint16_t offset, size_t length,
+                                uint8_t* target, size_t capacity) {
+    uint8_t command[APDU_HEADER_LENGTH + 3];
+    uint8_t shortTail[APDU_SHORT_MAX_LE + 2];
+    uint8_t* tail = shortTail;
+    size_t tailCapacity = sizeof(shortTail);
+    size_t position = 0;
+    int result = CARD_SUCCESS;
     
-    free(commandData);
-    free(response.data);
+    while (position < length) {
+        size_t chunk = length - position;
+        if (chunk > service->readChunkSize) {
+            chunk = service->readChunkSize;
+        }
+        
+        // Адрес: P1 — старший байт (без бита SFI), P2 — младший
+        uint16_t address = (uint16_t)(offset + position);
+        size_t commandLength = 0;
+        result = apdu_encode(command, sizeof(command), 0xFF, 0xB0,
+                             (uint8_t)((address >> 8) & 0x7F), (uint8_t)(address & 0xFF),
+                             NULL, 0, chunk, apdu_needs_extended(0, chunk), &commandLength);
+        if (result != CARD_SUCCESS) {
+            break;
+        }
+        
+        // Если статус не помещается в буфер вызывающего, принимаем блок во временный буфер
+        int useTail = position + chunk + 2 > capacity;
+        if (useTail && tailCapacity < chunk + 2) {
+            tail = service->scratch;
+            tailCapacity = service->scratchCapacity;
+            if (!tail || tailCapacity < chunk + 2) {
+                result = CARD_ERROR_INVALID_PARAMETER;
+                break;
+            }
+        }
+        uint8_t* chunkTarget = useTail ? tail : target + position;
+        size_t responseLength = useTail ? tailCapacity : chunk + 2;
+        
+        result = service_transmit(service, command, commandLength, chunkTarget, &responseLength);
+        if (result != CARD_SUCCESS) {
+            break;
+        }
+        
+        result = check_status_word(chunkTarget, responseLength);
+        if (result != CARD_SUCCESS) {
+            break;
+        }
+        
+        size_t received = responseLength - 2;
+        if (received == 0 || received > chunk) {
+            result = CARD_ERROR_TRANSMIT_FAILED;
+            break;
+        }
+        
+        if (useTail) {
+            memcpy(target + position, tail, received);
+        }
+        position += received;
+    }
     
     return result;
 }
 
+int card_service_read_range(CardService* service, uint16_t offset, size_t length, CardData* data) {
+    if (!service || !service->repository || !service->context || !data || length == 0 ||
+        (size_t)offset + length > CARD_SERVICE_MAX_OFFSET + 1) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    // Буфер результата: при выделении оставляем 2 байта под статус последнего блока,
+    // чтобы ответы всех блоков принимались сразу на своё место без копирования
+    int allocated = 0;
+    size_t capacity = data->length;
+    if (!data->data) {
+        if (card_data_reserve(data, length + 2) != CARD_SUCCESS) {
+            return CARD_ERROR_MEMORY_ALLOCATION;
+        }
+        capacity = length + 2;
+        allocated = 1;
+    } else if (capacity < length) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    // С карты читается только отрезок, не покрытый кэшем
+    size_t readOffset = offset;
+    size_t readLength = length;
+    if (service->cache) {
+        card_cache_find_missing(service->cache, offset, length, &readOffset, &readLength);
+        if (readLength == 0) {
+            service->cache->hits++;
+        } else {
+            service->cache->misses++;
+        }
+    }
+    
+    int result = CARD_SUCCESS;
+    size_t head = readOffset - offset;
+    
+    if (readLength > 0) {
+        result = read_range_from_card(service, (uint16_t)readOffset, readLength,
+                                      data->data + head, capacity - head);
+        if (result == CARD_SUCCESS && service->cache) {
+            card_cache_store(service->cache, readOffset, data->data + head, readLength);
+        }
+    }
+    
+    if (result != CARD_SUCCESS) {
+        if (allocated) {
+            card_data_release(data);
+        }
+        return result;
+    }
+    
+    // Байты до и после прочитанного отрезка действительны в кэше
+    if (service->cache && readLength < length) {
+        size_t tailStart = head + readLength;
+        memcpy(data->data, service->cache->image + offset, head);
+        memcpy(data->data + tailStart, service->cache->image + offset + tailStart, length - tailStart);
+    }
+    
+    data->length = length;
+    return CARD_SUCCESS;
+}
+
+/**
+ * Длина очередного блока записи
+ * Невыровненное начало дописывается до границы страницы, дальше блоки целые.
+ */
+static size_t write_chunk_length(const CardService* service, uint16_t address, size_t remaining, size_t maxChunk) {
+    size_t chunk = remaining < maxChunk ? remaining : maxChunk;
+    size_t pageTail = ((size_t)address + chunk) % service->writePageSize;
+    if (chunk < remaining && pageTail > 0 && chunk > pageTail) {
+        chunk -= pageTail;
+    }
+    return chunk;
+}
+
+size_t card_service_write_command_count(const CardService* service, uint16_t offset, size_t length) {
+    if (!service || service->writeChunkSize == 0 || service->writePageSize == 0) {
+        return 0;
+    }
+    
+    size_t count = 0;
+    size_t position = 0;
+    while (position < length) {
+        position += write_chunk_length(service, (uint16_t)(offset + position), length - position,
+                                       service->writeChunkSize);
+        count++;
+    }
+    return count;
+}
+
+int card_service_write_range(CardService* service, uint16_t offset, const CardData* data) {
+    if (!service || !service->repository || !service->context || !data || !data->data ||
+        data->length == 0 || (size_t)offset + data->length > CARD_SERVICE_MAX_OFFSET + 1) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    size_t maxChunk = data->length < service->writeChunkSize ? data->length : service->writeChunkSize;
+    
+    // Один буфер команды используется для всех блоков; для коротких APDU он на стеке,
+    // для расширенных — рабочий буфер сервиса
+    uint8_t shortCommand[APDU_HEADER_LENGTH + 1 + APDU_SHORT_MAX_LC];
+    uint8_t* command = shortCommand;
+    size_t commandCapacity = sizeof(shortCommand);
+    if (apdu_encoded_length(maxChunk, 0, apdu_needs_extended(maxChunk, 0)) > commandCapacity) {
+        if (!service->scratch) {
+            return CARD_ERROR_INVALID_PARAMETER;
+        }
+        command = service->scratch;
+        commandCapacity = service->scratchCapacity;
+    }
+    
+    uint8_t response[APDU_SHORT_MAX_LE + 2];
+    size_t position = 0;
+    int result = CARD_SUCCESS;
+    
+    while (position < data->length) {
+        // Адрес: P1 — старший байт (без бита SFI), P2 — младший
+        uint16_t address = (uint16_t)(offset + position);
+        size_t chunk = write_chunk_length(service, address, data->length - position, maxChunk);
+        
+        size_t commandLength = 0;
+        result = apdu_encode(command, commandCapacity, 0xFF, 0xD6,
+                             (uint8_t)((address >> 8) & 0x7F), (uint8_t)(address & 0xFF),
+                             data->data + position, chunk, 0, apdu_needs_extended(chunk, 0),
+                             &commandLength);
+        if (result != CARD_SUCCESS) {
+            break;
+        }
+        
+        size_t responseLength = sizeof(response);
+        result = service_transmit(service, command, commandLength, response, &responseLength);
+        if (result != CARD_SUCCESS) {
+            break;
+        }
+        
+        result = check_status_word(response, responseLength);
+        if (result != CARD_SUCCESS) {
+            break;
+        }
+        
+        position += chunk;
+    }
+    
+    // Записанное попадает в кэш; при ошибке часть диапазона могла не записаться
+    if (service->cache) {
+        if (result == CARD_SUCCESS) {
+            card_cache_store(service->cache, offset, data->data, data->length);
+        } else {
+            card_cache_invalidate_range(service->cache, offset, data->length);
+        }
+    }
+    
+    return result;
+}
+
+int card_service_read_into(CardService* service, uint16_t offset, uint8_t* buffer, size_t length) {
+    if (!buffer) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    CardData data = { buffer, length, NULL };
+    return card_service_read_range(service, offset, length, &data);
+}
+
+int card_service_write_from(CardService* service, uint16_t offset, const uint8_t* buffer, size_t length) {
+    if (!buffer) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    CardData data = { (uint8_t*)buffer, length, NULL };
+    return card_service_write_range(service, offset, &data);
+}
+
+int card_service_set_chunk_sizes(CardService* service, size_t readChunkSize, size_t writeChunkSize) {
+    if (!service) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    size_t maxLe = service->extendedLength ? APDU_EXTENDED_MAX_LE : APDU_SHORT_MAX_LE;
+    size_t maxLc = service->extendedLength ? APDU_EXTENDED_MAX_LC : APDU_SHORT_MAX_LC;
+    if (readChunkSize == 0 || readChunkSize > maxLe || writeChunkSize == 0 || writeChunkSize > maxLc) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    service->readChunkSize = readChunkSize;
+    service->writeChunkSize = writeChunkSize;
+    
+    return CARD_SUCCESS;
+}
+
 int card_service_execute_command(CardService* service, const CardData* command, CardData* response) {
     if (!service || !service->repository || !service->context || !command || !command->data || !response) {
         return CARD_ERROR_INVALID_PARAMETER;
     }
     
-    // Инициализация буфера для ответа, если он не инициализирован
+    // Произвольная команда может изменить память карты
+    if (service->cache && command_may_modify(command->data, command->length)) {
+        card_cache_invalidate(service->cache);
+    }
+    
+    if (!service->autoExchange) {
+        return execute_command_raw(service, command, response);
+    }
+    
     if (!response->data) {
-        response->data = (uint8_t*)malloc(258); // Максимальный размер ответа
-        if (!response->data) {
-            return CARD_ERROR_MEMORY_ALLOCATION;
+        int reserved = card_data_reserve(response, max_response_length(service));
+        if (reserved != CARD_SUCCESS) {
+            return reserved;
         }
-        response->length = 258;
     }
     
-    size_t responseLength = response->length;
-    int result = service->repository->transmit(
-        service->context, 
-        command->data, 
-        command->length, 
-        response->data, 
-        &responseLength
-    );
+    size_t responseLength = 0;
+    int result = exchange_command(service, command->data, command->length,
+                                  response->data, response->length, &responseLength);
     
     response->length = responseLength;
     return result;
 }
 
+int card_service_set_auto_exchange(CardService* service, int enabled) {
+    if (!service) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    service->autoExchange = enabled != 0;
+    return CARD_SUCCESS;
+}
+
+int card_service_enable_cache(CardService* service, size_t capacity) {
+    if (!service || !service->repository || !service->context || capacity == 0 ||
+        capacity > CARD_SERVICE_MAX_OFFSET + 1) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    card_cache_free(service->cache);
+    service->cache = card_cache_create(capacity);
+    if (!service->cache) {
+        return CARD_ERROR_MEMORY_ALLOCATION;
+    }
+    
+    refresh_cache_identity(service);
+    return CARD_SUCCESS;
+}
+
+int card_service_disable_cache(CardService* service) {
+    if (!service) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    card_cache_free(service->cache);
+    service->cache = NULL;
+    
+    return CARD_SUCCESS;
+}
+
+int card_service_invalidate_cache(CardService* service) {
+    if (!service) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    card_cache_invalidate(service->cache);
+    return CARD_SUCCESS;
+}
+
+int card_service_execute_batch(CardService* service, CardBatchItem* items, size_t count,
+                               CardBatchPolicy policy, size_t* executed) {
+    if (!service || !service->repository || !service->context || (!items && count > 0)) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    if (service->cache) {
+        for (size_t i = 0; i < count; i++) {
+            if (command_may_modify(items[i].command, items[i].commandLength)) {
+                card_cache_invalidate(service->cache);
+                break;
+            }
+        }
+    }
+    
+    if (service->repository->transmit_batch) {
+        return service->repository->transmit_batch(service->context, items, count, policy, executed);
+    }
+    
+    return card_batch_execute(service->context, service->repository->transmit, items, count,
+                              policy, executed);
+}
+
 CardOperations card_service_get_operations(CardService* service) {
     CardOperations operations = {
         .read_data = service_read_data_callback,
         .write_data = service_write_data_callback,
         .rewrite_data = service_rewrite_data_callback,
+        .read_range = service_read_range_callback,
+        .write_range = service_write_range_callback,
         .execute_command = service_execute_command_callback
     };
     
@@ -167,6 +1005,14 @@ static int service_rewrite_data_callback(void* service_ptr, uint8_t address, con
     return card_service_rewrite_data((CardService*)service_ptr, address, data);
 }
 
+static int service_read_range_callback(void* service_ptr, uint16_t offset, size_t length, CardData* data) {
+    return card_service_read_range((CardService*)service_ptr, offset, length, data);
+}
+
+static int service_write_range_callback(void* service_ptr, uint16_t offset, const CardData* data) {
+    return card_service_write_range((CardService*)service_ptr, offset, data);
+}
+
 static int service_execute_command_callback(void* service_ptr, const CardData* command, CardData* response) {
     return card_service_execute_command((CardService*)service_ptr, command, response);
 } 
\ No newline at end of file
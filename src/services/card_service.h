@@ -3,15 +3,32 @@
 
 #include "card_domain.h"
 #include "card_operations.h"
+#include "card_cache.h"
+#include "card_profile.h"
 
 /**
  * Слой сервисов (Service Layer)
  * Реализует бизнес-логику работы с картой
  */
 
+/**
+ * Максимальный адрес памяти карты: старший бит P1 зарезервирован под SFI
+ */
+#define CARD_SERVICE_MAX_OFFSET 0x7FFF
+
 typedef struct {
     CardRepository* repository;
     CardContext* context;
+    int extendedLength;     /* Подключённая карта принимает APDU расширенной длины */
+    size_t readChunkSize;   /* Максимум байт данных в одной команде чтения */
+    size_t writeChunkSize;  /* Максимум байт данных в одной команде записи */
+    CardMemoryCache* cache; /* Кэш образа памяти карты, NULL — выключен */
+    uint8_t* scratch;       /* Рабочий буфер для APDU расширенной длины */
+    size_t scratchCapacity; /* Короткие APDU формируются в буферах на стеке */
+    unsigned long resetCount; /* Последнее известное число сбросов карты */
+    int autoExchange;       /* GET RESPONSE, повтор с Le из 6C XX и цепочки команд */
+    const CardProfile* profile; /* Профиль подключённой карты, NULL — неизвестная карта */
+    size_t writePageSize;   /* Блоки записи заканчиваются на границе страницы */
 } CardService;
 
 /**
@@ -23,6 +40,26 @@ typedef struct {
  */
 int card_service_initialize(CardService* service, CardRepository* repository, CardContext* context);
 
+/**
+ * Привязка сервиса к уже инициализированному контексту карты
+ * Контекст не переинициализируется; если карта подключена,
+ * размеры блоков определяются по её возможностям. Прежнее содержимое
+ * структуры не освобождается: повторной привязке предшествует card_service_detach.
+ * @param service Указатель на структуру сервиса
+ * @param repository Репозиторий для работы с картой
+ * @param context Инициализированный контекст карты
+ * @return Код ошибки из CardError
+ */
+int card_service_attach(CardService* service, CardRepository* repository, CardContext* context);
+
+/**
+ * Отвязка сервиса от контекста карты без его освобождения
+ * Освобождаются кэш и рабочий буфер сервиса; контекстом по-прежнему владеет вызывающий.
+ * @param service Указатель на структуру сервиса
+ * @return Код ошибки из CardError
+ */
+int card_service_detach(CardService* service);
+
 /**
  * Подключение к считывателю карт
  * @param service Указатель на структуру сервиса
@@ -38,6 +75,24 @@ int card_service_connect(CardService* service, const char* readerName);
  */
 int card_service_disconnect(CardService* service);
 
+/**
+ * Отключение от считывателя с выбором действия над картой
+ * @param service Указатель на структуру сервиса
+ * @param disposition Оставить, сбросить или обесточить карту (CardDisposition)
+ * @return Код ошибки из CardError
+ */
+int card_service_disconnect_with(CardService* service, CardDisposition disposition);
+
+/**
+ * Сброс карты без повторного установления подключения
+ * Кэш образа памяти сбрасывается, размеры блоков определяются заново.
+ * @param service Указатель на структуру сервиса
+ * @param initialization CARD_DISPOSITION_RESET — тёплый сброс,
+ *                       CARD_DISPOSITION_UNPOWER — холодный
+ * @return Код ошибки из CardError
+ */
+int card_service_reset(CardService* service, CardDisposition initialization);
+
 /**
  * Освобождение ресурсов сервиса
  * @param service Указатель на структуру сервиса
@@ -73,15 +128,132 @@ int card_service_write_data(CardService* service, uint8_t address, const CardDat
  */
 int card_service_rewrite_data(CardService* service, uint8_t address, const CardData* data);
 
+/**
+ * Чтение непрерывного диапазона памяти карты
+ * Диапазон разбивается на команды READ BINARY максимального размера
+ * (с учётом профиля карты), адрес передаётся в P1/P2. Статусные слова в результат не попадают.
+ * @param service Указатель на структуру сервиса
+ * @param offset Адрес начала чтения (0..CARD_SERVICE_MAX_OFFSET)
+ * @param length Количество байт для чтения
+ * @param data Буфер для данных; если data->data == NULL, память будет выделена
+ *             (length + 2 байта под статус), иначе data->length — ёмкость буфера
+ * @return Код ошибки из CardError
+ */
+int card_service_read_range(CardService* service, uint16_t offset, size_t length, CardData* data);
+
+/**
+ * Запись непрерывного диапазона памяти карты (UPDATE BINARY)
+ * Данные разбиваются на команды максимального размера, все команды
+ * формируются в одном буфере. Для карт со страничной памятью блоки,
+ * кроме последнего, заканчиваются на границе страницы.
+ * @param service Указатель на структуру сервиса
+ * @param offset Адрес начала записи (0..CARD_SERVICE_MAX_OFFSET)
+ * @param data Данные для записи
+ * @return Код ошибки из CardError
+ */
+int card_service_write_range(CardService* service, uint16_t offset, const CardData* data);
+
+/**
+ * Число команд UPDATE BINARY, которыми card_service_write_range запишет диапазон
+ * (с учётом размера блока и выравнивания по страницам)
+ * @param service Указатель на структуру сервиса
+ * @param offset Адрес начала записи
+ * @param length Длина диапазона
+ * @return Число команд; 0 при неверных параметрах
+ */
+size_t card_service_write_command_count(const CardService* service, uint16_t offset, size_t length);
+
+/**
+ * Чтение диапазона в буфер вызывающего без выделения памяти
+ * @param service Указатель на структуру сервиса
+ * @param offset Адрес начала чтения (0..CARD_SERVICE_MAX_OFFSET)
+ * @param buffer Буфер для данных (не меньше length байт)
+ * @param length Количество байт для чтения
+ * @return Код ошибки из CardError
+ */
+int card_service_read_into(CardService* service, uint16_t offset, uint8_t* buffer, size_t length);
+
+/**
+ * Запись диапазона из буфера вызывающего без выделения памяти
+ * @param service Указатель на структуру сервиса
+ * @param offset Адрес начала записи (0..CARD_SERVICE_MAX_OFFSET)
+ * @param buffer Данные для записи
+ * @param length Количество байт для записи
+ * @return Код ошибки из CardError
+ */
+int card_service_write_from(CardService* service, uint16_t offset, const uint8_t* buffer, size_t length);
+
+/**
+ * Установка размеров блоков для диапазонных операций
+ * @param service Указатель на структуру сервиса
+ * Размеры ограничены короткими APDU, если карта не поддерживает расширенную длину
+ * @param readChunkSize Максимум байт в одной команде чтения (1..65536)
+ * @param writeChunkSize Максимум байт в одной команде записи (1..65535)
+ * @return Код ошибки из CardError
+ */
+int card_service_set_chunk_sizes(CardService* service, size_t readChunkSize, size_t writeChunkSize);
+
 /**
  * Отправка произвольной команды на карту
+ * При включённом автоматическом обмене ответ 61 XX дополняется командами
+ * GET RESPONSE в тот же буфер, на 6C XX команда повторяется с исправленным Le,
+ * а команда с данными длиннее допустимых для карты передаётся цепочкой (CLA | 0x10).
  * @param service Указатель на структуру сервиса
  * @param command Команда для отправки
- * @param response Буфер для ответа
+ * @param response Буфер для ответа; если response->data == NULL, память будет
+ *                 выделена, иначе response->length — ёмкость буфера
  * @return Код ошибки из CardError
  */
 int card_service_execute_command(CardService* service, const CardData* command, CardData* response);
 
+/**
+ * Включение и выключение автоматического обмена для card_service_execute_command
+ * По умолчанию включён; выключенный режим возвращает статусы карты без обработки.
+ * @param service Указатель на структуру сервиса
+ * @param enabled 1 — включить, 0 — выключить
+ * @return Код ошибки из CardError
+ */
+int card_service_set_auto_exchange(CardService* service, int enabled);
+
+/**
+ * Включение кэша образа памяти карты
+ * Чтения из действительных диапазонов обслуживаются без обращения к карте,
+ * записи проходят на карту и обновляют кэш. Кэш привязан к ATR и UID карты
+ * и сбрасывается при отключении, ошибке передачи и смене карты.
+ * @param service Указатель на структуру сервиса
+ * @param capacity Размер кэшируемой памяти (адреса 0..capacity-1)
+ * @return Код ошибки из CardError
+ */
+int card_service_enable_cache(CardService* service, size_t capacity);
+
+/**
+ * Выключение кэша образа памяти карты
+ * @param service Указатель на структуру сервиса
+ * @return Код ошибки из CardError
+ */
+int card_service_disable_cache(CardService* service);
+
+/**
+ * Сброс кэша, например по событию извлечения или сброса карты
+ * @param service Указатель на структуру сервиса
+ * @return Код ошибки из CardError
+ */
+int card_service_invalidate_cache(CardService* service);
+
+/**
+ * Пакетная отправка команд
+ * Если репозиторий поддерживает пакеты, команды выполняются в одной транзакции,
+ * иначе последовательно. Память под результаты не выделяется.
+ * @param service Указатель на структуру сервиса
+ * @param items Массив команд с буферами ответов вызывающего
+ * @param count Количество команд
+ * @param policy Правила остановки из CardBatchPolicy
+ * @param executed Количество выполненных команд (может быть NULL)
+ * @return CARD_SUCCESS или код ошибки первой неуспешной команды
+ */
+int card_service_execute_batch(CardService* service, CardBatchItem* items, size_t count,
+                               CardBatchPolicy policy, size_t* executed);
+
 /**
  * Получение операций карты (реализация интерфейса CardOperations)
  * @param service Указатель на структуру сервиса
@@ -0,0 +1,97 @@
+#include "card_sync.h"
+#include <string.h>
+
+/**
+ * Поиск следующего отличающегося байта начиная с position
+ */
+static size_t next_difference(const uint8_t* target, const uint8_t* current, size_t position, size_t length) {
+    while (position < length && target[position] == current[position]) {
+        position++;
+    }
+    return position;
+}
+
+/**
+ * Поиск конца участка отличающихся байт начиная с position
+ */
+static size_t next_match(const uint8_t* target, const uint8_t* current, size_t position, size_t length) {
+    while (position < length && target[position] != current[position]) {
+        position++;
+    }
+    return position;
+}
+
+int card_sync_image(CardService* service, uint16_t offset, const CardData* target,
+                    const CardData* current, size_t mergeGap, CardSyncStats* stats) {
+    if (!service || !target || !target->data || target->length == 0 ||
+        (size_t)offset + target->length > CARD_SERVICE_MAX_OFFSET + 1 ||
+        (current && (!current->data || current->length < target->length))) {
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    CardSyncStats localStats;
+    if (!stats) {
+        stats = &localStats;
+    }
+    memset(stats, 0, sizeof(CardSyncStats));
+    
+    // Текущий образ читается с карты или из кэша сервиса
+    CardData loaded = { NULL, 0, NULL };
+    if (!current) {
+        int result = card_service_read_range(service, offset, target->length, &loaded);
+        if (result != CARD_SUCCESS) {
+            return result;
+        }
+        current = &loaded;
+    }
+    
+    const uint8_t* wanted = target->data;
+    const uint8_t* actual = current->data;
+    size_t length = target->length;
+    int result = CARD_SUCCESS;
+    
+    size_t position = next_difference(wanted, actual, 0, length);
+    while (position < length) {
+        size_t rangeStart = position;
+        size_t rangeEnd = next_match(wanted, actual, position, length);
+        stats->changedBytes += rangeEnd - rangeStart;
+        
+        // Присоединяем следующие участки, пока одна запись дешевле двух
+        for (;;) {
+            size_t nextStart = next_difference(wanted, actual, rangeEnd, length);
+            if (nextStart >= length || nextStart - rangeEnd > mergeGap) {
+                break;
+            }
+            
+            size_t nextEnd = next_match(wanted, actual, nextStart, length);
+            size_t separate = card_service_write_command_count(service, (uint16_t)(offset + rangeStart),
+                                                               rangeEnd - rangeStart) +
+                              card_service_write_command_count(service, (uint16_t)(offset + nextStart),
+                                                               nextEnd - nextStart);
+            if (card_service_write_command_count(service, (uint16_t)(offset + rangeStart),
+                                                 nextEnd - rangeStart) > separate) {
+                break;
+            }
+            
+            stats->changedBytes += nextEnd - nextStart;
+            rangeEnd = nextEnd;
+        }
+        
+        CardData range = { (uint8_t*)wanted + rangeStart, rangeEnd - rangeStart, NULL };
+        result = card_service_write_range(service, (uint16_t)(offset + rangeStart), &range);
+        if (result != CARD_SUCCESS) {
+            break;
+        }
+        
+        stats->rangeCount++;
+        stats->writtenBytes += range.length;
+        stats->commandCount += card_service_write_command_count(service, (uint16_t)(offset + rangeStart),
+                                                                range.length);
+        
+        position = next_difference(wanted, actual, rangeEnd, length);
+    }
+    
+    card_data_release(&loaded);
+    
+    return result;
+} 
\ No newline at end of file
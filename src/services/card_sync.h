@@ -0,0 +1,39 @@
+#ifndef CARD_SYNC_H
+#define CARD_SYNC_H
+
+#include "card_domain.h"
+#include "card_service.h"
+
+/**
+ * Слой сервисов (Service Layer)
+ * Разностная запись: на карту отправляются только изменённые диапазоны
+ */
+
+/* Разрыв между изменёнными участками, который выгоднее переписать, чем
+ * отправлять отдельную команду: заголовок, статус и задержка одной APDU
+ * обходятся дороже передачи этого числа лишних байт */
+#define CARD_SYNC_DEFAULT_MERGE_GAP 16
+
+typedef struct {
+    size_t changedBytes;     /* Байт, отличающихся от текущего образа */
+    size_t writtenBytes;     /* Байт, отправленных на карту */
+    size_t rangeCount;       /* Диапазонов после объединения */
+    size_t commandCount;     /* Отправленных команд UPDATE BINARY, с учётом выравнивания по страницам */
+} CardSyncStats;
+
+/**
+ * Приведение памяти карты к целевому образу
+ * Если текущий образ не передан, он читается через card_service_read_range
+ * (при включённом кэше — без обращения к карте).
+ * @param service Указатель на структуру сервиса
+ * @param offset Адрес начала образа на карте
+ * @param target Целевой образ
+ * @param current Текущее содержимое карты той же длины или NULL
+ * @param mergeGap Максимальный разрыв между участками, объединяемыми в одну запись
+ * @param stats Статистика записи (может быть NULL)
+ * @return Код ошибки из CardError
+ */
+int card_sync_image(CardService* service, uint16_t offset, const CardData* target,
+                    const CardData* current, size_t mergeGap, CardSyncStats* stats);
+
+#endif /* CARD_SYNC_H */ 
\ No newline at end of file
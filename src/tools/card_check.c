@@ -0,0 +1,402 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "card_service.h"
+#include "card_simulator.h"
+#include "card_replay.h"
+#include "card_journal.h"
+
+/**
+ * Проверки инфраструктуры на эмуляторе карты, без считывателя.
+ *
+ * Использование:
+ *   card_check [--dir <каталог>]
+ *
+ * Сессия обмена с эмулятором записывается через card_recorder и
+ * воспроизводится card_replay без задержек: результаты и ответы должны
+ * совпасть с записанными, а команда вне записи — считаться расхождением.
+ * Пакет записей через card_journal обрывается в журнале посреди записи
+ * подтверждения: после повторного открытия подтверждённые диапазоны
+ * пропускаются, а только запланированные отдаются как неподтверждённые.
+ * Временные файлы создаются во временном каталоге или в --dir.
+ * Код возврата 0 — все проверки пройдены.
+ */
+
+#define CHECK_SESSION_NAME "card_check_session.apdu"
+#define CHECK_JOURNAL_NAME "card_check_journal.jrn"
+#define CHECK_PATH_LENGTH 260
+#define CHECK_LATENCY 200              /* Задержка команды эмулятора при записи, мкс */
+#define CHECK_MEMORY 0x1000            /* Размер памяти эмулятора */
+#define CHECK_OFFSET 0x40
+#define CHECK_LENGTH 300               /* Несколько команд записи и чтения */
+#define CHECK_RANGES 6                 /* Диапазонов в пакете журнала */
+#define CHECK_RANGE_LENGTH 64
+#define CHECK_CONFIRMED 4              /* Подтверждений, переживших сбой */
+#define CHECK_JOURNAL_HEADER (sizeof(CARD_JOURNAL_MAGIC) - 1) /* Сигнатура в начале журнала */
+#define CHECK_TORN 20                  /* Байт оборванной записи в хвосте журнала */
+
+static void print_usage(const char* program) {
+    printf("Использование:\n");
+    printf("  %s [--dir <каталог>]\n", program);
+}
+
+static int check_report(int isPassed, const char* name) {
+    printf("%s: %s\n", isPassed ? "OK" : "ОШИБКА", name);
+    return isPassed ? 0 : 1;
+}
+
+/**
+ * Путь к временному файлу проверки
+ */
+static int check_path(const char* directory, const char* name, char* path) {
+    size_t length;
+    if (directory) {
+        length = strlen(directory);
+        if (length + 1 + strlen(name) + 1 > CHECK_PATH_LENGTH) {
+            return CARD_ERROR_INVALID_PARAMETER;
+        }
+        memcpy(path, directory, length);
+        if (length > 0 && path[length - 1] != '\\' && path[length - 1] != '/') {
+            path[length++] = '\\';
+        }
+    } else {
+        length = GetTempPathA(CHECK_PATH_LENGTH, path);
+        if (length == 0 || length + strlen(name) + 1 > CHECK_PATH_LENGTH) {
+            return CARD_ERROR_INIT_FAILED;
+        }
+    }
+    
+    memcpy(path + length, name, strlen(name) + 1);
+    return CARD_SUCCESS;
+}
+
+/* ---- Запись и воспроизведение сессии ---- */
+
+/**
+ * Итог сценария, который должен совпасть при записи и воспроизведении
+ */
+typedef struct {
+    int results[4];
+    uint8_t image[CHECK_LENGTH];
+    uint8_t uid[CARD_SIMULATOR_MAX_UID + 2];
+    size_t uidLength;
+    uint8_t tail[8];
+} ReplayOutcome;
+
+static void replay_pattern(uint8_t* pattern) {
+    for (size_t i = 0; i < CHECK_LENGTH; i++) {
+        pattern[i] = (uint8_t)(i * 7 + 3);
+    }
+}
+
+/**
+ * Сценарий: запись и чтение нескольких блоков, GET DATA и чтение за концом памяти
+ */
+static void replay_scenario(CardService* service, ReplayOutcome* outcome) {
+    uint8_t pattern[CHECK_LENGTH];
+    uint8_t getUid[] = { 0xFF, 0xCA, 0x00, 0x00, 0x00 };
+    CardData command = { getUid, sizeof(getUid), NULL };
+    
+    memset(outcome, 0, sizeof(ReplayOutcome));
+    CardData response = { outcome->uid, sizeof(outcome->uid), NULL };
+    replay_pattern(pattern);
+    
+    outcome->results[0] = card_service_write_from(service, CHECK_OFFSET, pattern, CHECK_LENGTH);
+    outcome->results[1] = card_service_read_into(service, CHECK_OFFSET, outcome->image, CHECK_LENGTH);
+    outcome->results[2] = card_service_execute_command(service, &command, &response);
+    outcome->uidLength = response.length;
+    // Ошибочный ответ карты тоже должен воспроизводиться
+    outcome->results[3] = card_service_read_into(service, CHECK_MEMORY - 2, outcome->tail, sizeof(outcome->tail));
+}
+
+/**
+ * Запись сценария на эмуляторе в файл сессии
+ */
+static int replay_record(const char* path, ReplayOutcome* outcome) {
+    CardSimulatorContext simulator;
+    CardContext simulatorContext = { &simulator };
+    CardRepository simulatorRepository = card_simulator_create_repository();
+    
+    CardRecorderContext recorder;
+    int result = card_recorder_open(&recorder, &simulatorRepository, &simulatorContext, path);
+    if (result != CARD_SUCCESS) {
+        return result;
+    }
+    
+    CardContext context = { &recorder };
+    CardRepository repository = card_recorder_create_repository();
+    CardService service;
+    result = card_service_initialize(&service, &repository, &context);
+    if (result == CARD_SUCCESS) {
+        CardSimulatorConfig config;
+        card_simulator_default_config(&config);
+        config.memorySize = CHECK_MEMORY;
+        config.transmitLatency = CHECK_LATENCY;
+        result = card_simulator_configure(&simulatorContext, &config);
+        
+        if (result == CARD_SUCCESS) {
+            result = card_service_connect(&service, CARD_SIMULATOR_READER);
+        }
+        if (result == CARD_SUCCESS) {
+            replay_scenario(&service, outcome);
+            card_service_disconnect(&service);
+        }
+        card_service_release(&service);
+    }
+    
+    int closed = card_recorder_close(&recorder);
+    return result == CARD_SUCCESS ? closed : result;
+}
+
+static int check_replay(const char* directory) {
+    char path[CHECK_PATH_LENGTH];
+    if (check_path(directory, CHECK_SESSION_NAME, path) != CARD_SUCCESS) {
+        return check_report(0, "воспроизведение сессии: путь к файлу");
+    }
+    
+    ReplayOutcome recorded;
+    uint8_t pattern[CHECK_LENGTH];
+    replay_pattern(pattern);
+    if (replay_record(path, &recorded) != CARD_SUCCESS) {
+        return check_report(0, "воспроизведение сессии: запись");
+    }
+    
+    // Записанный сценарий сам должен быть осмысленным
+    int failures = check_report(recorded.results[0] == CARD_SUCCESS && recorded.results[1] == CARD_SUCCESS &&
+                                memcmp(recorded.image, pattern, CHECK_LENGTH) == 0 &&
+                                recorded.results[2] == CARD_SUCCESS && recorded.uidLength > 2 &&
+                                recorded.results[3] != CARD_SUCCESS,
+                                "запись сессии эмулятора");
+    
+    CardReplayContext replay;
+    if (card_replay_open(&replay, path, CARD_REPLAY_ZERO_LATENCY, 0.0) != CARD_SUCCESS) {
+        remove(path);
+        return failures + check_report(0, "воспроизведение сессии: загрузка");
+    }
+    
+    CardContext context = { &replay };
+    CardRepository repository = card_replay_create_repository();
+    CardService service;
+    ReplayOutcome replayed;
+    unsigned long mismatches = 0;
+    int extraResult = CARD_SUCCESS;
+    
+    int result = card_service_initialize(&service, &repository, &context);
+    if (result == CARD_SUCCESS) {
+        result = card_service_connect(&service, CARD_SIMULATOR_READER);
+        if (result == CARD_SUCCESS) {
+            replay_scenario(&service, &replayed);
+            mismatches = replay.mismatches;
+            
+            // Команды за концом записи в сессии нет
+            uint8_t extra[4];
+            extraResult = card_service_read_into(&service, 0, extra, sizeof(extra));
+            card_service_disconnect(&service);
+        }
+        card_service_release(&service);
+    }
+    
+    int isPassed = result == CARD_SUCCESS && mismatches == 0 &&
+                   memcmp(recorded.results, replayed.results, sizeof(recorded.results)) == 0 &&
+                   memcmp(recorded.image, replayed.image, CHECK_LENGTH) == 0 &&
+                   recorded.uidLength == replayed.uidLength &&
+                   memcmp(recorded.uid, replayed.uid, recorded.uidLength) == 0 &&
+                   memcmp(recorded.tail, replayed.tail, sizeof(recorded.tail)) == 0;
+    failures += check_report(isPassed, "воспроизведение сессии без задержек");
+    failures += check_report(result == CARD_SUCCESS && extraResult != CARD_SUCCESS &&
+                             replay.mismatches == mismatches + 1,
+                             "команда вне записанной сессии");
+    
+    card_replay_close(&replay);
+    remove(path);
+    return failures;
+}
+
+/* ---- Журнал записи после сбоя ---- */
+
+typedef struct {
+    CardSimulatorContext simulator;
+    CardContext context;
+    CardRepository repository;
+    CardService service;
+} CheckCard;
+
+static int check_card_open(CheckCard* card) {
+    memset(card, 0, sizeof(CheckCard));
+    card->context.context = &card->simulator;
+    card->repository = card_simulator_create_repository();
+    
+    int result = card_service_initialize(&card->service, &card->repository, &card->context);
+    if (result != CARD_SUCCESS) {
+        return result;
+    }
+    
+    result = card_service_connect(&card->service, CARD_SIMULATOR_READER);
+    if (result != CARD_SUCCESS) {
+        card_service_release(&card->service);
+    }
+    return result;
+}
+
+static void check_card_close(CheckCard* card) {
+    card_service_disconnect(&card->service);
+    card_service_release(&card->service);
+}
+
+/**
+ * Сбой посреди сброса журнала: от файла остаются первые length байт
+ */
+static int journal_cut(const char* path, size_t length) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    uint8_t* content = (uint8_t*)malloc(length);
+    size_t read = content ? fread(content, 1, length, file) : 0;
+    fclose(file);
+    if (read != length) {
+        free(content);
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    file = fopen(path, "wb");
+    int result = file && fwrite(content, 1, length, file) == length ? CARD_SUCCESS : CARD_ERROR_INIT_FAILED;
+    if (file && fclose(file) != 0) {
+        result = CARD_ERROR_INIT_FAILED;
+    }
+    free(content);
+    return result;
+}
+
+static void journal_batch(CardJournalWrite* writes, uint8_t data[][CHECK_RANGE_LENGTH]) {
+    memset(writes, 0, CHECK_RANGES * sizeof(CardJournalWrite));
+    for (size_t i = 0; i < CHECK_RANGES; i++) {
+        memset(data[i], (int)(0xA0 + i), CHECK_RANGE_LENGTH);
+        writes[i].offset = (uint16_t)(CHECK_OFFSET + i * 2 * CHECK_RANGE_LENGTH);
+        writes[i].data = data[i];
+        writes[i].length = CHECK_RANGE_LENGTH;
+    }
+}
+
+static int check_journal(const char* directory) {
+    char path[CHECK_PATH_LENGTH];
+    if (check_path(directory, CHECK_JOURNAL_NAME, path) != CARD_SUCCESS) {
+        return check_report(0, "журнал: путь к файлу");
+    }
+    remove(path);
+    
+    CheckCard card;
+    CardJournalCard journalCard;
+    if (check_card_open(&card) != CARD_SUCCESS) {
+        return check_report(0, "журнал: подключение к эмулятору");
+    }
+    if (card_journal_identify(&card.service, &journalCard) != CARD_SUCCESS) {
+        check_card_close(&card);
+        return check_report(0, "журнал: UID эмулятора");
+    }
+    
+    uint8_t data[CHECK_RANGES][CHECK_RANGE_LENGTH];
+    CardJournalWrite writes[CHECK_RANGES];
+    journal_batch(writes, data);
+    
+    CardJournal journal;
+    size_t executed = 0;
+    int result = card_journal_open(&journal, path, NULL);
+    if (result == CARD_SUCCESS) {
+        result = card_journal_write_batch(&journal, &card.service, &journalCard, writes, CHECK_RANGES, 1, &executed);
+        int closed = card_journal_close(&journal);
+        result = result == CARD_SUCCESS ? closed : result;
+    }
+    int failures = check_report(result == CARD_SUCCESS && executed == CHECK_RANGES &&
+                                journal.stats.written == CHECK_RANGES, "журнал: пакет записей");
+    
+    // Планы всего пакета, затем подтверждения по порядку; последнее целое — CHECK_CONFIRMED-е
+    result = journal_cut(path, CHECK_JOURNAL_HEADER + (CHECK_RANGES + CHECK_CONFIRMED) * CARD_JOURNAL_RECORD_SIZE +
+                         CHECK_TORN);
+    
+    // Затираются все диапазоны: пропущенный при возобновлении останется нулевым
+    uint8_t zeros[CHECK_RANGE_LENGTH];
+    memset(zeros, 0, sizeof(zeros));
+    for (size_t i = 0; i < CHECK_RANGES && result == CARD_SUCCESS; i++) {
+        result = card_service_write_from(&card.service, writes[i].offset, zeros, CHECK_RANGE_LENGTH);
+    }
+    
+    if (result == CARD_SUCCESS) {
+        result = card_journal_open(&journal, path, NULL);
+    }
+    if (result != CARD_SUCCESS) {
+        check_card_close(&card);
+        remove(path);
+        return failures + check_report(0, "журнал: открытие после сбоя");
+    }
+    failures += check_report(journal.stats.loaded == CHECK_RANGES + CHECK_CONFIRMED &&
+                             journal.stats.truncated == CHECK_TORN, "журнал: отброшен оборванный хвост");
+    
+    CardJournalRange ranges[CHECK_RANGES];
+    size_t count = 0;
+    int isPassed = card_journal_unconfirmed(&journal, &journalCard, ranges, CHECK_RANGES, &count) == CARD_SUCCESS &&
+                   count == CHECK_RANGES - CHECK_CONFIRMED;
+    for (size_t i = 0; isPassed && i < count; i++) {
+        int isPlanned = 0;
+        for (size_t j = CHECK_CONFIRMED; j < CHECK_RANGES; j++) {
+            isPlanned |= ranges[i].offset == writes[j].offset && ranges[i].length == writes[j].length;
+        }
+        isPassed = isPlanned;
+    }
+    failures += check_report(isPassed, "журнал: неподтверждённые диапазоны");
+    
+    journal_batch(writes, data);
+    result = card_journal_write_batch(&journal, &card.service, &journalCard, writes, CHECK_RANGES, 1, &executed);
+    isPassed = result == CARD_SUCCESS && executed == CHECK_RANGES &&
+               journal.stats.skipped == CHECK_CONFIRMED && journal.stats.written == CHECK_RANGES - CHECK_CONFIRMED;
+    for (size_t i = 0; isPassed && i < CHECK_RANGES; i++) {
+        uint8_t memory[CHECK_RANGE_LENGTH];
+        int isSkipped = i < CHECK_CONFIRMED;
+        isPassed = writes[i].result == CARD_SUCCESS && writes[i].skipped == isSkipped &&
+                   card_service_read_into(&card.service, writes[i].offset, memory, CHECK_RANGE_LENGTH) == CARD_SUCCESS &&
+                   memcmp(memory, isSkipped ? zeros : data[i], CHECK_RANGE_LENGTH) == 0;
+    }
+    isPassed = isPassed && card_journal_unconfirmed(&journal, &journalCard, ranges, CHECK_RANGES, &count) == CARD_SUCCESS &&
+               count == 0;
+    failures += check_report(isPassed, "журнал: возобновление пропускает подтверждённое");
+    
+    failures += check_report(card_journal_close(&journal) == CARD_SUCCESS, "журнал: закрытие");
+    
+    // Новые записи легли сразу за последней целой, а не за оборванным хвостом
+    isPassed = card_journal_open(&journal, path, NULL) == CARD_SUCCESS;
+    if (isPassed) {
+        isPassed = journal.stats.truncated == 0 &&
+                   journal.stats.loaded == CHECK_RANGES + CHECK_CONFIRMED + 2 * (CHECK_RANGES - CHECK_CONFIRMED) &&
+                   card_journal_unconfirmed(&journal, &journalCard, ranges, CHECK_RANGES, &count) == CARD_SUCCESS &&
+                   count == 0;
+        card_journal_close(&journal);
+    }
+    failures += check_report(isPassed, "журнал: повторное открытие после возобновления");
+    check_card_close(&card);
+    remove(path);
+    return failures;
+}
+
+int main(int argc, char** argv) {
+    const char* directory = NULL;
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc) {
+            directory = argv[++i];
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    
+    int failures = check_replay(directory);
+    failures += check_journal(directory);
+    
+    if (failures == 0) {
+        printf("Все проверки пройдены\n");
+    } else {
+        printf("Проверок не пройдено: %d\n", failures);
+    }
+    return failures == 0 ? 0 : 1;
+} 
\ No newline at end of file
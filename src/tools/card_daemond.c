@@ -0,0 +1,519 @@
+#include "card_daemon_client.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "card_service.h"
+#include "card_metrics.h"
+#include "card_simulator.h"
+#include "winscard_adapter.h"
+
+/**
+ * Демон доступа к картам (card_daemon) и проверка его задержки.
+ *
+ * Использование:
+ *   card_daemond [--socket <путь>] [--simulator N]   работа до Ctrl+C
+ *   card_daemond --ping [--socket <путь>] [--count N]
+ *   card_daemond --check [--socket <путь>]
+ *
+ * С --simulator демон обслуживает N эмуляторов карт вместо считывателей PC/SC,
+ * что позволяет проверять клиентов без оборудования. --check запускает демон
+ * с двумя эмуляторами в этом же процессе и проверяет его двумя клиентами:
+ * кадры и порядок ответов, очерёдность клиентов на общем считывателе,
+ * пропуск запросов остановленной единицы, порядок ответов на отклонённые
+ * запросы и снятие клиента посреди единицы.
+ * Код возврата 0 — все проверки пройдены.
+ */
+
+#define DAEMOND_MAX_SIMULATORS 16
+#define CHECK_SOCKET_NAME "card_daemon_check.sock"
+#define CHECK_LATENCY 500              /* Задержка команды эмулятора, мкс */
+#define CHECK_REQUESTS 48              /* Запросов в проверке порядка */
+#define CHECK_UNITS 16                 /* Единиц каждого клиента в проверке очерёдности */
+#define CHECK_BLOCKER 32               /* Длина единицы, занимающей считыватель, пока клиенты ставят запросы */
+#define CHECK_OVERFLOW 2               /* Запросов сверх CARD_DAEMON_MAX_UNIT в проверке отклонений */
+
+static HANDLE stopEvent = NULL;
+
+static void print_usage(const char* program) {
+    printf("Использование:\n");
+    printf("  %s [--socket <путь>] [--simulator N]\n", program);
+    printf("  %s --ping [--socket <путь>] [--count N]\n", program);
+    printf("  %s --check [--socket <путь>]\n", program);
+}
+
+static BOOL WINAPI on_console_event(DWORD event) {
+    (void)event;
+    SetEvent(stopEvent);
+    return TRUE;
+}
+
+/**
+ * Задержка обмена с демоном: запросы по одному и конвейером
+ */
+static int run_ping(const char* path, size_t count) {
+    CardDaemonClient client;
+    if (card_daemon_client_open(&client, path) != CARD_SUCCESS) {
+        return 1;
+    }
+    
+    CardDaemonResponse response;
+    if (card_daemon_client_submit(&client, CARD_DAEMON_READERS, 0, 0, NULL, 0, NULL) == CARD_SUCCESS &&
+        card_daemon_client_receive(&client, &response) == CARD_SUCCESS) {
+        printf("Считыватели демона:\n");
+        const char* name = (const char*)response.data;
+        const char* end = name + response.length;
+        for (size_t i = 1; name < end; i++) {
+            printf("%zu. %s\n", i, name);
+            name += strlen(name) + 1;
+        }
+    }
+    
+    int result = CARD_SUCCESS;
+    uint64_t started = card_metrics_now();
+    for (size_t i = 0; i < count && result == CARD_SUCCESS; i++) {
+        result = card_daemon_client_submit(&client, CARD_DAEMON_PING, 0, 0, NULL, 0, NULL);
+        if (result == CARD_SUCCESS) {
+            result = card_daemon_client_receive(&client, &response);
+        }
+    }
+    uint64_t sequential = card_metrics_now() - started;
+    
+    started = card_metrics_now();
+    for (size_t i = 0; i < count && result == CARD_SUCCESS; i++) {
+        result = card_daemon_client_submit(&client, CARD_DAEMON_PING, 0, 0, NULL, 0, NULL);
+    }
+    for (size_t i = 0; i < count && result == CARD_SUCCESS; i++) {
+        result = card_daemon_client_receive(&client, &response);
+    }
+    uint64_t pipelined = card_metrics_now() - started;
+    
+    if (result == CARD_SUCCESS) {
+        printf("Запрос-ответ: %.1f мкс, конвейер: %.2f мкс на запрос (%zu запросов)\n",
+               (double)sequential / (double)count / 1000.0, (double)pipelined / (double)count / 1000.0, count);
+    } else {
+        printf("Связь с демоном прервана: %d\n", result);
+    }
+    
+    card_daemon_client_close(&client);
+    return result == CARD_SUCCESS ? 0 : 1;
+}
+
+/* ---- Проверка демона на эмуляторах ---- */
+
+static int check_simulator_initialize(CardContext* context) {
+    int result = card_simulator_initialize(context);
+    if (result == CARD_SUCCESS) {
+        CardSimulatorConfig config;
+        card_simulator_default_config(&config);
+        config.transmitLatency = CHECK_LATENCY;
+        result = card_simulator_configure(context, &config);
+    }
+    return result;
+}
+
+static int check_report(int isPassed, const char* name) {
+    printf("%s: %s\n", isPassed ? "OK" : "ОШИБКА", name);
+    return isPassed ? 0 : 1;
+}
+
+/**
+ * Запись одного байта по адресу 0 эмулятора
+ */
+static int check_submit_write(CardDaemonClient* client, size_t readerIndex, uint16_t flags, uint8_t value,
+                              uint32_t* id) {
+    const uint8_t command[] = { 0xFF, 0xD6, 0x00, 0x00, 0x01, value };
+    return card_daemon_client_submit_transmit(client, readerIndex, flags, command, sizeof(command), 0, 0, id);
+}
+
+/**
+ * Чтение одного байта по адресу 0; bad — команда за пределами памяти (ответ 6B 00)
+ */
+static int check_submit_read(CardDaemonClient* client, size_t readerIndex, uint16_t flags, int bad,
+                             uint32_t* id) {
+    const uint8_t command[] = { 0xFF, 0xB0, bad ? 0x7F : 0x00, bad ? 0xF0 : 0x00, bad ? 0x20 : 0x01 };
+    return card_daemon_client_submit_transmit(client, readerIndex, flags, command, sizeof(command), 0, 0, id);
+}
+
+/**
+ * Кадры и порядок: запись, чтение и проверка связи вперемешку на двух считывателях;
+ * каждое чтение должно увидеть запись, отправленную перед ним
+ */
+static int check_ordering(const char* path) {
+    CardDaemonClient client;
+    if (card_daemon_client_open(&client, path) != CARD_SUCCESS) {
+        return check_report(0, "порядок ответов: подключение");
+    }
+    
+    uint32_t firstId = client.nextId;
+    int isPassed = 1;
+    for (size_t i = 0; i < CHECK_REQUESTS && isPassed; i++) {
+        size_t readerIndex = (i / 3) % 2;
+        int result = i % 3 == 0 ? check_submit_write(&client, readerIndex, 0, (uint8_t)i, NULL) :
+                     i % 3 == 1 ? check_submit_read(&client, readerIndex, 0, 0, NULL) :
+                     card_daemon_client_submit(&client, CARD_DAEMON_PING, 0, 0, NULL, 0, NULL);
+        isPassed = result == CARD_SUCCESS;
+    }
+    
+    uint8_t isAnswered[CHECK_REQUESTS] = { 0 };
+    size_t last[2] = { 0, 0 };
+    int hasLast[2] = { 0, 0 };
+    for (size_t k = 0; k < CHECK_REQUESTS && isPassed; k++) {
+        CardDaemonResponse response;
+        if (card_daemon_client_receive(&client, &response) != CARD_SUCCESS ||
+            response.id - firstId >= CHECK_REQUESTS || isAnswered[response.id - firstId]) {
+            isPassed = 0;
+            break;
+        }
+        
+        size_t i = response.id - firstId;
+        size_t readerIndex = (i / 3) % 2;
+        isAnswered[i] = 1;
+        if (i % 3 == 2) {
+            isPassed = response.result == CARD_SUCCESS && response.length == 0;
+            continue;
+        }
+        
+        // Ответы одного считывателя идут в порядке запросов; чтение видит предыдущую запись
+        isPassed = response.result == CARD_SUCCESS && (!hasLast[readerIndex] || last[readerIndex] < i) &&
+                   (i % 3 == 0 ? response.length == 2 :
+                    response.length == 3 && response.data[0] == (uint8_t)(i - 1));
+        last[readerIndex] = i;
+        hasLast[readerIndex] = 1;
+    }
+    
+    card_daemon_client_close(&client);
+    return check_report(isPassed, "кадры и порядок ответов одного считывателя");
+}
+
+/**
+ * Очерёдность: два клиента ставят на общий считыватель по CHECK_UNITS единиц
+ * «чтение — запись своей метки». При обходе по кругу каждое чтение видит
+ * метку другого клиента. Пока единица-заглушка клиента A занимает считыватель,
+ * очереди обоих клиентов успевают заполниться.
+ */
+static int check_fairness(const char* path) {
+    CardDaemonClient first;
+    CardDaemonClient second;
+    int isOpen = card_daemon_client_open(&first, path) == CARD_SUCCESS;
+    if (isOpen && card_daemon_client_open(&second, path) != CARD_SUCCESS) {
+        card_daemon_client_close(&first);
+        isOpen = 0;
+    }
+    if (!isOpen) {
+        return check_report(0, "очерёдность клиентов: подключение");
+    }
+    
+    CardDaemonClient* clients[2] = { &first, &second };
+    const uint8_t tags[2] = { 'A', 'B' };
+    int isPassed = 1;
+    
+    for (size_t i = 0; i + 1 < CHECK_BLOCKER && isPassed; i++) {
+        isPassed = check_submit_read(&first, 0, CARD_DAEMON_FLAG_MORE, 0, NULL) == CARD_SUCCESS;
+    }
+    if (isPassed) {
+        isPassed = check_submit_write(&first, 0, 0, tags[0], NULL) == CARD_SUCCESS;
+    }
+    
+    for (size_t c = 0; c < 2 && isPassed; c++) {
+        for (size_t i = 0; i < CHECK_UNITS && isPassed; i++) {
+            isPassed = check_submit_read(clients[c], 0, CARD_DAEMON_FLAG_MORE, 0, NULL) == CARD_SUCCESS &&
+                       check_submit_write(clients[c], 0, 0, tags[c], NULL) == CARD_SUCCESS;
+        }
+        if (isPassed) {
+            isPassed = card_daemon_client_flush(clients[c]) == CARD_SUCCESS;
+        }
+    }
+    
+    size_t alternations = 0;
+    for (size_t c = 0; c < 2 && isPassed; c++) {
+        size_t count = 2 * CHECK_UNITS + (c == 0 ? CHECK_BLOCKER : 0);
+        for (size_t k = 0; k < count && isPassed; k++) {
+            CardDaemonResponse response;
+            isPassed = card_daemon_client_receive(clients[c], &response) == CARD_SUCCESS &&
+                       response.result == CARD_SUCCESS;
+            
+            // Чтения единиц после заглушки: метка другого клиента — считыватель сменил клиента
+            int isUnitRead = (c == 1 || k >= CHECK_BLOCKER) && (k - (c == 0 ? CHECK_BLOCKER : 0)) % 2 == 0;
+            if (isPassed && isUnitRead) {
+                alternations += response.length == 3 && response.data[0] == tags[1 - c];
+            }
+        }
+    }
+    
+    card_daemon_client_close(&first);
+    card_daemon_client_close(&second);
+    printf("Смен клиента: %zu из %d\n", alternations, 2 * CHECK_UNITS);
+    return check_report(isPassed && alternations == 2 * CHECK_UNITS, "очерёдность клиентов на общем считывателе");
+}
+
+/**
+ * Остановка единицы: после ошибки с правилом CARD_BATCH_STOP_ON_ERROR
+ * остальные запросы единицы приходят с CARD_DAEMON_RESPONSE_SKIPPED,
+ * а следующая единица выполняется как обычно
+ */
+static int check_skipped(const char* path) {
+    CardDaemonClient client;
+    if (card_daemon_client_open(&client, path) != CARD_SUCCESS) {
+        return check_report(0, "пропуск запросов: подключение");
+    }
+    
+    uint16_t policy = (uint16_t)(CARD_BATCH_STOP_ON_ERROR << CARD_DAEMON_FLAG_POLICY_SHIFT);
+    int isPassed = check_submit_read(&client, 1, policy | CARD_DAEMON_FLAG_MORE, 0, NULL) == CARD_SUCCESS &&
+                   check_submit_read(&client, 1, policy | CARD_DAEMON_FLAG_MORE, 1, NULL) == CARD_SUCCESS &&
+                   check_submit_read(&client, 1, policy | CARD_DAEMON_FLAG_MORE, 0, NULL) == CARD_SUCCESS &&
+                   check_submit_read(&client, 1, policy, 0, NULL) == CARD_SUCCESS &&
+                   check_submit_read(&client, 1, policy, 0, NULL) == CARD_SUCCESS;
+    
+    const int results[] = { CARD_SUCCESS, CARD_ERROR_BAD_STATUS, 0, 0, CARD_SUCCESS };
+    const uint16_t flags[] = { 0, 0, CARD_DAEMON_RESPONSE_SKIPPED, CARD_DAEMON_RESPONSE_SKIPPED, 0 };
+    for (size_t i = 0; i < sizeof(results) / sizeof(results[0]) && isPassed; i++) {
+        CardDaemonResponse response;
+        isPassed = card_daemon_client_receive(&client, &response) == CARD_SUCCESS &&
+                   response.flags == flags[i] && (flags[i] != 0 || response.result == results[i]);
+    }
+    
+    card_daemon_client_close(&client);
+    return check_report(isPassed, "пропуск запросов остановленной единицы");
+}
+
+/**
+ * Отклонённые запросы отвечаются на своём месте среди ответов считывателя:
+ * остаток единицы длиннее CARD_DAEMON_MAX_UNIT, неизвестная операция и
+ * TRANSMIT без ожидаемого статуса не обгоняют ещё не выполненные чтения
+ */
+static int check_rejected(const char* path) {
+    CardDaemonClient client;
+    if (card_daemon_client_open(&client, path) != CARD_SUCCESS) {
+        return check_report(0, "порядок отклонённых запросов: подключение");
+    }
+    
+    uint16_t policy = (uint16_t)(CARD_BATCH_CONTINUE << CARD_DAEMON_FLAG_POLICY_SHIFT);
+    const uint8_t shortTransmit[] = { 0x90, 0x00 };
+    size_t count = CARD_DAEMON_MAX_UNIT + CHECK_OVERFLOW + 3;
+    uint32_t firstId = client.nextId;
+    int isPassed = 1;
+    for (size_t i = 0; i < CARD_DAEMON_MAX_UNIT + CHECK_OVERFLOW && isPassed; i++) {
+        uint16_t more = i + 1 < CARD_DAEMON_MAX_UNIT + CHECK_OVERFLOW ? CARD_DAEMON_FLAG_MORE : 0;
+        isPassed = check_submit_read(&client, 1, policy | more, 0, NULL) == CARD_SUCCESS;
+    }
+    isPassed = isPassed &&
+               card_daemon_client_submit(&client, (CardDaemonOperation)0x7F, 1, 0, NULL, 0, NULL) == CARD_SUCCESS &&
+               card_daemon_client_submit(&client, CARD_DAEMON_TRANSMIT, 1, 0, shortTransmit, sizeof(shortTransmit),
+                                         NULL) == CARD_SUCCESS &&
+               check_submit_read(&client, 1, 0, 0, NULL) == CARD_SUCCESS;
+    
+    for (size_t k = 0; k < count && isPassed; k++) {
+        CardDaemonResponse response;
+        int isOverflow = k >= CARD_DAEMON_MAX_UNIT && k < CARD_DAEMON_MAX_UNIT + CHECK_OVERFLOW;
+        int isMalformed = k == count - 3 || k == count - 2;
+        isPassed = card_daemon_client_receive(&client, &response) == CARD_SUCCESS && response.id == firstId + k &&
+                   (isOverflow ? response.result == CARD_ERROR_INVALID_PARAMETER &&
+                                 response.flags == CARD_DAEMON_RESPONSE_SKIPPED :
+                    isMalformed ? response.result == CARD_ERROR_INVALID_PARAMETER && response.flags == 0 :
+                    response.result == CARD_SUCCESS && response.flags == 0);
+    }
+    
+    card_daemon_client_close(&client);
+    return check_report(isPassed, "порядок ответов на отклонённые запросы");
+}
+
+/**
+ * Снятие клиента посреди единицы: считыватель освобождается сразу,
+ * не дожидаясь CARD_DAEMON_UNIT_TIMEOUT
+ */
+static int check_disconnect(const char* path) {
+    CardDaemonClient leaving;
+    CardDaemonClient staying;
+    int isOpen = card_daemon_client_open(&leaving, path) == CARD_SUCCESS;
+    if (isOpen && card_daemon_client_open(&staying, path) != CARD_SUCCESS) {
+        card_daemon_client_close(&leaving);
+        isOpen = 0;
+    }
+    if (!isOpen) {
+        return check_report(0, "снятие клиента: подключение");
+    }
+    
+    int isPassed = check_submit_read(&leaving, 0, CARD_DAEMON_FLAG_MORE, 0, NULL) == CARD_SUCCESS &&
+                   card_daemon_client_flush(&leaving) == CARD_SUCCESS;
+    Sleep(50);
+    card_daemon_client_close(&leaving);
+    
+    uint64_t started = card_metrics_now();
+    CardDaemonResponse response;
+    isPassed = isPassed && check_submit_read(&staying, 0, 0, 0, NULL) == CARD_SUCCESS &&
+               card_daemon_client_receive(&staying, &response) == CARD_SUCCESS &&
+               response.result == CARD_SUCCESS;
+    uint64_t elapsed = (card_metrics_now() - started) / 1000000;
+    card_daemon_client_close(&staying);
+    
+    printf("Ответ второму клиенту через %llu мс\n", (unsigned long long)elapsed);
+    return check_report(isPassed && elapsed < CARD_DAEMON_UNIT_TIMEOUT / 2, "снятие клиента посреди единицы");
+}
+
+/**
+ * Все клиенты отключены: их память освобождена, ссылок не осталось
+ */
+static int check_sessions_gone(CardDaemon* daemon) {
+    size_t sessions = 1;
+    for (int attempt = 0; attempt < 100 && sessions > 0; attempt++) {
+        EnterCriticalSection(&daemon->sessionsLock);
+        sessions = daemon->sessionCount;
+        LeaveCriticalSection(&daemon->sessionsLock);
+        if (sessions > 0) {
+            Sleep(10);
+        }
+    }
+    return check_report(sessions == 0, "освобождение отключившихся клиентов");
+}
+
+static int run_check(const char* path) {
+    char defaultPath[108];
+    if (!path) {
+        DWORD length = GetTempPathA(sizeof(defaultPath), defaultPath);
+        if (length == 0 || length + sizeof(CHECK_SOCKET_NAME) > sizeof(defaultPath)) {
+            printf("Не удалось получить временный каталог\n");
+            return 1;
+        }
+        memcpy(defaultPath + length, CHECK_SOCKET_NAME, sizeof(CHECK_SOCKET_NAME));
+        path = defaultPath;
+    }
+    
+    CardRepository repository = card_simulator_create_repository();
+    repository.initialize = check_simulator_initialize;
+    const char* names[] = { "Simulator 1", "Simulator 2" };
+    
+    CardDaemonConfig config;
+    memset(&config, 0, sizeof(config));
+    config.repository = &repository;
+    config.contextSize = sizeof(CardSimulatorContext);
+    config.readerNames = names;
+    config.readerCount = 2;
+    config.socketPath = path;
+    
+    CardDaemon daemon;
+    if (card_daemon_start(&daemon, &config) != CARD_SUCCESS) {
+        printf("Не удалось запустить демон\n");
+        return 1;
+    }
+    
+    int failures = check_ordering(path);
+    failures += check_fairness(path);
+    failures += check_skipped(path);
+    failures += check_rejected(path);
+    failures += check_disconnect(path);
+    failures += check_sessions_gone(&daemon);
+    
+    card_daemon_stop(&daemon);
+    printf("Подключений: %lld, кадров: %lld, запросов к картам: %lld, пакетов: %lld\n",
+           (long long)daemon.connections, (long long)daemon.frames,
+           (long long)daemon.requests, (long long)daemon.batches);
+    if (failures == 0) {
+        printf("Все проверки пройдены\n");
+    } else {
+        printf("Проверок не пройдено: %d\n", failures);
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    const char* path = NULL;
+    size_t simulators = 0;
+    size_t count = 10000;
+    int ping = 0;
+    int check = 0;
+    
+    for (int i = 1; i < argc; i++) {
+        int hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--socket") == 0 && hasValue) {
+            path = argv[++i];
+        } else if (strcmp(argv[i], "--simulator") == 0 && hasValue) {
+            simulators = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--count") == 0 && hasValue) {
+            count = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--ping") == 0) {
+            ping = 1;
+        } else if (strcmp(argv[i], "--check") == 0) {
+            check = 1;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    
+    if (ping) {
+        return run_ping(path, count > 0 ? count : 1);
+    }
+    if (check) {
+        return run_check(path);
+    }
+    if (simulators > DAEMOND_MAX_SIMULATORS) {
+        printf("Не больше %d эмуляторов\n", DAEMOND_MAX_SIMULATORS);
+        return 1;
+    }
+    
+    CardDaemonConfig config;
+    memset(&config, 0, sizeof(config));
+    config.socketPath = path;
+    
+    WinScardContext winscardContext;
+    CardContext listContext = { &winscardContext };
+    CardRepository repository;
+    char simulatorNames[DAEMOND_MAX_SIMULATORS][24];
+    const char* names[DAEMOND_MAX_SIMULATORS];
+    
+    if (simulators > 0) {
+        repository = card_simulator_create_repository();
+        for (size_t i = 0; i < simulators; i++) {
+            snprintf(simulatorNames[i], sizeof(simulatorNames[i]), "Simulator %zu", i + 1);
+            names[i] = simulatorNames[i];
+        }
+        config.contextSize = sizeof(CardSimulatorContext);
+        config.readerNames = names;
+        config.readerCount = simulators;
+    } else {
+        // Список считывателей читается один раз; имена живут в контексте до остановки
+        repository = winscard_create_repository();
+        if (repository.initialize(&listContext) != CARD_SUCCESS) {
+            printf("Не удалось инициализировать сервис смарт-карт\n");
+            return 1;
+        }
+        
+        char* const* readers = NULL;
+        size_t readersCount = 0;
+        if (winscard_get_readers(&listContext, &readers, &readersCount) != CARD_SUCCESS || readersCount == 0) {
+            printf("Считыватели не найдены.\n");
+            repository.release(&listContext);
+            return 1;
+        }
+        config.contextSize = sizeof(WinScardContext);
+        config.readerNames = (const char* const*)readers;
+        config.readerCount = readersCount;
+    }
+    config.repository = &repository;
+    
+    stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    CardDaemon daemon;
+    int result = stopEvent ? card_daemon_start(&daemon, &config) : CARD_ERROR_INIT_FAILED;
+    if (result != CARD_SUCCESS) {
+        printf("Не удалось запустить демон: %d\n", result);
+    } else {
+        printf("Демон слушает %s, считывателей: %zu. Ctrl+C — остановка.\n",
+               daemon.socketPath, config.readerCount);
+        SetConsoleCtrlHandler(on_console_event, TRUE);
+        WaitForSingleObject(stopEvent, INFINITE);
+        
+        printf("Остановка...\n");
+        card_daemon_stop(&daemon);
+        printf("Подключений: %lld, кадров: %lld, запросов к картам: %lld, пакетов: %lld\n",
+               (long long)daemon.connections, (long long)daemon.frames,
+               (long long)daemon.requests, (long long)daemon.batches);
+    }
+    
+    if (stopEvent) {
+        CloseHandle(stopEvent);
+    }
+    if (simulators == 0) {
+        repository.release(&listContext);
+    }
+    return result == CARD_SUCCESS ? 0 : 1;
+} 
\ No newline at end of file
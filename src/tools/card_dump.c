@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "card_service.h"
+#include "card_image.h"
+#include "winscard_adapter.h"
+
+/**
+ * Утилита снятия и восстановления образов памяти карт (card_image).
+ *
+ * Использование:
+ *   card_dump dump <файл> [--offset A] [--length N] [--reader N]
+ *   card_dump restore <файл> [--full] [--reader N]
+ *   card_dump info <файл>
+ *   card_dump diff <файл1> <файл2>
+ */
+
+static void print_usage(const char* program) {
+    printf("Использование:\n");
+    printf("  %s dump <файл> [--offset A] [--length N] [--reader N]\n", program);
+    printf("  %s restore <файл> [--full] [--reader N]\n", program);
+    printf("  %s info <файл>\n", program);
+    printf("  %s diff <файл1> <файл2>\n", program);
+}
+
+static void print_bytes(const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        printf("%02X", data[i]);
+    }
+}
+
+/**
+ * Подключение к считывателю с номером readerIndex (с 1)
+ */
+static int connect_card(CardService* service, CardRepository* repository, CardContext* context,
+                        size_t readerIndex) {
+    int result = card_service_initialize(service, repository, context);
+    if (result != CARD_SUCCESS) {
+        printf("Не удалось инициализировать сервис смарт-карт: %d\n", result);
+        return result;
+    }
+    
+    char* const* readers = NULL;
+    size_t readersCount = 0;
+    result = winscard_get_readers(context, &readers, &readersCount);
+    if (result != CARD_SUCCESS || readersCount == 0) {
+        printf("Считыватели не найдены.\n");
+        card_service_release(service);
+        return CARD_ERROR_INIT_FAILED;
+    }
+    
+    if (readerIndex < 1 || readerIndex > readersCount) {
+        printf("Неверный номер считывателя: %zu (доступно %zu)\n", readerIndex, readersCount);
+        card_service_release(service);
+        return CARD_ERROR_INVALID_PARAMETER;
+    }
+    
+    result = card_service_connect(service, readers[readerIndex - 1]);
+    if (result != CARD_SUCCESS) {
+        printf("Не удалось подключиться к карте в считывателе %s: %d\n", readers[readerIndex - 1], result);
+        card_service_release(service);
+    }
+    return result;
+}
+
+static int show_info(const char* path) {
+    CardImage image;
+    int result = card_image_open(&image, path);
+    if (result != CARD_SUCCESS) {
+        printf("Не удалось открыть образ %s: %d\n", path, result);
+        return 1;
+    }
+    
+    const CardImageHeader* header = image.header;
+    printf("Карта: %s\n", header->profileName[0] ? header->profileName : "неизвестна");
+    printf("ATR: ");
+    print_bytes(header->atr, header->atrLength);
+    printf("\nUID: ");
+    print_bytes(header->uid, header->uidLength);
+    printf("\nОбласть: %04X-%04X (%lu байт), страниц: %lu по %lu байт, прочитано: %lu\n",
+           (unsigned)header->baseOffset, (unsigned)(header->baseOffset + header->memorySize - 1),
+           (unsigned long)header->memorySize, (unsigned long)header->pageCount,
+           (unsigned long)header->pageSize, (unsigned long)header->presentPages);
+    
+    size_t badPage = 0;
+    if (card_image_verify(&image, &badPage) == CARD_SUCCESS) {
+        printf("Контрольные суммы страниц верны\n");
+    } else {
+        printf("Повреждена страница %zu\n", badPage);
+    }
+    
+    card_image_close(&image);
+    return 0;
+}
+
+static int show_diff(const char* leftPath, const char* rightPath) {
+    CardImage left;
+    CardImage right;
+    if (card_image_open(&left, leftPath) != CARD_SUCCESS) {
+        printf("Не удалось открыть образ %s\n", leftPath);
+        return 1;
+    }
+    if (card_image_open(&right, rightPath) != CARD_SUCCESS) {
+        printf("Не удалось открыть образ %s\n", rightPath);
+        card_image_close(&left);
+        return 1;
+    }
+    
+    uint32_t pages[64];
+    size_t count = 0;
+    int result = card_image_diff(&left, &right, pages, sizeof(pages) / sizeof(pages[0]), &count);
+    if (result != CARD_SUCCESS) {
+        printf("Образы описывают разные области памяти\n");
+    } else if (count == 0) {
+        printf("Образы совпадают\n");
+    } else {
+        printf("Различающихся страниц: %zu\n", count);
+        for (size_t i = 0; i < count && i < sizeof(pages) / sizeof(pages[0]); i++) {
+            printf("  %04lX\n", (unsigned long)(left.header->baseOffset + pages[i] * left.header->pageSize));
+        }
+    }
+    
+    card_image_close(&left);
+    card_image_close(&right);
+    return result == CARD_SUCCESS && count == 0 ? 0 : 2;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    
+    const char* command = argv[1];
+    if (strcmp(command, "info") == 0) {
+        return show_info(argv[2]);
+    }
+    if (strcmp(command, "diff") == 0 && argc >= 4) {
+        return show_diff(argv[2], argv[3]);
+    }
+    if (strcmp(command, "dump") != 0 && strcmp(command, "restore") != 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    
+    unsigned long offset = 0;
+    size_t length = 0;
+    size_t readerIndex = 1;
+    int differential = 1;
+    for (int i = 3; i < argc; i++) {
+        int hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--offset") == 0 && hasValue) {
+            offset = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--length") == 0 && hasValue) {
+            length = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--reader") == 0 && hasValue) {
+            readerIndex = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--full") == 0) {
+            differential = 0;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    
+    if (offset > CARD_SERVICE_MAX_OFFSET) {
+        printf("Адрес вне памяти карты: %lu\n", offset);
+        return 1;
+    }
+    
+    // Повреждённый образ отклоняется до подключения к карте
+    CardImage image;
+    int isRestore = strcmp(command, "restore") == 0;
+    if (isRestore) {
+        size_t badPage = 0;
+        if (card_image_open(&image, argv[2]) != CARD_SUCCESS) {
+            printf("Не удалось открыть образ %s\n", argv[2]);
+            return 1;
+        }
+        if (card_image_verify(&image, &badPage) != CARD_SUCCESS) {
+            printf("Повреждена страница %zu, образ не записан\n", badPage);
+            card_image_close(&image);
+            return 1;
+        }
+    }
+    
+    WinScardContext winscardContext;
+    CardContext context = { &winscardContext };
+    CardRepository repository = winscard_create_repository();
+    CardService service;
+    
+    if (connect_card(&service, &repository, &context, readerIndex) != CARD_SUCCESS) {
+        if (isRestore) {
+            card_image_close(&image);
+        }
+        return 1;
+    }
+    
+    CardImageStats stats;
+    int result;
+    if (!isRestore) {
+        result = card_image_dump(&service, argv[2], (uint16_t)offset, length, &stats);
+        if (result == CARD_SUCCESS) {
+            printf("Образ снят: %zu байт, страниц: %zu, не прочитано: %zu\n",
+                   stats.bytes, stats.pages, stats.missingPages);
+        }
+    } else {
+        result = card_image_restore(&service, &image, differential, &stats);
+        card_image_close(&image);
+        if (result == CARD_SUCCESS) {
+            printf("Образ записан: %zu байт", stats.bytes);
+            if (differential) {
+                printf(", команд: %zu", stats.commands);
+            }
+            printf(", пропущено страниц: %zu\n", stats.missingPages);
+        }
+    }
+    
+    if (result != CARD_SUCCESS) {
+        printf("Ошибка: %d\n", result);
+    }
+    
+    card_service_disconnect(&service);
+    card_service_release(&service);
+    return result == CARD_SUCCESS ? 0 : 1;
+} 
\ No newline at end of file
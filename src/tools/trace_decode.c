@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "card_trace.h"
+
+/**
+ * Утилита разбора трассы обмена (card_trace): выводит записи в порядке
+ * номеров и статистику времени выполнения по байтам инструкции.
+ *
+ * Использование: trace_decode <файл трассы> [--stats]
+ */
+
+typedef struct {
+    uint32_t* samples;       /* Длительности, мкс */
+    size_t count;
+    size_t capacity;
+    size_t errors;
+} TimingStats;
+
+static int compare_records(const void* left, const void* right) {
+    int64_t a = ((const CardTraceRecord*)left)->sequence;
+    int64_t b = ((const CardTraceRecord*)right)->sequence;
+    return (a > b) - (a < b);
+}
+
+static int compare_samples(const void* left, const void* right) {
+    uint32_t a = *(const uint32_t*)left;
+    uint32_t b = *(const uint32_t*)right;
+    return (a > b) - (a < b);
+}
+
+static int add_sample(TimingStats* stats, uint32_t elapsed, int failed) {
+    if (stats->count == stats->capacity) {
+        size_t capacity = stats->capacity ? stats->capacity * 2 : 64;
+        uint32_t* samples = (uint32_t*)realloc(stats->samples, capacity * sizeof(uint32_t));
+        if (!samples) {
+            return 0;
+        }
+        stats->samples = samples;
+        stats->capacity = capacity;
+    }
+    
+    stats->samples[stats->count++] = elapsed;
+    if (failed) {
+        stats->errors++;
+    }
+    return 1;
+}
+
+static void print_bytes(const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        printf("%02X", data[i]);
+    }
+}
+
+static void print_record(const CardTraceHeader* header, const CardTraceRecord* record, uint64_t origin) {
+    const char* reader = "?";
+    if (record->readerId < CARD_TRACE_MAX_READERS && header->readerState[record->readerId] == 2) {
+        reader = header->readerNames[record->readerId];
+    }
+    
+    printf("%8lld %12.3f мс %8lu мкс [%s] ", (long long)(record->sequence - 1),
+           (double)(record->timestamp - origin) / 1000000.0, (unsigned long)record->elapsed, reader);
+    
+    if (record->type == CARD_TRACE_CONNECT) {
+        printf("CONNECT");
+    } else {
+        print_bytes(record->data, record->commandStored);
+        if (record->commandStored < record->commandLength) {
+            printf("..(%u)", (unsigned)record->commandLength);
+        }
+        
+        printf(" -> ");
+        
+        const uint8_t* response = record->data + record->commandStored;
+        if (record->responseStored < record->responseLength) {
+            print_bytes(response, record->responseStored - 2u);
+            printf("..(%u) ", (unsigned)record->responseLength);
+            print_bytes(response + record->responseStored - 2, 2);
+        } else {
+            print_bytes(response, record->responseStored);
+        }
+    }
+    
+    if (record->result != 0) {
+        printf(" ошибка 0x%08lX", (unsigned long)(uint32_t)record->result);
+    }
+    printf("\n");
+}
+
+static void print_stats(const char* name, TimingStats* stats) {
+    if (stats->count == 0) {
+        return;
+    }
+    
+    qsort(stats->samples, stats->count, sizeof(uint32_t), compare_samples);
+    
+    uint64_t sum = 0;
+    for (size_t i = 0; i < stats->count; i++) {
+        sum += stats->samples[i];
+    }
+    
+    printf("%-10s %8zu %7zu %9llu %9lu %9lu %9lu %9lu %9lu\n", name, stats->count, stats->errors,
+           (unsigned long long)(sum / stats->count),
+           (unsigned long)stats->samples[0],
+           (unsigned long)stats->samples[(stats->count - 1) * 50 / 100],
+           (unsigned long)stats->samples[(stats->count - 1) * 90 / 100],
+           (unsigned long)stats->samples[(stats->count - 1) * 99 / 100],
+           (unsigned long)stats->samples[stats->count - 1]);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Использование: %s <файл трассы> [--stats]\n", argv[0]);
+        return 1;
+    }
+    
+    int statsOnly = argc > 2 && strcmp(argv[2], "--stats") == 0;
+    
+    FILE* file = fopen(argv[1], "rb");
+    if (!file) {
+        printf("Не удалось открыть файл трассы: %s\n", argv[1]);
+        return 1;
+    }
+    
+    // Заголовок занимает CARD_TRACE_HEADER_SIZE байт, структура — его начало
+    static uint8_t headerBlock[CARD_TRACE_HEADER_SIZE];
+    const CardTraceHeader* header = (const CardTraceHeader*)headerBlock;
+    
+    if (fread(headerBlock, 1, sizeof(headerBlock), file) != sizeof(headerBlock) ||
+        memcmp(header->magic, CARD_TRACE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != CARD_TRACE_VERSION || header->recordSize != CARD_TRACE_RECORD_SIZE) {
+        printf("Неизвестный формат трассы\n");
+        fclose(file);
+        return 1;
+    }
+    
+    uint32_t mask = header->recordCount - 1;
+    CardTraceRecord* records = (CardTraceRecord*)malloc((size_t)header->recordCount * sizeof(CardTraceRecord));
+    if (!records) {
+        printf("Недостаточно памяти\n");
+        fclose(file);
+        return 1;
+    }
+    
+    // Остаются только завершённые записи, лежащие в своей ячейке кольца
+    size_t count = 0;
+    for (uint32_t i = 0; i < header->recordCount; i++) {
+        CardTraceRecord* record = &records[count];
+        if (fread(record, sizeof(CardTraceRecord), 1, file) != 1) {
+            break;
+        }
+        if (record->sequence > 0 && ((uint64_t)(record->sequence - 1) & mask) == i &&
+            record->commandStored + record->responseStored <= CARD_TRACE_DATA_SIZE) {
+            count++;
+        }
+    }
+    fclose(file);
+    
+    qsort(records, count, sizeof(CardTraceRecord), compare_records);
+    
+    long long written = (long long)header->head;
+    printf("Записей в файле: %zu, всего записано: %lld, потеряно при переполнении: %lld\n\n",
+           count, written, written > (long long)count ? written - (long long)count : 0);
+    
+    TimingStats instructions[256];
+    TimingStats connects;
+    memset(instructions, 0, sizeof(instructions));
+    memset(&connects, 0, sizeof(connects));
+    
+    uint64_t origin = count > 0 ? records[0].timestamp : 0;
+    
+    for (size_t i = 0; i < count; i++) {
+        const CardTraceRecord* record = &records[i];
+        if (!statsOnly) {
+            print_record(header, record, origin);
+        }
+        
+        TimingStats* stats = &connects;
+        if (record->type == CARD_TRACE_TRANSMIT) {
+            if (record->commandStored < 2) {
+                continue;
+            }
+            stats = &instructions[record->data[1]];
+        }
+        
+        if (!add_sample(stats, record->elapsed, record->result != 0)) {
+            printf("Недостаточно памяти\n");
+            break;
+        }
+    }
+    
+    printf("\n%-10s %8s %7s %9s %9s %9s %9s %9s %9s\n", "Команда", "вызовов", "ошибок",
+           "среднее", "min", "p50", "p90", "p99", "max");
+    print_stats("CONNECT", &connects);
+    free(connects.samples);
+    
+    for (int ins = 0; ins < 256; ins++) {
+        char name[16];
+        snprintf(name, sizeof(name), "INS %02X", ins);
+        print_stats(name, &instructions[ins]);
+        free(instructions[ins].samples);
+    }
+    
+    free(records);
+    return 0;
+} 
\ No newline at end of file
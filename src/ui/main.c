@@ -1,9 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "card_domain.h"
 #include "card_operations.h"
 #include "card_service.h"
 #include "winscard_adapter.h"
+#include "card_personalize.h"
+#include "card_script_runner.h"
 
 void print_hex_data(const uint8_t* data, size_t length) {
     for (size_t i = 0; i < length; i++) {
@@ -13,7 +16,7 @@ void print_hex_data(const uint8_t* data, size_t length) {
     printf("\n");
 }
 
-void display_readers(char** readers, size_t readersCount) {
+void display_readers(char* const* readers, size_t readersCount) {
     printf("\nДоступные считыватели карт:\n");
     for (size_t i = 0; i < readersCount; i++) {
         printf("%zu. %s\n", i + 1, readers[i]);
@@ -21,11 +24,11 @@ void display_readers(char** readers, size_t readersCount) {
 }
 
 int select_reader(CardService* service, CardContext* context) {
-    char** readers = NULL;
+    char* const* readers = NULL;
     size_t readersCount = 0;
     
-    // Получаем список считывателей
-    int result = winscard_list_readers(context, &readers, &readersCount);
+    // Получаем список считывателей (кэшируется в контексте)
+    int result = winscard_get_readers(context, &readers, &readersCount);
     if (result != CARD_SUCCESS) {
         printf("Ошибка при получении списка считывателей: %d\n", result);
         return result;
@@ -38,9 +41,7 @@ int select_reader(CardService* service, CardContext* context) {
     
     if (readersCount == 1) {
         printf("Найден один считыватель: %s. Используем его.\n", readers[0]);
-        result = card_service_connect(service, readers[0]);
-        winscard_free_readers(readers, readersCount);
-        return result;
+        return card_service_connect(service, readers[0]);
     }
     
     // Вывод считывателей для выбора
@@ -52,19 +53,16 @@ int select_reader(CardService* service, CardContext* context) {
     
     if (selectedIndex < 1 || selectedIndex > readersCount) {
         printf("Неверный выбор.\n");
-        winscard_free_readers(readers, readersCount);
         return CARD_ERROR_INVALID_PARAMETER;
     }
     
-    result = card_service_connect(service, readers[selectedIndex - 1]);
-    winscard_free_readers(readers, readersCount);
-    return result;
+    return card_service_connect(service, readers[selectedIndex - 1]);
 }
 
 void read_card_example(CardService* service) {
     uint8_t address = 0x00;
     size_t length = 16;
-    CardData data = { NULL, 0 };
+    CardData data = { NULL, 0, NULL };
     
     printf("\nОтправка команды чтения на карту...\n");
     
@@ -96,7 +94,7 @@ void write_card_example(CardService* service) {
     uint8_t dataToWrite[] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88};
     uint8_t address = 0x10;
     
-    CardData data = { NULL, 0 };
+    CardData data = { NULL, 0, NULL };
     data.data = (uint8_t*)malloc(sizeof(dataToWrite));
     if (!data.data) {
         printf("Ошибка выделения памяти\n");
@@ -115,7 +113,7 @@ void write_card_example(CardService* service) {
         printf("Запись успешно выполнена\n");
         
         printf("\nЧтение данных для проверки записи...\n");
-        CardData readData = { NULL, 0 };
+        CardData readData = { NULL, 0, NULL };
         
         result = card_service_read_data(service, address, data.length, &readData);
         if (result == CARD_SUCCESS) {
@@ -132,7 +130,211 @@ void write_card_example(CardService* service) {
     free(data.data);
 }
 
-int main() {
+void print_usage(void) {
+    printf("Использование: smart_card_app --personalize <вход> <журнал> [параметры]\n");
+    printf("  --record-size N  двоичные записи по N байт (по умолчанию)\n");
+    printf("  --csv            строки CSV, столбцы в шестнадцатеричном виде\n");
+    printf("  --header         первая строка CSV — заголовок\n");
+    printf("  --length N       длина образа карты (для CSV обязательна)\n");
+    printf("  --offset A       адрес образа в памяти карты\n");
+    printf("  --attempts N     попыток на запись с разными картами\n");
+    printf("  --uid            записывать UID карты в журнал\n");
+    printf("       smart_card_app --script <файл> [параметры]\n");
+    printf("  --reader N       номер считывателя (по умолчанию 1)\n");
+    printf("  --stop           остановиться на первом неожиданном статусе\n");
+    printf("  --raw            без автоматического GET RESPONSE и цепочек\n");
+}
+
+/**
+ * Неинтерактивный режим: персонализация на всех подключённых считывателях
+ */
+int run_personalization(int argc, char* argv[]) {
+    CardPersoConfig config;
+    card_perso_default_config(&config);
+    config.waitForCards = 1;
+    
+    for (int i = 4; i < argc; i++) {
+        int hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--csv") == 0) {
+            config.format = CARD_PERSO_INPUT_CSV;
+        } else if (strcmp(argv[i], "--header") == 0) {
+            config.skipHeader = 1;
+        } else if (strcmp(argv[i], "--uid") == 0) {
+            config.readUid = 1;
+        } else if (strcmp(argv[i], "--record-size") == 0 && hasValue) {
+            config.recordSize = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--length") == 0 && hasValue) {
+            config.imageLength = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--offset") == 0 && hasValue) {
+            config.cardOffset = (uint16_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--attempts") == 0 && hasValue) {
+            config.maxAttempts = strtoul(argv[++i], NULL, 0);
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+    
+    // Двоичная запись целиком становится образом карты
+    if (config.imageLength == 0) {
+        config.imageLength = config.recordSize;
+    }
+    
+    WinScardContext winscardContext;
+    CardContext cardContext = { &winscardContext };
+    CardRepository repository = winscard_create_repository();
+    
+    int result = repository.initialize(&cardContext);
+    if (result != CARD_SUCCESS) {
+        printf("Не удалось инициализировать сервис смарт-карт: %d\n", result);
+        return 1;
+    }
+    
+    char* const* readers = NULL;
+    size_t readersCount = 0;
+    result = winscard_get_readers(&cardContext, &readers, &readersCount);
+    if (result != CARD_SUCCESS || readersCount == 0) {
+        printf("Считыватели не найдены.\n");
+        repository.release(&cardContext);
+        return 1;
+    }
+    
+    config.repository = &repository;
+    config.contextSize = sizeof(WinScardContext);
+    config.readerNames = (const char* const*)readers;
+    config.readerCount = readersCount;
+    
+    printf("Персонализация на %zu считывателях. Вставляйте карты.\n", readersCount);
+    
+    CardPersoPipeline pipeline;
+    result = card_perso_run(&pipeline, &config, argv[2], argv[3]);
+    if (result == CARD_ERROR_INVALID_PARAMETER) {
+        print_usage();
+        repository.release(&cardContext);
+        return 1;
+    }
+    
+    const CardPersoStats* stats = &pipeline.stats;
+    printf("Записей: %zu, записано карт: %zu, ошибок: %zu, повторов: %zu, неразобранных записей: %zu\n",
+           stats->records, stats->personalized, stats->failed, stats->retries, stats->malformed);
+    printf("Производительность: %.0f карт в час\n", stats->cardsPerHour);
+    
+    repository.release(&cardContext);
+    return result == CARD_SUCCESS ? 0 : 1;
+}
+
+/**
+ * Неинтерактивный режим: выполнение сценария APDU с замером задержек
+ */
+int run_script(int argc, char* argv[]) {
+    size_t readerIndex = 1;
+    int stopOnMismatch = 0;
+    int raw = 0;
+    
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--stop") == 0) {
+            stopOnMismatch = 1;
+        } else if (strcmp(argv[i], "--raw") == 0) {
+            raw = 1;
+        } else if (strcmp(argv[i], "--reader") == 0 && i + 1 < argc) {
+            readerIndex = strtoul(argv[++i], NULL, 0);
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+    
+    // Сценарий разбирается до подключения: ошибка в тексте не требует карты
+    CardScriptRun run;
+    size_t errorLine = 0;
+    int result = card_script_load(&run, argv[2], &errorLine);
+    if (result != CARD_SUCCESS) {
+        if (errorLine > 0) {
+            printf("Ошибка в сценарии %s, строка %zu\n", argv[2], errorLine);
+        } else {
+            printf("Не удалось загрузить сценарий %s: %d\n", argv[2], result);
+        }
+        return 1;
+    }
+    
+    WinScardContext winscardContext;
+    CardContext cardContext = { &winscardContext };
+    CardRepository repository = winscard_create_repository();
+    CardService service;
+    
+    result = card_service_initialize(&service, &repository, &cardContext);
+    if (result != CARD_SUCCESS) {
+        printf("Не удалось инициализировать сервис смарт-карт: %d\n", result);
+        card_script_unload(&run);
+        return 1;
+    }
+    
+    char* const* readers = NULL;
+    size_t readersCount = 0;
+    result = winscard_get_readers(&cardContext, &readers, &readersCount);
+    if (result != CARD_SUCCESS || readerIndex < 1 || readerIndex > readersCount) {
+        printf("Считыватель %zu не найден.\n", readerIndex);
+        card_service_release(&service);
+        card_script_unload(&run);
+        return 1;
+    }
+    
+    result = card_service_connect(&service, readers[readerIndex - 1]);
+    if (result != CARD_SUCCESS) {
+        printf("Не удалось подключиться к карте в считывателе %s: %d\n", readers[readerIndex - 1], result);
+        card_service_release(&service);
+        card_script_unload(&run);
+        return 1;
+    }
+    
+    if (raw) {
+        card_service_set_auto_exchange(&service, 0);
+    }
+    
+    result = card_script_execute(&run, &service, stopOnMismatch);
+    
+    // Задержки по шагам: строка сценария, выполнений, среднее, минимум и максимум в мкс
+    printf("Строка  Выполнений  Среднее, мкс  Мин, мкс  Макс, мкс  Неожиданных\n");
+    for (size_t i = 0; i < run.program.count; i++) {
+        const CardScriptStepStats* step = &run.steps[i];
+        if (step->count == 0) {
+            continue;
+        }
+        printf("%6lu  %10llu  %12.1f  %8.1f  %9.1f  %11llu\n",
+               (unsigned long)run.program.lines[i], (unsigned long long)step->count,
+               (double)step->totalNs / (double)step->count / 1000.0,
+               (double)step->minNs / 1000.0, (double)step->maxNs / 1000.0,
+               (unsigned long long)step->mismatches);
+    }
+    
+    double seconds = (double)run.elapsedNs / 1e9;
+    printf("Команд: %llu за %.3f с (%.0f команд/с), неожиданных статусов: %llu\n",
+           (unsigned long long)run.commands, seconds,
+           seconds > 0 ? (double)run.commands / seconds : 0.0, (unsigned long long)run.mismatches);
+    if (run.hasFailure) {
+        printf("Первая ошибка: строка %lu", (unsigned long)run.program.lines[run.failedInstruction]);
+        if (result == CARD_ERROR_BAD_STATUS) {
+            printf(", статус %04X", (unsigned)run.failedStatus);
+        } else {
+            printf(", код %d", result);
+        }
+        printf("\n");
+    }
+    
+    card_service_disconnect(&service);
+    card_service_release(&service);
+    card_script_unload(&run);
+    return result == CARD_SUCCESS ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc >= 4 && strcmp(argv[1], "--personalize") == 0) {
+        return run_personalization(argc, argv);
+    }
+    if (argc >= 3 && strcmp(argv[1], "--script") == 0) {
+        return run_script(argc, argv);
+    }
+    
     printf("Сервис работы со смарт-картами (Луковая архитектура)\n");
     printf("===================================================\n");
     
@@ -161,6 +363,22 @@ int main() {
     
     printf("\nПодключение к карте успешно установлено\n");
     
+    // Согласованный протокол, параметры канала и профиль карты
+    WinScardLinkInfo link;
+    if (winscard_get_link_info(&cardContext, &link) == CARD_SUCCESS) {
+        printf("Протокол: T=%d", link.protocol == SCARD_PROTOCOL_T1 ? 1 : 0);
+        if (link.ifsd > 0) {
+            printf(", IFSD: %lu", (unsigned long)link.ifsd);
+        }
+        if (link.baudRate > 0) {
+            printf(", скорость: %lu бит/с", (unsigned long)link.baudRate);
+        }
+        printf("\n");
+    }
+    if (service.profile) {
+        printf("Карта: %s\n", service.profile->name);
+    }
+    
     // Главное меню
     int choice;
     do {